@@ -1,7 +1,43 @@
 -- benchmark_data
 -- @short: Retrieve gathered benchmarking values.
--- @outargs: nticks, tickcosttbl, framecount, frametimetbl, costcount, framecosttbl
+-- @outargs: nticks, tickcosttbl, framecount, frametimetbl, costcount, framecosttbl, pipelinetbl
+-- @longdescr: Returns the sample rings gathered since the last call to
+-- benchmark_enable, along with *pipelinetbl* that covers the most recently
+-- completed frame. The *pipelinetbl* fields are: objects (number of objects
+-- visited while processing rendertargets), draw_calls (number of draw
+-- calls that were issued for those objects) and upload_bytes (number of
+-- bytes synched from frameserver buffers to textures) and redraw_px (number
+-- of rendertarget pixels that were cleared and redrawn, only the regions
+-- that changed are redrawn unless ARCAN_VIDEO_NODAMAGE is set). The ratio
+-- between objects and draw_calls indicates how well consecutive objects
+-- could be batched together. The culled field is the number of objects that
+-- were not drawn as they were entirely covered by opaque objects in front
+-- of them (unrotated and unclipped, blended with BLEND_NONE or at full
+-- opacity from a store without an alpha channel). The drawn_3d and culled_3d
+-- fields count the geometry nodes of 3D models that were submitted and those
+-- that were skipped as their bounding box is outside the camera frustum.
+-- Nodes that share mesh and material are drawn instanced, so with shaders
+-- that use the instance_modelview attribute (see ref:build_shader), draw_calls
+-- can be far lower than drawn_3d.
+-- The glyph_hits, glyph_misses and glyph_evictions fields are running totals
+-- for the glyph caches used when rendering text, summed over all threads
+-- (e.g. asynchronous loaders), and glyph_bytes is their current size. A high rate of misses and evictions means
+-- the cache is too small for the active set of fonts and sizes, see the
+-- ARCAN_GLYPH_CACHE environment variable. The asynch_ fields cover the
+-- worker pool used by load_image_asynch: asynch_queued is the number of
+-- loads waiting for a worker and asynch_peak the most that have been
+-- waiting at once, asynch_completed and asynch_cancelled count loads that
+-- finished or were dropped as their object was deleted first, and
+-- asynch_decode_ms / asynch_decode_max_ms are the total and worst decode
+-- times in milliseconds. The image_hits, image_misses and image_evictions
+-- fields are running totals for the cache of decoded images shared between
+-- load_image calls, and image_bytes is its current size, see the
+-- ARCAN_IMAGE_CACHE environment variable. The mem_vbuffer_, mem_abuffer_,
+-- mem_vstruct_ and mem_string_ prefixed fields cover the engine memory
+-- pools for pixel buffers, audio buffers, video pipeline structures and
+-- strings: _alloc is the running total of allocations served by the pool,
+-- _in_use the number of bytes currently handed out and _pages the number
+-- of pages held by the pool, including freed ones kept around for reuse.
 -- @group: system
 -- @cfunction: getbenchvals
 -- @related: benchmark_enable, benchmark_timestamp
-
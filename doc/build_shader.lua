@@ -26,7 +26,13 @@
 -- @note: For GLSL120, reserved attributes are:
 -- vertex (vec4), normal (vec3), color (vec4), texcoord (vec2),
 -- texcoord1 (vec2), tangent (vec3), bitangent (vec3), joints (ivec4),
--- weights (vec4)
+-- weights (vec4), instance_modelview (mat4)
+-- @note: 3D models that share program, textures, blend mode, opacity and
+-- mesh contents are drawn as instances of one another. A vertex program that
+-- reads its modelview matrix from the instance_modelview attribute rather
+-- than the modelview uniform lets these be drawn with a single draw call,
+-- otherwise they are drawn one at a time with the uniform updated in between.
+-- Such a program should only be used on 3D models.
 -- @note: For GLSL120, reserved uniforms are:
 -- modelview (mat4), projection (mat4), texturem (mat4),
 -- trans_move (float, 0.0 .. 1.0), trans_scale (float, 0.0 .. 1.0)
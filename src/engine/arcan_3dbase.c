@@ -14,6 +14,7 @@
 #include <string.h>
 #include <stdarg.h>
 #include <inttypes.h>
+#include <float.h>
 
 #include <assert.h>
 
@@ -51,6 +52,18 @@ struct geometry {
 	bool threaded;
 
 	pthread_t worker;
+
+/* object space bounds of the vertices this node uses, and those bounds in
+ * world space for the transform cached in the model. [bounded] is false
+ * for nodes that can't be culled (no usable vertices, skinned) */
+	bool bounds_valid, bounded;
+	vector bbmin, bbmax;
+	vector wmin, wmax;
+
+/* cached mesh_hash() of the store */
+	bool hashed;
+	uint64_t hash;
+
 	struct geometry* next;
 };
 
@@ -65,6 +78,15 @@ typedef struct {
 	vector bbmax;
 	float radius;
 
+/* world space AABB for the transform the model was last drawn with, only
+ * rebuilt when that transform (or the vertices) change */
+	struct {
+		bool valid, bounded;
+		vector position, scale;
+		quat rotation;
+		vector wmin, wmax;
+	} world;
+
 /* position, opacity etc. are inherited from parent */
 	struct {
 /* debug geometry (position, normals, bounding box, ...) */
@@ -240,12 +262,251 @@ static void push_deferred(arcan_3dmodel* model)
 	}
 }
 
+static void minmax_verts(vector* minp, vector* maxp,
+	const float* verts, unsigned nverts)
+{
+	for (size_t i = 0; i < nverts * 3; i += 3){
+		vector a = {.x = verts[i], .y = verts[i+1], .z = verts[i+2]};
+		if (a.x < minp->x) minp->x = a.x;
+		if (a.y < minp->y) minp->y = a.y;
+		if (a.z < minp->z) minp->z = a.z;
+		if (a.x > maxp->x) maxp->x = a.x;
+		if (a.y > maxp->y) maxp->y = a.y;
+		if (a.z > maxp->z) maxp->z = a.z;
+	}
+}
+
+static bool geometry_bounds(struct geometry* geom)
+{
+	struct agp_mesh_store* store = &geom->store;
+
+/* joints are animated in the shader, so the vertices don't say where it ends up */
+	if (!store->verts || !store->n_vertices ||
+		store->vertex_size != 3 || store->joints)
+		return false;
+
+	vector minv = {.x = FLT_MAX, .y = FLT_MAX, .z = FLT_MAX};
+	vector maxv = {.x = -FLT_MAX, .y = -FLT_MAX, .z = -FLT_MAX};
+
+/* nodes can share vertices and only index a part of them */
+	if (store->indices && store->n_indices){
+		for (size_t i = 0; i < store->n_indices; i++){
+			if (store->indices[i] >= store->n_vertices)
+				continue;
+			minmax_verts(&minv, &maxv, &store->verts[store->indices[i] * 3], 1);
+		}
+	}
+	else
+		minmax_verts(&minv, &maxv, store->verts, store->n_vertices);
+
+	if (minv.x > maxv.x)
+		return false;
+
+	geom->bbmin = minv;
+	geom->bbmax = maxv;
+	return true;
+}
+
+/* AABB of the box [minv, maxv] transformed by [m] (Arvo, Graphics Gems) */
+static void transform_aabb(const float* m,
+	vector minv, vector maxv, vector* dmin, vector* dmax)
+{
+	float a[3] = {minv.x, minv.y, minv.z};
+	float b[3] = {maxv.x, maxv.y, maxv.z};
+	float lo[3] = {m[12], m[13], m[14]};
+	float hi[3] = {m[12], m[13], m[14]};
+
+	for (size_t i = 0; i < 3; i++)
+		for (size_t j = 0; j < 3; j++){
+			float e = m[j * 4 + i] * a[j];
+			float f = m[j * 4 + i] * b[j];
+			lo[i] += e < f ? e : f;
+			hi[i] += e < f ? f : e;
+		}
+
+	*dmin = (vector){.x = lo[0], .y = lo[1], .z = lo[2]};
+	*dmax = (vector){.x = hi[0], .y = hi[1], .z = hi[2]};
+}
+
+/* the vertices of [model] have changed */
+static void invalidate_geometry(arcan_3dmodel* model)
+{
+	model->world.valid = false;
+	for (struct geometry* geom = model->geometry; geom; geom = geom->next){
+		geom->bounds_valid = false;
+		geom->hashed = false;
+	}
+}
+
+/* rebuild the world space bounds of [src] and its nodes if the transform
+ * that produced [model] isn't the one they were built for */
+static void update_bounds(arcan_3dmodel* src,
+	const surface_properties* props, const float* model)
+{
+	if (src->world.valid &&
+		memcmp(&src->world.position, &props->position, sizeof(vector)) == 0 &&
+		memcmp(&src->world.scale, &props->scale, sizeof(vector)) == 0 &&
+		memcmp(&src->world.rotation,
+			&props->rotation.quaternion, sizeof(quat)) == 0)
+		return;
+
+	src->world.valid = true;
+	src->world.bounded = src->geometry != NULL;
+	src->world.position = props->position;
+	src->world.scale = props->scale;
+	src->world.rotation = props->rotation.quaternion;
+	src->world.wmin = (vector){.x = FLT_MAX, .y = FLT_MAX, .z = FLT_MAX};
+	src->world.wmax = (vector){.x = -FLT_MAX, .y = -FLT_MAX, .z = -FLT_MAX};
+
+	for (struct geometry* geom = src->geometry; geom; geom = geom->next){
+		if (!geom->bounds_valid){
+			geom->bounded = geometry_bounds(geom);
+			geom->bounds_valid = true;
+		}
+
+		if (!geom->bounded){
+			src->world.bounded = false;
+			continue;
+		}
+
+		transform_aabb(model, geom->bbmin, geom->bbmax, &geom->wmin, &geom->wmax);
+		minmax_verts(&src->world.wmin, &src->world.wmax, geom->wmin.xyz, 1);
+		minmax_verts(&src->world.wmin, &src->world.wmax, geom->wmax.xyz, 1);
+	}
+}
+
+static enum cstate cull_aabb(const float frustum[6][4], vector minv, vector maxv)
+{
+	return frustum_aabb(frustum, minv.x, minv.y, minv.z, maxv.x, maxv.y, maxv.z);
+}
+
 /*
  * Render-loops, Pass control, Initialization
  */
-static void rendermodel(arcan_vobject* vobj, arcan_3dmodel* src,
+/*
+ * Identity of the mesh data of a node, so that nodes from different models
+ * that were built the same way (e.g. a grid of arcan_3d_buildbox models) can
+ * be drawn as instances of one mesh. Vertices, texture coordinates, normals
+ * and indices are compared by content, the less common attributes only by
+ * buffer as their sizes aren't tracked.
+ */
+static uint64_t hash_bytes(uint64_t h, const void* buf, size_t n)
+{
+	const uint8_t* in = buf;
+	for (size_t i = 0; i < n; i++){
+		h ^= in[i];
+		h *= 0x100000001b3ull;
+	}
+	return h;
+}
+
+static uint64_t mesh_hash(struct geometry* geom)
+{
+	if (geom->hashed)
+		return geom->hash;
+
+	struct agp_mesh_store* s = &geom->store;
+	size_t nv = s->n_vertices;
+
+	struct {
+		const void* buf;
+		size_t sz;
+	} data[] = {
+		{s->verts, nv * s->vertex_size * sizeof(float)},
+		{s->txcos, nv * 2 * sizeof(float)},
+		{s->normals, nv * 3 * sizeof(float)},
+		{s->indices, s->n_indices * sizeof(unsigned)}
+	};
+
+	uintptr_t hdr[] = {
+		s->type, s->depth_func, s->nodepth,
+		s->vertex_size, nv, s->n_indices,
+		(!!s->verts) | (!!s->txcos << 1) | (!!s->normals << 2) | (!!s->indices << 3),
+		(uintptr_t) s->txcos2, (uintptr_t) s->colors,
+		(uintptr_t) s->tangents, (uintptr_t) s->bitangents,
+		(uintptr_t) s->weights, (uintptr_t) s->joints
+	};
+
+	uint64_t h = hash_bytes(0xcbf29ce484222325ull, hdr, sizeof(hdr));
+	for (size_t i = 0; i < COUNT_OF(data); i++)
+		if (data[i].buf)
+			h = hash_bytes(h, data[i].buf, data[i].sz);
+
+	geom->hash = h;
+	geom->hashed = true;
+	return h;
+}
+
+/*
+ * The passes don't draw models as they go. Visible geometry nodes are put
+ * in a queue along with the state they need, and the normal pass sorts it
+ * so that neighbours share as much of that state as possible: opaque nodes
+ * by program, then textures, then mesh, and blended ones back to front.
+ * Runs that end up with the same mesh and material are drawn instanced.
+ */
+struct draw_item {
+	_Alignas(16) float modelview[16];
+
+	struct geometry* geom;
+	agp_shader_id program;
+
+/* the store to activate, unless [nmaps] > 1 where the maps are taken from
+ * the frameset starting at [fset_ofs]. NULL for nodes without maps */
+	arcan_vobject* vobj;
+	struct agp_vstore* vstore;
+	size_t nmaps, fset_ofs;
+
+	enum arcan_blendfunc blend;
+	enum agp_mesh_flags flags;
+	bool blended;
+	float opa;
+
+/* view space depth of the model origin, and the order it was queued in */
+	float depth;
+	size_t seq;
+};
+
+static struct {
+	struct draw_item* items;
+	float* matrices;
+	size_t count, limit;
+} draw_queue;
+
+static bool queue_grow()
+{
+	size_t limit = draw_queue.limit ? draw_queue.limit * 2 : 256;
+
+	struct draw_item* items = arcan_alloc_mem(sizeof(struct draw_item) * limit,
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_SIMD);
+	float* matrices = arcan_alloc_mem(sizeof(float) * 16 * limit,
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_SIMD);
+
+	if (!items || !matrices){
+		arcan_mem_free(items);
+		arcan_mem_free(matrices);
+		return false;
+	}
+
+	if (draw_queue.count)
+		memcpy(items, draw_queue.items,
+			sizeof(struct draw_item) * draw_queue.count);
+
+	arcan_mem_free(draw_queue.items);
+	arcan_mem_free(draw_queue.matrices);
+	draw_queue.items = items;
+	draw_queue.matrices = matrices;
+	draw_queue.limit = limit;
+	return true;
+}
+
+/*
+ * [frustum] is in world space, NULL to queue regardless of visibility. The
+ * model is tested as a whole first, and only if it straddles the frustum
+ * are its geometry nodes tested one by one.
+ */
+static void queue_model(arcan_vobject* vobj, arcan_3dmodel* src,
 	agp_shader_id baseprog, surface_properties props, float* view,
-	enum agp_mesh_flags flags)
+	const float (*frustum)[4], enum agp_mesh_flags flags)
 {
 	assert(vobj);
 
@@ -266,45 +527,183 @@ static void rendermodel(arcan_vobject* vobj, arcan_3dmodel* src,
 	translate_matrix(scale, props.position.x, props.position.y, props.position.z);
 	multiply_matrix(model, scale, orient);
 
+	arcan_benchdata* stats = arcan_bench_data();
+	enum cstate vis = inside;
+
+	if (frustum){
+		update_bounds(src, &props, model);
+		if (src->world.bounded)
+			vis = cull_aabb(frustum, src->world.wmin, src->world.wmax);
+
+		if (vis == outside){
+			for (struct geometry* geom = src->geometry; geom; geom = geom->next)
+				stats->acc.culled_3d++;
+			return;
+		}
+	}
+
 	float _Alignas(16) out[16];
 	multiply_matrix(out, view, model);
 
-	agp_shader_envv(MODELVIEW_MATR, out, sizeof(float) * 16);
-	agp_shader_envv(OBJ_OPACITY, &props.opa, sizeof(float));
+/* same rule as the 2D pipeline uses for picking the blend state */
+	bool blended = vobj->blendmode == BLEND_FORCE ||
+		(vobj->blendmode != BLEND_NONE && props.opa < 1.0 - EPSILON);
 
 	struct geometry* base = src->geometry;
-
-	agp_blendstate(vobj->blendmode);
 	int fset_ofs = vobj->frameset ? vobj->frameset->index : 0;
 
 	while (base){
-		agp_shader_activate(base->program > 0 ? base->program : baseprog);
-
-		if (!vobj->frameset)
-			agp_activate_vstore(vobj->vstore);
-		else {
-			if (base->nmaps == 1){
-				agp_activate_vstore(vobj->frameset->frames[fset_ofs].frame);
-				fset_ofs = (fset_ofs + 1) % vobj->frameset->n_frames;
-			}
-			else if (base->nmaps > 1){
-				struct agp_vstore* backing[base->nmaps];
-				for (size_t i = 0; i < base->nmaps; i++){
-					backing[i] = vobj->frameset->frames[fset_ofs].frame;
-					fset_ofs = (fset_ofs + 1) % vobj->frameset->n_frames;
-				}
-				agp_activate_vstore_multi(backing, base->nmaps);
-			}
-			else
-				;
+/* the frameset offset still has to move past the maps of a culled node */
+		if (vis == intersect && base->bounded && src->geometry->next &&
+			cull_aabb(frustum, base->wmin, base->wmax) == outside){
+			if (vobj->frameset && base->nmaps)
+				fset_ofs = (fset_ofs + base->nmaps) % vobj->frameset->n_frames;
+			stats->acc.culled_3d++;
+			base = base->next;
+			continue;
 		}
 
-		agp_shader_envv(MODELVIEW_MATR, out, sizeof(float) * 16);
-		agp_submit_mesh(&base->store, flags);
+		if (draw_queue.count == draw_queue.limit && !queue_grow())
+			return;
+
+		struct draw_item* item = &draw_queue.items[draw_queue.count];
+		*item = (struct draw_item){
+			.geom = base,
+			.program = base->program > 0 ? base->program : baseprog,
+			.vobj = vobj,
+			.blend = vobj->blendmode,
+			.flags = flags,
+			.blended = blended,
+			.opa = props.opa,
+			.depth = out[14],
+			.seq = draw_queue.count
+		};
+		memcpy(item->modelview, out, sizeof(float) * 16);
+
+		if (!vobj->frameset){
+			item->vstore = vobj->vstore;
+			item->nmaps = 1;
+		}
+		else if (base->nmaps){
+			item->vstore = vobj->frameset->frames[fset_ofs].frame;
+			item->nmaps = base->nmaps;
+			item->fset_ofs = fset_ofs;
+			fset_ofs = (fset_ofs + base->nmaps) % vobj->frameset->n_frames;
+		}
+
+		draw_queue.count++;
 		base = base->next;
 	}
 }
 
+static bool same_maps(const struct draw_item* a, const struct draw_item* b)
+{
+	if (a->nmaps > 1 || b->nmaps > 1)
+		return a->nmaps == b->nmaps && a->fset_ofs == b->fset_ofs &&
+			a->vobj->frameset == b->vobj->frameset;
+
+	return a->vstore == b->vstore;
+}
+
+#define CMP(A, B) if ((A) != (B)) return (A) < (B) ? -1 : 1;
+static int item_cmp(const void* va, const void* vb)
+{
+	const struct draw_item* a = va;
+	const struct draw_item* b = vb;
+
+	CMP(a->blended, b->blended);
+
+/* farthest (most negative z) first */
+	if (a->blended){
+		CMP(a->depth, b->depth);
+		return a->seq < b->seq ? -1 : 1;
+	}
+
+	CMP(a->program, b->program);
+	CMP((uintptr_t) a->vstore, (uintptr_t) b->vstore);
+	CMP(a->nmaps, b->nmaps);
+	CMP((uintptr_t) (a->nmaps > 1 ? a->vobj->frameset : NULL),
+		(uintptr_t) (b->nmaps > 1 ? b->vobj->frameset : NULL));
+	CMP(a->fset_ofs, b->fset_ofs);
+	CMP(mesh_hash(a->geom), mesh_hash(b->geom));
+	CMP(a->blend, b->blend);
+	CMP(a->flags, b->flags);
+	CMP(a->opa, b->opa);
+
+	return a->seq < b->seq ? -1 : 1;
+}
+#undef CMP
+
+static bool same_instance(const struct draw_item* a, const struct draw_item* b)
+{
+	return a->program == b->program && same_maps(a, b) &&
+		a->blend == b->blend && a->flags == b->flags && a->opa == b->opa &&
+		(a->geom == b->geom || (
+			a->geom->store.n_vertices == b->geom->store.n_vertices &&
+			a->geom->store.n_indices == b->geom->store.n_indices &&
+			mesh_hash(a->geom) == mesh_hash(b->geom)));
+}
+
+/*
+ * Draw and empty the queue, optionally [sorted]. Program, textures, blend
+ * state and opacity are only changed when they differ from the previous
+ * run, and each run of [same_instance] items is one agp_submit_mesh_instanced.
+ */
+static void flush_queue(bool sorted)
+{
+	if (!draw_queue.count)
+		return;
+
+	if (sorted)
+		qsort(draw_queue.items,
+			draw_queue.count, sizeof(struct draw_item), item_cmp);
+
+	arcan_benchdata* stats = arcan_bench_data();
+	struct draw_item* last = NULL;
+
+	for (size_t i = 0; i < draw_queue.count;){
+		struct draw_item* item = &draw_queue.items[i];
+		size_t n = 0;
+
+		while (i + n < draw_queue.count &&
+			same_instance(item, &draw_queue.items[i + n])){
+			memcpy(&draw_queue.matrices[n * 16],
+				draw_queue.items[i + n].modelview, sizeof(float) * 16);
+			n++;
+		}
+
+		if (!last || last->program != item->program)
+			agp_shader_activate(item->program);
+
+		if (!last || !same_maps(last, item)){
+			if (item->nmaps > 1){
+				struct agp_vstore* backing[item->nmaps];
+				struct vobject_frameset* fset = item->vobj->frameset;
+				for (size_t j = 0; j < item->nmaps; j++)
+					backing[j] = fset->frames[(item->fset_ofs + j) % fset->n_frames].frame;
+				agp_activate_vstore_multi(backing, item->nmaps);
+			}
+			else if (item->vstore)
+				agp_activate_vstore(item->vstore);
+		}
+
+		if (!last || last->blend != item->blend)
+			agp_blendstate(item->blend);
+
+		if (!last || last->opa != item->opa)
+			agp_shader_envv(OBJ_OPACITY, &item->opa, sizeof(float));
+
+		stats->acc.draw_calls += agp_submit_mesh_instanced(
+			&item->geom->store, item->flags, draw_queue.matrices, n);
+		stats->acc.drawn_3d += n;
+
+		last = item;
+		i += n;
+	}
+
+	draw_queue.count = 0;
+}
+
 enum arcan_ffunc_rv arcan_ffunc_3dobj FFUNC_HEAD
 {
 	if ( (state.tag == ARCAN_TAG_3DOBJ ||
@@ -371,17 +770,19 @@ static arcan_vobject_litem* process_scene_infinite(
 		surface_properties dprops;
 
 		arcan_resolve_vidprop(cvo, lerp, &dprops);
-		rendermodel(cvo, obj3d, cvo->program,
-				dprops, modelview, flags | MESH_FACING_NODEPTH);
+		queue_model(cvo, obj3d, cvo->program,
+				dprops, modelview, NULL, flags | MESH_FACING_NODEPTH);
 
 		current = current->next;
 	}
 
+/* these are drawn in order, around the camera and behind everything else */
+	flush_queue(false);
 	return current;
 }
 
-static void process_scene_normal(arcan_vobject_litem* cell,
-	float lerp, float* modelview, enum agp_mesh_flags flags)
+static void process_scene_normal(arcan_vobject_litem* cell, float lerp,
+	float* modelview, const float (*frustum)[4], enum agp_mesh_flags flags)
 {
 	arcan_vobject_litem* current = cell;
 	struct rendertarget* rtgt = arcan_vint_current_rt();
@@ -414,10 +815,12 @@ static void process_scene_normal(arcan_vobject_litem* cell,
 			dprops = cvo->current;
 		else
 			arcan_resolve_vidprop(cvo, lerp, &dprops);
-		rendermodel(cvo, model, cvo->program, dprops, modelview, flags);
+		queue_model(cvo, model, cvo->program, dprops, modelview, frustum, flags);
 
 		current = current->next;
 	}
+
+	flush_queue(true);
 }
 
 arcan_errc arcan_3d_bindvr(arcan_vobj_id id, struct arcan_vr_ctx* vrref)
@@ -527,23 +930,14 @@ arcan_vobject_litem* arcan_3d_refresh(arcan_vobj_id camtag,
 	translate_matrix(dmatr, dprop.position.x, dprop.position.y, dprop.position.z);
 	memcpy(cdata->mvm, dmatr, sizeof(float) * 16);
 
-	process_scene_normal(cell, fract, dmatr, camera->flags);
+/* infinite geometry surrounds the camera, so only cull the normal scene */
+	float frustum[6][4];
+	update_frustum(camera->projection, dmatr, frustum);
 
-	return cell;
-}
+	process_scene_normal(cell, fract, dmatr,
+		(const float (*)[4]) frustum, camera->flags);
 
-static void minmax_verts(vector* minp, vector* maxp,
-	const float* verts, unsigned nverts)
-{
-	for (size_t i = 0; i < nverts * 3; i += 3){
-		vector a = {.x = verts[i], .y = verts[i+1], .z = verts[i+2]};
-		if (a.x < minp->x) minp->x = a.x;
-		if (a.y < minp->y) minp->y = a.y;
-		if (a.z < minp->z) minp->z = a.z;
-		if (a.x > maxp->x) maxp->x = a.x;
-		if (a.y > maxp->y) maxp->y = a.y;
-		if (a.z > maxp->z) maxp->z = a.z;
-	}
+	return cell;
 }
 
 /* Go through the indices of a model and reverse the winding-
@@ -591,6 +985,7 @@ arcan_errc arcan_3d_swizzlemodel(arcan_vobj_id dst)
 		curr = curr->next;
 	}
 
+	invalidate_geometry(model);
 	pthread_mutex_unlock(&model->lock);
 	return rv;
 }
@@ -1429,6 +1824,8 @@ arcan_errc arcan_3d_scalevertices(arcan_vobj_id vid)
 	dst->bbmax.y += ty; dst->bbmin.y += ty;
 	dst->bbmax.z += tz; dst->bbmin.z += tz;
 
+	invalidate_geometry(dst);
+
 	while(geom){
 		for (unsigned i = 0; i < geom->store.n_vertices * 3; i += 3){
 			geom->store.verts[i]   = tx + geom->store.verts[i]   * sf;
@@ -1528,6 +1925,7 @@ arcan_errc arcan_3d_baseorient(arcan_vobj_id dst,
 	matr_quatf(repr, matr);
 
 /* 2. iterate all geometries connected to the model */
+	invalidate_geometry(model);
 	while (geom){
 		float* verts = geom->store.verts;
 
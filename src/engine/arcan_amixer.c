@@ -0,0 +1,508 @@
+/*
+ * Copyright 2019, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in the arcan source repository.
+ * Reference: https://arcan-fe.com
+ * Description: Audio monitor mixing and resampling, see arcan_amixer.h
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "arcan_amixer.h"
+#include "../frameserver/util/resampler/speex_resampler.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define AMIXER_X86
+#include <emmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define AMIXER_ARM
+#include <arm_neon.h>
+#endif
+
+#define RING_MASK (AMIXER_RING - 1)
+
+/* frames converted (and resampled) at a time before going into the ring */
+#define FEED_CHUNK 1024
+
+/* samples mixed at a time, the accumulator lives on the stack */
+#define MIX_BLOCK 1024
+
+/*
+ * All kernels work on [n] interleaved stereo samples, [n] is even. The SIMD
+ * versions handle whatever doesn't fill a vector with the scalar version.
+ *
+ * conv: int16 to float with the per-channel [l] and [r] scale (gain / 32767)
+ * mix: acc = acc + (in - acc * in), same order as the per-sample mixer had
+ * clip: float to int16, >= 1.0 is 32767, < -1.0 is -32768, else truncated
+ */
+struct amixer_ops {
+	enum amixer_impl impl;
+	const char* name;
+	void (*conv)(const int16_t* in, float* out, size_t n, float l, float r);
+	void (*mix)(float* acc, const float* in, size_t n);
+	void (*clip)(const float* in, int16_t* out, size_t n);
+};
+
+static void conv_scalar(const int16_t* in, float* out, size_t n, float l, float r)
+{
+	for (size_t i = 0; i < n; i += 2){
+		out[i+0] = (float)in[i+0] * l;
+		out[i+1] = (float)in[i+1] * r;
+	}
+}
+
+static void mix_scalar(float* acc, const float* in, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		acc[i] += in[i] - acc[i] * in[i];
+}
+
+static void clip_scalar(const float* in, int16_t* out, size_t n)
+{
+	for (size_t i = 0; i < n; i++){
+		float v = in[i];
+		out[i] = v >= 1.0f ? 32767 : (v < -1.0f ? -32768 : (int16_t)(v * 32767.0f));
+	}
+}
+
+#ifdef AMIXER_X86
+static void conv_sse2(const int16_t* in, float* out, size_t n, float l, float r)
+{
+	__m128 gain = _mm_setr_ps(l, r, l, r);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8){
+		__m128i s = _mm_loadu_si128((const __m128i*)&in[i]);
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+		_mm_storeu_ps(&out[i+0], _mm_mul_ps(_mm_cvtepi32_ps(lo), gain));
+		_mm_storeu_ps(&out[i+4], _mm_mul_ps(_mm_cvtepi32_ps(hi), gain));
+	}
+
+	conv_scalar(&in[i], &out[i], n - i, l, r);
+}
+
+static void mix_sse2(float* acc, const float* in, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4){
+		__m128 a = _mm_loadu_ps(&acc[i]);
+		__m128 s = _mm_loadu_ps(&in[i]);
+		_mm_storeu_ps(&acc[i], _mm_add_ps(a, _mm_sub_ps(s, _mm_mul_ps(a, s))));
+	}
+
+	mix_scalar(&acc[i], &in[i], n - i);
+}
+
+static inline __m128i clip4_sse2(__m128 v)
+{
+	__m128 x = _mm_mul_ps(v, _mm_set1_ps(32767.0f));
+	__m128 neg = _mm_cmplt_ps(v, _mm_set1_ps(-1.0f));
+	x = _mm_or_ps(
+		_mm_and_ps(neg, _mm_set1_ps(-32768.0f)), _mm_andnot_ps(neg, x));
+	return _mm_cvttps_epi32(_mm_min_ps(x, _mm_set1_ps(32767.0f)));
+}
+
+static void clip_sse2(const float* in, int16_t* out, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8){
+		__m128i lo = clip4_sse2(_mm_loadu_ps(&in[i+0]));
+		__m128i hi = clip4_sse2(_mm_loadu_ps(&in[i+4]));
+		_mm_storeu_si128((__m128i*)&out[i], _mm_packs_epi32(lo, hi));
+	}
+
+	clip_scalar(&in[i], &out[i], n - i);
+}
+#endif
+
+#ifdef AMIXER_ARM
+static void conv_neon(const int16_t* in, float* out, size_t n, float l, float r)
+{
+	const float gv[4] = {l, r, l, r};
+	float32x4_t gain = vld1q_f32(gv);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8){
+		int16x8_t s = vld1q_s16(&in[i]);
+		float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(s)));
+		float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(s)));
+		vst1q_f32(&out[i+0], vmulq_f32(lo, gain));
+		vst1q_f32(&out[i+4], vmulq_f32(hi, gain));
+	}
+
+	conv_scalar(&in[i], &out[i], n - i, l, r);
+}
+
+/* explicit mul and sub, vmls can be fused depending on target */
+static void mix_neon(float* acc, const float* in, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4){
+		float32x4_t a = vld1q_f32(&acc[i]);
+		float32x4_t s = vld1q_f32(&in[i]);
+		vst1q_f32(&acc[i], vaddq_f32(a, vsubq_f32(s, vmulq_f32(a, s))));
+	}
+
+	mix_scalar(&acc[i], &in[i], n - i);
+}
+
+static inline int16x4_t clip4_neon(float32x4_t v)
+{
+	float32x4_t x = vmulq_n_f32(v, 32767.0f);
+	uint32x4_t neg = vcltq_f32(v, vdupq_n_f32(-1.0f));
+	x = vbslq_f32(neg, vdupq_n_f32(-32768.0f), x);
+	x = vminq_f32(x, vdupq_n_f32(32767.0f));
+	return vqmovn_s32(vcvtq_s32_f32(x));
+}
+
+static void clip_neon(const float* in, int16_t* out, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8){
+		int16x4_t lo = clip4_neon(vld1q_f32(&in[i+0]));
+		int16x4_t hi = clip4_neon(vld1q_f32(&in[i+4]));
+		vst1q_s16(&out[i], vcombine_s16(lo, hi));
+	}
+
+	clip_scalar(&in[i], &out[i], n - i);
+}
+#endif
+
+static const struct amixer_ops impls[] = {
+	{
+		.impl = AMIXER_SCALAR,
+		.name = "scalar",
+		.conv = conv_scalar,
+		.mix = mix_scalar,
+		.clip = clip_scalar
+	},
+#ifdef AMIXER_X86
+	{
+		.impl = AMIXER_SSE2,
+		.name = "sse2",
+		.conv = conv_sse2,
+		.mix = mix_sse2,
+		.clip = clip_sse2
+	},
+#endif
+#ifdef AMIXER_ARM
+	{
+		.impl = AMIXER_NEON,
+		.name = "neon",
+		.conv = conv_neon,
+		.mix = mix_neon,
+		.clip = clip_neon
+	},
+#endif
+};
+
+static const struct amixer_ops* active;
+
+bool amixer_set_impl(enum amixer_impl impl)
+{
+	size_t n_impls = sizeof(impls) / sizeof(impls[0]);
+
+	if (impl != AMIXER_AUTO){
+		for (size_t i = 0; i < n_impls; i++)
+			if (impls[i].impl == impl){
+				active = &impls[i];
+				return true;
+			}
+		return false;
+	}
+
+	const char* env = getenv("ARCAN_AMIXER");
+	if (env){
+		for (size_t i = 0; i < n_impls; i++)
+			if (strcasecmp(env, impls[i].name) == 0){
+				active = &impls[i];
+				return true;
+			}
+	}
+
+/* table is in order of preference */
+	active = &impls[n_impls - 1];
+	return true;
+}
+
+const char* amixer_impl_name()
+{
+	if (!active)
+		amixer_set_impl(AMIXER_AUTO);
+	return active->name;
+}
+
+void amixer_resampler_free(struct amixer_resampler* res)
+{
+	if (res->state)
+		speex_resampler_destroy(res->state);
+	*res = (struct amixer_resampler){0};
+}
+
+/* make sure [res] converts [channels] from [rate] to [out_rate] */
+static bool resampler_state(struct amixer_resampler* res,
+	unsigned channels, unsigned rate, unsigned out_rate)
+{
+	if (res->state && res->rate == rate && res->channels == channels)
+		return true;
+
+	amixer_resampler_free(res);
+	if (!channels || !rate || !out_rate)
+		return false;
+
+	int err;
+	res->state = speex_resampler_init(channels,
+		rate, out_rate, SPEEX_RESAMPLER_QUALITY_DEFAULT, &err);
+	if (!res->state)
+		return false;
+
+	res->rate = rate;
+	res->channels = channels;
+	return true;
+}
+
+void amixer_free(struct amixer* mix)
+{
+	for (size_t i = 0; i < mix->n_sources; i++){
+		amixer_resampler_free(&mix->sources[i].resampler);
+		free(mix->sources[i].ring);
+	}
+	free(mix->sources);
+	amixer_resampler_free(&mix->direct);
+	mix->sources = NULL;
+	mix->n_sources = 0;
+}
+
+bool amixer_setup(struct amixer* mix, unsigned rate, size_t n, const int* ids)
+{
+	if (!active)
+		amixer_set_impl(AMIXER_AUTO);
+
+	amixer_free(mix);
+	mix->rate = rate;
+	if (!n)
+		return true;
+
+	mix->sources = malloc(n * sizeof(struct amixer_source));
+	if (!mix->sources)
+		return false;
+
+	for (size_t i = 0; i < n; i++){
+		mix->sources[i] = (struct amixer_source){
+			.id = ids[i],
+			.l_gain = 1.0,
+			.r_gain = 1.0,
+			.ring = malloc(AMIXER_RING * sizeof(float))
+		};
+		mix->n_sources = i + 1;
+
+		if (!mix->sources[i].ring){
+			amixer_free(mix);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void amixer_gain(struct amixer* mix, int id, float left, float right)
+{
+	for (size_t i = 0; i < mix->n_sources; i++){
+		if (id == 0 || mix->sources[i].id == id){
+			mix->sources[i].l_gain = left;
+			mix->sources[i].r_gain = right;
+		}
+	}
+}
+
+/* append [n] already converted samples, returns how many fit */
+static size_t ring_push(struct amixer_source* src, const float* in, size_t n)
+{
+	size_t space = AMIXER_RING - src->count;
+	if (n > space)
+		n = space;
+
+	size_t tail = (src->head + src->count) & RING_MASK;
+	size_t first = AMIXER_RING - tail;
+	if (first > n)
+		first = n;
+
+	memcpy(&src->ring[tail], in, first * sizeof(float));
+	memcpy(src->ring, &in[first], (n - first) * sizeof(float));
+	src->count += n;
+
+	return n;
+}
+
+/* same as ring_push, but convert straight from int16 stereo */
+static size_t ring_conv(struct amixer_source* src,
+	const int16_t* in, size_t n, float l, float r)
+{
+	size_t space = AMIXER_RING - src->count;
+	if (n > space)
+		n = space;
+
+	size_t tail = (src->head + src->count) & RING_MASK;
+	size_t first = AMIXER_RING - tail;
+	if (first > n)
+		first = n;
+
+	active->conv(in, &src->ring[tail], first, l, r);
+	active->conv(&in[first], src->ring, n - first, l, r);
+	src->count += n;
+
+	return n;
+}
+
+/* mono or more than two channels, not worth a vector version */
+static void conv_channels(const int16_t* in, unsigned channels,
+	float* out, size_t frames, float l, float r)
+{
+	for (size_t i = 0; i < frames; i++, in += channels){
+		out[i*2+0] = (float)in[0] * l;
+		out[i*2+1] = (float)in[channels > 1] * r;
+	}
+}
+
+size_t amixer_feed(struct amixer* mix, int id,
+	const int16_t* buf, size_t n, unsigned channels, unsigned rate)
+{
+	struct amixer_source* src = NULL;
+	for (size_t i = 0; i < mix->n_sources && !src; i++)
+		if (mix->sources[i].id == id)
+			src = &mix->sources[i];
+
+	if (!src || !channels)
+		return 0;
+
+	float l = src->l_gain / 32767.0f;
+	float r = src->r_gain / 32767.0f;
+	size_t frames = n / channels;
+
+/* native rate and layout (the common case) converts right into the ring */
+	if (rate == mix->rate || !rate){
+		amixer_resampler_free(&src->resampler);
+		if (channels == 2)
+			return ring_conv(src, buf, frames * 2, l, r);
+	}
+	else if (!resampler_state(&src->resampler, 2, rate, mix->rate))
+		return 0;
+
+	float conv[FEED_CHUNK * 2];
+	float out[FEED_CHUNK * 2];
+	size_t in_cap = FEED_CHUNK;
+	size_t total = 0;
+
+/* leave some headroom so that the resampler can always consume all input */
+	if (src->resampler.state){
+		in_cap = (size_t)(FEED_CHUNK - 16) * rate / mix->rate;
+		if (in_cap > FEED_CHUNK)
+			in_cap = FEED_CHUNK;
+		if (!in_cap)
+			in_cap = 1;
+	}
+
+	while (frames){
+		size_t nf = frames > in_cap ? in_cap : frames;
+
+		if (channels == 2)
+			active->conv(buf, conv, nf * 2, l, r);
+		else
+			conv_channels(buf, channels, conv, nf, l, r);
+
+		if (!src->resampler.state){
+			total += ring_push(src, conv, nf * 2);
+		}
+		else {
+			spx_uint32_t in_len = nf;
+			spx_uint32_t out_len = FEED_CHUNK;
+			speex_resampler_process_interleaved_float(
+				src->resampler.state, conv, &in_len, out, &out_len);
+			total += ring_push(src, out, out_len * 2);
+
+			if (!in_len)
+				break;
+			nf = in_len;
+		}
+
+		buf += nf * channels;
+		frames -= nf;
+	}
+
+	return total;
+}
+
+size_t amixer_mix(struct amixer* mix, int16_t* dst, size_t lim)
+{
+	if (!mix->n_sources)
+		return 0;
+
+	size_t n = AMIXER_RING;
+	for (size_t i = 0; i < mix->n_sources; i++)
+		if (mix->sources[i].count < n)
+			n = mix->sources[i].count;
+
+	if (n <= AMIXER_THRESHOLD)
+		return 0;
+
+	lim &= ~(size_t)1;
+	if (n > lim)
+		n = lim;
+
+/* the first source is copied as 0 + (s - 0 * s) is s */
+	float acc[MIX_BLOCK];
+	for (size_t ofs = 0; ofs < n; ofs += MIX_BLOCK){
+		size_t step = n - ofs > MIX_BLOCK ? MIX_BLOCK : n - ofs;
+
+		for (size_t i = 0; i < mix->n_sources; i++){
+			struct amixer_source* src = &mix->sources[i];
+			size_t pos = (src->head + ofs) & RING_MASK;
+			size_t first = AMIXER_RING - pos;
+			if (first > step)
+				first = step;
+
+			if (i == 0){
+				memcpy(acc, &src->ring[pos], first * sizeof(float));
+				memcpy(&acc[first], src->ring, (step - first) * sizeof(float));
+			}
+			else {
+				active->mix(acc, &src->ring[pos], first);
+				active->mix(&acc[first], src->ring, step - first);
+			}
+		}
+
+		active->clip(acc, &dst[ofs], step);
+	}
+
+	for (size_t i = 0; i < mix->n_sources; i++){
+		mix->sources[i].head = (mix->sources[i].head + n) & RING_MASK;
+		mix->sources[i].count -= n;
+	}
+
+	return n;
+}
+
+size_t amixer_resample_s16(struct amixer_resampler* res, unsigned out_rate,
+	const int16_t* in, size_t n, unsigned channels, unsigned rate,
+	int16_t* out, size_t lim)
+{
+	if (!resampler_state(res, channels, rate, out_rate))
+		return 0;
+
+	spx_uint32_t in_len = n / channels;
+	spx_uint32_t out_len = lim / channels;
+	speex_resampler_process_interleaved_int(
+		res->state, in, &in_len, out, &out_len);
+
+	return (size_t) out_len * channels;
+}
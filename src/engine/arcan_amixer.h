@@ -0,0 +1,107 @@
+/*
+ * Copyright 2019, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in the arcan source repository.
+ * Reference: https://arcan-fe.com
+ * Description: Mixing of audio monitor feeds into the interleaved stereo
+ * int16 buffer of a recording frameserver. Each source gets a ring buffer of
+ * gain-adjusted float samples and, should it deliver at a different rate
+ * than the output, a resampler. Conversion, mixing and clipping have SIMD
+ * versions picked at runtime. Kept free from engine dependencies so that it
+ * can be built into tests/core/amixbench.
+ */
+
+#ifndef HAVE_ARCAN_AMIXER
+#define HAVE_ARCAN_AMIXER
+
+/* per source ring buffer size, in samples, must be a power of two */
+#ifndef AMIXER_RING
+#define AMIXER_RING 16384
+#endif
+
+/* don't mix until all sources have at least this many samples buffered */
+#ifndef AMIXER_THRESHOLD
+#define AMIXER_THRESHOLD 512
+#endif
+
+enum amixer_impl {
+	AMIXER_AUTO = 0,
+	AMIXER_SCALAR,
+	AMIXER_SSE2,
+	AMIXER_NEON
+};
+
+struct amixer_resampler {
+	void* state;
+	unsigned rate;
+	unsigned channels;
+};
+
+struct amixer_source {
+	int id;
+	float l_gain, r_gain;
+
+/* [count] samples starting at [head] */
+	float* ring;
+	size_t head, count;
+
+	struct amixer_resampler resampler;
+};
+
+struct amixer {
+	unsigned rate;
+	size_t n_sources;
+	struct amixer_source* sources;
+
+/* for a single monitored source that only needs resampling */
+	struct amixer_resampler direct;
+};
+
+/*
+ * Pick the implementation used by the mixer, same rules as for pixconv:
+ * AUTO is the best one available (and the default), ARCAN_AMIXER (scalar,
+ * sse2, neon) overrides. Returns false if [impl] is not available.
+ */
+bool amixer_set_impl(enum amixer_impl impl);
+const char* amixer_impl_name();
+
+/*
+ * (Re-)build [mix] for the [n] sources in [ids], output at [rate] Hz.
+ * Previous sources and resamplers are released. Returns false on allocation
+ * failure, [mix] is then left without sources.
+ */
+bool amixer_setup(struct amixer* mix, unsigned rate, size_t n, const int* ids);
+void amixer_free(struct amixer* mix);
+
+/* set the gain of source [id], or of all sources if [id] is 0 */
+void amixer_gain(struct amixer* mix, int id, float left, float right);
+
+/*
+ * Buffer [n] interleaved samples with [channels] channels at [rate] Hz from
+ * source [id]. Mono is spread to both channels and anything past the second
+ * channel is dropped. What doesn't fit in the ring buffer is dropped as
+ * well. Returns the number of (output rate, stereo) samples buffered.
+ */
+size_t amixer_feed(struct amixer* mix, int id,
+	const int16_t* buf, size_t n, unsigned channels, unsigned rate);
+
+/*
+ * Mix what all sources have in common into [dst], at most [lim] samples.
+ * Samples are combined as A + B - A * B and clipped to int16. Returns the
+ * number of samples written, 0 until every source has buffered more than
+ * AMIXER_THRESHOLD.
+ */
+size_t amixer_mix(struct amixer* mix, int16_t* dst, size_t lim);
+
+/*
+ * Resample [n] interleaved int16 samples at [rate] Hz into [out] at
+ * [out_rate], keeping the number of channels. The state is (re-)created
+ * when rate or channels change. Returns the number of samples written,
+ * input that would exceed [lim] is dropped.
+ */
+size_t amixer_resample_s16(struct amixer_resampler* res, unsigned out_rate,
+	const int16_t* in, size_t n, unsigned channels, unsigned rate,
+	int16_t* out, size_t lim);
+
+void amixer_resampler_free(struct amixer_resampler* res);
+
+#endif
@@ -14,6 +14,8 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include "arcan_math.h"
 #include "arcan_general.h"
@@ -26,6 +28,8 @@
 #include "arcan_video.h"
 #include "arcan_videoint.h"
 #include "arcan_mem.h"
+#include "arcan_db.h"
+#include "arcan_dispsched.h"
 
 #include "../platform/platform.h"
 #include "../platform/video_platform.h"
@@ -51,6 +55,8 @@
  *      or drop the semaphores entirely (yes please) and switch to futexes, alas
  *      then we still have the problem of those not being a multiplexable primitives
  *      and needing a separate path for OSX.
+ *      [x] negotiate futex wait/wake on vready/aready (synch_flags)
+ *      [ ] same for the event queue and resize-ack that still use the sems
  *
  *  [ ] defer GCs to low-load / embarassing pause in thread during synch etc.
  *      since we now 'know' when we are waiting for the GPU to unlock, this is a
@@ -58,20 +64,33 @@
  *
  *  [ ] perform readbacks in possible delay periods might break some GPU drivers
  *
- *  [ ] thread rendertarget processing
+ *  [x] thread rendertarget processing
  *      this would again be better for something like vulkan where we tie the
  *      rendertarget to a unique pipeline (they are much alike)
+ *      [x] record resolved draw lists in parallel (arcan_conductor_parallel)
+ *      [x] submit in dependency order (rendertargets sampling others go last)
+ *      [ ] overlap recording of the next level with submission
+ *
+ *  [x] per-display scanout deadlines (arcan_dispsched), so that displays with
+ *      different refresh rates are composed and flipped on their own cadence
+ *      [x] only refresh the rendertargets that feed the displays that are due
+ *      [ ] per-GPU affinity for the rendertargets
  */
 static struct {
 	uint64_t tick_count;
 	int64_t set_deadline;
 	double render_cost;
 	double transfer_cost;
+	uint64_t transfer_acc;
+	uint64_t last_synch;
+	double synch_step;
 	uint8_t timestep;
 	bool in_frame;
+	struct dispsched displays;
 } conductor = {
 	.render_cost = 4,
 	.transfer_cost = 1,
+	.synch_step = 16,
 	.timestep = 2
 };
 
@@ -148,6 +167,149 @@ static void internal_yield()
 	arcan_timesleep(conductor.timestep);
 }
 
+/*
+ * Worker pool for arcan_conductor_parallel, the dispatching thread publishes
+ * a new job generation and then participates in draining the index counter.
+ */
+static struct {
+	pthread_t* threads;
+	size_t count;
+	bool init;
+	bool shutdown;
+
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_cond_t done;
+
+	uint64_t generation;
+	size_t active;
+
+	void (*job)(void* tag, size_t ind);
+	void* tag;
+	size_t n;
+	atomic_size_t next;
+} workers = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.wake = PTHREAD_COND_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER
+};
+
+static void drain_jobs()
+{
+	size_t ind;
+	while ((ind = atomic_fetch_add(&workers.next, 1)) < workers.n)
+		workers.job(workers.tag, ind);
+}
+
+static void* worker_loop(void* arg)
+{
+	uint64_t generation = 0;
+	pthread_mutex_lock(&workers.lock);
+
+	for(;;){
+		while (generation == workers.generation)
+			pthread_cond_wait(&workers.wake, &workers.lock);
+		generation = workers.generation;
+
+		if (workers.shutdown)
+			break;
+		pthread_mutex_unlock(&workers.lock);
+
+		drain_jobs();
+
+		pthread_mutex_lock(&workers.lock);
+		if (--workers.active == 0)
+			pthread_cond_signal(&workers.done);
+	}
+
+	pthread_mutex_unlock(&workers.lock);
+	return NULL;
+}
+
+static void setup_workers()
+{
+	workers.init = true;
+	const char* env = getenv("ARCAN_CONDUCTOR_WORKERS");
+	if (!env)
+		return;
+
+	size_t count = strtoul(env, NULL, 10);
+	if (!count)
+		return;
+
+	if (count > 16)
+		count = 16;
+
+	workers.threads = arcan_alloc_mem(sizeof(pthread_t) * count,
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+
+	for (size_t i = 0; i < count; i++){
+		if (0 != pthread_create(&workers.threads[i], NULL, worker_loop, NULL)){
+			arcan_warning("conductor: couldn't spawn worker (%zu)\n", i);
+			break;
+		}
+		workers.count++;
+	}
+}
+
+void arcan_conductor_parallel(
+	void (*job)(void* tag, size_t ind), void* tag, size_t n)
+{
+	if (!workers.init)
+		setup_workers();
+
+/* not worth waking anyone for a single job */
+	if (n < 2 || !workers.count){
+		for (size_t i = 0; i < n; i++)
+			job(tag, i);
+		return;
+	}
+
+	pthread_mutex_lock(&workers.lock);
+		workers.job = job;
+		workers.tag = tag;
+		workers.n = n;
+		atomic_store(&workers.next, 0);
+		workers.active = workers.count;
+		workers.generation++;
+		pthread_cond_broadcast(&workers.wake);
+	pthread_mutex_unlock(&workers.lock);
+
+	drain_jobs();
+
+	pthread_mutex_lock(&workers.lock);
+	while (workers.active)
+		pthread_cond_wait(&workers.done, &workers.lock);
+	pthread_mutex_unlock(&workers.lock);
+}
+
+void arcan_conductor_stop_workers()
+{
+	if (!workers.count){
+		arcan_mem_free(workers.threads);
+		workers.threads = NULL;
+		workers.init = false;
+		return;
+	}
+
+/* a new generation with the shutdown flag set makes every worker exit
+ * rather than drain, parallel is never active at this point */
+	pthread_mutex_lock(&workers.lock);
+		workers.shutdown = true;
+		workers.generation++;
+		pthread_cond_broadcast(&workers.wake);
+	pthread_mutex_unlock(&workers.lock);
+
+	for (size_t i = 0; i < workers.count; i++)
+		pthread_join(workers.threads[i], NULL);
+
+	arcan_mem_free(workers.threads);
+	workers.threads = NULL;
+	workers.count = 0;
+	workers.shutdown = false;
+	workers.init = false;
+}
+
 static void alloc_frameserver_struct()
 {
 	if (frameservers.ref)
@@ -178,16 +340,52 @@ void arcan_conductor_release_gpu(size_t gpu_id)
 void arcan_conductor_register_display(size_t gpu_id,
 		size_t disp_id, enum synch_method method, float rate, arcan_vobj_id obj)
 {
-/* need to know which display and which vobj is needed to be updated in order
- * to fulfill the requirement of the display synch so that we can schedule it
- * accordingly, later the full DAG- would also be calculated here to resolve
- * which agp- stores are involved and if they have an affinity on a locked
- * GPU or not so that we can MT GPU updates */
+/* the vobj is kept so that the platform can ask which rendertargets feed a
+ * display, the DAG itself is resolved in arcan_vint_refresh_displays. Later
+ * the affinity of the involved agp- stores would go here as well so that
+ * updates on different GPUs can be MT */
+	if (!dispsched_register(&conductor.displays, gpu_id, disp_id, rate, obj))
+		arcan_warning("conductor: display limit reached, "
+			"(%zu:%zu) won't be scheduled\n", gpu_id, disp_id);
 }
 
 void arcan_conductor_release_display(size_t gpu_id, size_t disp_id)
 {
 /* remove from set of known displays so its rate doesn't come into account */
+	dispsched_release(&conductor.displays, gpu_id, disp_id);
+}
+
+size_t arcan_conductor_displays_due(
+	struct conductor_display_ref* out, size_t lim, int* wait)
+{
+	struct dispsched_display* due[DISPSCHED_LIMIT];
+	if (lim > DISPSCHED_LIMIT)
+		lim = DISPSCHED_LIMIT;
+
+/* processing: synch to any display that is ready, don't wait for vblank */
+	size_t n = dispsched_due(&conductor.displays, arcan_timemillis(),
+		conductor.timestep, synchopt == SYNCH_PROCESSING, due, lim, wait);
+
+	for (size_t i = 0; i < n && out; i++)
+		out[i] = (struct conductor_display_ref){
+			.gpu_id = due[i]->gpu_id,
+			.disp_id = due[i]->disp_id,
+			.vid = due[i]->vid
+		};
+
+	return n;
+}
+
+void arcan_conductor_display_submit(
+	size_t gpu_id, size_t disp_id, int cost, bool queued)
+{
+	dispsched_submit(&conductor.displays,
+		gpu_id, disp_id, arcan_timemillis(), cost, queued);
+}
+
+void arcan_conductor_display_synch(size_t gpu_id, size_t disp_id, long long ts)
+{
+	dispsched_vblank(&conductor.displays, gpu_id, disp_id, ts);
 }
 
 void arcan_conductor_register_frameserver(struct arcan_frameserver* fsrv)
@@ -392,8 +590,23 @@ static bool preframe_synch(int next, int elapsed)
 	return true;
 }
 
+/*
+ * Forward the estimates for the next composition so that they reach the
+ * clients as part of the buffer release, letting them render just in time
+ * rather than as soon as they are woken up (see arcan_shmif_deadline).
+ */
+static void publish_deadline(uint64_t next)
+{
+	if (!next)
+		next = conductor.last_synch + conductor.synch_step;
+
+	arcan_frameserver_deadline(next, conductor.synch_step, estimate_frame_cost());
+}
+
 static uint64_t postframe_synch(uint64_t next)
 {
+	publish_deadline(next);
+
 	switch(synchopt){
 	case SYNCH_VSYNCH:
 	case SYNCH_ADAPTIVE:
@@ -424,6 +637,17 @@ static int trigger_video_synch(float frag)
 		0.8 * (double)stats->framecost[(uint8_t)stats->costofs] +
 		0.2 * conductor.render_cost;
 
+/* and the time spent in buffer transfers since the last synch */
+	conductor.transfer_cost =
+		0.8 * (double)conductor.transfer_acc + 0.2 * conductor.transfer_cost;
+	conductor.transfer_acc = 0;
+
+	uint64_t now = arcan_timemillis();
+	if (conductor.last_synch)
+		conductor.synch_step = 0.8 * (double)(now - conductor.last_synch) +
+			0.2 * conductor.synch_step;
+	conductor.last_synch = now;
+
 /* if the platform wants us to wait, it'll provide a new deadline at synch */
 	return conductor.set_deadline > 0 ? conductor.set_deadline : 0;
 }
@@ -447,7 +671,9 @@ int arcan_conductor_run(arcan_tick_cb tick)
  * and then actually dispatch / process these twice so that their old buffers
  * might get to be updated before we synch to display.
  */
+		uint64_t transfer_start = arcan_timemillis();
 		arcan_video_pollfeed();
+		conductor.transfer_acc += arcan_timemillis() - transfer_start;
 		arcan_audio_refresh();
 		last_tickcount = conductor.tick_count;
 		float frag = arcan_event_process(evctx, conductor_cycle);
@@ -519,6 +745,9 @@ static void conductor_cycle(int nticks)
 	arcan_lua_tick(main_lua_context, nticks, conductor.tick_count);
 	outcb(nticks);
 
+/* write back whatever key-value updates the scripts made during the tick */
+	arcan_db_flush(arcan_db_get_shared(NULL));
+
 	while(nticks--)
 		arcan_mem_tick();
 }
@@ -29,6 +29,36 @@ void arcan_conductor_register_display(size_t gpu_id,
  * Release a previously registered display and gpu pairing */
 void arcan_conductor_release_display(size_t gpu_id, size_t disp_id);
 
+/* [ called from platform ]
+ * Each registered display has a deadline of its own, derived from its rate
+ * and the last reported scanout. Fill [out] with up to [lim] displays that
+ * should be composed and submitted now, return the number of entries. [wait]
+ * is set to the ms until the next display becomes due (or a pending flip is
+ * expected), or -1 if no displays are registered.
+ *
+ * A display that has been returned stays due until it is reported through
+ * arcan_conductor_display_submit.
+ */
+struct conductor_display_ref {
+	size_t gpu_id;
+	size_t disp_id;
+	arcan_vobj_id vid;
+};
+size_t arcan_conductor_displays_due(
+	struct conductor_display_ref* out, size_t lim, int* wait);
+
+/* [ called from platform ]
+ * Composition for a due display is done and took [cost] ms. [queued] is set
+ * if a new frame is waiting for a flip, the display then isn't due again
+ * until arcan_conductor_display_synch. Otherwise (no damage, or no flip
+ * feedback) the upcoming vblank counts as handled. */
+void arcan_conductor_display_submit(
+	size_t gpu_id, size_t disp_id, int cost, bool queued);
+
+/* [ called from platform ]
+ * A queued frame was scanned out at [ts] (arcan_timemillis clock) */
+void arcan_conductor_display_synch(size_t gpu_id, size_t disp_id, long long ts);
+
 /* [ called from platform ]
  * mark GPU as locked and add [fence] to pollset, when there's data on fence,
  * invoke the lockhandler callback which [may] release the gpu
@@ -101,6 +131,24 @@ void arcan_conductor_setsynch(const char* arg);
 void arcan_conductor_fakesynch(uint8_t left_ms);
 
 #ifndef VIDEO_PLATFORM_IMPL
+/*
+ * Run [job](tag, 0..n-1) spread out over the conductor worker threads and
+ * block until all invocations have completed. The calling thread takes part
+ * in processing. Jobs may not touch the GPU, the scripting VM or modify
+ * state that other jobs read.
+ *
+ * The number of workers is set from the ARCAN_CONDUCTOR_WORKERS environment
+ * variable, and with none (the default) all jobs run on the calling thread.
+ */
+void arcan_conductor_parallel(
+	void (*job)(void* tag, size_t ind), void* tag, size_t n);
+
+/*
+ * Terminate and join the worker threads used by arcan_conductor_parallel,
+ * used on video shutdown. A later call to parallel will spawn new ones.
+ */
+void arcan_conductor_stop_workers();
+
 /* Update the priority target to match the specified frameserver. This
  * means that heuristics driving synchronization will be biased towards
  * letting the specific fsrv align synchronization - if the synchronization
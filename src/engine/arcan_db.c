@@ -118,6 +118,10 @@ static const char* ddls[] = {
 
 #define DI_DROPKV_CONFIG "DELETE FROM config_kv WHERE val=\"\";"
 
+#define DI_DELKV_TARGET "DELETE FROM target_kv WHERE key = ? AND target = ?;"
+
+#define DI_DELKV_CONFIG "DELETE FROM config_kv WHERE key = ? AND config = ?;"
+
 #define DI_INSKV_CONFIG_ENV "INSERT OR REPLACE INTO "\
 	"config_env(key, val, config) VALUES(?, ?, ?);"
 
@@ -127,6 +131,39 @@ static const char* ddls[] = {
 #define DI_INSKV_TARGET_LIBV "INSERT OR REPLACE INTO "\
 	"target_libs(libname, libnote, target) VALUES(?, ?, ?);"
 
+/*
+ * The number of distinct queries is small (static queries and the appl_
+ * namespaced ones for the few appls that are active), a linear scan over
+ * the hashes is cheaper than the sqlite3_prepare_v2 it saves by orders of
+ * magnitude.
+ */
+#define DB_STMT_CACHE 64
+
+struct db_stmt {
+	uint32_t hash;
+	char* qry;
+	sqlite3_stmt* stmt;
+	uint64_t used;
+};
+
+#define DB_KV_BUCKETS 256
+#define DB_KV_LIMIT 4096
+
+/*
+ * val == NULL means that the key is known not to exist, and when combined
+ * with dirty that the key should be removed on flush.
+ */
+struct db_kv {
+	struct db_kv* next;
+	uint32_t hash;
+	enum DB_KVTARGET kvt;
+	int64_t id;
+	char* appl;
+	char* key;
+	char* val;
+	bool dirty;
+};
+
 struct arcan_dbh {
 	sqlite3* dbh;
 
@@ -144,7 +181,21 @@ struct arcan_dbh {
 	enum DB_KVTARGET ttype;
 	union arcan_dbtrans_id trid;
 	bool trclean;
+	bool trpending;
+	bool trmirror;
 	sqlite3_stmt* transaction;
+
+/* prepared statements, keyed on the query string */
+	struct db_stmt stmts[DB_STMT_CACHE];
+	uint64_t stmt_clock;
+
+/* optional in-memory mirror of the appl/target/config kv stores, updates
+ * are deferred and written back in one transaction on flush */
+	struct {
+		struct db_kv** buckets;
+		size_t count;
+		size_t dirty;
+	} kv;
 };
 
 static void setup_ddl(struct arcan_dbh* dbh);
@@ -162,6 +213,343 @@ void arcan_db_set_shared(struct arcan_dbh* new)
 	shared_handle = new;
 }
 
+static uint32_t db_hash(uint32_t hash, const char* str)
+{
+	while (*str){
+		hash ^= (uint8_t) *str++;
+		hash *= 16777619;
+	}
+	return hash;
+}
+
+/*
+ * retrieve a cached prepared statement for [qry], or prepare and cache
+ * a new one, replacing the least recently used. The statement is returned
+ * reset and without bindings, hand it back with db_stmt_done.
+ */
+static sqlite3_stmt* db_stmt(struct arcan_dbh* dbh, const char* qry)
+{
+	uint32_t hash = db_hash(2166136261, qry);
+	struct db_stmt* dst = NULL;
+
+	for (size_t i = 0; i < DB_STMT_CACHE; i++){
+		struct db_stmt* slot = &dbh->stmts[i];
+		if (slot->stmt && slot->hash == hash && strcmp(slot->qry, qry) == 0){
+			slot->used = ++dbh->stmt_clock;
+			return slot->stmt;
+		}
+
+/* never evict the statement that an open transaction is building on */
+		if (slot->stmt && slot->stmt == dbh->transaction)
+			continue;
+
+		if (!dst || !slot->stmt || (dst->stmt && slot->used < dst->used))
+			dst = slot;
+	}
+
+	sqlite3_stmt* stmt = NULL;
+	if (SQLITE_OK != sqlite3_prepare_v2(dbh->dbh, qry, -1, &stmt, NULL)){
+		sqlite3_finalize(stmt);
+		return NULL;
+	}
+
+	if (dst->stmt){
+		sqlite3_finalize(dst->stmt);
+		free(dst->qry);
+	}
+
+	*dst = (struct db_stmt){
+		.hash = hash,
+		.qry = strdup(qry),
+		.stmt = stmt,
+		.used = ++dbh->stmt_clock
+	};
+
+	return stmt;
+}
+
+static void db_stmt_done(sqlite3_stmt* stmt)
+{
+	if (!stmt)
+		return;
+
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+}
+
+/*
+ * build and retrieve a cached statement for a query that is specific to
+ * the appl_ namespace of [appl] (fmt contains a single %s)
+ */
+static sqlite3_stmt* db_appl_stmt(
+	struct arcan_dbh* dbh, const char* fmt, const char* appl)
+{
+	size_t buf_sz = strlen(fmt) + strlen(appl) + 1;
+	char buf[buf_sz];
+	snprintf(buf, buf_sz, fmt, appl);
+	return db_stmt(dbh, buf);
+}
+
+static const char appl_kv_insert[] =
+	"INSERT OR REPLACE INTO appl_%s(key, val) VALUES(?, ?);";
+static const char appl_kv_drop[] = "DELETE FROM appl_%s WHERE key=?;";
+static const char appl_kv_get[] = "SELECT val FROM appl_%s WHERE key = ?;";
+
+/*
+ * target- and config- keys are hashed without the id as the schema has
+ * the key column UNIQUE, meaning that a set for one id replaces any other
+ * id that used the same key. Having them in the same bucket lets kv_set
+ * mimic that.
+ */
+static uint32_t kv_hash(enum DB_KVTARGET kvt, const char* appl, const char* key)
+{
+	uint32_t hash = 2166136261 ^ (uint32_t) kvt;
+	if (appl)
+		hash = db_hash(hash * 16777619, appl);
+	return db_hash(hash * 16777619, key);
+}
+
+static struct db_kv* kv_find(struct arcan_dbh* dbh,
+	enum DB_KVTARGET kvt, int64_t id, const char* appl, const char* key)
+{
+	uint32_t hash = kv_hash(kvt, appl, key);
+	struct db_kv* cur = dbh->kv.buckets[hash % DB_KV_BUCKETS];
+
+	while (cur){
+		if (cur->hash == hash && cur->kvt == kvt && cur->id == id &&
+			strcmp(cur->key, key) == 0 && (!appl || strcmp(cur->appl, appl) == 0))
+			return cur;
+		cur = cur->next;
+	}
+
+	return NULL;
+}
+
+static void kv_free(struct db_kv* ent)
+{
+	free(ent->appl);
+	free(ent->key);
+	free(ent->val);
+	free(ent);
+}
+
+static void kv_purge(struct arcan_dbh* dbh)
+{
+	for (size_t i = 0; i < DB_KV_BUCKETS; i++){
+		struct db_kv* cur = dbh->kv.buckets[i];
+		while (cur){
+			struct db_kv* next = cur->next;
+			kv_free(cur);
+			cur = next;
+		}
+		dbh->kv.buckets[i] = NULL;
+	}
+
+	dbh->kv.count = 0;
+	dbh->kv.dirty = 0;
+}
+
+static void kv_store(struct arcan_dbh* dbh, struct db_kv* ent)
+{
+	sqlite3_stmt* stmt = NULL;
+	int idind = 3;
+
+	switch (ent->kvt){
+	case DVT_APPL:
+		stmt = db_appl_stmt(dbh, ent->val ? appl_kv_insert : appl_kv_drop, ent->appl);
+	break;
+	case DVT_TARGET:
+		stmt = db_stmt(dbh, ent->val ? DI_INSKV_TARGET : DI_DELKV_TARGET);
+	break;
+	case DVT_CONFIG:
+		stmt = db_stmt(dbh, ent->val ? DI_INSKV_CONFIG : DI_DELKV_CONFIG);
+	break;
+	default:
+	break;
+	}
+
+	if (!stmt)
+		return;
+
+	sqlite3_bind_text(stmt, 1, ent->key, -1, SQLITE_STATIC);
+	if (ent->val)
+		sqlite3_bind_text(stmt, 2, ent->val, -1, SQLITE_STATIC);
+	else
+		idind = 2;
+
+	if (ent->kvt != DVT_APPL)
+		sqlite3_bind_int64(stmt, idind, ent->id);
+
+	int rc = sqlite3_step(stmt);
+	if (SQLITE_DONE != rc)
+		arcan_warning("arcan_db(), writeback of (%s) failed: %s\n",
+			ent->key, sqlite3_errmsg(dbh->dbh));
+
+	db_stmt_done(stmt);
+}
+
+/*
+ * write back all dirty entries, joining the current transaction if one is
+ * open or as a transaction of its own
+ */
+static void kv_flush(struct arcan_dbh* dbh)
+{
+	if (!dbh->kv.buckets || !dbh->kv.dirty)
+		return;
+
+	bool wrap = sqlite3_get_autocommit(dbh->dbh);
+
+	if (wrap)
+		sqlite3_exec(dbh->dbh, "BEGIN;", NULL, NULL, NULL);
+
+	for (size_t i = 0; i < DB_KV_BUCKETS; i++)
+		for (struct db_kv* cur = dbh->kv.buckets[i]; cur; cur = cur->next)
+			if (cur->dirty){
+				kv_store(dbh, cur);
+				cur->dirty = false;
+			}
+
+	dbh->kv.dirty = 0;
+
+	if (wrap && SQLITE_OK != sqlite3_exec(dbh->dbh, "COMMIT;", NULL, NULL, NULL))
+		arcan_warning("arcan_db_flush(), commit failed: %s\n",
+			sqlite3_errmsg(dbh->dbh));
+}
+
+/*
+ * add or update an entry in the mirror, [dirty] if it should be written
+ * back (new value or deletion) or if it just caches the result of a query
+ */
+static void kv_set(struct arcan_dbh* dbh, enum DB_KVTARGET kvt,
+	int64_t id, const char* appl, const char* key, const char* val, bool dirty)
+{
+	if (dbh->kv.count >= DB_KV_LIMIT){
+		kv_flush(dbh);
+		kv_purge(dbh);
+	}
+
+	uint32_t hash = kv_hash(kvt, appl, key);
+	struct db_kv** prev = &dbh->kv.buckets[hash % DB_KV_BUCKETS];
+	struct db_kv* ent = NULL;
+
+	while (*prev){
+		struct db_kv* cur = *prev;
+		if (cur->hash != hash || cur->kvt != kvt || strcmp(cur->key, key) != 0 ||
+			(appl && strcmp(cur->appl, appl) != 0)){
+			prev = &cur->next;
+			continue;
+		}
+
+		if (cur->id == id){
+			ent = cur;
+			prev = &cur->next;
+			continue;
+		}
+
+/* same key on another target/config, a set will replace that one */
+		if (dirty && val){
+			*prev = cur->next;
+			dbh->kv.count--;
+			if (cur->dirty)
+				dbh->kv.dirty--;
+			kv_free(cur);
+		}
+		else
+			prev = &cur->next;
+	}
+
+	if (!ent){
+		ent = malloc(sizeof(struct db_kv));
+		if (!ent)
+			return;
+
+		*ent = (struct db_kv){
+			.hash = hash,
+			.kvt = kvt,
+			.id = id,
+			.appl = appl ? strdup(appl) : NULL,
+			.key = strdup(key),
+			.next = dbh->kv.buckets[hash % DB_KV_BUCKETS]
+		};
+		dbh->kv.buckets[hash % DB_KV_BUCKETS] = ent;
+		dbh->kv.count++;
+	}
+	else
+		free(ent->val);
+
+	ent->val = val ? strdup(val) : NULL;
+	if (dirty && !ent->dirty){
+		ent->dirty = true;
+		dbh->kv.dirty++;
+	}
+}
+
+static bool kv_mirrored(struct arcan_dbh* dbh, enum DB_KVTARGET kvt)
+{
+	return dbh->kv.buckets &&
+		(kvt == DVT_APPL || kvt == DVT_TARGET || kvt == DVT_CONFIG);
+}
+
+/*
+ * serve a lookup from the mirror, returns false if the key hasn't been
+ * seen and the database needs to be queried
+ */
+static bool kv_get(struct arcan_dbh* dbh, enum DB_KVTARGET kvt,
+	int64_t id, const char* appl, const char* key, char** out)
+{
+	if (!kv_mirrored(dbh, kvt))
+		return false;
+
+	struct db_kv* ent = kv_find(dbh, kvt, id, appl, key);
+	if (!ent)
+		return false;
+
+	*out = ent->val ? strdup(ent->val) : NULL;
+	return true;
+}
+
+/*
+ * pattern queries and drops go straight to the database, write back any
+ * pending changes first and, for drops, forget what we know
+ */
+static void kv_sync(struct arcan_dbh* dbh, bool invalidate)
+{
+	if (!dbh->kv.buckets)
+		return;
+
+	kv_flush(dbh);
+	if (invalidate)
+		kv_purge(dbh);
+}
+
+void arcan_db_flush(struct arcan_dbh* dbh)
+{
+	if (dbh)
+		kv_flush(dbh);
+}
+
+void arcan_db_kvmirror(struct arcan_dbh* dbh, bool enable)
+{
+	if (!dbh || enable == (dbh->kv.buckets != NULL))
+		return;
+
+	if (dbh->trpending)
+		arcan_fatal("arcan_db_kvmirror() called during a pending transaction\n");
+
+	if (enable){
+		dbh->kv.buckets = arcan_alloc_mem(
+			sizeof(struct db_kv*) * DB_KV_BUCKETS, ARCAN_MEM_EXTSTRUCT,
+			ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL
+		);
+		return;
+	}
+
+	kv_flush(dbh);
+	kv_purge(dbh);
+	arcan_mem_free(dbh->kv.buckets);
+	dbh->kv.buckets = NULL;
+}
+
 /*
  * any query that just returns a list of strings,
  * pack into a dbres (or append to an existing one)
@@ -190,7 +578,7 @@ static struct arcan_strarr db_string_query(struct arcan_dbh* dbh,
 		res.data[res.count++] = (arg ? strdup(arg) : NULL);
 	}
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 	return res;
 }
 
@@ -254,6 +642,7 @@ void arcan_db_dropappl(struct arcan_dbh* dbh, const char* appl)
 	char dropbuf[sizeof(dropqry) + len + 1];
 	snprintf(dropbuf, sizeof(dropbuf), "%s%s;", dropqry, appl);
 
+	kv_sync(dbh, true);
 	db_void_query(dbh, dropbuf, true);
 
 /* special case, reset version fields etc. */
@@ -282,6 +671,11 @@ static void create_appl_group(struct arcan_dbh* dbh, const char* applname)
 
 	if (dbh->akv_update)
 		arcan_mem_free(dbh->akv_update);
+	if (dbh->akv_clean)
+		arcan_mem_free(dbh->akv_clean);
+	if (dbh->akv_get)
+		arcan_mem_free(dbh->akv_get);
+	dbh->akv_update = dbh->akv_clean = dbh->akv_get = NULL;
 
 	size_t len = applname ? strlen(applname) : 0;
 	if (0 == len){
@@ -321,11 +715,11 @@ bool arcan_db_droptarget(struct arcan_dbh* dbh, arcan_targetid id)
 /* should suffice from ON DELETE CASCADE relationship */
 	static const char qry[]  = "DELETE FROM target WHERE tgtid = ?;";
 
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, qry, sizeof(qry)-1, &stmt, NULL);
+	kv_sync(dbh, true);
+	sqlite3_stmt* stmt = db_stmt(dbh, qry);
 	sqlite3_bind_int(stmt, 1, id);
 	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 
 	return true;
 }
@@ -334,11 +728,11 @@ bool arcan_db_dropconfig(struct arcan_dbh* dbh, arcan_configid id)
 {
 	static const char qry[] = "DELETE FROM config WHERE cfgid = ?;";
 
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, qry, sizeof(qry)-1, &stmt, NULL);
+	kv_sync(dbh, true);
+	sqlite3_stmt* stmt = db_stmt(dbh, qry);
 	sqlite3_bind_int(stmt, 1, id);
 	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 
 	return true;
 }
@@ -351,8 +745,7 @@ arcan_targetid arcan_db_addtarget(struct arcan_dbh* dbh,
 		"	target(tgtid, name, tag, executable, bfmt) VALUES "
 		"((select tgtid FROM target where name = ?), ?, ?, ?, ?)";
 
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, ddl, sizeof(ddl)-1, &stmt, NULL);
+	sqlite3_stmt* stmt = db_stmt(dbh, ddl);
 
 	sqlite3_bind_text(stmt, 1, identifier, -1, SQLITE_STATIC);
 	sqlite3_bind_text(stmt, 2, identifier, -1, SQLITE_STATIC);
@@ -361,16 +754,16 @@ arcan_targetid arcan_db_addtarget(struct arcan_dbh* dbh,
 	sqlite3_bind_int(stmt, 5, bfmt);
 
 	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 
 	arcan_targetid newid = sqlite3_last_insert_rowid(dbh->dbh);
 
 /* delete previous arguments */
 	static const char drop_argv[] = "DELETE FROM target_argv WHERE target = ?;";
-	sqlite3_prepare_v2(dbh->dbh, drop_argv, sizeof(drop_argv) - 1, &stmt, NULL);
+	stmt = db_stmt(dbh, drop_argv);
 	sqlite3_bind_int(stmt, 1, newid);
 	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 
 /* add new ones */
 	if (0 == sz)
@@ -378,11 +771,11 @@ arcan_targetid arcan_db_addtarget(struct arcan_dbh* dbh,
 
 	static const char add_argv[] = DI_INSARG_TARGET;
 	for (size_t i = 0; i < sz; i++){
-		sqlite3_prepare_v2(dbh->dbh, add_argv, sizeof(add_argv) - 1, &stmt, NULL);
+		stmt = db_stmt(dbh, add_argv);
 		sqlite3_bind_int(stmt, 1, newid);
 		sqlite3_bind_text(stmt, 2, argv[i], -1, SQLITE_STATIC);
 		sqlite3_step(stmt);
-		sqlite3_finalize(stmt);
+		db_stmt_done(stmt);
 	}
 
 	return newid;
@@ -398,8 +791,7 @@ arcan_configid arcan_db_addconfig(struct arcan_dbh* dbh,
 		"passed_counter, failed_counter, target) VALUES "
 		"((select cfgid FROM config where name = ?), ?, ?, ?, ?)";
 
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, ddl, sizeof(ddl)-1, &stmt, NULL);
+	sqlite3_stmt* stmt = db_stmt(dbh, ddl);
 
 	sqlite3_bind_text(stmt, 1, identifier, -1, SQLITE_STATIC);
 	sqlite3_bind_text(stmt, 2, identifier, -1, SQLITE_STATIC);
@@ -408,16 +800,16 @@ arcan_configid arcan_db_addconfig(struct arcan_dbh* dbh,
 	sqlite3_bind_int(stmt, 5, id);
 
 	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 
 	arcan_configid newid = sqlite3_last_insert_rowid(dbh->dbh);
 
 /* delete previous arguments */
 	static const char drop_argv[] = "DELETE FROM config_argv WHERE config = ?;";
-	sqlite3_prepare_v2(dbh->dbh, drop_argv, sizeof(drop_argv) - 1, &stmt, NULL);
+	stmt = db_stmt(dbh, drop_argv);
 	sqlite3_bind_int(stmt, 1, newid);
 	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 
 /* add new ones */
 	if (0 == sz)
@@ -425,11 +817,11 @@ arcan_configid arcan_db_addconfig(struct arcan_dbh* dbh,
 
 	static const char add_argv[] = DI_INSARG_CONFIG;
 	for (size_t i = 0; i < sz; i++){
-		sqlite3_prepare_v2(dbh->dbh, add_argv, sizeof(add_argv) - 1, &stmt, NULL);
+		stmt = db_stmt(dbh, add_argv);
 		sqlite3_bind_int(stmt, 1, newid);
 		sqlite3_bind_text(stmt, 2, argv[i], -1, SQLITE_STATIC);
 		sqlite3_step(stmt);
-		sqlite3_finalize(stmt);
+		db_stmt_done(stmt);
 	}
 
 	return newid;
@@ -441,15 +833,16 @@ bool arcan_db_verifytarget(struct arcan_dbh* dbh, arcan_targetid id)
 {
 	static const char ddl[] = "SELECT COUNT(*) FROM target WHERE tgtid = ?;";
 
-	sqlite3_stmt* stmt = NULL;
-	if (SQLITE_OK == sqlite3_prepare_v2(
-		dbh->dbh, ddl, sizeof(ddl)-1, &stmt, NULL)){
-		sqlite3_bind_int(stmt, 1, id);
-		sqlite3_step(stmt);
-		return 1 == sqlite3_column_int(stmt, 0);
-	}
+	sqlite3_stmt* stmt = db_stmt(dbh, ddl);
+	if (!stmt)
+		return false;
+
+	sqlite3_bind_int(stmt, 1, id);
+	sqlite3_step(stmt);
+	bool rv = 1 == sqlite3_column_int(stmt, 0);
+	db_stmt_done(stmt);
 
-	return false;
+	return rv;
 }
 
 arcan_targetid arcan_db_targetid(struct arcan_dbh* dbh,
@@ -459,13 +852,13 @@ arcan_targetid arcan_db_targetid(struct arcan_dbh* dbh,
 	static const char dql[] = "SELECT tgtid FROM target WHERE name = ?;";
 	sqlite3_stmt* stmt;
 
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql);
 	sqlite3_bind_text(stmt, 1, identifier, -1, SQLITE_STATIC);
 
 	if (SQLITE_ROW == sqlite3_step(stmt))
 		rid = sqlite3_column_int64(stmt, 0);
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 	return rid;
 }
 
@@ -473,8 +866,7 @@ struct arcan_strarr arcan_db_config_argv(struct arcan_dbh* dbh,arcan_configid id
 {
 	static const char dql[] = "SELECT arg FROM config_argv WHERE "
 		"config = ? ORDER BY argnum ASC;";
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	sqlite3_stmt* stmt = db_stmt(dbh, dql);
 	sqlite3_bind_int(stmt, 1, id);
 
 	return db_string_query(dbh, stmt, NULL, 0);
@@ -484,8 +876,7 @@ struct arcan_strarr arcan_db_target_argv(struct arcan_dbh* dbh,arcan_targetid id
 {
 	static const char dql[] = "SELECT arg FROM target_argv WHERE "
 		"target = ? ORDER BY argnum ASC;";
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	sqlite3_stmt* stmt = db_stmt(dbh, dql);
 	sqlite3_bind_int(stmt, 1, id);
 
 	return db_string_query(dbh, stmt, NULL, 0);
@@ -494,15 +885,14 @@ struct arcan_strarr arcan_db_target_argv(struct arcan_dbh* dbh,arcan_targetid id
 arcan_targetid arcan_db_cfgtarget(struct arcan_dbh* dbh, arcan_configid cfg)
 {
 	static const char dql[] = "SELECT target FROM config WHERE cfgid = ?;";
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	sqlite3_stmt* stmt = db_stmt(dbh, dql);
 	sqlite3_bind_int(stmt, 1, cfg);
 	arcan_targetid tid = BAD_TARGET;
 
 	if (SQLITE_ROW == sqlite3_step(stmt))
 		tid = sqlite3_column_int64(stmt, 0);
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 	return tid;
 }
 
@@ -514,14 +904,14 @@ arcan_configid arcan_db_configid(struct arcan_dbh* dbh,
 	sqlite3_stmt* stmt;
 	arcan_configid cid = BAD_CONFIG;
 
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql);
 	sqlite3_bind_text(stmt, 1, config, strlen(config), SQLITE_STATIC);
 	sqlite3_bind_int(stmt, 2, target);
 
 	if (SQLITE_ROW == sqlite3_step(stmt))
 		cid = sqlite3_column_int64(stmt, 0);
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 	return cid;
 }
 
@@ -529,7 +919,7 @@ struct arcan_strarr arcan_db_target_tags(struct arcan_dbh* dbh)
 {
 	sqlite3_stmt* stmt;
 	static const char dql[] = "SELECT DISTINCT tag FROM target;";
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql);
 	return db_string_query(dbh, stmt, NULL, 0);
 }
 
@@ -538,11 +928,11 @@ struct arcan_strarr arcan_db_targets(struct arcan_dbh* dbh, const char* tag)
 	sqlite3_stmt* stmt;
 	if (!tag){
 		static const char dql[] = "SELECT name FROM target;";
-		sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+		stmt = db_stmt(dbh, dql);
 	}
 	else {
 		static const char dql[] = "SELECT name FROM target WHERE tag=?;";
-		sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+		stmt = db_stmt(dbh, dql);
 		sqlite3_bind_text(stmt, 1, tag, strlen(tag), SQLITE_STATIC);
 	}
 	return db_string_query(dbh, stmt, NULL, 0);
@@ -552,8 +942,7 @@ char* arcan_db_targettag(struct arcan_dbh* dbh, arcan_targetid tid)
 {
 	static const char dql[] = "SELECT tag FROM target WHERE tgtid = ?;";
 	char* resstr = NULL;
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	sqlite3_stmt* stmt = db_stmt(dbh, dql);
 
 	sqlite3_bind_int(stmt, 1, tid);
 	if (sqlite3_step(stmt) == SQLITE_ROW){
@@ -563,7 +952,7 @@ char* arcan_db_targettag(struct arcan_dbh* dbh, arcan_targetid tid)
 	if (resstr)
 		resstr = strdup(resstr);
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 	return resstr;
 }
 
@@ -580,7 +969,7 @@ char* arcan_db_targetexec(struct arcan_dbh* dbh,
 	static const char dql[] = "SELECT executable, bfmt "
 		"FROM target WHERE tgtid = ?;";
 
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql) - 1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql);
 	sqlite3_bind_int(stmt, 1, tid);
 
 	char* execstr = NULL;
@@ -592,12 +981,11 @@ char* arcan_db_targetexec(struct arcan_dbh* dbh,
 	if (execstr)
 		execstr = strdup(execstr);
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 
 	static const char dql_tgt_argv[] = "SELECT arg FROM target_argv WHERE "
 		"target = ? ORDER BY argnum ASC;";
-	sqlite3_prepare_v2(dbh->dbh, dql_tgt_argv,
-		sizeof(dql_tgt_argv)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql_tgt_argv);
 	sqlite3_bind_int(stmt, 1, tid);
 
 	*argv = db_string_query(dbh, stmt, NULL, 1);
@@ -605,29 +993,25 @@ char* arcan_db_targetexec(struct arcan_dbh* dbh,
 
 	static const char dql_cfg_argv[] = "SELECT arg FROM config_argv WHERE "
 		"config = ? ORDER BY argnum ASC;";
-	sqlite3_prepare_v2(dbh->dbh, dql_cfg_argv,
-		sizeof(dql_cfg_argv)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql_cfg_argv);
 	sqlite3_bind_int(stmt, 1, configid);
 	*argv = db_string_query(dbh, stmt, argv, 0);
 
 	static const char dql_tgt_env[] = "SELECT key || '=' || val "
 		"FROM target_env WHERE target = ?";
-	sqlite3_prepare_v2(dbh->dbh, dql_tgt_env,
-		sizeof(dql_tgt_env)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql_tgt_env);
 	sqlite3_bind_int(stmt, 1, tid);
 	*env = db_string_query(dbh, stmt, NULL, 0);
 
 	static const char dql_cfg_env[] = "SELECT key || '=' || val "
 		"FROM config_env WHERE config = ?";
-	sqlite3_prepare_v2(dbh->dbh, dql_cfg_env,
-		sizeof(dql_cfg_env)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql_cfg_env);
 	sqlite3_bind_int(stmt, 1, tid);
 	db_string_query(dbh, stmt, env, 0);
 
 	static const char dql_tgt_lib[] = "SELECT libname FROM target_libs WHERE "
 		"target = ?;";
-	sqlite3_prepare_v2(dbh->dbh, dql_tgt_lib,
-		sizeof(dql_tgt_lib)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql_tgt_lib);
 	sqlite3_bind_int(stmt, 1, tid);
 	*libs = db_string_query(dbh, stmt, NULL, 0);
 
@@ -636,25 +1020,22 @@ char* arcan_db_targetexec(struct arcan_dbh* dbh,
 
 void arcan_db_launch_status(struct arcan_dbh* dbh, arcan_configid cid, bool s)
 {
-	static const char dql_ok[] = "UPDATE passed_counter SET "
-		"passed_counter = passed_counter + 1 WHERE config = ?;";
+	static const char dql_ok[] = "UPDATE config SET "
+		"passed_counter = passed_counter + 1 WHERE cfgid = ?;";
 
-	static const char dql_fail[] = "UPDATE failed_counter SET "
-		"failed_counter = failed_counter + 1 WHERE config = ?;";
+	static const char dql_fail[] = "UPDATE config SET "
+		"failed_counter = failed_counter + 1 WHERE cfgid = ?;";
 
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh,
-		(s ? dql_ok : dql_fail), sizeof(dql_ok)-1, &stmt, NULL);
+	sqlite3_stmt* stmt = db_stmt(dbh, s ? dql_ok : dql_fail);
 	sqlite3_bind_int(stmt, 1, cid);
 	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 }
 
 struct arcan_strarr arcan_db_configs(struct arcan_dbh* dbh, arcan_targetid tid)
 {
 	static const char dql[] = "SELECT name FROM config WHERE target = ?;";
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	sqlite3_stmt* stmt = db_stmt(dbh, dql);
 	sqlite3_bind_int(stmt, 1, tid);
 
 	return db_string_query(dbh, stmt, NULL, 0);
@@ -663,8 +1044,7 @@ struct arcan_strarr arcan_db_configs(struct arcan_dbh* dbh, arcan_targetid tid)
 char* arcan_db_execname(struct arcan_dbh* dbh, arcan_targetid tid)
 {
 	static const char dql[] = "SELECT executable FROM target WHERE tgtid = ?;";
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	sqlite3_stmt* stmt = db_stmt(dbh, dql);
 	sqlite3_bind_int(stmt, 1, tid);
 
 	char* res = NULL;
@@ -673,61 +1053,66 @@ char* arcan_db_execname(struct arcan_dbh* dbh, arcan_targetid tid)
 		res = arg ? strdup((char*)arg) : NULL;
 	}
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 	return res;
 }
 
 void arcan_db_begin_transaction(struct arcan_dbh* dbh,
 	enum DB_KVTARGET kvt, union arcan_dbtrans_id id)
 {
-	if (dbh->transaction)
+	if (dbh->trpending)
 		arcan_fatal("arcan_db_begin_transaction()"
 			"	called during a pending transaction\n");
 
+	dbh->trid = id;
+	dbh->ttype = kvt;
+	dbh->trpending = true;
+
+/* with the mirror active, the kv stores are only updated in memory and
+ * written back along with everything else on the next flush */
+	dbh->trmirror = kv_mirrored(dbh, kvt);
+	if (dbh->trmirror)
+		return;
+
 	sqlite3_exec(dbh->dbh, "BEGIN;", NULL, NULL, NULL);
-	int code = SQLITE_OK;
+
+/* and whatever the mirror has pending joins this transaction */
+	kv_flush(dbh);
+
+	const char* qry = NULL;
 
 	switch (kvt){
 	case DVT_APPL:
-		code = sqlite3_prepare_v2(dbh->dbh, dbh->akv_update,
-			dbh->akv_upd_sz, &dbh->transaction, NULL);
+		qry = dbh->akv_update;
 	break;
 
 	case DVT_TARGET:
-		code = sqlite3_prepare_v2(dbh->dbh, DI_INSKV_TARGET,
-			strlen(DI_INSKV_TARGET)+1, &dbh->transaction, NULL);
+		qry = DI_INSKV_TARGET;
 	break;
 
 	case DVT_CONFIG:
-		code = sqlite3_prepare_v2(dbh->dbh, DI_INSKV_CONFIG,
-			strlen(DI_INSKV_CONFIG)+1, &dbh->transaction, NULL);
+		qry = DI_INSKV_CONFIG;
 	break;
 
 	case DVT_CONFIG_ENV:
-		code = sqlite3_prepare_v2(dbh->dbh, DI_INSKV_CONFIG_ENV,
-			strlen(DI_INSKV_TARGET_ENV)+1, &dbh->transaction, NULL);
+		qry = DI_INSKV_CONFIG_ENV;
 	break;
 
 	case DVT_TARGET_ENV:
-		code = sqlite3_prepare_v2(dbh->dbh, DI_INSKV_TARGET_ENV,
-			strlen(DI_INSKV_TARGET_ENV)+1, &dbh->transaction, NULL);
+		qry = DI_INSKV_TARGET_ENV;
 	break;
 
 	case DVT_TARGET_LIBV:
-		code = sqlite3_prepare_v2(dbh->dbh, DI_INSKV_TARGET_LIBV,
-			strlen(DI_INSKV_TARGET_LIBV)+1, &dbh->transaction, NULL);
+		qry = DI_INSKV_TARGET_LIBV;
 	break;
 	case DVT_ENDM:
 	break;
 	}
 
-	if (code != SQLITE_OK){
+	if (qry && !(dbh->transaction = db_stmt(dbh, qry))){
 		arcan_warning("arcan_db_begin_transaction(), failed: %s\n",
 			sqlite3_errmsg(dbh->dbh));
 	}
-
-	dbh->trid = id;
-	dbh->ttype = kvt;
 }
 
 struct arcan_strarr arcan_db_getkeys(struct arcan_dbh* dbh,
@@ -745,8 +1130,8 @@ struct arcan_strarr arcan_db_getkeys(struct arcan_dbh* dbh,
 	else
 		qry = queries[1];
 
-	sqlite3_stmt * stmt;
-	sqlite3_prepare_v2(dbh->dbh, qry, sizeof(GET_KV_TGT)-1, &stmt, NULL);
+	kv_sync(dbh, false);
+	sqlite3_stmt* stmt = db_stmt(dbh, qry);
 	sqlite3_bind_int(stmt, 1, tgt>=DVT_TARGET && tgt<DVT_CONFIG ? id.tid:id.cid);
 
 #undef GET_KV_TGT
@@ -760,10 +1145,10 @@ struct arcan_strarr arcan_db_applkeys(struct arcan_dbh* dbh,
 
 	size_t mk_sz = sizeof(MATCH_APPL) + strlen(applname);
 	char mk_buf[ mk_sz ];
-	ssize_t nw = snprintf(mk_buf, mk_sz, MATCH_APPL, applname);
+	snprintf(mk_buf, mk_sz, MATCH_APPL, applname);
 
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, mk_buf, mk_sz-1, &stmt, NULL);
+	kv_sync(dbh, false);
+	sqlite3_stmt* stmt = db_stmt(dbh, mk_buf);
 	sqlite3_bind_text(stmt, 1, pattern, -1, SQLITE_TRANSIENT);
 
 	return db_string_query(dbh, stmt, NULL, 0);
@@ -787,8 +1172,8 @@ struct arcan_strarr arcan_db_matchkey(struct arcan_dbh* dbh,
 	else
 		qry = queries[1];
 
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, qry, sizeof(MATCH_KEY_TGT)-1, &stmt, NULL);
+	kv_sync(dbh, false);
+	sqlite3_stmt* stmt = db_stmt(dbh, qry);
 	sqlite3_bind_text(stmt, 1, pattern, -1, SQLITE_TRANSIENT);
 
 	return db_string_query(dbh, stmt, NULL, 0);
@@ -802,8 +1187,8 @@ char* arcan_db_getvalue(struct arcan_dbh* dbh,
 	assert(DVT_ENDM == 5);
 
 	static const char* queries[] = {
-		"SELECT val FROM target_kv WHERE key = ? AND tgtid = ? LIMIT 1;",
-		"SELECT val FROM config_kv WHERE key = ? AND cfgid = ? LIMIT 1;"
+		"SELECT val FROM target_kv WHERE key = ? AND target = ? LIMIT 1;",
+		"SELECT val FROM config_kv WHERE key = ? AND config = ? LIMIT 1;"
 	};
 
 	const char* qry = NULL;
@@ -812,39 +1197,66 @@ char* arcan_db_getvalue(struct arcan_dbh* dbh,
 	else
 		qry = queries[1];
 
-/* assume they all are the same length */
-	static size_t qry_sz;
-	if (qry_sz == 0)
-		qry_sz = strlen(queries[1]);
-
-	sqlite3_stmt* stmt = NULL;
-
+	const char* appl = NULL;
 	if (tgt == DVT_APPL){
-		sqlite3_prepare_v2(dbh->dbh, dbh->akv_get, dbh->akv_get_sz, &stmt, NULL);
-	}
-	else {
-		sqlite3_prepare_v2(dbh->dbh, qry, qry_sz, &stmt, NULL);
-		sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
-		sqlite3_bind_int(stmt, 2, id);
+		appl = dbh->applname;
+		qry = dbh->akv_get;
+		id = 0;
 	}
 
+	if (kv_get(dbh, tgt, id, appl, key, &res))
+		return res;
+
+	sqlite3_stmt* stmt = db_stmt(dbh, qry);
+	if (!stmt)
+		return NULL;
+
+	sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
+	if (tgt != DVT_APPL)
+		sqlite3_bind_int64(stmt, 2, id);
+
 	if (SQLITE_ROW == sqlite3_step(stmt)){
 		const char* row = (const char*) sqlite3_column_text(stmt, 0);
 		if (row)
 			res = strdup(row);
 	}
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
+
+	if (kv_mirrored(dbh, tgt))
+		kv_set(dbh, tgt, id, appl, key, res, false);
+
 	return res;
 }
 
 void arcan_db_add_kvpair(
 	struct arcan_dbh* dbh, const char* key, const char* val)
 {
-	if (!dbh->transaction)
+	if (!dbh->trpending)
 		arcan_fatal("arcan_db_add_kvpair() "
 			"called without any open transaction.");
 
+/* an empty value in a transaction is a deletion, see end_transaction */
+	if (dbh->trmirror){
+		if (!val)
+			return;
+
+		int64_t id = 0;
+		if (dbh->ttype == DVT_TARGET)
+			id = dbh->trid.tid;
+		else if (dbh->ttype == DVT_CONFIG)
+			id = dbh->trid.cid;
+
+		kv_set(dbh, dbh->ttype, id,
+			dbh->ttype == DVT_APPL ? dbh->applname : NULL, key,
+			val[0] ? val : NULL, true
+		);
+		return;
+	}
+
+	if (!dbh->transaction)
+		return;
+
 	if (!val){
 		dbh->trclean = true;
 		return;
@@ -877,19 +1289,25 @@ void arcan_db_add_kvpair(
 	if (SQLITE_DONE != rc)
 		arcan_warning("arcan_db_addkvpair(%s=%s), %d failed: %s\n",
 			key, val, rc, sqlite3_errmsg(dbh->dbh));
-	else {
-		sqlite3_clear_bindings(dbh->transaction);
-		sqlite3_reset(dbh->transaction);
-	}
+
+	db_stmt_done(dbh->transaction);
 }
 
 void arcan_db_end_transaction(struct arcan_dbh* dbh)
 {
-	if (!dbh->transaction)
+	if (!dbh->trpending)
 		arcan_fatal("arcan_db_end_transaction() "
 			"called without any open transaction.");
 
-	sqlite3_finalize(dbh->transaction);
+	dbh->trpending = false;
+	if (dbh->trmirror){
+		dbh->trmirror = false;
+		return;
+	}
+
+	db_stmt_done(dbh->transaction);
+	dbh->transaction = NULL;
+
 	if (dbh->trclean){
 		switch (dbh->ttype){
 		case DVT_APPL:
@@ -911,8 +1329,6 @@ void arcan_db_end_transaction(struct arcan_dbh* dbh)
 		arcan_warning("arcan_db_end_transaction(), failed: %s\n",
 			sqlite3_errmsg(dbh->dbh));
 	}
-
-	dbh->transaction = NULL;
 }
 
 bool arcan_db_appl_kv(struct arcan_dbh* dbh,
@@ -920,36 +1336,28 @@ bool arcan_db_appl_kv(struct arcan_dbh* dbh,
 {
 	bool rv = false;
 
-	if (dbh->transaction)
+	if (dbh->trpending)
 		arcan_fatal("arcan_db_appl_kv() called during a pending transaction\n");
 
 	if (!applname || !dbh || !key)
 		return rv;
 
-	const char ddl_insert[] = "INSERT OR REPLACE "
-		"INTO appl_%s(key, val) VALUES(?, ?);";
-	const char k_drop[] = "DELETE FROM appl_%s WHERE key=?;";
-
-	size_t upd_sz = 0;
-	const char* dqry = ddl_insert;
-
-	if (!value){
-		upd_sz = sizeof(k_drop) + strlen(applname);
-		dqry = k_drop;
+	if (kv_mirrored(dbh, DVT_APPL)){
+		kv_set(dbh, DVT_APPL, 0, applname, key, value, true);
+		return true;
 	}
-	else
-		upd_sz = sizeof(ddl_insert) + strlen(applname);
 
-	char upd_buf[ upd_sz ];
-	ssize_t nw = snprintf(upd_buf, upd_sz, dqry, applname);
+	sqlite3_stmt* stmt = db_appl_stmt(dbh,
+		value ? appl_kv_insert : appl_kv_drop, applname);
+	if (!stmt)
+		return rv;
 
-	sqlite3_stmt* stmt = NULL;
-	sqlite3_prepare_v2(dbh->dbh, upd_buf, nw, &stmt, NULL);
-	sqlite3_bind_text(stmt, 1, key,   -1, SQLITE_TRANSIENT);
-	sqlite3_bind_text(stmt, 2, value, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text(stmt, 1, key, -1, SQLITE_TRANSIENT);
+	if (value)
+		sqlite3_bind_text(stmt, 2, value, -1, SQLITE_TRANSIENT);
 
 	rv = sqlite3_step(stmt) == SQLITE_DONE;
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 
 	return rv;
 }
@@ -960,18 +1368,16 @@ char* arcan_db_appl_val(struct arcan_dbh* dbh,
 	if (!dbh || !key)
 		return NULL;
 
-	const char qry[] = "SELECT val FROM appl_%s WHERE key = ?;";
+	char* rv = NULL;
+	if (kv_get(dbh, DVT_APPL, 0, applname, key, &rv))
+		return rv;
 
-	size_t wbuf_sz = strlen(applname) + sizeof(qry);
-	char wbuf[ wbuf_sz ];
-	memset(wbuf, '\0', wbuf_sz);
-	snprintf(wbuf, wbuf_sz, qry, applname);
+	sqlite3_stmt* stmt = db_appl_stmt(dbh, appl_kv_get, applname);
+	if (!stmt)
+		return NULL;
 
-	sqlite3_stmt* stmt = NULL;
-	sqlite3_prepare_v2(dbh->dbh, wbuf, wbuf_sz, &stmt, NULL);
 	sqlite3_bind_text(stmt, 1, (char*) key, -1, SQLITE_TRANSIENT);
 
-	char* rv = NULL;
 	int rc = sqlite3_step(stmt);
 
 	if (rc == SQLITE_ROW){
@@ -981,7 +1387,10 @@ char* arcan_db_appl_val(struct arcan_dbh* dbh,
 			rv = strdup((const char*) rowt);
 	}
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
+
+	if (kv_mirrored(dbh, DVT_APPL))
+		kv_set(dbh, DVT_APPL, 0, applname, key, rv, false);
 
 	return rv;
 }
@@ -1029,14 +1438,28 @@ static bool dbh_integrity_check(struct arcan_dbh* dbh){
 
 void arcan_db_close(struct arcan_dbh** ctx)
 {
-	if (!ctx)
+	if (!ctx || !*ctx)
 		return;
 
-	sqlite3_close((*ctx)->dbh);
-	arcan_mem_free((*ctx)->applname);
-	arcan_mem_free((*ctx)->akv_update);
-	arcan_mem_free((*ctx)->akv_get);
-	arcan_mem_free(*ctx);
+	struct arcan_dbh* dbh = *ctx;
+	if (dbh->kv.buckets){
+		kv_flush(dbh);
+		kv_purge(dbh);
+		arcan_mem_free(dbh->kv.buckets);
+	}
+
+	for (size_t i = 0; i < DB_STMT_CACHE; i++)
+		if (dbh->stmts[i].stmt){
+			sqlite3_finalize(dbh->stmts[i].stmt);
+			free(dbh->stmts[i].qry);
+		}
+
+	sqlite3_close(dbh->dbh);
+	arcan_mem_free(dbh->applname);
+	arcan_mem_free(dbh->akv_update);
+	arcan_mem_free(dbh->akv_get);
+	arcan_mem_free(dbh->akv_clean);
+	arcan_mem_free(dbh);
 	*ctx = NULL;
 }
 
@@ -1071,8 +1494,7 @@ struct arcan_dbh* arcan_db_open(const char* fname, const char* applname)
 		assert(dbh);
 
 		if ( !dbh_integrity_check(res) ){
-			sqlite3_close(dbh);
-			arcan_mem_free(res);
+			arcan_db_close(&res);
 			return NULL;
 		}
 
@@ -1082,6 +1504,11 @@ struct arcan_dbh* arcan_db_open(const char* fname, const char* applname)
 		db_void_query(res, "PRAGMA foreign_keys=ON;", false);
 		db_void_query(res, "PRAGMA synchronous=OFF;", false);
 
+#ifndef ARCAN_DB_STANDALONE
+		if (getenv("ARCAN_DB_MIRROR"))
+			arcan_db_kvmirror(res, true);
+#endif
+
 		return res;
 	}
 	else
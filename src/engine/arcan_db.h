@@ -60,6 +60,25 @@ void arcan_db_set_shared(struct arcan_dbh*);
  */
 void arcan_db_close(struct arcan_dbh**);
 
+/*
+ * Enable or disable the in-memory mirror of the appl/target/config
+ * key-value stores (the _ENV/_LIBV groups are not covered). With the
+ * mirror active, lookups are served from memory after the first query
+ * and updates (appl_kv and transactions alike) are deferred until the
+ * next arcan_db_flush, which writes them back as a single transaction.
+ *
+ * The engine enables this if ARCAN_DB_MIRROR is set in the environment,
+ * and flushes once every logical tick.
+ */
+void arcan_db_kvmirror(struct arcan_dbh*, bool enable);
+
+/*
+ * Write back any updates pending in the key-value mirror, this is
+ * implied by close and by queries that need to go through the database
+ * (key pattern matching, drop-appl etc.)
+ */
+void arcan_db_flush(struct arcan_dbh*);
+
 /*
  * Define this to add database features that should
  * only be present in a standalone application
@@ -163,7 +182,9 @@ union arcan_dbtrans_id {
  * Storage operations on a key- store are marked as transactions,
  * i.e. begin_transaction to specify the type then repeatedly call add_kvpair
  * and finalize with end_transaction. While inside a transaction, the
- * only valid db operation is add_kvpair and end_transaction.
+ * only valid db operation is add_kvpair and end_transaction. For the
+ * mirrored stores (see arcan_db_kvmirror) the transaction is merged into
+ * the next flush, otherwise pending mirror updates are merged into it.
  */
 void arcan_db_begin_transaction(struct arcan_dbh*, enum DB_KVTARGET,
 	union arcan_dbtrans_id);
@@ -220,7 +241,8 @@ void arcan_db_dropappl(struct arcan_dbh* dbh, const char* appl);
 
 /*
  * Synchronously store/retrieve a key-value pair,
- * set to empty value to delete.
+ * set to empty value to delete. With the mirror enabled, the store
+ * is deferred to the next flush and always reports success.
  */
 bool arcan_db_appl_kv(struct arcan_dbh* dbh, const char* appl,
 	const char* key, const char* value);
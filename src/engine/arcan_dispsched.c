@@ -0,0 +1,208 @@
+/*
+ * Copyright 2019, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in the arcan source repository.
+ * Reference: https://arcan-fe.com
+ * Description: Per-display scanout deadlines, see arcan_dispsched.h
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <math.h>
+
+#include "arcan_dispsched.h"
+
+/* starting estimate for the cost of composing a display, same as the
+ * conductor uses for render cost */
+#define DEFAULT_COST 4
+
+struct dispsched_display* dispsched_find(
+	struct dispsched* ctx, size_t gpu_id, size_t disp_id)
+{
+	for (size_t i = 0; i < DISPSCHED_LIMIT; i++){
+		struct dispsched_display* d = &ctx->displays[i];
+		if (d->used && d->gpu_id == gpu_id && d->disp_id == disp_id)
+			return d;
+	}
+
+	return NULL;
+}
+
+struct dispsched_display* dispsched_register(struct dispsched* ctx,
+	size_t gpu_id, size_t disp_id, float rate, long long vid)
+{
+	double period = 1000.0 / (rate > 0 ? rate : 60.0);
+	struct dispsched_display* d = dispsched_find(ctx, gpu_id, disp_id);
+
+	if (d){
+		d->vid = vid;
+		if (fabs(d->period - period) > 0.01){
+			d->period = period;
+			d->last_vblank = -1;
+		}
+		return d;
+	}
+
+	for (size_t i = 0; i < DISPSCHED_LIMIT; i++){
+		if (ctx->displays[i].used)
+			continue;
+
+		d = &ctx->displays[i];
+		*d = (struct dispsched_display){
+			.used = true,
+			.gpu_id = gpu_id,
+			.disp_id = disp_id,
+			.vid = vid,
+			.period = period,
+			.last_vblank = -1,
+			.cost = DEFAULT_COST
+		};
+		return d;
+	}
+
+	return NULL;
+}
+
+void dispsched_release(struct dispsched* ctx, size_t gpu_id, size_t disp_id)
+{
+	struct dispsched_display* d = dispsched_find(ctx, gpu_id, disp_id);
+	if (d)
+		*d = (struct dispsched_display){0};
+}
+
+long long dispsched_next_vblank(const struct dispsched_display* d, long long now)
+{
+	if (d->last_vblank < 0)
+		return now;
+
+	double next = d->last_vblank + d->period;
+	if (next <= now)
+		next += (floor((now - next) / d->period) + 1.0) * d->period;
+
+	return llround(next);
+}
+
+/*
+ * Displays are composed one after the other, so a display can't start at
+ * its own (vblank - cost) if another one with an earlier vblank is being
+ * composed at that time. Order by vblank (earliest first) and walk that
+ * backwards so that every display also finishes before the start of the
+ * next one in line, which gives the latest time each can start and still
+ * make its vblank.
+ */
+size_t dispsched_due(struct dispsched* ctx, long long now, int margin,
+	bool eager, struct dispsched_display** out, size_t lim, int* wait)
+{
+	struct dispsched_display* order[DISPSCHED_LIMIT];
+	long long next[DISPSCHED_LIMIT], start[DISPSCHED_LIMIT];
+	bool force[DISPSCHED_LIMIT];
+	long long next_wait = LLONG_MAX;
+	size_t n = 0, count = 0;
+	bool any = false;
+
+	for (size_t i = 0; i < DISPSCHED_LIMIT; i++){
+		struct dispsched_display* d = &ctx->displays[i];
+		if (!d->used)
+			continue;
+		any = true;
+
+/* the flip event will wake the platform, but it can go missing (DPMS off,
+ * VT switch, driver dropping it). Give it a period past the target and then
+ * consider the frame missed and the display due again, or it never will be */
+		bool expired = false;
+		if (d->pending){
+			long long left = d->target + (long long) ceil(d->period) - now;
+			if (left >= 0){
+				if (left < next_wait)
+					next_wait = left;
+				continue;
+			}
+
+			d->pending = false;
+			d->misses++;
+			d->last_vblank = d->target;
+			expired = true;
+		}
+
+		long long nv = dispsched_next_vblank(d, now);
+		size_t j = count++;
+		for (; j > 0 && next[j-1] > nv; j--){
+			next[j] = next[j-1];
+			order[j] = order[j-1];
+			force[j] = force[j-1];
+		}
+		next[j] = nv;
+		order[j] = d;
+		force[j] = expired;
+	}
+
+	long long limit = LLONG_MAX;
+	for (size_t i = count; i > 0; i--){
+		long long finish = next[i-1] - margin;
+		if (finish > limit)
+			finish = limit;
+		start[i-1] = finish - (long long) ceil(order[i-1]->cost);
+		limit = start[i-1];
+	}
+
+	for (size_t i = 0; i < count; i++){
+		struct dispsched_display* d = order[i];
+		long long left = start[i] - now;
+
+		if (eager || force[i] || d->last_vblank < 0 || left <= 0){
+			if (n < lim)
+				out[n++] = d;
+		}
+		else if (left < next_wait)
+			next_wait = left;
+	}
+
+	if (wait){
+		if (!any)
+			*wait = -1;
+		else if (next_wait == LLONG_MAX)
+			*wait = 0;
+		else
+			*wait = next_wait < 1 ? 1 : (next_wait > INT_MAX ? INT_MAX : next_wait);
+	}
+
+	return n;
+}
+
+void dispsched_submit(struct dispsched* ctx,
+	size_t gpu_id, size_t disp_id, long long now, int cost, bool queued)
+{
+	struct dispsched_display* d = dispsched_find(ctx, gpu_id, disp_id);
+	if (!d)
+		return;
+
+/* react slowly so that one slow frame doesn't move the start of every display */
+	d->cost = 0.2 * (double)cost + 0.8 * d->cost;
+	long long next = dispsched_next_vblank(d, now);
+
+	if (queued){
+		d->pending = true;
+		d->target = next;
+	}
+	else {
+		d->idle++;
+		d->last_vblank = next;
+	}
+}
+
+void dispsched_vblank(struct dispsched* ctx,
+	size_t gpu_id, size_t disp_id, long long ts)
+{
+	struct dispsched_display* d = dispsched_find(ctx, gpu_id, disp_id);
+	if (!d)
+		return;
+
+/* landing later than half a period after the target means we were late */
+	if (d->pending && ts > d->target + d->period * 0.5)
+		d->misses += (unsigned long long)
+			((ts - d->target + d->period * 0.5) / d->period);
+
+	d->frames++;
+	d->pending = false;
+	d->last_vblank = ts;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2019, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in the arcan source repository.
+ * Reference: https://arcan-fe.com
+ * Description: Per-display scanout deadlines used by the conductor. Each
+ * display is tracked with its own refresh period and last known vblank so
+ * that displays with different rates are composed and flipped on their own
+ * cadence rather than that of the fastest or primary one. Kept free from
+ * engine dependencies so that it can be driven by a simulated clock, see
+ * tests/core/dispsched.
+ */
+
+#ifndef HAVE_ARCAN_DISPSCHED
+#define HAVE_ARCAN_DISPSCHED
+
+#ifndef DISPSCHED_LIMIT
+#define DISPSCHED_LIMIT 16
+#endif
+
+struct dispsched_display {
+	bool used;
+	size_t gpu_id, disp_id;
+	long long vid;
+
+/* ms between vblanks and when the last one (that we know of) happened */
+	double period;
+	long long last_vblank;
+
+/* a frame has been queued and is waiting for the flip, aimed at [target] */
+	bool pending;
+	long long target;
+
+/* moving average of the time from starting to compose until submitted */
+	double cost;
+
+	unsigned long long frames, idle, misses;
+};
+
+struct dispsched {
+	struct dispsched_display displays[DISPSCHED_LIMIT];
+};
+
+/*
+ * Add or update the display [gpu_id:disp_id], a [rate] of 0 (unknown) is
+ * treated as 60Hz. Timing information is kept if the display is already
+ * known and the rate didn't change. Returns NULL if the table is full.
+ */
+struct dispsched_display* dispsched_register(struct dispsched* ctx,
+	size_t gpu_id, size_t disp_id, float rate, long long vid);
+
+void dispsched_release(struct dispsched* ctx, size_t gpu_id, size_t disp_id);
+
+struct dispsched_display* dispsched_find(
+	struct dispsched* ctx, size_t gpu_id, size_t disp_id);
+
+/*
+ * The first vblank after [now] that the display hasn't been given a frame
+ * (or been marked idle) for.
+ */
+long long dispsched_next_vblank(const struct dispsched_display* d, long long now);
+
+/*
+ * Fill [out] with up to [lim] displays that should be composed and submitted
+ * now, in the order they should be composed (earliest vblank first). That is
+ * those without a pending flip whose next vblank is closer than their cost +
+ * [margin] plus the cost of the ones that have to be composed before them.
+ * With [eager], every display without a pending flip is due. [wait] is set
+ * to the number of ms until the next display becomes due (or its flip is
+ * expected), or -1 if there are no displays at all.
+ *
+ * A flip that hasn't been reported a period after its target is considered
+ * lost: it is counted as a miss and the display is due again.
+ */
+size_t dispsched_due(struct dispsched* ctx, long long now, int margin,
+	bool eager, struct dispsched_display** out, size_t lim, int* wait);
+
+/*
+ * Composition for the display finished at [now] after [cost] ms. With
+ * [queued], a frame is waiting for flip and the display isn't due again
+ * until dispsched_vblank. Otherwise (no changes, or a display without flip
+ * feedback) the upcoming vblank is considered handled.
+ */
+void dispsched_submit(struct dispsched* ctx,
+	size_t gpu_id, size_t disp_id, long long now, int cost, bool queued);
+
+/*
+ * A queued frame was scanned out at [ts]
+ */
+void dispsched_vblank(struct dispsched* ctx,
+	size_t gpu_id, size_t disp_id, long long ts);
+
+#endif
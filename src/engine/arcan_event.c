@@ -471,6 +471,9 @@ void arcan_bench_register_cost(unsigned cost)
 void arcan_bench_register_frame()
 {
 	static long long int lastframe = -1;
+	benchdata.pipeline = benchdata.acc;
+	benchdata.acc = (struct arcan_bench_pipeline){0};
+
 	if (benchdata.bench_enabled == false)
 		return;
 
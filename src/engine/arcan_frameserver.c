@@ -33,6 +33,7 @@
 #define FRAMESERVER_PRIVATE
 #include "arcan_frameserver.h"
 #include "arcan_conductor.h"
+#include "arcan_amixer.h"
 
 #include "arcan_event.h"
 #include "arcan_img.h"
@@ -49,6 +50,10 @@
 #endif
 
 static int g_buffers_locked;
+static struct {
+	unsigned long long next;
+	unsigned step, cost;
+} g_deadline;
 
 static inline void emit_deliveredframe(arcan_frameserver* src,
 	unsigned long long pts, unsigned long long framecount);
@@ -104,6 +109,12 @@ arcan_errc arcan_frameserver_free(arcan_frameserver* src)
 	}
 	src->alocks = NULL;
 
+	if (src->amixer){
+		amixer_free(src->amixer);
+		arcan_mem_free(src->amixer);
+		src->amixer = NULL;
+	}
+
 	char msg[32];
 	if (!platform_fsrv_lastwords(src, msg, COUNT_OF(msg)))
 		snprintf(msg, COUNT_OF(msg), "Couldn't access metadata (SIGBUS?)");
@@ -181,6 +192,59 @@ bool arcan_frameserver_control_chld(arcan_frameserver* src){
 	return true;
 }
 
+/*
+ * Synch each region in the dirty chain of the frame as a separate update.
+ * An empty chain, broken counters from the client or regions that cover
+ * most of the store degrade to a full update.
+ */
+static void push_chain(arcan_frameserver* src, struct agp_vstore* store,
+	struct stream_meta stream, enum stream_type type)
+{
+	struct arcan_shmif_page* shmpage = src->shm.ptr;
+	struct arcan_shmif_region regions[ARCAN_SHMIF_DIRTY_CHAIN_LIM];
+	size_t n_regions = 0, area = 0;
+
+	unsigned head = atomic_load(&shmpage->dirty_chain.head);
+	unsigned mark = atomic_load_explicit(
+		&shmpage->dirty_chain.mark, memory_order_acquire);
+	unsigned count = mark - head;
+	if (count > ARCAN_SHMIF_DIRTY_CHAIN_LIM)
+		count = 0;
+
+	for (size_t i = 0; i < count; i++){
+		struct arcan_shmif_region r = atomic_load(
+			&shmpage->dirty_chain.regions[(head + i) % ARCAN_SHMIF_DIRTY_CHAIN_LIM]);
+
+		if (r.x2 > store->w)
+			r.x2 = store->w;
+		if (r.y2 > store->h)
+			r.y2 = store->h;
+		if (r.x1 >= r.x2 || r.y1 >= r.y2)
+			continue;
+
+		regions[n_regions++] = r;
+		area += (size_t)(r.x2 - r.x1) * (r.y2 - r.y1);
+	}
+
+	arcan_benchdata* bench = arcan_bench_data();
+	if (!n_regions || area > (size_t)store->w * store->h / 2){
+		stream.dirty = false;
+		agp_stream_commit(store, agp_stream_prepare(store, stream, type));
+		bench->acc.upload_bytes += sizeof(av_pixel) * store->w * store->h;
+		return;
+	}
+
+	stream.dirty = true;
+	for (size_t i = 0; i < n_regions; i++){
+		stream.x1 = regions[i].x1;
+		stream.y1 = regions[i].y1;
+		stream.w = regions[i].x2 - regions[i].x1;
+		stream.h = regions[i].y2 - regions[i].y1;
+		agp_stream_commit(store, agp_stream_prepare(store, stream, type));
+		bench->acc.upload_bytes += sizeof(av_pixel) * stream.w * stream.h;
+	}
+}
+
 static bool push_buffer(arcan_frameserver* src,
 	struct agp_vstore* store, struct arcan_shmif_region* dirty)
 {
@@ -274,6 +338,14 @@ static bool push_buffer(arcan_frameserver* src,
 	}
 
 	stream.buf = buf;
+	enum stream_type type = explicit ? STREAM_RAW_DIRECT_SYNCHRONOUS : (
+		src->flags.local_copy ? STREAM_RAW_DIRECT_COPY : STREAM_RAW_DIRECT);
+
+	if (atomic_load(&src->shm.ptr->hints) & SHMIF_RHINT_SUBREGION_CHAIN){
+		push_chain(src, store, stream, type);
+		goto commit_mask;
+	}
+
 /* validate, fallback to fullsynch if we get bad values */
 	if (dirty){
 		stream.x1 = dirty->x1; stream.w = dirty->x2 - dirty->x1;
@@ -282,9 +354,9 @@ static bool push_buffer(arcan_frameserver* src,
 			(dirty->x2 - dirty->x1 > 0 && stream.w <= store->w) &&
 			(dirty->y2 - dirty->y1 > 0 && stream.h <= store->h);
 	}
-	stream = agp_stream_prepare(store, stream, explicit ?
-		STREAM_RAW_DIRECT_SYNCHRONOUS : (
-			src->flags.local_copy ? STREAM_RAW_DIRECT_COPY : STREAM_RAW_DIRECT));
+	stream = agp_stream_prepare(store, stream, type);
+	arcan_bench_data()->acc.upload_bytes += sizeof(av_pixel) *
+		(stream.dirty ? stream.w * stream.h : store->w * store->h);
 
 	agp_stream_commit(store, stream);
 commit_mask:
@@ -475,6 +547,51 @@ void arcan_frameserver_lock_buffers(int state)
 	g_buffers_locked = state;
 }
 
+void arcan_frameserver_deadline(
+	unsigned long long next, unsigned step, unsigned cost)
+{
+	g_deadline.next = next;
+	g_deadline.step = step;
+	g_deadline.cost = cost;
+}
+
+/*
+ * Track how the delivery of a frame relates to the deadline we gave when the
+ * previous one was released, the jitter is what gets fed back to the client.
+ */
+static void delivery_timing(struct arcan_frameserver* tgt)
+{
+	if (!tgt->desc.deadline)
+		return;
+
+	float dev = (float)((long long)arcan_timemillis() -
+		(long long)tgt->desc.deadline);
+	tgt->desc.delivery_dev = 0.9 * tgt->desc.delivery_dev + 0.1 * dev;
+	tgt->desc.jitter = 0.9 * tgt->desc.jitter +
+		0.1 * fabsf(dev - tgt->desc.delivery_dev);
+}
+
+/*
+ * Update the deadline feedback fields in the page before the client is woken
+ * up, this relies on the caller having the page guarded.
+ */
+static void publish_deadline(struct arcan_frameserver* tgt)
+{
+	struct arcan_shmif_page* shmpage = tgt->shm.ptr;
+
+	if (!g_deadline.next){
+		atomic_store(&shmpage->vsynch_next, 0);
+		tgt->desc.deadline = 0;
+		return;
+	}
+
+	tgt->desc.deadline = g_deadline.next - g_deadline.cost;
+	atomic_store(&shmpage->vsynch_step, g_deadline.step * 1000);
+	atomic_store(&shmpage->vsynch_cost, g_deadline.cost * 1000);
+	atomic_store(&shmpage->vsynch_jitter, (uint32_t)(tgt->desc.jitter * 1000.0));
+	atomic_store(&shmpage->vsynch_next, g_deadline.next);
+}
+
 int arcan_frameserver_releaselock(struct arcan_frameserver* tgt)
 {
 	if (!tgt->flags.release_pending){
@@ -484,8 +601,8 @@ int arcan_frameserver_releaselock(struct arcan_frameserver* tgt)
 	tgt->flags.release_pending = false;
 	TRAMP_GUARD(0, tgt);
 
-	atomic_store_explicit(&tgt->shm.ptr->vready, 0, memory_order_release);
-	arcan_sem_post( tgt->vsync );
+	publish_deadline(tgt);
+	platform_fsrv_release_video(tgt);
 		if (tgt->desc.hints & SHMIF_RHINT_VSIGNAL_EV){
 			platform_fsrv_pushevent(tgt, &(struct arcan_event){
 				.category = EVENT_TARGET,
@@ -585,9 +702,9 @@ enum arcan_ffunc_rv arcan_frameserver_vdirect FFUNC_HEAD
 			goto no_out;
 		}
 
-/* for tighter latency management, here is where the estimated next
- * synch deadline for any output it is used on could/should be set,
- * though it feeds back into the need of the conductor- refactor */
+/* the deadline feedback itself is set on release, here we just account
+ * for how well the client managed to hit the last one */
+		delivery_timing(tgt);
 		dst_store->vinf.text.vpts = shmpage->vpts;
 
 /* for some connections, we want additional statistics */
@@ -598,9 +715,8 @@ enum arcan_ffunc_rv arcan_frameserver_vdirect FFUNC_HEAD
 /* interactive frameserver blocks on vsemaphore only,
  * so set monitor flags and wake up */
 		if (g_buffers_locked != 2){
-			atomic_store_explicit(&shmpage->vready, 0, memory_order_release);
-
-			arcan_sem_post( tgt->vsync );
+			publish_deadline(tgt);
+			platform_fsrv_release_video(tgt);
 			if (tgt->desc.hints & SHMIF_RHINT_VSIGNAL_EV){
 				platform_fsrv_pushevent(tgt, &(struct arcan_event){
 					.category = EVENT_TARGET,
@@ -769,83 +885,26 @@ no_out:
 
 /* assumptions:
  * buf_sz doesn't contain partial samples (% (bytes per sample * channels))
- * dst->amixer inaud is allocated and allocation count matches n_aids */
+ * dst->amixer is setup with the sources that are hooked up */
 static void feed_amixer(arcan_frameserver* dst, arcan_aobj_id srcid,
-	int16_t* buf, int nsamples)
+	int16_t* buf, size_t nsamples, unsigned channels, unsigned frequency)
 {
-/* formats; nsamples (samples in, 2 samples / frame)
- * cur->inbuf; samples converted to float with gain, 2 samples / frame)
- * dst->outbuf; SINT16, in bytes, ofset in bytes */
-	size_t minv = INT_MAX;
-
-/* 1. Convert to float and buffer. Find the lowest common number of samples
- * buffered. Truncate if needed. Assume source feeds L/R */
-	for (int i = 0; i < dst->amixer.n_aids; i++){
-		struct frameserver_audsrc* cur = dst->amixer.inaud + i;
-
-		if (cur->src_aid == srcid){
-			int ulim = sizeof(cur->inbuf) / sizeof(float);
-			int count = 0;
-
-			while (nsamples-- && cur->inofs < ulim){
-				float val = *buf++;
-				cur->inbuf[cur->inofs++] =
-					(count++ % 2 ? cur->l_gain : cur->r_gain) * (val / 32767.0f);
-			}
-		}
+	amixer_feed(dst->amixer, srcid, buf, nsamples, channels, frequency);
 
-		if (cur->inofs < minv)
-			minv = cur->inofs;
-	}
-
-/*
- * 2. If number of samples exceeds some threshold, mix (minv)
- * samples together and store in dst->outb Formulae used:
- * A = float(sampleA) * gainA.
- * B = float(sampleB) * gainB. Z = A + B - A * B
- */
-		if (minv != INT_MAX && minv > 512 && dst->sz_audb - dst->ofs_audb > 0){
-/* clamp */
-			if (dst->ofs_audb + minv * sizeof(uint16_t) > dst->sz_audb)
-				minv = (dst->sz_audb - dst->ofs_audb) / sizeof(uint16_t);
-
-			for (int sc = 0; sc < minv; sc++){
-				float work_sample = 0;
-
-			for (int i = 0; i < dst->amixer.n_aids; i++){
-				work_sample += dst->amixer.inaud[i].inbuf[sc] - (work_sample *
-					dst->amixer.inaud[i].inbuf[sc]);
-			}
-/* clip output */
-			int16_t sample_conv = work_sample >= 1.0 ? 32767.0 :
-				(work_sample < -1.0 ? -32768 : work_sample * 32767);
-			memcpy(&dst->audb[dst->ofs_audb], &sample_conv, sizeof(int16_t));
-			dst->ofs_audb += sizeof(int16_t);
-		}
-/* 2b. Reset intermediate buffers, slide if needed. */
-		for (int j = 0; j < dst->amixer.n_aids; j++){
-			struct frameserver_audsrc* cur = dst->amixer.inaud + j;
-			if (cur->inofs > minv){
-				memmove(cur->inbuf, &cur->inbuf[minv], (cur->inofs - minv) *
-					sizeof(float));
-				cur->inofs -= minv;
-			}
-			else
-				cur->inofs = 0;
-		}
-	}
+/* mix what all sources have in common and push as much as fits */
+	if (dst->ofs_audb >= dst->sz_audb)
+		return;
 
+	size_t nmix = amixer_mix(dst->amixer, (int16_t*)(dst->audb + dst->ofs_audb),
+		(dst->sz_audb - dst->ofs_audb) / sizeof(int16_t));
+	dst->ofs_audb += nmix * sizeof(int16_t);
 }
 
 void arcan_frameserver_update_mixweight(arcan_frameserver* dst,
 	arcan_aobj_id src, float left, float right)
 {
-	for (int i = 0; i < dst->amixer.n_aids; i++){
-		if (src == 0 || dst->amixer.inaud[i].src_aid == src){
-			dst->amixer.inaud[i].l_gain = left;
-			dst->amixer.inaud[i].r_gain = right;
-		}
-	}
+	if (dst->amixer)
+		amixer_gain(dst->amixer, src, left, right);
 }
 
 void arcan_frameserver_avfeed_mixer(arcan_frameserver* dst, int n_sources,
@@ -853,21 +912,13 @@ void arcan_frameserver_avfeed_mixer(arcan_frameserver* dst, int n_sources,
 {
 	assert(sources != NULL && dst != NULL && n_sources > 0);
 
-	if (dst->amixer.n_aids)
-		arcan_mem_free(dst->amixer.inaud);
-
-	dst->amixer.inaud = arcan_alloc_mem(
-		n_sources * sizeof(struct frameserver_audsrc),
-		ARCAN_MEM_ATAG, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+	if (!dst->amixer)
+		dst->amixer = arcan_alloc_mem(sizeof(struct amixer),
+			ARCAN_MEM_ATAG, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
 
-	for (int i = 0; i < n_sources; i++){
-		dst->amixer.inaud[i].l_gain  = 1.0;
-		dst->amixer.inaud[i].r_gain  = 1.0;
-		dst->amixer.inaud[i].inofs   = 0;
-		dst->amixer.inaud[i].src_aid = *sources++;
-	}
-
-	dst->amixer.n_aids = n_sources;
+	if (!amixer_setup(dst->amixer, ARCAN_SHMIF_SAMPLERATE, n_sources, sources))
+		arcan_warning("arcan_frameserver_avfeed_mixer(), couldn't allocate "
+			"buffers for %d sources\n", n_sources);
 }
 
 void arcan_frameserver_avfeedmon(arcan_aobj_id src, uint8_t* buf,
@@ -876,29 +927,26 @@ void arcan_frameserver_avfeedmon(arcan_aobj_id src, uint8_t* buf,
 	arcan_frameserver* dst = tag;
 	assert((intptr_t)(buf) % 4 == 0);
 
-/*
- * FIXME: This is a victim of a recent shmif refactor where we started to
- * allow negotating different samplerates. This should be complemented with
- * the speex- resampler that's in the codebase already
- */
-	if (frequency != ARCAN_SHMIF_SAMPLERATE){
-		static bool warn;
-		if (!warn){
-			arcan_warning("arcan_frameserver_avfeedmon(), monitoring an audio feed\n"
-				"with a non-native samplerate, this is >currently< supported for\n"
-				"playback but not for recording (TOFIX).\n");
-			warn = true;
-		}
-	}
-
 /*
  * with no mixing setup (lowest latency path), we just feed the sync buffer
  * shared with the frameserver. otherwise we forward to the amixer that is
  * responsible for pushing as much as has been generated by all the defined
- * sources
+ * sources, resampling those that don't match the shmif rate
  */
-	if (dst->amixer.n_aids > 0){
-		feed_amixer(dst, src, (int16_t*) buf, buf_sz >> 1);
+	if (dst->amixer && dst->amixer->n_sources > 0){
+		feed_amixer(dst, src, (int16_t*) buf, buf_sz >> 1, channels, frequency);
+	}
+	else if (frequency && frequency != ARCAN_SHMIF_SAMPLERATE){
+		if (!dst->amixer)
+			dst->amixer = arcan_alloc_mem(sizeof(struct amixer),
+				ARCAN_MEM_ATAG, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+
+		if (dst->ofs_audb < dst->sz_audb)
+			dst->ofs_audb += sizeof(int16_t) * amixer_resample_s16(
+				&dst->amixer->direct, ARCAN_SHMIF_SAMPLERATE,
+				(int16_t*) buf, buf_sz >> 1, channels, frequency,
+				(int16_t*)(dst->audb + dst->ofs_audb),
+				(dst->sz_audb - dst->ofs_audb) / sizeof(int16_t));
 	}
 	else if (dst->ofs_audb + buf_sz < dst->sz_audb){
 			memcpy(dst->audb + dst->ofs_audb, buf, buf_sz);
@@ -1080,9 +1128,8 @@ arcan_errc arcan_frameserver_audioframe_direct(arcan_aobj* aobj,
 	}
 
 	if (0 == amask || ((1<<ind)&amask) == 0){
-		atomic_store_explicit(&src->shm.ptr->aready, 0, memory_order_release);
+		platform_fsrv_release_audio(src);
 		platform_fsrv_leave(src);
-		arcan_sem_post(src->async);
 		return ARCAN_ERRC_NOTREADY;
 	}
 
@@ -1106,9 +1153,8 @@ arcan_errc arcan_frameserver_audioframe_direct(arcan_aobj* aobj,
 
 /* check for cont and > 1, wait for signal.. else release */
 	if (!cont){
-		atomic_store_explicit(&src->shm.ptr->aready, 0, memory_order_release);
+		platform_fsrv_release_audio(src);
 		platform_fsrv_leave(src);
-		arcan_sem_post(src->async);
 	}
 
 	return ARCAN_OK;
@@ -69,14 +69,12 @@ struct arcan_frameserver_meta {
 	unsigned long long framecount;
 	unsigned long long dropcount;
 	unsigned long long lastpts;
-};
 
-struct frameserver_audsrc {
-	float inbuf[4096];
-	off_t inofs;
-	arcan_aobj_id src_aid;
-	float l_gain;
-	float r_gain;
+/* deadline that was published on the last release, and the moving average of
+ * how much (ms) deliveries deviate from it and from that average (jitter) */
+	unsigned long long deadline;
+	float delivery_dev;
+	float jitter;
 };
 
 struct arcan_frameserver {
@@ -150,12 +148,9 @@ struct arcan_frameserver {
 		arcan_vobj_id vid;
 	} parent;
 
-/* for recording output where we need to mix multiple audio sources */
-	struct {
-		unsigned n_aids;
-		size_t max_bufsz;
-		struct frameserver_audsrc* inaud;
-	} amixer;
+/* for recording output where we need to mix multiple audio sources, or
+ * resample the one being monitored, see arcan_amixer.h */
+	struct amixer* amixer;
 
 /* playstate control and statistics */
 	enum arcan_playstate playstate;
@@ -418,6 +413,15 @@ arcan_errc arcan_frameserver_free(arcan_frameserver*);
  */
 void arcan_frameserver_lock_buffers(int state);
 
+/*
+ * Set the timing information that will be published to clients whenever their
+ * buffers are released. [next] is the arcan_timemillis() timestamp of the next
+ * expected composition, [step] the expected time between compositions and
+ * [cost] how many milliseconds before [next] a buffer needs to be delivered.
+ */
+void arcan_frameserver_deadline(
+	unsigned long long next, unsigned step, unsigned cost);
+
 /*
  * IF the frameserver is in pending-release state, this will send signals
  * unlock semaphores and clear the flag. This is used in combination with
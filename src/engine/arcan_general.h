@@ -113,6 +113,18 @@ typedef struct {
 
 	unsigned framecost[64], costcount;
 	char costofs;
+
+/* pipeline counters, accumulated in [acc] while rendertargets are being
+ * processed and latched into [pipeline] on arcan_bench_register_frame */
+	struct arcan_bench_pipeline {
+		size_t objects;
+		size_t draw_calls;
+		size_t upload_bytes;
+		size_t redraw_px;
+		size_t culled;
+		size_t drawn_3d;
+		size_t culled_3d;
+	} acc, pipeline;
 } arcan_benchdata;
 
 /*
@@ -22,7 +22,21 @@
 	ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE))
 
 #define STBI_FREE(ptr) (arcan_mem_free(ptr))
-#define STBI_REALLOC(p,sz) realloc(p,sz)
+#define STBI_REALLOC_SIZED(p,oldsz,newsz) stbi_grow(p,oldsz,newsz)
+
+/* pooled blocks can't go through realloc */
+static void* stbi_grow(void* p, size_t oldsz, size_t newsz)
+{
+	void* res = arcan_alloc_mem(newsz,
+		ARCAN_MEM_VBUFFER, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE);
+
+	if (res && p){
+		memcpy(res, p, oldsz < newsz ? oldsz : newsz);
+		arcan_mem_free(p);
+	}
+
+	return res;
+}
 
 #define STBI_ONLY_PNG
 #define STBI_ONLY_JPEG
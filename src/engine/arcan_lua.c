@@ -1363,7 +1363,7 @@ static void tblstr(lua_State* ctx, const char* k,
 	lua_rawset(ctx, top);
 }
 
-static void tblnum(lua_State* ctx, char* k, double v, int top){
+static void tblnum(lua_State* ctx, const char* k, double v, int top){
 	lua_pushstring(ctx, k);
 	lua_pushnumber(ctx, v);
 	lua_rawset(ctx, top);
@@ -6135,7 +6135,12 @@ static int getkey(lua_State* ctx)
 			free(val);
 		}
 		else{
-			arcan_db_getvalue(DBHANDLE, DVT_TARGET, tid, key);
+			char* val = arcan_db_getvalue(DBHANDLE, DVT_TARGET, tid, key);
+			if (val)
+				lua_pushstring(ctx, val);
+			else
+				lua_pushnil(ctx);
+			free(val);
 		}
 	}
 	else {
@@ -6722,6 +6727,8 @@ static int imagecolor(lua_State* ctx)
 			agp_rendertarget_clearcolor(rtgt->art,
 				(float)cred / 255.0f, (float)cgrn / 255.0f,
 				(float)cblu / 255.0f, (float)alpha / 255.0f);
+			arcan_vint_damageall(rtgt);
+			FLAG_DIRTY(NULL);
 			lua_pushboolean(ctx, true);
 			LUA_ETRACE("image_color", NULL, 1);
 		}
@@ -8816,6 +8823,7 @@ static int procimage_histo(lua_State* ctx)
 	int packing = luaL_optnumber(ctx, 3, HIST_MERGE);
 	size_t dst_row = luaL_optnumber(ctx, 4, 0);
 
+	arcan_vint_privatestore(vobj);
 	av_pixel* base = (av_pixel*) vobj->vstore->vinf.text.raw;
 	if (dst_row > vobj->vstore->h){
 		arcan_fatal("calcImage:histogram_impose, "
@@ -9753,7 +9761,7 @@ static int recordset(lua_State* ctx)
 					ARCAN_MEM_STRINGBUF, 0, ARCAN_MEMALIGN_NATURAL);
 
 				sprintf(ol, "%s%s", argl, ":noaudio=true");
-				free(argl);
+				arcan_mem_free(argl);
 				argl = ol;
 				break;
 			}
@@ -9766,7 +9774,7 @@ static int recordset(lua_State* ctx)
 		char* ol = arcan_alloc_mem(strlen(argl) + sizeof(":noaudio=true"),
 			ARCAN_MEM_STRINGBUF, 0, ARCAN_MEMALIGN_NATURAL);
 		sprintf(ol, "%s%s", argl, ":noaudio=true");
-		free(argl);
+		arcan_mem_free(argl);
 		argl = ol;
 	}
 
@@ -9775,7 +9783,7 @@ static int recordset(lua_State* ctx)
 		spawn_recfsrv(ctx, did, dfsrv, naids, aidlocks, argl, resf);
 
 cleanup:
-	free(argl);
+	arcan_mem_free(argl);
 	LUA_ETRACE("define_recordtarget", NULL, rc);
 }
 
@@ -9868,7 +9876,59 @@ static int getbenchvals(lua_State* ctx)
 		i = (i + 1) % bench_sz;
 	}
 
-	LUA_ETRACE("benchmark_data", NULL, 6);
+	lua_newtable(ctx);
+	top = lua_gettop(ctx);
+	tblnum(ctx, "objects", benchdata.pipeline.objects, top);
+	tblnum(ctx, "draw_calls", benchdata.pipeline.draw_calls, top);
+	tblnum(ctx, "upload_bytes", benchdata.pipeline.upload_bytes, top);
+	tblnum(ctx, "redraw_px", benchdata.pipeline.redraw_px, top);
+	tblnum(ctx, "culled", benchdata.pipeline.culled, top);
+	tblnum(ctx, "drawn_3d", benchdata.pipeline.drawn_3d, top);
+	tblnum(ctx, "culled_3d", benchdata.pipeline.culled_3d, top);
+
+	TTF_CacheStats glyphs;
+	TTF_GlyphCacheStats(&glyphs);
+	tblnum(ctx, "glyph_hits", glyphs.hits, top);
+	tblnum(ctx, "glyph_misses", glyphs.misses, top);
+	tblnum(ctx, "glyph_evictions", glyphs.evictions, top);
+	tblnum(ctx, "glyph_bytes", glyphs.bytes, top);
+
+	struct arcan_asynch_stats asynch;
+	arcan_vint_asynchstats(&asynch);
+	tblnum(ctx, "asynch_queued", asynch.queued, top);
+	tblnum(ctx, "asynch_peak", asynch.peak, top);
+	tblnum(ctx, "asynch_completed", asynch.completed, top);
+	tblnum(ctx, "asynch_cancelled", asynch.cancelled, top);
+	tblnum(ctx, "asynch_decode_ms", asynch.decode_ms, top);
+	tblnum(ctx, "asynch_decode_max_ms", asynch.decode_max_ms, top);
+
+	struct arcan_imgcache_stats images;
+	arcan_vint_imgcachestats(&images);
+	tblnum(ctx, "image_hits", images.hits, top);
+	tblnum(ctx, "image_misses", images.misses, top);
+	tblnum(ctx, "image_evictions", images.evictions, top);
+	tblnum(ctx, "image_bytes", images.bytes, top);
+
+	static const struct {
+		enum arcan_memtypes type;
+		const char* alloc, (* in_use), (* pages);
+	} pools[] = {
+		{ARCAN_MEM_VBUFFER, "mem_vbuffer_alloc", "mem_vbuffer_in_use", "mem_vbuffer_pages"},
+		{ARCAN_MEM_ABUFFER, "mem_abuffer_alloc", "mem_abuffer_in_use", "mem_abuffer_pages"},
+		{ARCAN_MEM_VSTRUCT, "mem_vstruct_alloc", "mem_vstruct_in_use", "mem_vstruct_pages"},
+		{ARCAN_MEM_STRINGBUF, "mem_string_alloc", "mem_string_in_use", "mem_string_pages"}
+	};
+
+	for (size_t i = 0; i < COUNT_OF(pools); i++){
+		struct arcan_mem_stats mem;
+		if (!arcan_mem_stats(pools[i].type, &mem))
+			continue;
+		tblnum(ctx, pools[i].alloc, mem.alloc_cnt, top);
+		tblnum(ctx, pools[i].in_use, mem.in_use, top);
+		tblnum(ctx, pools[i].pages, mem.n_pages, top);
+	}
+
+	LUA_ETRACE("benchmark_data", NULL, 7);
 }
 
 static int timestamp(lua_State* ctx)
@@ -10845,7 +10905,7 @@ static int net_open(lua_State* ctx)
 
 	lua_launch_fsrv(ctx, &args, ref);
 
-	free(instr);
+	arcan_mem_free(instr);
 	free(workstr);
 
 	LUA_ETRACE("net_open", NULL, 1);
@@ -10936,8 +10996,7 @@ static int net_pushcl(lua_State* ctx)
 		memcpy(srv->vbufs[0], dvobj->vstore->vinf.text.raw,
 			dvobj->vstore->vinf.text.s_raw);
 
-		srv->shm.ptr->vready = true;
-		arcan_sem_post(srv->vsync);
+		platform_fsrv_push_video(srv);
 
 		outev.tgt.kind = TARGET_COMMAND_STEPFRAME;
 		platform_fsrv_pushevent(srv, &outev);
@@ -12418,12 +12477,15 @@ void arcan_lua_stategrab(lua_State* ctx, char* dstfun, int src)
 		}
 
 		if (statebuf_ofs == statebuf_sz - 1){
-			statebuf_sz <<= 1;
-			char* newp = realloc(statebuf, statebuf_sz);
-			if (newp)
+			char* newp = arcan_alloc_mem(statebuf_sz << 1, ARCAN_MEM_STRINGBUF,
+				ARCAN_MEM_TEMPORARY | ARCAN_MEM_NONFATAL | ARCAN_MEM_BZERO,
+				ARCAN_MEMALIGN_NATURAL);
+			if (newp){
+				memcpy(newp, statebuf, statebuf_sz);
+				arcan_mem_free(statebuf);
 				statebuf = newp;
-			else
-				statebuf_sz >>= 1;
+				statebuf_sz <<= 1;
+			}
 		}
 
 	}
@@ -864,45 +864,28 @@ bool frustum_point(const float frustum[6][4],
 	return true;
 }
 
+/*
+ * Only two corners need to be checked per plane: the one furthest along the
+ * plane normal decides if the box is entirely outside, and the one closest
+ * if it straddles the plane.
+ */
 enum cstate frustum_aabb(const float frustum[6][4],
 	const float x1, const float y1, const float z1,
 	const float x2, const float y2, const float z2)
 {
 	enum cstate res = inside;
 	for (int i = 0; i < 6; i++){
-		if (frustum[i][0] * x1 + frustum[i][1] * y1 +
-			frustum[i][2] * z1 + frustum[i][3] > 0.0f)
-			continue;
-
-		res = intersect;
-
-		if (frustum[i][0] * x2 + frustum[i][1] * y1 +
-			frustum[i][2] * z1 + frustum[i][3] > 0.0f)
-			continue;
-
-		if (frustum[i][0] * x1 + frustum[i][1] * y2 +
-			frustum[i][2] * z1 + frustum[i][3] > 0.0f)
-			continue;
+		const float* pl = frustum[i];
 
-		if (frustum[i][0] * x2 + frustum[i][1] * y2 +
-			frustum[i][2] * z1 + frustum[i][3] > 0.0f)
-			continue;
-
-		if (frustum[i][0] * x1 + frustum[i][1] * y1 +
-			frustum[i][2] * z2 + frustum[i][3] > 0.0f)
-			continue;
-
-		if (frustum[i][0] * x2 + frustum[i][1] * y1 +
-			frustum[i][2] * z2 + frustum[i][3] > 0.0f)
-			continue;
-
-		if (frustum[i][0] * x1 + frustum[i][1] * y2 +
-			frustum[i][2] * z2 + frustum[i][3] > 0.0f)
-			continue;
+		if (pl[0] * (pl[0] > 0.0f ? x2 : x1) +
+			pl[1] * (pl[1] > 0.0f ? y2 : y1) +
+			pl[2] * (pl[2] > 0.0f ? z2 : z1) + pl[3] < 0.0f)
+			return outside;
 
-		if (frustum[i][0] * x2 + frustum[i][1] * y2 +
-			frustum[i][2] * z2 + frustum[i][3] > 0.0f)
-			continue;
+		if (pl[0] * (pl[0] > 0.0f ? x1 : x2) +
+			pl[1] * (pl[1] > 0.0f ? y1 : y2) +
+			pl[2] * (pl[2] > 0.0f ? z1 : z2) + pl[3] < 0.0f)
+			res = intersect;
 	}
 
 	return res;
@@ -930,9 +913,10 @@ enum cstate frustum_sphere(const float frustum[6][4],
 
 void update_frustum(float* prjm, float* mvm, float frustum[6][4])
 {
-	float mmr[16];
-/* multiply modelview with projection */
-	multiply_matrix(mmr, mvm, prjm);
+	float _Alignas(16) mmr[16];
+/* clip space = projection * modelview, planes come out in the space that
+ * modelview maps from */
+	multiply_matrix(mmr, prjm, mvm);
 
 /* extract and normalize planes */
 	frustum[0][0] = mmr[3]  + mmr[0]; // left
@@ -204,6 +204,23 @@ void arcan_mem_unlock(void*);
  */
 void arcan_mem_tick();
 
+/*
+ * implemented in <platform>/mem.c
+ * retrieve counters for the pool that serves [type], covering allocations
+ * that were served by the pool rather than passed on to the system
+ * allocator: alloc_cnt/dealloc_cnt are running totals, in_use is the
+ * number of bytes currently handed out and n_pages the pages the pool
+ * holds (including free ones kept for reuse). Returns false for an
+ * invalid type.
+ */
+struct arcan_mem_stats {
+	size_t alloc_cnt;
+	size_t dealloc_cnt;
+	size_t in_use;
+	size_t n_pages;
+};
+bool arcan_mem_stats(enum arcan_memtypes type, struct arcan_mem_stats* out);
+
 /*
  * implemented in <platform>/mem.c
  * aggregates a mem_alloc and a mem_copy from a source buffer.
@@ -50,6 +50,10 @@ struct font_entry {
 	size_t size;
 	float vdpi, hdpi;
 	uint8_t usecount;
+
+/* unique for every chain that gets loaded into a slot, used to refer to
+ * the font from the glyph atlas without pinning the slot */
+	uint64_t id;
 };
 
 struct text_format {
@@ -103,6 +107,7 @@ static struct text_format last_style = {
 };
 
 static unsigned int font_cache_size = ARCAN_FONT_CACHE_LIMIT;
+static uint64_t font_seq;
 static struct font_entry font_cache[ARCAN_FONT_CACHE_LIMIT] = {
 };
 
@@ -146,9 +151,28 @@ struct rcell {
 		} format;
 	} data;
 
+/* set if the text was laid out as [count] glyph references into the run
+ * that is being built (see glyph_alloc) rather than rasterized into surf,
+ * surf.w and surf.h still carry the dimensions */
+	struct {
+		bool used;
+		size_t start, count;
+	} glyphs;
+
 	struct rcell* next;
 };
 
+enum chain_mode {
+	CHAIN_RENDER = 0,
+	CHAIN_SIZE,
+	CHAIN_GLYPHS
+};
+
+static inline bool data_node(struct rcell* cnode)
+{
+	return cnode->data.surf.buf || cnode->glyphs.used;
+}
+
 void arcan_video_fontdefaults(file_handle* fd, int* pt_sz, int* hint)
 {
 	if (fd)
@@ -307,6 +331,7 @@ static struct font_entry* grab_font(const char* fname, size_t size)
 	font_cache[i].vdpi = default_vdpi;
 	font_cache[i].hdpi = default_hdpi;
 	font_cache[i].chain = newch;
+	font_cache[i].id = ++font_seq;
 	font = &font_cache[i];
 
 done:
@@ -337,6 +362,7 @@ bool arcan_video_defaultfont(const char* ident,
 		font_cache[0].chain.data[0] = font;
 		font_cache[0].chain.fd[0] = fd;
 		font_cache[0].chain.count = 1;
+		font_cache[0].id = ++font_seq;
 		set_style(&last_style, &font_cache[0]);
 	}
 	else{
@@ -352,6 +378,7 @@ bool arcan_video_defaultfont(const char* ident,
 		font_cache[0].chain.count = dst_i;
 		font_cache[0].chain.fd[dst_i-1] = fd;
 		font_cache[0].chain.data[dst_i-1] = font;
+		font_cache[0].id = ++font_seq;
 	}
 
 	return true;
@@ -368,6 +395,7 @@ void arcan_video_reset_fontcache()
 	else{
 		for (int i = 0; i < ARCAN_FONT_CACHE_LIMIT; i++)
 			zap_slot(i);
+		arcan_renderfun_glyphreset();
 	}
 }
 
@@ -877,6 +905,442 @@ retry:
 #define CONST_MAX_SURFACEH 4096
 #endif
 
+/*
+ * Glyph atlas, used for text that is laid out as glyph quads rather than
+ * rasterized (arcan_renderfun_glyphfmtstr). Each glyph is rendered once per
+ * font (which implies size and density), hinting and color into a shared,
+ * shelf packed texture. Changing the string of such a text object only
+ * means rewriting its quads, not re-rendering and re-uploading a buffer.
+ *
+ * The atlas has a fixed width and grows in height until it hits the limit,
+ * after which it is cleared. Both cases bump the generation, and text that
+ * was laid out against an older generation gets its quads rebuilt the next
+ * time it is drawn (arcan_renderfun_glyphrefresh).
+ */
+#ifndef GLYPH_ATLAS_WIDTH
+#define GLYPH_ATLAS_WIDTH 1024
+#endif
+
+#ifndef GLYPH_ATLAS_BASE
+#define GLYPH_ATLAS_BASE 256
+#endif
+
+#ifndef GLYPH_ATLAS_LIMIT
+#define GLYPH_ATLAS_LIMIT 4096
+#endif
+
+#define GLYPH_ATLAS_BUCKETS 1024
+
+struct glyph_key {
+	uint64_t font;
+	uint32_t cp;
+	uint8_t col[4];
+	int hint;
+};
+
+struct glyph_ref {
+	struct glyph_key key;
+	int x, y;
+};
+
+struct atlas_entry {
+	struct glyph_key key;
+	uint16_t x, y, w, h;
+	int16_t ox, oy;
+	struct atlas_entry* next;
+};
+
+static struct {
+	int enabled;
+	struct agp_vstore* store;
+	av_pixel* raw;
+	size_t h;
+
+/* generation changes on anything that moves texture coordinates, resets only
+ * when the entries themselves are gone */
+	uint64_t generation;
+	uint64_t resets;
+
+	size_t pack_x, pack_y, shelf_h;
+	struct atlas_entry* buckets[GLYPH_ATLAS_BUCKETS];
+
+	bool dirty;
+	size_t dx1, dy1, dx2, dy2;
+
+/* scratch for rasterizing one glyph before it is packed */
+	av_pixel* cell;
+	size_t cell_sz;
+} atlas = {
+	.enabled = -1,
+	.generation = 1
+};
+
+/* run currently being built by glyph_alloc */
+static struct text_glyphs* glyph_dst;
+
+static bool atlas_enabled()
+{
+	if (-1 == atlas.enabled){
+		const char* env = getenv("ARCAN_TEXT_ATLAS");
+		atlas.enabled = env && strcmp(env, "0") != 0;
+	}
+	return atlas.enabled;
+}
+
+static size_t glyph_hash(struct glyph_key* key)
+{
+	uint64_t h = key->font * 0x9e3779b97f4a7c15ull;
+	h ^= key->cp + 0x9e3779b9 + (h << 6) + (h >> 2);
+	h ^= (uint64_t)(key->col[0] | key->col[1] << 8 |
+		key->col[2] << 16 | (uint32_t)key->col[3] << 24) + (h << 6) + (h >> 2);
+	h ^= (uint64_t) key->hint + (h << 6) + (h >> 2);
+	return h % GLYPH_ATLAS_BUCKETS;
+}
+
+static bool glyph_keyeq(struct glyph_key* a, struct glyph_key* b)
+{
+	return a->font == b->font && a->cp == b->cp &&
+		memcmp(a->col, b->col, 4) == 0 && a->hint == b->hint;
+}
+
+static void atlas_dirty(size_t x1, size_t y1, size_t x2, size_t y2)
+{
+	if (!atlas.dirty){
+		atlas.dx1 = x1;
+		atlas.dy1 = y1;
+		atlas.dx2 = x2;
+		atlas.dy2 = y2;
+		atlas.dirty = true;
+		return;
+	}
+
+	atlas.dx1 = x1 < atlas.dx1 ? x1 : atlas.dx1;
+	atlas.dy1 = y1 < atlas.dy1 ? y1 : atlas.dy1;
+	atlas.dx2 = x2 > atlas.dx2 ? x2 : atlas.dx2;
+	atlas.dy2 = y2 > atlas.dy2 ? y2 : atlas.dy2;
+}
+
+static void atlas_sync()
+{
+	if (!atlas.dirty || !atlas.store)
+		return;
+
+	agp_stream_prepare(atlas.store, (struct stream_meta){
+		.buf = atlas.raw,
+		.dirty = true,
+		.x1 = atlas.dx1,
+		.y1 = atlas.dy1,
+		.w = atlas.dx2 - atlas.dx1,
+		.h = atlas.dy2 - atlas.dy1
+	}, STREAM_RAW_DIRECT_SYNCHRONOUS);
+
+	atlas.dirty = false;
+}
+
+static void atlas_clear()
+{
+	for (size_t i = 0; i < GLYPH_ATLAS_BUCKETS; i++){
+		struct atlas_entry* cur = atlas.buckets[i];
+		while (cur){
+			struct atlas_entry* next = cur->next;
+			arcan_mem_free(cur);
+			cur = next;
+		}
+		atlas.buckets[i] = NULL;
+	}
+
+	atlas.pack_x = atlas.pack_y = atlas.shelf_h = 0;
+	atlas.resets++;
+	atlas.generation++;
+}
+
+/*
+ * (Re-)create the backing store at [h] rows, keeping the contents that are
+ * already packed. The raw copy lives here and not in the vstore as the
+ * conservative memory mode would otherwise drop it after upload.
+ */
+static bool atlas_resize(size_t h)
+{
+	size_t sz = GLYPH_ATLAS_WIDTH * h * sizeof(av_pixel);
+	av_pixel* raw = arcan_alloc_mem(sz,
+		ARCAN_MEM_VBUFFER, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE);
+	if (!raw)
+		return false;
+
+/* VBUFFER BZERO sets full alpha, we want an empty one */
+	memset(raw, '\0', sz);
+
+	if (!atlas.store){
+		atlas.store = arcan_alloc_mem(sizeof(struct agp_vstore),
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_NONFATAL | ARCAN_MEM_BZERO,
+			ARCAN_MEMALIGN_NATURAL
+		);
+		if (!atlas.store){
+			arcan_mem_free(raw);
+			return false;
+		}
+		atlas.store->filtermode = ARCAN_VFILTER_LINEAR;
+	}
+
+	if (atlas.raw){
+		memcpy(raw, atlas.raw,
+			GLYPH_ATLAS_WIDTH * atlas.h * sizeof(av_pixel));
+		arcan_mem_free(atlas.raw);
+	}
+
+	atlas.raw = raw;
+	atlas.h = h;
+	atlas.store->vinf.text.s_raw = 0;
+	agp_empty_vstore(atlas.store, GLYPH_ATLAS_WIDTH, h);
+
+	atlas.dirty = false;
+	atlas_dirty(0, 0, GLYPH_ATLAS_WIDTH, h);
+	atlas_sync();
+	atlas.generation++;
+
+	return true;
+}
+
+static struct font_entry* font_byid(uint64_t id)
+{
+	for (size_t i = 0; i < font_cache_size; i++)
+		if (font_cache[i].chain.data[0] && font_cache[i].id == id)
+			return &font_cache[i];
+
+	return NULL;
+}
+
+/*
+ * Find room for a [w]x[h] region, growing or clearing the atlas as needed.
+ * Returns false if it can't fit even in an empty atlas.
+ */
+static bool atlas_pack(size_t w, size_t h, size_t* x, size_t* y)
+{
+	if (w + 1 > GLYPH_ATLAS_WIDTH || h + 1 > GLYPH_ATLAS_LIMIT)
+		return false;
+
+	if (atlas.pack_x + w + 1 > GLYPH_ATLAS_WIDTH){
+		atlas.pack_x = 0;
+		atlas.pack_y += atlas.shelf_h + 1;
+		atlas.shelf_h = 0;
+	}
+
+	while (atlas.pack_y + h + 1 > atlas.h){
+		if (atlas.h < GLYPH_ATLAS_LIMIT){
+			if (!atlas_resize(atlas.h * 2))
+				return false;
+			continue;
+		}
+
+/* out of space, start over, everyone will have to refresh */
+		atlas_clear();
+		memset(atlas.raw, '\0', GLYPH_ATLAS_WIDTH * atlas.h * sizeof(av_pixel));
+		atlas_dirty(0, 0, GLYPH_ATLAS_WIDTH, atlas.h);
+	}
+
+	*x = atlas.pack_x;
+	*y = atlas.pack_y;
+	atlas.pack_x += w + 1;
+	if (h > atlas.shelf_h)
+		atlas.shelf_h = h;
+
+	return true;
+}
+
+static struct atlas_entry* atlas_insert(struct glyph_key* key, size_t ind)
+{
+	struct font_entry* font = font_byid(key->font);
+	if (!font)
+		return NULL;
+
+/* render into a cell that is large enough that nothing but the very tall
+ * fallback glyphs would be clipped, with the pen well inside */
+	int fh = TTF_FontHeight(font->chain.data[0]);
+	size_t pad = fh > 0 ? fh : 1;
+	size_t cw = pad * 4;
+	size_t ch = pad * 2;
+	size_t sz = cw * ch * sizeof(av_pixel);
+
+	if (sz > atlas.cell_sz){
+		arcan_mem_free(atlas.cell);
+		atlas.cell = arcan_alloc_mem(sz,
+			ARCAN_MEM_VBUFFER, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE);
+		atlas.cell_sz = atlas.cell ? sz : 0;
+		if (!atlas.cell)
+			return NULL;
+	}
+	memset(atlas.cell, '\0', sz);
+
+	for (size_t i = 0; i < font->chain.count; i++)
+		TTF_SetFontHinting(font->chain.data[i], key->hint);
+
+	unsigned xstart = pad;
+	unsigned prev_index = 0;
+	int advance = 0;
+	TTF_RenderUNICODEglyph(atlas.cell, cw, ch, cw,
+		font->chain.data, font->chain.count, key->cp, &xstart,
+		key->col, key->col, false, false, 0, &advance, &prev_index
+	);
+
+/* only the covered part goes into the atlas */
+	size_t x1 = cw, y1 = ch, x2 = 0, y2 = 0;
+	for (size_t y = 0; y < ch; y++){
+		av_pixel* row = &atlas.cell[y * cw];
+		for (size_t x = 0; x < cw; x++){
+			if (!row[x])
+				continue;
+			x1 = x < x1 ? x : x1;
+			x2 = x >= x2 ? x + 1 : x2;
+			y1 = y < y1 ? y : y1;
+			y2 = y >= y2 ? y + 1 : y2;
+		}
+	}
+
+	struct atlas_entry* res = arcan_alloc_mem(sizeof(struct atlas_entry),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_NONFATAL | ARCAN_MEM_BZERO,
+		ARCAN_MEMALIGN_NATURAL
+	);
+	if (!res)
+		return NULL;
+	res->key = *key;
+
+/* whitespace and missing glyphs still get an entry, just not any space */
+	if (x2 > x1){
+		size_t w = x2 - x1, h = y2 - y1, dx, dy;
+		uint64_t resets = atlas.resets;
+
+		if (!atlas_pack(w, h, &dx, &dy)){
+			arcan_mem_free(res);
+			return NULL;
+		}
+
+/* the bucket might just have been emptied */
+		if (resets != atlas.resets)
+			ind = glyph_hash(key);
+
+		for (size_t y = 0; y < h; y++)
+			memcpy(&atlas.raw[(dy + y) * GLYPH_ATLAS_WIDTH + dx],
+				&atlas.cell[(y1 + y) * cw + x1], w * sizeof(av_pixel));
+
+		atlas_dirty(dx, dy, dx + w, dy + h);
+		res->x = dx;
+		res->y = dy;
+		res->w = w;
+		res->h = h;
+		res->ox = (int)x1 - (int)pad;
+		res->oy = y1;
+	}
+
+	res->next = atlas.buckets[ind];
+	atlas.buckets[ind] = res;
+	return res;
+}
+
+static struct atlas_entry* atlas_lookup(struct glyph_key* key)
+{
+	size_t ind = glyph_hash(key);
+	for (struct atlas_entry* cur = atlas.buckets[ind]; cur; cur = cur->next)
+		if (glyph_keyeq(&cur->key, key))
+			return cur;
+
+	return atlas_insert(key, ind);
+}
+
+static bool glyph_push(struct text_glyphs* dst, struct glyph_ref* ref)
+{
+	if (dst->n_refs == dst->limit){
+		size_t nlim = dst->limit ? dst->limit * 2 : 64;
+		struct glyph_ref* refs = arcan_alloc_mem(sizeof(struct glyph_ref) * nlim,
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL);
+		float* vtx = arcan_alloc_mem(sizeof(float) * 8 * nlim,
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_SIMD);
+
+		if (!refs || !vtx){
+			arcan_mem_free(refs);
+			arcan_mem_free(vtx);
+			return false;
+		}
+
+		if (dst->refs)
+			memcpy(refs, dst->refs, sizeof(struct glyph_ref) * dst->n_refs);
+
+/* vertices are always rebuilt from the references */
+		arcan_mem_free(dst->refs);
+		arcan_mem_free(dst->vtx);
+		dst->refs = refs;
+		dst->vtx = vtx;
+		dst->limit = nlim;
+		dst->n_quads = 0;
+	}
+
+	dst->refs[dst->n_refs++] = *ref;
+	return true;
+}
+
+struct glyph_emit {
+	struct glyph_ref ref;
+	bool ok;
+};
+
+static void glyph_emit(void* tag, uint32_t cp, int x)
+{
+	struct glyph_emit* emit = tag;
+	emit->ref.key.cp = cp;
+	emit->ref.x = x;
+	if (!glyph_push(glyph_dst, &emit->ref))
+		emit->ok = false;
+}
+
+/*
+ * Counterpart to render_alloc, the pen positions are relative to the node
+ * and get moved into place along with the rest of the chain.
+ */
+static bool glyph_alloc(struct rcell* cnode,
+	const char* const base, struct text_format* style)
+{
+	int w, h;
+
+	if (TTF_SizeUTF8chain(style->font->chain.data,
+		style->font->chain.count, base, &w, &h, style->style)){
+		arcan_warning("arcan_video_renderstring(), couldn't size node.\n");
+		return false;
+	}
+
+	if (w==0 || w > CONST_MAX_SURFACEW || h == 0 || h > CONST_MAX_SURFACEH){
+		return false;
+	}
+
+	struct glyph_emit emit = {
+		.ref = {
+			.key = {
+				.font = style->font->id,
+				.hint = default_hint
+			}
+		},
+		.ok = true
+	};
+	memcpy(emit.ref.key.col, style->col, 4);
+
+	size_t start = glyph_dst->n_refs;
+	if (!TTF_LayoutUTF8chain(style->font->chain.data,
+		style->font->chain.count, base, glyph_emit, &emit) || !emit.ok){
+		glyph_dst->n_refs = start;
+		return false;
+	}
+
+	cnode->glyphs.used = true;
+	cnode->glyphs.start = start;
+	cnode->glyphs.count = glyph_dst->n_refs - start;
+	cnode->data.surf.w = w;
+	cnode->data.surf.h = h;
+	cnode->ascent = style->ascent;
+	cnode->height = style->height;
+	cnode->descent = style->descent;
+	cnode->skipv = style->skip;
+
+	return true;
+}
+
 static bool render_alloc(struct rcell* cnode,
 	const char* const base, struct text_format* style)
 {
@@ -925,9 +1389,9 @@ static bool render_alloc(struct rcell* cnode,
 }
 
 static inline void currstyle_cnode(struct text_format* curr_style,
-	const char* const base, struct rcell* cnode, bool sizeonly)
+	const char* const base, struct rcell* cnode, enum chain_mode mode)
 {
-	if (sizeonly){
+	if (mode == CHAIN_SIZE){
 		if (curr_style->font){
 			int dw, dh;
 			TTF_SizeUTF8chain(curr_style->font->chain.data,
@@ -958,7 +1422,11 @@ static inline void currstyle_cnode(struct text_format* curr_style,
 		goto reset;
 	}
 
-	if (!render_alloc(cnode, base, curr_style))
+	if (mode == CHAIN_GLYPHS){
+		if (!glyph_alloc(cnode, base, curr_style))
+			goto reset;
+	}
+	else if (!render_alloc(cnode, base, curr_style))
 		goto reset;
 
 	return;
@@ -968,7 +1436,7 @@ reset:
 
 static struct rcell* trystep(struct rcell* cnode, bool force)
 {
-	if (force || cnode->data.surf.buf)
+	if (force || data_node(cnode))
 	cnode = cnode->next = arcan_alloc_mem(sizeof(struct rcell),
 		ARCAN_MEM_VSTRUCT, ARCAN_MEM_TEMPORARY | ARCAN_MEM_BZERO,
 		ARCAN_MEMALIGN_NATURAL
@@ -978,7 +1446,7 @@ static struct rcell* trystep(struct rcell* cnode, bool force)
 
 /* a */
 static int build_textchain(char* message, struct rcell* root,
-	bool sizeonly, bool nolast)
+	enum chain_mode mode, bool nolast)
 {
 	int rv = 0;
 /*
@@ -1006,7 +1474,7 @@ static int build_textchain(char* message, struct rcell* root,
 				if (msglen > 0){
 					*current = 0;
 /* render surface and slide window */
-					currstyle_cnode(curr_style, base, cnode, sizeonly);
+					currstyle_cnode(curr_style, base, cnode, mode);
 					if (!curr_style->font) {
 						arcan_warning("arcan_video_renderstring(),"
 							" no font specified / found.\n");
@@ -1036,7 +1504,13 @@ static int build_textchain(char* message, struct rcell* root,
 				}
 
 				if (curr_style->surf.buf){
-					currstyle_cnode(curr_style, base, cnode, sizeonly);
+/* embedded images have no place in the glyph atlas */
+					if (mode == CHAIN_GLYPHS){
+						arcan_mem_free(curr_style->surf.buf);
+						curr_style->surf.buf = NULL;
+						return -1;
+					}
+					currstyle_cnode(curr_style, base, cnode, mode);
 					cnode = trystep(cnode, false);
 				}
 
@@ -1057,12 +1531,16 @@ static int build_textchain(char* message, struct rcell* root,
 /* last element .. */
 	if (msglen && curr_style->font) {
 		cnode->next = NULL;
-		if (sizeonly){
+		if (mode == CHAIN_SIZE){
 			TTF_SizeUTF8chain(curr_style->font->chain.data,
 				curr_style->font->chain.count, base, (int*) &cnode->width,
 				(int*) &cnode->height, curr_style->style
 			);
 		}
+		else if (mode == CHAIN_GLYPHS){
+			if (!glyph_alloc(cnode, base, curr_style))
+				return -1;
+		}
 		else
 			render_alloc(cnode, base, curr_style);
 	}
@@ -1132,10 +1610,12 @@ static void cleanup_chain(struct rcell* root)
 	}
 }
 
-static av_pixel* process_chain(struct rcell* root, arcan_vobject* dst,
-	size_t chainlines, bool norender, bool pot,
-	unsigned int* n_lines, struct renderline_meta** lineheights, size_t* dw,
-	size_t* dh, uint32_t* d_sz, size_t* maxw, size_t* maxh)
+/*
+ * Figure out the visual constraints of the chain, returns the
+ * (linecount) lines of line metrics that the nodes will be positioned by.
+ */
+static struct renderline_meta* chain_metrics(struct rcell* root,
+	size_t chainlines, unsigned* n_lines, size_t* maxw, size_t* maxh)
 {
 	struct rcell* cnode = root;
 	unsigned int linecount = 0;
@@ -1156,12 +1636,9 @@ static av_pixel* process_chain(struct rcell* root, arcan_vobject* dst,
 		ARCAN_MEM_BZERO | ARCAN_MEM_TEMPORARY, ARCAN_MEMALIGN_NATURAL
 	);
 
-/* (A) figure out visual constraints */
-	struct rcell* linestart = cnode;
-
 	while (cnode) {
 /* data node */
-		if (cnode->data.surf.buf) {
+		if (data_node(cnode)) {
 			if (!fixed_spacing)
 				line_spacing = cnode->skipv;
 
@@ -1208,6 +1685,56 @@ static av_pixel* process_chain(struct rcell* root, arcan_vobject* dst,
 		cnode = cnode->next;
 	}
 
+	*n_lines = linecount;
+	return lines;
+}
+
+/*
+ * Move the glyph references of each node into place, same walk as the
+ * blit stage of process_chain.
+ */
+static void chain_glyphs(struct rcell* root,
+	struct renderline_meta* lines, struct text_glyphs* dst)
+{
+	struct rcell* cnode = root;
+	int curw = 0;
+	int line = 0;
+
+	while (cnode) {
+		if (cnode->glyphs.used) {
+			for (size_t i = 0; i < cnode->glyphs.count; i++){
+				struct glyph_ref* ref = &dst->refs[cnode->glyphs.start + i];
+				ref->x += curw;
+				ref->y = lines[line].ystart;
+			}
+			curw += cnode->data.surf.w;
+		}
+		else {
+			if (cnode->data.format.tab > 0)
+				curw = get_tabofs(curw, cnode->data.format.tab, /* tab_spacing */ 0);
+
+			if (cnode->data.format.cr)
+				curw = 0;
+
+			if (cnode->data.format.newline > 0)
+				line += cnode->data.format.newline;
+		}
+		cnode = cnode->next;
+	}
+}
+
+static av_pixel* process_chain(struct rcell* root, arcan_vobject* dst,
+	size_t chainlines, bool norender, bool pot,
+	unsigned int* n_lines, struct renderline_meta** lineheights, size_t* dw,
+	size_t* dh, uint32_t* d_sz, size_t* maxw, size_t* maxh)
+{
+	struct rcell* cnode;
+	unsigned int linecount;
+
+/* (A) figure out visual constraints */
+	struct renderline_meta* lines =
+		chain_metrics(root, chainlines, &linecount, maxw, maxh);
+
 /* (B) render into destination buffers, possibly pad to reduce number
  * of needed relocations on dynamic resizing from small changes */
 	*dw = pot ? nexthigher(*maxw) : *maxw;
@@ -1247,7 +1774,7 @@ static av_pixel* process_chain(struct rcell* root, arcan_vobject* dst,
 
 	memset(raw, '\0', *d_sz);
 	cnode = root;
-	curw = 0;
+	int curw = 0;
 	int line = 0;
 
 	while (cnode) {
@@ -1285,22 +1812,13 @@ static av_pixel* process_chain(struct rcell* root, arcan_vobject* dst,
 	return (cleanup_chain(root), raw);
 }
 
-av_pixel* arcan_renderfun_renderfmtstr_extended(const char** msgarray,
-	arcan_vobj_id dstore, bool pot,
-	unsigned int* n_lines, struct renderline_meta** lineheights, size_t* dw,
-	size_t* dh, uint32_t* d_sz, size_t* maxw, size_t* maxh, bool norender)
+/*
+ * Build the chain for a message array, where % 2 entries are format strings
+ * and % 2 + 1 entries plain text. Returns the number of lines or -1.
+ */
+static int build_arraychain(const char** msgarray,
+	struct rcell* root, enum chain_mode mode)
 {
-	struct rcell* root = arcan_alloc_mem(sizeof(struct rcell),
-		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_TEMPORARY,
-		ARCAN_MEMALIGN_NATURAL
-	);
-	if (!root || !msgarray || !msgarray[0])
-		return NULL;
-
-	last_style.newline = 0;
-	last_style.tab = 0;
-	last_style.cr = false;
-
 /* %2, build as text-chain, accumulate linechain view */
 	size_t acc = 0, ind = 0;
 
@@ -1313,10 +1831,13 @@ av_pixel* arcan_renderfun_renderfmtstr_extended(const char** msgarray,
 
 		if (ind % 2 == 0){
 			char* work = strdup(msgarray[ind]);
-			int nlines = build_textchain(work, cur, false, true);
+			int nlines = build_textchain(work, cur, mode, true);
 			arcan_mem_free(work);
-			if (-1 == nlines)
+			if (-1 == nlines){
+				if (mode == CHAIN_GLYPHS)
+					return -1;
 				break;
+			}
 			acc += nlines;
 			while (cur->next != NULL)
 				cur = cur->next;
@@ -1327,7 +1848,7 @@ av_pixel* arcan_renderfun_renderfmtstr_extended(const char** msgarray,
 				ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_TEMPORARY,
 				ARCAN_MEMALIGN_NATURAL
 			);
-			currstyle_cnode(&last_style, msgarray[ind], cur, false);
+			currstyle_cnode(&last_style, msgarray[ind], cur, mode);
 		}
 		ind++;
 	}
@@ -1340,8 +1861,29 @@ av_pixel* arcan_renderfun_renderfmtstr_extended(const char** msgarray,
 	);
 	cur->data.format.newline = 1;
 
+	return acc + 1;
+}
+
+av_pixel* arcan_renderfun_renderfmtstr_extended(const char** msgarray,
+	arcan_vobj_id dstore, bool pot,
+	unsigned int* n_lines, struct renderline_meta** lineheights, size_t* dw,
+	size_t* dh, uint32_t* d_sz, size_t* maxw, size_t* maxh, bool norender)
+{
+	struct rcell* root = arcan_alloc_mem(sizeof(struct rcell),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_TEMPORARY,
+		ARCAN_MEMALIGN_NATURAL
+	);
+	if (!root || !msgarray || !msgarray[0])
+		return NULL;
+
+	last_style.newline = 0;
+	last_style.tab = 0;
+	last_style.cr = false;
+
+	int chainlines = build_arraychain(msgarray, root, CHAIN_RENDER);
+
 	return process_chain(root, arcan_video_getobject(dstore),
-		acc+1, norender, pot, n_lines,
+		chainlines, norender, pot, n_lines,
 		lineheights, dw, dh, d_sz, maxw, maxh
 	);
 }
@@ -1368,7 +1910,7 @@ av_pixel* arcan_renderfun_renderfmtstr(const char* message,
 	last_style.tab = 0;
 	last_style.cr = false;
 
-	int chainlines = build_textchain(work, root, false, false);
+	int chainlines = build_textchain(work, root, CHAIN_RENDER, false);
 	arcan_mem_free(work);
 
 	if (chainlines > 0){
@@ -1381,6 +1923,178 @@ av_pixel* arcan_renderfun_renderfmtstr(const char* message,
 	return raw;
 }
 
+bool arcan_renderfun_glyphfmtstr(const char* message, const char** msgarray,
+	struct text_glyphs** dst, unsigned int* n_lines,
+	struct renderline_meta** lineheights, size_t* maxw, size_t* maxh)
+{
+	if (!atlas_enabled() || (!message && (!msgarray || !msgarray[0])))
+		goto fail;
+
+	struct text_glyphs* glyphs = *dst;
+	if (!glyphs){
+		glyphs = *dst = arcan_alloc_mem(sizeof(struct text_glyphs),
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_NONFATAL | ARCAN_MEM_BZERO,
+			ARCAN_MEMALIGN_NATURAL
+		);
+		if (!glyphs)
+			return false;
+	}
+
+	struct rcell* root = arcan_alloc_mem(sizeof(struct rcell),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_TEMPORARY,
+		ARCAN_MEMALIGN_NATURAL
+	);
+
+/* the format state carries between calls, and the fallback to rasterizing
+ * should start from where we did */
+	struct text_format old_style = last_style;
+	last_style.newline = 0;
+	last_style.tab = 0;
+	last_style.cr = false;
+
+	glyph_dst = glyphs;
+	glyphs->n_refs = 0;
+	glyphs->generation = 0;
+
+	int chainlines;
+	if (message){
+		char* work = strdup(message);
+		chainlines = build_textchain(work, root, CHAIN_GLYPHS, false);
+		arcan_mem_free(work);
+	}
+	else
+		chainlines = build_arraychain(msgarray, root, CHAIN_GLYPHS);
+	glyph_dst = NULL;
+
+	if (chainlines <= 0){
+		cleanup_chain(root);
+		last_style = old_style;
+		goto fail;
+	}
+
+	unsigned linecount;
+	struct renderline_meta* lines =
+		chain_metrics(root, chainlines, &linecount, maxw, maxh);
+	chain_glyphs(root, lines, glyphs);
+	cleanup_chain(root);
+
+	if (!arcan_renderfun_glyphrefresh(glyphs)){
+		arcan_mem_free(lines);
+		last_style = old_style;
+		goto fail;
+	}
+
+	if (n_lines)
+		*n_lines = linecount;
+
+	if (lineheights)
+		*lineheights = lines;
+	else
+		arcan_mem_free(lines);
+
+	return true;
+
+fail:
+	arcan_renderfun_glyphfree(dst);
+	return false;
+}
+
+bool arcan_renderfun_glyphrefresh(struct text_glyphs* glyphs)
+{
+	if (glyphs->generation == atlas.generation)
+		return true;
+
+	if (!atlas.store && !atlas_resize(GLYPH_ATLAS_BASE))
+		return false;
+
+/* make sure everything is in the atlas first, if it had to be cleared on
+ * the way, the earlier glyphs need to go in again */
+	for (size_t attempt = 0;; attempt++){
+		uint64_t resets = atlas.resets;
+		size_t i;
+
+		for (i = 0; i < glyphs->n_refs; i++)
+			if (!atlas_lookup(&glyphs->refs[i].key) || resets != atlas.resets)
+				break;
+
+		if (i == glyphs->n_refs && resets == atlas.resets)
+			break;
+
+/* either a glyph can't be resolved (font gone) or it doesn't all fit */
+		if (attempt || resets == atlas.resets){
+			atlas_sync();
+			glyphs->n_quads = 0;
+			return false;
+		}
+	}
+
+	float sx = 1.0f / (float) GLYPH_ATLAS_WIDTH;
+	float sy = 1.0f / (float) atlas.h;
+	float* out = glyphs->vtx;
+	glyphs->n_quads = 0;
+
+	for (size_t i = 0; i < glyphs->n_refs; i++){
+		struct glyph_ref* ref = &glyphs->refs[i];
+		struct atlas_entry* ent = atlas_lookup(&ref->key);
+		if (!ent->w)
+			continue;
+
+		float x1 = ref->x + ent->ox;
+		float y1 = ref->y + ent->oy;
+		*out++ = x1;
+		*out++ = y1;
+		*out++ = x1 + ent->w;
+		*out++ = y1 + ent->h;
+		*out++ = (float) ent->x * sx;
+		*out++ = (float) ent->y * sy;
+		*out++ = (float)(ent->x + ent->w) * sx;
+		*out++ = (float)(ent->y + ent->h) * sy;
+		glyphs->n_quads++;
+	}
+
+	atlas_sync();
+	glyphs->generation = atlas.generation;
+	return true;
+}
+
+struct agp_vstore* arcan_renderfun_glyphatlas(uint64_t* generation)
+{
+	if (generation)
+		*generation = atlas.generation;
+	return atlas.store;
+}
+
+void arcan_renderfun_glyphfree(struct text_glyphs** glyphs)
+{
+	if (!glyphs || !*glyphs)
+		return;
+
+	arcan_mem_free((*glyphs)->refs);
+	arcan_mem_free((*glyphs)->vtx);
+	arcan_mem_free(*glyphs);
+	*glyphs = NULL;
+}
+
+void arcan_renderfun_glyphreset()
+{
+	atlas_clear();
+
+	if (atlas.store){
+		agp_drop_vstore(atlas.store);
+		arcan_mem_free(atlas.store);
+		atlas.store = NULL;
+	}
+
+	arcan_mem_free(atlas.raw);
+	atlas.raw = NULL;
+	atlas.h = 0;
+	atlas.dirty = false;
+
+	arcan_mem_free(atlas.cell);
+	atlas.cell = NULL;
+	atlas.cell_sz = 0;
+}
+
 int arcan_renderfun_stretchblit(char* src, int inw, int inh,
 	uint32_t* dst, size_t dstw, size_t dsth, int flipv)
 {
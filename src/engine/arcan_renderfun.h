@@ -81,6 +81,63 @@ av_pixel* arcan_renderfun_renderfmtstr_extended(const char** message,
 	size_t* maxw, size_t* maxh, bool norender
 );
 
+/*
+ * Text laid out as references into a glyph atlas that is shared between all
+ * such text, rather than rasterized into a buffer of its own. [vtx] holds
+ * [n_quads] quads as (x1, y1, x2, y2, s1, t1, s2, t2), x/y in pixels relative
+ * to the upper left corner of the text and s/t in atlas texture coordinates.
+ * They are valid for as long as arcan_renderfun_glyphrefresh returns true.
+ */
+struct glyph_ref;
+struct text_glyphs {
+	struct glyph_ref* refs;
+	size_t n_refs;
+	size_t limit;
+
+	float* vtx;
+	size_t n_quads;
+
+	uint64_t generation;
+};
+
+/*
+ * Lay out a format string, or a message array (see _extended) if [message]
+ * is NULL, into *[dst] (allocated if NULL). Line metrics and dimensions are
+ * written back like with arcan_renderfun_renderfmtstr.
+ *
+ * This only works if the atlas is enabled (ARCAN_TEXT_ATLAS is set in the
+ * environment) and if the string only uses features that can be represented
+ * as glyphs (i.e. no embedded images). On failure, *[dst] is freed and the
+ * caller should fall back to arcan_renderfun_renderfmtstr.
+ */
+bool arcan_renderfun_glyphfmtstr(const char* message, const char** msgarray,
+	struct text_glyphs** dst, unsigned int* n_lines,
+	struct renderline_meta** lineheights, size_t* maxw, size_t* maxh);
+
+/*
+ * Make sure that the quads in [glyphs] match the current state of the atlas,
+ * this should be called before drawing. Returns false if some glyph can no
+ * longer be resolved (its font has been evicted from the font cache or the
+ * text doesn't fit in the atlas), the text should then be rasterized.
+ */
+bool arcan_renderfun_glyphrefresh(struct text_glyphs* glyphs);
+
+/*
+ * Get the backing store that glyph quads reference, NULL until some text
+ * has been laid out. [generation] (if !NULL) is set to the current atlas
+ * generation, glyphs with a different one need to be refreshed and anything
+ * that has been prepared from older quads should be drawn first.
+ */
+struct agp_vstore* arcan_renderfun_glyphatlas(uint64_t* generation);
+
+void arcan_renderfun_glyphfree(struct text_glyphs** glyphs);
+
+/*
+ * Drop the atlas and its backing store, any text laid out before this will
+ * be re-added on its next refresh.
+ */
+void arcan_renderfun_glyphreset();
+
 /*
  * set the video offset used for embedded rendering of vstores, this is
  * primarily used when there's a scripting- or similar context that remaps
@@ -26,6 +26,8 @@
 #include <stdint.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <stdatomic.h>
+#include <pthread.h>
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
@@ -57,6 +59,7 @@
 #define CACHED_METRICS	0x10
 #define CACHED_BITMAP	0x01
 #define CACHED_PIXMAP	0x02
+#define CACHED_MISSING	0x20
 
 /* Cached glyph information */
 typedef struct cached_glyph {
@@ -106,9 +109,11 @@ struct _TTF_Font {
 	int underline_offset;
 	int underline_height;
 
-	/* Cache for style-transformed glyphs */
+	/* Most recent Find_Glyph result, points into the shared glyph cache */
 	c_glyph *current;
-	c_glyph cache[257]; /* 257 is a prime */
+
+	/* Unique for the lifetime of the process, keys the glyph cache */
+	uint64_t id;
 
 	/* We are responsible for closing the font stream */
 	FILE* src;
@@ -138,6 +143,70 @@ struct _TTF_Font {
 static _Thread_local FT_Library library;
 static _Thread_local int TTF_initialized = 0;
 
+/*
+ * Glyph cache, shared by all fonts opened on a thread so that a fallback
+ * chain competes for the same budget rather than each font flushing its
+ * own table on collisions. It is set-associative with GLYPH_WAYS entries
+ * per set, replaced in LRU order. The number of sets is derived from the
+ * byte budget so that each set gets an equal share of it, assuming a glyph
+ * costs around GLYPH_COST.
+ *
+ * The key covers font, glyph and the style/outline/hinting that affect the
+ * raster, so changing those on a font doesn't need to flush anything.
+ */
+#define GLYPH_WAYS 8
+#define GLYPH_COST 1024
+#define GLYPH_CACHE_DEFAULT (8 * 1024 * 1024)
+
+struct glyph_slot {
+	c_glyph glyph;
+	uint64_t font;
+	uint32_t ch;
+	uint32_t variant;
+	uint64_t used;
+	size_t bytes;
+};
+
+static _Thread_local struct {
+	struct glyph_slot* slots;
+	size_t n_sets;
+	size_t set_budget;
+	size_t limit;
+	uint64_t clock;
+
+/* how far into the closed fonts / limit changes below this cache has come */
+	uint64_t closed_seq;
+	uint64_t limit_seq;
+} gcache;
+
+/*
+ * A font can be closed (or flushed) on another thread than the ones that
+ * have its glyphs cached, and the budget can be changed from any thread.
+ * Both are published here and each thread catches up on its next lookup,
+ * dropping the glyphs of the fonts in the ring or everything if it has
+ * fallen further behind than that.
+ */
+#define CLOSED_RING 64
+
+static struct {
+	pthread_mutex_t lock;
+	uint64_t closed[CLOSED_RING];
+	_Atomic uint64_t closed_seq;
+
+	atomic_size_t limit;
+	_Atomic uint64_t limit_seq;
+} gshared = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+/* shared between the caches of all threads so that glyphs rasterized off the
+ * main thread are accounted for in TTF_GlyphCacheStats as well */
+static struct {
+	atomic_size_t hits, misses, evictions, bytes;
+} gstats;
+
+static _Atomic uint64_t font_seq = 1;
+
 void TTF_SetError(const char* msg){
 }
 
@@ -312,6 +381,7 @@ TTF_Font* TTF_OpenFontIndexRW( FILE* src, int freesrc, int ptsize,
 	}
 	memset(font, 0, sizeof(*font));
 
+	font->id = atomic_fetch_add(&font_seq, 1);
 	font->src = src;
 	font->freesrc = freesrc;
 
@@ -491,19 +561,142 @@ static void Flush_Glyph( c_glyph* glyph )
 	glyph->cached = 0;
 }
 
-void TTF_Flush_Cache( TTF_Font* font )
+static size_t glyph_bytes(c_glyph* glyph)
 {
-	int i;
-	int size = sizeof( font->cache ) / sizeof( font->cache[0] );
+	size_t sum = sizeof(struct glyph_slot);
+	if (glyph->bitmap.buffer)
+		sum += abs(glyph->bitmap.pitch) * glyph->bitmap.rows;
+	if (glyph->pixmap.buffer)
+		sum += abs(glyph->pixmap.pitch) * glyph->pixmap.rows;
+	return sum;
+}
 
-	for( i = 0; i < size; ++i ) {
-		if( font->cache[i].cached ) {
-			Flush_Glyph( &font->cache[i] );
-		}
+static void glyph_release(struct glyph_slot* slot)
+{
+	Flush_Glyph(&slot->glyph);
+	atomic_fetch_sub(&gstats.bytes, slot->bytes);
+	slot->bytes = 0;
+	slot->font = 0;
+}
+
+static void glyph_cache_free()
+{
+	if (!gcache.slots)
+		return;
+
+	for (size_t i = 0; i < gcache.n_sets * GLYPH_WAYS; i++)
+		if (gcache.slots[i].font)
+			glyph_release(&gcache.slots[i]);
+
+	free(gcache.slots);
+	gcache.slots = NULL;
+	gcache.n_sets = 0;
+}
+
+static size_t glyph_cache_limit()
+{
+	size_t limit = atomic_load(&gshared.limit);
+	if (limit)
+		return limit;
+
+	const char* env = getenv("ARCAN_GLYPH_CACHE");
+	limit = env ? strtoul(env, NULL, 10) : 0;
+	return limit ? limit : GLYPH_CACHE_DEFAULT;
+}
 
+static bool glyph_cache_alloc()
+{
+	gcache.limit = glyph_cache_limit();
+
+	size_t n_sets = gcache.limit / (GLYPH_WAYS * GLYPH_COST);
+	if (!n_sets)
+		n_sets = 1;
+
+	gcache.slots = calloc(n_sets * GLYPH_WAYS, sizeof(struct glyph_slot));
+	if (!gcache.slots)
+		return false;
+
+	gcache.n_sets = n_sets;
+	gcache.set_budget = gcache.limit / n_sets;
+	return true;
+}
+
+/* catch up with the changes other threads have published */
+static void glyph_cache_sync()
+{
+	uint64_t lseq = atomic_load(&gshared.limit_seq);
+	if (lseq != gcache.limit_seq){
+		glyph_cache_free();
+		gcache.limit_seq = lseq;
+	}
+
+	if (atomic_load(&gshared.closed_seq) == gcache.closed_seq)
+		return;
+
+	uint64_t ids[CLOSED_RING];
+	size_t n = 0;
+	bool all = false;
+
+	pthread_mutex_lock(&gshared.lock);
+	uint64_t seq = atomic_load(&gshared.closed_seq);
+	if (seq - gcache.closed_seq > CLOSED_RING)
+		all = true;
+	else
+		for (uint64_t i = gcache.closed_seq; i < seq; i++)
+			ids[n++] = gshared.closed[i % CLOSED_RING];
+	pthread_mutex_unlock(&gshared.lock);
+	gcache.closed_seq = seq;
+
+	if (!gcache.slots)
+		return;
+
+	if (all){
+		glyph_cache_free();
+		return;
+	}
+
+	for (size_t i = 0; i < gcache.n_sets * GLYPH_WAYS; i++){
+		if (!gcache.slots[i].font)
+			continue;
+
+		for (size_t j = 0; j < n; j++)
+			if (gcache.slots[i].font == ids[j]){
+				glyph_release(&gcache.slots[i]);
+				break;
+			}
 	}
 }
 
+void TTF_SetGlyphCacheSize(size_t bytes)
+{
+	atomic_store(&gshared.limit, bytes);
+	atomic_fetch_add(&gshared.limit_seq, 1);
+	glyph_cache_sync();
+}
+
+void TTF_GlyphCacheStats(TTF_CacheStats* out)
+{
+	*out = (TTF_CacheStats){
+		.hits = atomic_load(&gstats.hits),
+		.misses = atomic_load(&gstats.misses),
+		.evictions = atomic_load(&gstats.evictions),
+		.bytes = atomic_load(&gstats.bytes)
+	};
+	out->limit = glyph_cache_limit();
+}
+
+void TTF_Flush_Cache( TTF_Font* font )
+{
+	pthread_mutex_lock(&gshared.lock);
+	uint64_t seq = atomic_load(&gshared.closed_seq);
+	gshared.closed[seq % CLOSED_RING] = font->id;
+	atomic_store(&gshared.closed_seq, seq + 1);
+	pthread_mutex_unlock(&gshared.lock);
+
+/* the calling thread drops its glyphs right away, the others on next use */
+	glyph_cache_sync();
+}
+
 static FT_Error Load_Glyph(
 	TTF_Font* font, uint32_t ch, c_glyph* cached, int want, bool by_ind )
 {
@@ -832,21 +1025,108 @@ static FT_Error Load_Glyph(
 	return 0;
 }
 
+static uint32_t glyph_variant(TTF_Font* font, bool by_ind)
+{
+	return ((uint32_t)(font->style & ~TTF_STYLE_NO_GLYPH_CHANGE) & 0xff) |
+		(((uint32_t) font->outline & 0xffff) << 8) |
+		(((uint32_t) font->hinting & 0x7f) << 24) | ((uint32_t) by_ind << 31);
+}
+
+/*
+ * bring the set within its share of the budget after [slot] has grown,
+ * dropping the least recently used entries but never [slot] itself
+ */
+static void glyph_account(struct glyph_slot* set, struct glyph_slot* slot)
+{
+	size_t bytes = glyph_bytes(&slot->glyph);
+	atomic_fetch_add(&gstats.bytes, bytes - slot->bytes);
+	slot->bytes = bytes;
+
+	size_t sum = 0;
+	for (size_t i = 0; i < GLYPH_WAYS; i++)
+		sum += set[i].bytes;
+
+	while (sum > gcache.set_budget){
+		struct glyph_slot* victim = NULL;
+		for (size_t i = 0; i < GLYPH_WAYS; i++)
+			if (set[i].font && &set[i] != slot &&
+				(!victim || set[i].used < victim->used))
+				victim = &set[i];
+
+		if (!victim)
+			break;
+
+		sum -= victim->bytes;
+		atomic_fetch_add(&gstats.evictions, 1);
+		glyph_release(victim);
+	}
+}
+
 static FT_Error Find_Glyph(
 	TTF_Font* font, uint32_t ch, int want, bool by_ind)
 {
 	int retval = 0;
-	int hsize = sizeof( font->cache ) / sizeof( font->cache[0] );
 
-	int h = ch % hsize;
-	font->current = &font->cache[h];
+	glyph_cache_sync();
+	if (!gcache.slots && !glyph_cache_alloc())
+		return FT_Err_Out_Of_Memory;
+
+	uint32_t variant = glyph_variant(font, by_ind);
+	uint64_t hash = (font->id * 0x9E3779B97F4A7C15ull) ^ ch ^ ((uint64_t) variant << 21);
+	hash ^= hash >> 29;
+	struct glyph_slot* set = &gcache.slots[(hash % gcache.n_sets) * GLYPH_WAYS];
+	struct glyph_slot* slot = NULL;
+
+	for (size_t i = 0; i < GLYPH_WAYS; i++){
+		struct glyph_slot* cur = &set[i];
+		if (cur->font == font->id && cur->ch == ch && cur->variant == variant){
+			slot = cur;
+			break;
+		}
+
+		if (!slot || (slot->font && (!cur->font || cur->used < slot->used)))
+			slot = cur;
+	}
+
+	if (slot->font != font->id || slot->ch != ch || slot->variant != variant){
+		if (slot->font){
+			atomic_fetch_add(&gstats.evictions, 1);
+			glyph_release(slot);
+		}
+		slot->font = font->id;
+		slot->ch = ch;
+		slot->variant = variant;
+	}
+
+	slot->used = ++gcache.clock;
+	font->current = &slot->glyph;
 
-	if (font->current->cached != ch)
-		Flush_Glyph( font->current );
+/* remember glyphs the font doesn't provide, fallback chains otherwise
+ * probe the primary font for each of them on every lookup */
+	if (slot->glyph.stored & CACHED_MISSING){
+		atomic_fetch_add(&gstats.hits, 1);
+		return -1;
+	}
+
+	if ( (slot->glyph.stored & want) == want ){
+		atomic_fetch_add(&gstats.hits, 1);
+		return 0;
+	}
+
+	atomic_fetch_add(&gstats.misses, 1);
+	retval = Load_Glyph( font, ch, &slot->glyph, want, by_ind );
 
-	if ( (font->current->stored & want) != want ) {
-		retval = Load_Glyph( font, ch, font->current, want, by_ind );
+	if (retval){
+		bool missing = slot->glyph.index == 0;
+		glyph_release(slot);
+		if (missing){
+			slot->font = font->id;
+			slot->glyph.stored = CACHED_MISSING;
+		}
+		return retval;
 	}
+
+	glyph_account(set, slot);
 	return retval;
 }
 
@@ -1050,15 +1330,9 @@ int TTF_GlyphMetrics(TTF_Font *font, uint32_t ch,
 
 void TTF_SetFontStyle( TTF_Font* font, int style )
 {
-	int prev_style = font->style;
 	font->style = style | font->face_style;
 
-	/* Flush the cache if the style has changed.
-	* Ignore UNDERLINE which does not impact glyph drawning.
-	* */
-	if ( (font->style | TTF_STYLE_NO_GLYPH_CHANGE ) != ( prev_style | TTF_STYLE_NO_GLYPH_CHANGE )) {
-		TTF_Flush_Cache( font );
-	}
+/* glyphs are cached per style (see glyph_variant) so no flush is needed */
 }
 
 _Thread_local static size_t pool_cnt;
@@ -1568,6 +1842,53 @@ bool TTF_RenderUTF8chain(PIXEL* dst, size_t width, size_t height,
 	return true;
 }
 
+bool TTF_LayoutUTF8chain(TTF_Font **font, size_t n,
+	const char* intext, void (*emit)(void* tag, uint32_t cp, int x), void* tag)
+{
+	FT_UInt prev_index = 0;
+	int x = 0;
+
+	if (!intext || intext[0] == '\0')
+		return true;
+
+	int unicode_len = strlen(intext);
+	size_upool(unicode_len+1);
+	if (!unicode_buf)
+		return false;
+
+	UTF8_to_UTF32(unicode_buf, (const uint8_t*) intext, unicode_len);
+	bool use_kerning = FT_HAS_KERNING(font[0]->face) && font[0]->kerning;
+
+/* same pen stepping as render_unicode, minus the drawing */
+	for (const uint32_t* ch = unicode_buf; *ch; ++ch){
+		TTF_Font* outf = Find_Glyph_fb(font, n, *ch, CACHED_METRICS, false);
+		if (!outf)
+			continue;
+
+		c_glyph* glyph = outf->current;
+		int advance = glyph->advance;
+
+		if (glyph->manual_scale)
+			advance = outf->ptsize;
+		else if (use_kerning && prev_index && glyph->index){
+			FT_Vector delta;
+			FT_Get_Kerning(outf->face, prev_index,
+				glyph->index, ft_kerning_default, &delta);
+			x += delta.x >> 6;
+		}
+
+		emit(tag, *ch, x);
+
+		if (TTF_HANDLE_STYLE_BOLD(outf))
+			x += outf->glyph_overhang;
+
+		prev_index = glyph->index;
+		x += advance;
+	}
+
+	return true;
+}
+
 int TTF_GetFontStyle( const TTF_Font* font )
 {
 	return font->style;
@@ -1576,7 +1897,6 @@ int TTF_GetFontStyle( const TTF_Font* font )
 void TTF_SetFontOutline( TTF_Font* font, int outline )
 {
 	font->outline = outline;
-	TTF_Flush_Cache( font );
 }
 
 int TTF_GetFontOutline( const TTF_Font* font )
@@ -1598,8 +1918,6 @@ void TTF_SetFontHinting( TTF_Font* font, int hinting )
 		font->hinting = FT_RENDER_MODE_LCD_V;
 	else
 		font->hinting = FT_RENDER_MODE_NORMAL;
-
-	TTF_Flush_Cache( font );
 }
 
 int TTF_GetFontHinting( const TTF_Font* font )
@@ -1622,6 +1940,7 @@ void TTF_Quit( void )
 {
 	if ( TTF_initialized ) {
 		if ( --TTF_initialized == 0 ) {
+			glyph_cache_free();
 			FT_Done_FreeType( library );
 		}
 	}
@@ -184,8 +184,44 @@ bool TTF_RenderUNICODEglyph(PIXEL* dst,
 	int* advance, unsigned* prev_index
 );
 
+/*
+ * Walk [intext] like TTF_RenderUTF8chain would, but rather than drawing,
+ * call [emit] with each codepoint that resolved to a glyph and the pen
+ * position (kerning applied) it would have been drawn at. Rendering that
+ * codepoint with TTF_RenderUNICODEglyph at that position (kerning disabled)
+ * gives the same result as the full string, which lets a caller rasterize
+ * glyphs once and composite them elsewhere.
+ */
+bool TTF_LayoutUTF8chain(TTF_Font **font, size_t n,
+	const char* intext, void (*emit)(void* tag, uint32_t cp, int x), void* tag);
+
+/*
+ * Drop the cached glyphs of [font] (also done by TTF_CloseFont). The calling
+ * thread drops them immediately, other threads on their next glyph lookup.
+ */
 void TTF_Flush_Cache( TTF_Font* font );
 
+/*
+ * Glyphs are cached per thread in a cache that is shared between all fonts
+ * (and thus fallback chains) used on that thread. The budget is in bytes,
+ * applies to each thread, and covers both bookkeeping and rasterized glyphs.
+ * It defaults to 8MiB or the value of ARCAN_GLYPH_CACHE in the environment.
+ * Changing it flushes the caches of all threads, the calling one right away
+ * and the others on their next glyph lookup.
+ */
+void TTF_SetGlyphCacheSize(size_t bytes);
+
+typedef struct {
+	size_t hits;      /* lookups served without going through freetype */
+	size_t misses;    /* lookups that had to load or rasterize          */
+	size_t evictions; /* entries dropped to make room                    */
+	size_t bytes;     /* current cache size, all threads                */
+	size_t limit;     /* cache budget of each thread                    */
+} TTF_CacheStats;
+
+/* Retrieve the statistics accumulated over the caches of all threads */
+void TTF_GlyphCacheStats(TTF_CacheStats* out);
+
 /*
  * Same as TTF_RenderUNICODEglyph above, but 'ch' references the glyph index in
  * the font-chain, not the unicode codepoint.  This is only for special/trusted
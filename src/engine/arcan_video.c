@@ -46,6 +46,7 @@
 #include "arcan_renderfun.h"
 #include "arcan_videoint.h"
 #include "arcan_3dbase.h"
+#include "arcan_conductor.h"
 #include "arcan_img.h"
 
 #ifndef offsetof
@@ -126,6 +127,7 @@ struct arcan_video_context* dctx);
 static inline void build_modelview(float* dmatr,
 	float* imatr, surface_properties* prop, arcan_vobject* src);
 static inline void process_readback(struct rendertarget* tgt, float fract);
+static void damage_drop(struct rendertarget* tgt);
 
 static inline void trace(const char* msg, ...)
 {
@@ -640,6 +642,13 @@ signed arcan_video_pushcontext()
 
 	current_context->rtargets[0].first = NULL;
 
+/* damage snapshots belong to the context below */
+	memset(&current_context->stdoutp.damage, '\0',
+		sizeof(current_context->stdoutp.damage));
+	for (size_t i = 0; i < RENDERTARGET_LIMIT; i++)
+		memset(&current_context->rtargets[i].damage, '\0',
+			sizeof(current_context->rtargets[i].damage));
+
 /* propagate persistent flagged objects upwards */
 	push_transfer_persists(
 		&vcontext_stack[ vcontext_ind - 1], current_context);
@@ -875,11 +884,20 @@ unsigned arcan_video_popcontext()
 
 	deallocate_gl_context(current_context, true, current_context->world.vstore);
 
+	damage_drop(&current_context->stdoutp);
+	for (size_t i = 0; i < RENDERTARGET_LIMIT; i++)
+		damage_drop(&current_context->rtargets[i]);
+
 	if (vcontext_ind > 0){
 		vcontext_ind--;
 		current_context = &vcontext_stack[ vcontext_ind ];
 	}
 
+/* the world store has been drawn to in the meanwhile */
+	arcan_vint_damageall(&current_context->stdoutp);
+	for (size_t i = 0; i < current_context->n_rtargets; i++)
+		arcan_vint_damageall(&current_context->rtargets[i]);
+
 	reallocate_gl_context(current_context);
 	FLAG_DIRTY(NULL);
 
@@ -973,6 +991,7 @@ arcan_errc arcan_video_resampleobject(arcan_vobj_id vid,
 		}
 
 /* and now swap and the rest of the function should behave as normal */
+		arcan_vint_privatestore(dvobj);
 		if (dvobj->vstore->w != neww || dvobj->vstore->h != newh){
 			agp_resize_vstore(dvobj->vstore, neww, newh);
 		}
@@ -1056,6 +1075,7 @@ arcan_errc arcan_video_mipmapset(arcan_vobj_id vid, bool enable)
 	if (!newbuf)
 		return ARCAN_ERRC_OUT_OF_SPACE;
 
+	arcan_vint_privatestore(vobj);
 	arcan_vint_drop_vstore(vobj->vstore);
 	if (enable)
 		vobj->vstore->filtermode |= ARCAN_VFILTER_MIPMAP;
@@ -1122,6 +1142,16 @@ arcan_vobj_id arcan_vint_nextfree()
 		return id;
 }
 
+void arcan_vint_touch(arcan_vobject* obj)
+{
+	if (!obj)
+		return;
+
+	obj->update_seq++;
+	if (obj->vstore)
+		obj->vstore->update_seq++;
+}
+
 /*
  * arcan_video_newvobject is used in other parts (3d, renderfun, ...)
  * as well, but they wrap to this one as to not expose more of the
@@ -1130,6 +1160,10 @@ arcan_vobj_id arcan_vint_nextfree()
 static arcan_vobject* new_vobject(arcan_vobj_id* id,
 	struct arcan_video_context* dctx)
 {
+/* slots get reused, a fresh sequence keeps damage tracking from mistaking
+ * a new object for the old one */
+	static uint32_t seq_base;
+
 	arcan_vobject* rv = NULL;
 
 	bool status;
@@ -1166,6 +1200,9 @@ static arcan_vobject* new_vobject(arcan_vobj_id* id,
 	rv->cellid = fid;
 	assert(rv->cellid > 0);
 
+	seq_base += 0x10000;
+	rv->update_seq = seq_base;
+
 	rv->parent = &current_context->world;
 	rv->mask = MASK_ORIENTATION | MASK_OPACITY | MASK_POSITION
 		| MASK_FRAMESET | MASK_LIVING;
@@ -1284,19 +1321,10 @@ static bool detach_fromtarget(struct rendertarget* dst, arcan_vobject* src)
 	return true;
 }
 
-void arcan_vint_reraster(arcan_vobject* src, struct rendertarget* rtgt)
+static void text_reraster(arcan_vobject* src)
 {
 	struct agp_vstore* vs = src->vstore;
 
-/* unless the storage is eligible and the density is sufficiently different */
-	if (!
-		((vs->txmapped && (vs->vinf.text.kind ==
-		STORAGE_TEXT || vs->vinf.text.kind == STORAGE_TEXTARRAY)) &&
-		((fabs(vs->vinf.text.vppcm - rtgt->vppcm) > EPSILON ||
-		 fabs(vs->vinf.text.hppcm - rtgt->hppcm) > EPSILON)))
-	)
-		return;
-
 /*  in update sourcedescr we guarantee that any vinf that come here with
  *  the TEXT | TEXTARRAY storage type will have a copy of the format string
  *  that led to its creation. This allows us to just reraster into that */
@@ -1315,6 +1343,65 @@ void arcan_vint_reraster(arcan_vobject* src, struct rendertarget* rtgt)
 	}
 }
 
+/*
+ * Text that is drawn from the glyph atlas has nothing in its own store, so
+ * rasterize it for the operations that work on the store itself (sharing,
+ * framesets, readbacks). It stays rasterized until the next renderstring.
+ */
+static void text_materialize(arcan_vobject* src)
+{
+	if (!src->glyphs)
+		return;
+
+	arcan_renderfun_glyphfree(&src->glyphs);
+	text_reraster(src);
+	FLAG_DIRTY(src);
+}
+
+/*
+ * Once the store has been materialized and something else holds on to it
+ * (shared store, frame in a frameset) or the object is a rendertarget or
+ * readback source, going back to glyphs would leave those with the old text.
+ */
+static bool text_glyph_eligible(arcan_vobject* vobj)
+{
+	return vobj->vstore->refcount == 1 && !vobj->frameset &&
+		!arcan_vint_findrt(vobj) && !arcan_vint_findrt_vstore(vobj->vstore);
+}
+
+void arcan_vint_reraster(arcan_vobject* src, struct rendertarget* rtgt)
+{
+	struct agp_vstore* vs = src->vstore;
+
+/* unless the storage is eligible and the density is sufficiently different */
+	if (!
+		((vs->txmapped && (vs->vinf.text.kind ==
+		STORAGE_TEXT || vs->vinf.text.kind == STORAGE_TEXTARRAY)) &&
+		((fabs(vs->vinf.text.vppcm - rtgt->vppcm) > EPSILON ||
+		 fabs(vs->vinf.text.hppcm - rtgt->hppcm) > EPSILON)))
+	)
+		return;
+
+/* glyphs only need to be laid out again, at the new density */
+	if (src->glyphs){
+		size_t maxw, maxh;
+		arcan_renderfun_outputdensity(rtgt->hppcm, rtgt->vppcm);
+
+		if (arcan_renderfun_glyphfmtstr(
+			vs->vinf.text.kind == STORAGE_TEXT ? vs->vinf.text.source : NULL,
+			(const char**)(vs->vinf.text.kind == STORAGE_TEXTARRAY ?
+				vs->vinf.text.source_arr : NULL),
+			&src->glyphs, NULL, NULL, &maxw, &maxh)){
+			vs->vinf.text.vppcm = rtgt->vppcm;
+			vs->vinf.text.hppcm = rtgt->hppcm;
+			FLAG_DIRTY(src);
+			return;
+		}
+	}
+
+	text_reraster(src);
+}
+
 static void attach_object(struct rendertarget* dst, arcan_vobject* src)
 {
 	if (dst->link)
@@ -1601,6 +1688,7 @@ arcan_errc arcan_video_init(uint16_t width, uint16_t height, uint8_t bpp,
 
 	arcan_video_display.in_video = true;
 	arcan_video_display.conservative = conservative;
+	arcan_video_display.no_damage = getenv("ARCAN_VIDEO_NODAMAGE") != NULL;
 
 	current_context->world.current.scale.x = 1.0;
 	current_context->world.current.scale.y = 1.0;
@@ -1789,6 +1877,315 @@ done:
 	return rv;
 }
 
+/*
+ * Decoded images are kept around and shared, so loading the same resource
+ * again with the same constraints and store defaults reuses the texture
+ * instead of decoding and uploading it again. Entries are keyed on the path
+ * along with the size and modification time of the resource so that an
+ * updated file is picked up. The cache holds one reference to each store,
+ * and when the budget is exceeded the least recently used entries are
+ * released. Anything that modifies a store in place has to go through
+ * arcan_vint_privatestore first so that the change won't propagate to other
+ * objects loaded from the same resource.
+ *
+ * Only used from the main thread, asynchronous loads check the cache when
+ * queued and are added when joined.
+ */
+#ifndef IMAGE_CACHE_DEFAULT
+#define IMAGE_CACHE_DEFAULT (64 * 1024 * 1024)
+#endif
+
+struct imgcache_key {
+	uint64_t hash;
+	off_t size;
+	time_t mtime;
+	unsigned w, h;
+	uint8_t txu, txv, scale, imageproc, filtermode;
+};
+
+struct imgcache_entry {
+	char* path;
+	struct imgcache_key key;
+	size_t origw, origh, bytes;
+	struct agp_vstore* store;
+	struct imgcache_entry* prev, (* next);
+};
+
+static struct {
+	struct imgcache_entry* first, (* last);
+	size_t bytes, limit;
+	bool configured;
+	struct arcan_imgcache_stats stats;
+} imgcache;
+
+static bool imgcache_enabled()
+{
+	if (!imgcache.configured){
+		const char* env = getenv("ARCAN_IMAGE_CACHE");
+		imgcache.limit = env ? strtoul(env, NULL, 10) : IMAGE_CACHE_DEFAULT;
+		imgcache.configured = true;
+	}
+
+/* conservative mode drops the raw buffers after upload, which is what
+ * private copies and context restores would be made from */
+	return imgcache.limit > 0 && !arcan_video_display.conservative;
+}
+
+static bool imgcache_buildkey(const char* fname,
+	struct agp_vstore* defaults, img_cons cons, struct imgcache_key* key)
+{
+	data_source inres = arcan_open_resource(fname);
+	if (inres.fd == BADFD)
+		return false;
+
+	struct stat buf;
+	bool rv = fstat(inres.fd, &buf) == 0 && S_ISREG(buf.st_mode);
+	arcan_release_resource(&inres);
+	if (!rv)
+		return false;
+
+	uint64_t hash = 14695981039346656037ULL;
+	for (const char* c = fname; *c; c++)
+		hash = (hash ^ (uint8_t)*c) * 1099511628211ULL;
+
+	*key = (struct imgcache_key){
+		.hash = hash,
+		.size = buf.st_size,
+		.mtime = buf.st_mtime,
+		.w = cons.w,
+		.h = cons.h,
+		.txu = defaults->txu,
+		.txv = defaults->txv,
+		.scale = defaults->scale,
+		.imageproc = defaults->imageproc,
+		.filtermode = defaults->filtermode
+	};
+
+	return true;
+}
+
+static void imgcache_unlink(struct imgcache_entry* ent)
+{
+	if (ent->prev)
+		ent->prev->next = ent->next;
+	else
+		imgcache.first = ent->next;
+
+	if (ent->next)
+		ent->next->prev = ent->prev;
+	else
+		imgcache.last = ent->prev;
+
+	ent->prev = ent->next = NULL;
+}
+
+static void imgcache_drop(struct imgcache_entry* ent)
+{
+	imgcache_unlink(ent);
+	imgcache.bytes -= ent->bytes;
+	imgcache.stats.entries--;
+
+/* a store that had its texture dropped on a context push is not freed
+ * fully by drop_vstore, so take care of the rest when we are the last */
+	if (ent->store->refcount == 1 && !ent->store->vinf.text.glid){
+		arcan_mem_free(ent->store->vinf.text.raw);
+		arcan_mem_free(ent->store->vinf.text.source);
+		ent->store->vinf.text.raw = NULL;
+		ent->store->vinf.text.source = NULL;
+	}
+
+	arcan_vint_drop_vstore(ent->store);
+	arcan_mem_free(ent->path);
+	arcan_mem_free(ent);
+}
+
+static bool imgcache_match(struct imgcache_key* a, struct imgcache_key* b)
+{
+	return a->w == b->w && a->h == b->h &&
+		a->txu == b->txu && a->txv == b->txv && a->scale == b->scale &&
+		a->imageproc == b->imageproc && a->filtermode == b->filtermode;
+}
+
+static struct imgcache_entry* imgcache_find(
+	const char* fname, struct imgcache_key* key)
+{
+	struct imgcache_entry* next;
+
+	for (struct imgcache_entry* ent = imgcache.first; ent; ent = next){
+		next = ent->next;
+		if (ent->key.hash != key->hash || strcmp(ent->path, fname) != 0)
+			continue;
+
+/* same resource but changed since, no point in keeping that around */
+		if (ent->key.size != key->size || ent->key.mtime != key->mtime){
+			imgcache_drop(ent);
+			imgcache.stats.evictions++;
+			continue;
+		}
+
+		if (imgcache_match(&ent->key, key))
+			return ent;
+	}
+
+	return NULL;
+}
+
+static struct imgcache_entry* imgcache_bystore(struct agp_vstore* store)
+{
+	for (struct imgcache_entry* ent = imgcache.first; ent; ent = ent->next)
+		if (ent->store == store)
+			return ent;
+
+	return NULL;
+}
+
+/*
+ * Try to satisfy a load for [dst] from the cache, swapping in the shared
+ * store. [key] is filled in either way so that a miss can be inserted after
+ * decoding.
+ */
+static bool imgcache_lookup(const char* fname,
+	arcan_vobject* dst, img_cons cons, struct imgcache_key* key, bool* keyed)
+{
+	*keyed = false;
+	if (!imgcache_enabled() ||
+		!imgcache_buildkey(fname, dst->vstore, cons, key))
+		return false;
+
+	*keyed = true;
+	struct imgcache_entry* ent = imgcache_find(fname, key);
+	if (!ent){
+		imgcache.stats.misses++;
+		return false;
+	}
+
+	imgcache.stats.hits++;
+	if (ent != imgcache.first){
+		imgcache_unlink(ent);
+		ent->next = imgcache.first;
+		imgcache.first->prev = ent;
+		imgcache.first = ent;
+	}
+
+/* the texture was released on a context push, but the pixels are still
+ * here so that is a cheaper way back than decoding */
+	if (!ent->store->vinf.text.glid)
+		agp_update_vstore(ent->store, true);
+
+	arcan_vint_drop_vstore(dst->vstore);
+	dst->vstore = ent->store;
+	dst->vstore->refcount++;
+	dst->origw = ent->origw;
+	dst->origh = ent->origh;
+	dst->feed.state.tag = ARCAN_TAG_IMAGE;
+
+	return true;
+}
+
+static void imgcache_insert(const char* fname,
+	arcan_vobject* src, struct imgcache_key* key)
+{
+	struct agp_vstore* store = src->vstore;
+	if (store->txmapped != TXSTATE_TEX2D || !store->vinf.text.raw ||
+		!store->vinf.text.glid || store->vinf.text.s_raw > imgcache.limit)
+		return;
+
+	struct imgcache_entry* ent = arcan_alloc_mem(
+		sizeof(struct imgcache_entry), ARCAN_MEM_VSTRUCT,
+		ARCAN_MEM_BZERO | ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL);
+	if (!ent)
+		return;
+
+	ent->path = strdup(fname);
+	if (!ent->path){
+		arcan_mem_free(ent);
+		return;
+	}
+
+	ent->key = *key;
+	ent->origw = src->origw;
+	ent->origh = src->origh;
+	ent->store = store;
+	ent->bytes = store->vinf.text.s_raw;
+	store->refcount++;
+
+	ent->next = imgcache.first;
+	if (imgcache.first)
+		imgcache.first->prev = ent;
+	else
+		imgcache.last = ent;
+	imgcache.first = ent;
+
+	imgcache.bytes += ent->bytes;
+	imgcache.stats.entries++;
+
+	while (imgcache.bytes > imgcache.limit && imgcache.last != ent){
+		imgcache_drop(imgcache.last);
+		imgcache.stats.evictions++;
+	}
+}
+
+static void imgcache_flush()
+{
+	while (imgcache.first)
+		imgcache_drop(imgcache.first);
+	imgcache.bytes = 0;
+}
+
+void arcan_vint_privatestore(arcan_vobject* vobj)
+{
+	if (!imgcache.first || !vobj->vstore)
+		return;
+
+	struct imgcache_entry* ent = imgcache_bystore(vobj->vstore);
+	if (!ent)
+		return;
+
+/* only the cache and us, just stop tracking it */
+	struct agp_vstore* src = vobj->vstore;
+	if (src->refcount <= 2){
+		imgcache_drop(ent);
+		return;
+	}
+
+	struct agp_vstore* dst;
+	populate_vstore(&dst);
+	av_pixel* raw = arcan_alloc_fillmem(src->vinf.text.raw,
+		src->vinf.text.s_raw, ARCAN_MEM_VBUFFER,
+		ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE);
+
+/* can't copy, so drop it from the cache and let the change be shared */
+	if (!raw){
+		arcan_mem_free(dst);
+		imgcache_drop(ent);
+		return;
+	}
+
+	dst->txu = src->txu;
+	dst->txv = src->txv;
+	dst->scale = src->scale;
+	dst->imageproc = src->imageproc;
+	dst->filtermode = src->filtermode;
+	dst->w = src->w;
+	dst->h = src->h;
+	dst->vinf.text.raw = raw;
+	dst->vinf.text.s_raw = src->vinf.text.s_raw;
+	dst->vinf.text.source = src->vinf.text.source ?
+		strdup(src->vinf.text.source) : NULL;
+	agp_update_vstore(dst, true);
+
+	arcan_vint_drop_vstore(src);
+	vobj->vstore = dst;
+	FLAG_DIRTY(vobj);
+}
+
+void arcan_vint_imgcachestats(struct arcan_imgcache_stats* out)
+{
+	*out = imgcache.stats;
+	out->bytes = imgcache.bytes;
+	out->limit = imgcache_enabled() ? imgcache.limit : 0;
+}
+
 arcan_errc arcan_video_3dorder(enum arcan_order3d order, arcan_vobj_id rt)
 {
 	if (rt != ARCAN_EID){
@@ -1876,6 +2273,8 @@ arcan_errc arcan_video_shareglstore(arcan_vobj_id sid, arcan_vobj_id did)
 	if (!src || !dst || src == dst)
 		return ARCAN_ERRC_NO_SUCH_OBJECT;
 
+	text_materialize(src);
+
 	if (src->vstore->txmapped == TXSTATE_OFF ||
 		src->vstore->vinf.text.glid == 0 ||
 		FL_TEST(src, FL_PRSIST) ||
@@ -2029,7 +2428,7 @@ arcan_errc arcan_video_rendertargetdensity(
 		cent = cent->next;
 	}
 
-	FLAG_DIRTY(rtgt);
+	FLAG_DIRTY(NULL);
 	return ARCAN_OK;
 }
 
@@ -2247,6 +2646,7 @@ arcan_errc arcan_video_setuprendertarget(arcan_vobj_id did,
 	if (current_context->n_rtargets >= RENDERTARGET_LIMIT)
 		return ARCAN_ERRC_OUT_OF_SPACE;
 
+	arcan_vint_privatestore(vobj);
 	int ind = current_context->n_rtargets++;
 	struct rendertarget* dst = &current_context->rtargets[ ind ];
 	*dst = (struct rendertarget){};
@@ -2317,6 +2717,8 @@ arcan_errc arcan_video_setasframe(arcan_vobj_id dst,
 	if (!dstvobj || !srcvobj)
 		return ARCAN_ERRC_NO_SUCH_OBJECT;
 
+	text_materialize(srcvobj);
+
 	if (dstvobj->frameset == NULL || srcvobj->vstore->txmapped != TXSTATE_TEX2D)
 		return ARCAN_ERRC_UNACCEPTED_STATE;
 
@@ -2341,107 +2743,410 @@ arcan_errc arcan_video_setasframe(arcan_vobj_id dst,
 	return ARCAN_OK;
 }
 
+/*
+ * Asynchronous image loads are queued to a fixed set of decode workers
+ * rather than getting a thread each. The queue is a binary heap ordered on
+ * priority, then on submission order. Loads for objects that show up in a
+ * draw list get promoted so that what is on screen decodes first, and loads
+ * for objects that get deleted while still queued are just dropped.
+ */
+enum loader_state {
+	LOADER_QUEUED = 0,
+	LOADER_RUNNING,
+	LOADER_DONE
+};
+
+enum loader_prio {
+	LOADER_PRIO_NORMAL = 0,
+	LOADER_PRIO_VISIBLE = 1
+};
+
 struct thread_loader_args {
 	arcan_vobject* dst;
-	pthread_t self;
 	arcan_vobj_id dstid;
 	char* fname;
 	intptr_t tag;
 	img_cons constraints;
 	arcan_errc rc;
+
+	struct imgcache_key key;
+	bool keyed;
+
+/* protected by the pool lock */
+	enum loader_state state;
+	enum loader_prio prio;
+	uint64_t seq;
+	size_t heap_ind;
 };
 
-static void* thread_loader(void* in)
-{
-	struct thread_loader_args* largs = (struct thread_loader_args*) in;
-	arcan_vobject* dst = largs->dst;
-	largs->rc = arcan_vint_getimage(largs->fname, dst, largs->constraints, true);
-	dst->feed.state.tag = ARCAN_TAG_ASYNCIMGRD;
-	return 0;
-}
+#ifndef ASYNCH_WORKERS
+#define ASYNCH_WORKERS 4
+#endif
 
-void arcan_vint_joinasynch(arcan_vobject* img, bool emit, bool force)
-{
-	if (!force && img->feed.state.tag != ARCAN_TAG_ASYNCIMGRD){
-		return;
-	}
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_cond_t done;
 
-	struct thread_loader_args* args =
-		(struct thread_loader_args*) img->feed.state.ptr;
+	pthread_t workers[ASYNCH_CONCURRENT_THREADS];
+	size_t n_workers;
+	bool alive;
 
-	pthread_join(args->self, NULL);
+	struct thread_loader_args** heap;
+	size_t count, limit;
+	uint64_t seq;
 
-	arcan_event loadev = {
-		.category = EVENT_VIDEO,
-		.vid.data = args->tag,
-		.vid.source = args->dstid
-	};
+	struct arcan_asynch_stats stats;
+} loader = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.wake = PTHREAD_COND_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER
+};
 
-	if (args->rc == ARCAN_OK){
-		loadev.vid.kind = EVENT_VIDEO_ASYNCHIMAGE_LOADED;
-		loadev.vid.width = img->origw;
-		loadev.vid.height = img->origh;
-	}
-/* copy broken placeholder instead */
-	else {
-		img->origw = 32;
-		img->origh = 32;
-		img->vstore->vinf.text.s_raw = 32 * 32 * sizeof(av_pixel);
-		img->vstore->vinf.text.raw = arcan_alloc_mem(img->vstore->vinf.text.s_raw,
-			ARCAN_MEM_VBUFFER, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_PAGE);
+static bool loader_before(struct thread_loader_args* a,
+	struct thread_loader_args* b)
+{
+	return a->prio != b->prio ? a->prio > b->prio : a->seq < b->seq;
+}
 
-		img->vstore->w = 32;
-		img->vstore->h = 32;
-		img->vstore->vinf.text.source = strdup(args->fname);
-		img->vstore->filtermode = ARCAN_VFILTER_NONE;
+static void loader_swap(size_t a, size_t b)
+{
+	struct thread_loader_args* tmp = loader.heap[a];
+	loader.heap[a] = loader.heap[b];
+	loader.heap[b] = tmp;
+	loader.heap[a]->heap_ind = a;
+	loader.heap[b]->heap_ind = b;
+}
 
-		loadev.vid.width = 32;
-		loadev.vid.height = 32;
-		loadev.vid.kind = EVENT_VIDEO_ASYNCHIMAGE_FAILED;
+static void loader_up(size_t i)
+{
+	while (i > 0 && loader_before(loader.heap[i], loader.heap[(i - 1) / 2])){
+		loader_swap(i, (i - 1) / 2);
+		i = (i - 1) / 2;
 	}
+}
 
-	agp_update_vstore(img->vstore, true);
+static void loader_down(size_t i)
+{
+	for(;;){
+		size_t best = i, l = i * 2 + 1, r = i * 2 + 2;
+		if (l < loader.count && loader_before(loader.heap[l], loader.heap[best]))
+			best = l;
+		if (r < loader.count && loader_before(loader.heap[r], loader.heap[best]))
+			best = r;
+		if (best == i)
+			return;
+		loader_swap(i, best);
+		i = best;
+	}
+}
 
-	if (emit)
-		arcan_event_enqueue(arcan_event_defaultctx(), &loadev);
+/* lock held, remove a queued job from wherever it is in the heap */
+static void loader_remove(struct thread_loader_args* args)
+{
+	size_t i = args->heap_ind;
+	loader.count--;
 
-	arcan_mem_free(args->fname);
-	arcan_mem_free(args);
-	img->feed.state.ptr = NULL;
-	img->feed.state.tag = ARCAN_TAG_IMAGE;
+	if (i != loader.count){
+		loader.heap[i] = loader.heap[loader.count];
+		loader.heap[i]->heap_ind = i;
+		loader_down(i);
+		loader_up(i);
+	}
 }
 
-static arcan_vobj_id loadimage_asynch(const char* fname,
-	img_cons constraints, intptr_t tag)
+static void* loader_worker(void* tag)
 {
-	arcan_vobj_id rv = ARCAN_EID;
-	arcan_vobject* dstobj = arcan_video_newvobject(&rv);
-	if (!dstobj)
-		return rv;
+	pthread_mutex_lock(&loader.lock);
 
-	struct thread_loader_args* args = arcan_alloc_mem(
-		sizeof(struct thread_loader_args),
-		ARCAN_MEM_THREADCTX, 0, ARCAN_MEMALIGN_NATURAL);
+	while (loader.alive){
+		if (!loader.count){
+			pthread_cond_wait(&loader.wake, &loader.lock);
+			continue;
+		}
 
-	args->dstid = rv;
-	args->dst = dstobj;
-	args->fname = strdup(fname);
-	args->tag = tag;
-	args->constraints = constraints;
+		struct thread_loader_args* args = loader.heap[0];
+		loader_remove(args);
+		args->state = LOADER_RUNNING;
+		loader.stats.running++;
+		pthread_mutex_unlock(&loader.lock);
 
-	dstobj->feed.state.tag = ARCAN_TAG_ASYNCIMGLD;
-	dstobj->feed.state.ptr = args;
+		unsigned long long start = arcan_timemillis();
+		args->rc = arcan_vint_getimage(args->fname, args->dst,
+			args->constraints, true);
+		unsigned long long elapsed = arcan_timemillis() - start;
 
-	pthread_create(&args->self, NULL, thread_loader, (void*) args);
+		pthread_mutex_lock(&loader.lock);
+		loader.stats.running--;
+		loader.stats.completed++;
+		loader.stats.decode_ms += elapsed;
+		if (elapsed > loader.stats.decode_max_ms)
+			loader.stats.decode_max_ms = elapsed;
 
-	return rv;
+/* the main thread owns args again as soon as this is visible */
+		args->dst->feed.state.tag = ARCAN_TAG_ASYNCIMGRD;
+		args->state = LOADER_DONE;
+		pthread_cond_broadcast(&loader.done);
+	}
+
+	pthread_mutex_unlock(&loader.lock);
+	return NULL;
 }
 
-arcan_errc arcan_video_pushasynch(arcan_vobj_id source)
+/* lock held, lazily (re-) spawn the workers */
+static bool loader_start()
 {
-	arcan_vobject* vobj = arcan_video_getobject(source);
+	if (loader.alive)
+		return true;
 
-	if (!vobj)
+	size_t n = ASYNCH_WORKERS;
+	const char* env = getenv("ARCAN_IMAGE_WORKERS");
+	if (env){
+		n = strtoul(env, NULL, 10);
+		n = CLAMP(n, 1, ASYNCH_CONCURRENT_THREADS);
+	}
+
+	loader.alive = true;
+	for (loader.n_workers = 0; loader.n_workers < n; loader.n_workers++){
+		if (0 != pthread_create(
+			&loader.workers[loader.n_workers], NULL, loader_worker, NULL))
+			break;
+	}
+
+	loader.stats.workers = loader.n_workers;
+	if (!loader.n_workers){
+		loader.alive = false;
+		return false;
+	}
+
+	return true;
+}
+
+static void loader_stop()
+{
+	pthread_mutex_lock(&loader.lock);
+	if (!loader.alive){
+		pthread_mutex_unlock(&loader.lock);
+		return;
+	}
+
+	loader.alive = false;
+	pthread_cond_broadcast(&loader.wake);
+	pthread_mutex_unlock(&loader.lock);
+
+	for (size_t i = 0; i < loader.n_workers; i++)
+		pthread_join(loader.workers[i], NULL);
+
+	loader.n_workers = 0;
+	loader.stats.workers = 0;
+}
+
+/*
+ * Wait for a job to finish. One that hasn't been picked up yet is taken
+ * off the queue and decoded right here instead.
+ */
+static void loader_wait(struct thread_loader_args* args)
+{
+	pthread_mutex_lock(&loader.lock);
+
+	if (args->state == LOADER_QUEUED){
+		loader_remove(args);
+		args->state = LOADER_RUNNING;
+		pthread_mutex_unlock(&loader.lock);
+
+		args->rc = arcan_vint_getimage(args->fname, args->dst,
+			args->constraints, true);
+
+		pthread_mutex_lock(&loader.lock);
+		args->state = LOADER_DONE;
+		loader.stats.completed++;
+	}
+
+	while (args->state != LOADER_DONE)
+		pthread_cond_wait(&loader.done, &loader.lock);
+
+	loader.stats.queued = loader.count;
+	pthread_mutex_unlock(&loader.lock);
+}
+
+void arcan_vint_asynchstats(struct arcan_asynch_stats* out)
+{
+	pthread_mutex_lock(&loader.lock);
+	loader.stats.queued = loader.count;
+	*out = loader.stats;
+	pthread_mutex_unlock(&loader.lock);
+}
+
+/* the object is (about to be) visible, move its load ahead in the queue */
+static void loader_promote(arcan_vobject* vobj)
+{
+	struct thread_loader_args* args = vobj->feed.state.ptr;
+	if (!args || args->prio == LOADER_PRIO_VISIBLE)
+		return;
+
+	pthread_mutex_lock(&loader.lock);
+	if (args->state == LOADER_QUEUED){
+		args->prio = LOADER_PRIO_VISIBLE;
+		loader_up(args->heap_ind);
+	}
+	pthread_mutex_unlock(&loader.lock);
+}
+
+/*
+ * Drop a load for an object that is being deleted, if a worker has already
+ * started on it, it has to finish as it writes into the object.
+ */
+static void loader_cancel(arcan_vobject* vobj)
+{
+	struct thread_loader_args* args = vobj->feed.state.ptr;
+
+	pthread_mutex_lock(&loader.lock);
+	if (args->state != LOADER_QUEUED){
+		pthread_mutex_unlock(&loader.lock);
+		arcan_vint_joinasynch(vobj, false, true);
+		return;
+	}
+
+	loader_remove(args);
+	loader.stats.cancelled++;
+	pthread_mutex_unlock(&loader.lock);
+
+	arcan_mem_free(args->fname);
+	arcan_mem_free(args);
+	vobj->feed.state.ptr = NULL;
+	vobj->feed.state.tag = ARCAN_TAG_IMAGE;
+}
+
+void arcan_vint_joinasynch(arcan_vobject* img, bool emit, bool force)
+{
+	if (!force && img->feed.state.tag != ARCAN_TAG_ASYNCIMGRD){
+		return;
+	}
+
+	struct thread_loader_args* args =
+		(struct thread_loader_args*) img->feed.state.ptr;
+
+	loader_wait(args);
+
+	arcan_event loadev = {
+		.category = EVENT_VIDEO,
+		.vid.data = args->tag,
+		.vid.source = args->dstid
+	};
+
+	if (args->rc == ARCAN_OK){
+		loadev.vid.kind = EVENT_VIDEO_ASYNCHIMAGE_LOADED;
+		loadev.vid.width = img->origw;
+		loadev.vid.height = img->origh;
+	}
+/* copy broken placeholder instead */
+	else {
+		img->origw = 32;
+		img->origh = 32;
+		img->vstore->vinf.text.s_raw = 32 * 32 * sizeof(av_pixel);
+		img->vstore->vinf.text.raw = arcan_alloc_mem(img->vstore->vinf.text.s_raw,
+			ARCAN_MEM_VBUFFER, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_PAGE);
+
+		img->vstore->w = 32;
+		img->vstore->h = 32;
+		img->vstore->vinf.text.source = strdup(args->fname);
+		img->vstore->filtermode = ARCAN_VFILTER_NONE;
+
+		loadev.vid.width = 32;
+		loadev.vid.height = 32;
+		loadev.vid.kind = EVENT_VIDEO_ASYNCHIMAGE_FAILED;
+	}
+
+	agp_update_vstore(img->vstore, true);
+
+	if (args->rc == ARCAN_OK && args->keyed)
+		imgcache_insert(args->fname, img, &args->key);
+
+	if (emit)
+		arcan_event_enqueue(arcan_event_defaultctx(), &loadev);
+
+	arcan_mem_free(args->fname);
+	arcan_mem_free(args);
+	img->feed.state.ptr = NULL;
+	img->feed.state.tag = ARCAN_TAG_IMAGE;
+}
+
+static arcan_vobj_id loadimage_asynch(const char* fname,
+	img_cons constraints, intptr_t tag)
+{
+	arcan_vobj_id rv = ARCAN_EID;
+	arcan_vobject* dstobj = arcan_video_newvobject(&rv);
+	if (!dstobj)
+		return rv;
+
+/* already decoded, skip the queue but keep the event for the caller */
+	struct imgcache_key key;
+	bool keyed;
+	if (imgcache_lookup(fname, dstobj, constraints, &key, &keyed)){
+		arcan_event loadev = {
+			.category = EVENT_VIDEO,
+			.vid.kind = EVENT_VIDEO_ASYNCHIMAGE_LOADED,
+			.vid.data = tag,
+			.vid.source = rv,
+			.vid.width = dstobj->origw,
+			.vid.height = dstobj->origh
+		};
+		arcan_event_enqueue(arcan_event_defaultctx(), &loadev);
+		return rv;
+	}
+
+	struct thread_loader_args* args = arcan_alloc_mem(
+		sizeof(struct thread_loader_args),
+		ARCAN_MEM_THREADCTX, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+
+	args->dstid = rv;
+	args->dst = dstobj;
+	args->fname = strdup(fname);
+	args->tag = tag;
+	args->constraints = constraints;
+	args->key = key;
+	args->keyed = keyed;
+
+	dstobj->feed.state.tag = ARCAN_TAG_ASYNCIMGLD;
+	dstobj->feed.state.ptr = args;
+
+	pthread_mutex_lock(&loader.lock);
+	if (loader.count == loader.limit){
+		size_t nlim = loader.limit ? loader.limit * 2 : 64;
+		struct thread_loader_args** nheap = arcan_alloc_mem(
+			sizeof(struct thread_loader_args*) * nlim,
+			ARCAN_MEM_VSTRUCT, 0, ARCAN_MEMALIGN_NATURAL);
+
+		if (loader.heap){
+			memcpy(nheap, loader.heap,
+				sizeof(struct thread_loader_args*) * loader.count);
+			arcan_mem_free(loader.heap);
+		}
+		loader.heap = nheap;
+		loader.limit = nlim;
+	}
+
+	args->seq = loader.seq++;
+	args->heap_ind = loader.count;
+	loader.heap[loader.count++] = args;
+	loader_up(args->heap_ind);
+
+	if (loader.count > loader.stats.peak)
+		loader.stats.peak = loader.count;
+
+/* without workers the job stays queued and gets decoded on join */
+	if (loader_start())
+		pthread_cond_signal(&loader.wake);
+	pthread_mutex_unlock(&loader.lock);
+
+	return rv;
+}
+
+arcan_errc arcan_video_pushasynch(arcan_vobj_id source)
+{
+	arcan_vobject* vobj = arcan_video_getobject(source);
+
+	if (!vobj)
 		return ARCAN_ERRC_NO_SUCH_OBJECT;
 
 	if (vobj->feed.state.tag == ARCAN_TAG_ASYNCIMGLD ||
@@ -2464,10 +3169,20 @@ static arcan_vobj_id loadimage(const char* fname, img_cons constraints,
 	if (newvobj == NULL)
 		return ARCAN_EID;
 
+	struct imgcache_key key;
+	bool keyed;
+	if (imgcache_lookup(fname, newvobj, constraints, &key, &keyed)){
+		if (errcode != NULL)
+			*errcode = ARCAN_OK;
+		return rv;
+	}
+
 	arcan_errc rc = arcan_vint_getimage(fname, newvobj, constraints, false);
 
 	if (rc != ARCAN_OK)
 		arcan_video_deleteobject(rv);
+	else if (keyed)
+		imgcache_insert(fname, newvobj, &key);
 
 	if (errcode != NULL)
 		*errcode = rc;
@@ -2578,9 +3293,12 @@ arcan_errc arcan_video_resizefeed(arcan_vobj_id id, size_t w, size_t h)
 	vobj->current.scale.x = sfx;
 	vobj->current.scale.y = sfy;
 	invalidate_cache(vobj);
+
+/* the store might be shared through the image cache */
+	arcan_vint_privatestore(vobj);
 	agp_resize_vstore(vobj->vstore, w, h);
 
-	FLAG_DIRTY();
+	FLAG_DIRTY(vobj);
 	return ARCAN_OK;
 }
 
@@ -2913,6 +3631,7 @@ arcan_errc arcan_video_objecttexmode(arcan_vobj_id id,
 	arcan_errc rv = ARCAN_ERRC_NO_SUCH_OBJECT;
 
 	if (src){
+		arcan_vint_privatestore(src);
 		src->vstore->txu = modes;
 		src->vstore->txv = modet;
 		agp_update_vstore(src->vstore, false);
@@ -2930,6 +3649,7 @@ arcan_errc arcan_video_objectfilter(arcan_vobj_id id,
 
 /* fake an upload with disabled filteroptions */
 	if (src){
+		arcan_vint_privatestore(src);
 		src->vstore->filtermode = mode;
 		agp_update_vstore(src->vstore, false);
 	}
@@ -3024,6 +3744,8 @@ arcan_errc arcan_video_transfertransform(arcan_vobj_id sid, arcan_vobj_id did)
 }
 
 /* remove a video object that is also a rendertarget (FBO) output */
+static void drop_draw_list(size_t ind);
+
 static void drop_rtarget(arcan_vobject* vobj)
 {
 /* check if vobj is indeed a rendertarget */
@@ -3102,6 +3824,11 @@ static void drop_rtarget(arcan_vobject* vobj)
 		arcan_mem_free(last);
 	}
 
+	damage_drop(dst);
+
+/* and the draw lists and dependencies that refer to them by index */
+	drop_draw_list(dstind);
+
 /* compact the context array of rendertargets */
 	if (dstind+1 < RENDERTARGET_LIMIT)
 		memmove(&current_context->rtargets[dstind],
@@ -3236,6 +3963,7 @@ arcan_errc arcan_video_deleteobject(arcan_vobj_id id)
 /* time to drop all associated resources */
 	arcan_video_zaptransform(id, NULL);
 	arcan_mem_free(vobj->txcos);
+	arcan_renderfun_glyphfree(&vobj->glyphs);
 
 /* full- object specific clean-up */
 	if (vobj->feed.ffunc){
@@ -3246,8 +3974,9 @@ arcan_errc arcan_video_deleteobject(arcan_vobj_id id)
 		vobj->feed.state.tag = ARCAN_TAG_NONE;
 	}
 
-	if (vobj->feed.state.tag == ARCAN_TAG_ASYNCIMGLD)
-		arcan_video_pushasynch(id);
+	if (vobj->feed.state.tag == ARCAN_TAG_ASYNCIMGLD ||
+		vobj->feed.state.tag == ARCAN_TAG_ASYNCIMGRD)
+		loader_cancel(vobj);
 
 /* video storage, will take care of refcounting in case of shared storage */
 	arcan_vint_drop_vstore(vobj->vstore);
@@ -4262,6 +4991,8 @@ arcan_errc arcan_video_persistobject(arcan_vobj_id id)
 	if (!vobj)
 		return ARCAN_ERRC_NO_SUCH_OBJECT;
 
+	arcan_vint_privatestore(vobj);
+
 	if (!vobj->frameset &&
 		vobj->vstore->refcount == 1 &&
 		vobj->parent == &current_context->world){
@@ -4361,8 +5092,26 @@ static void apply(arcan_vobject* vobj, surface_properties* dprops,
  * which is then re-used every rendercall.
  * Queueing a transformation immediately invalidates the cache.
  */
-void arcan_resolve_vidprop(arcan_vobject* vobj, float lerp,
-	surface_properties* props)
+static void commit_vidprop_cache(arcan_vobject* vobj, surface_properties* props)
+{
+	surface_properties dprop = *props;
+	vobj->prop_cache  = *props;
+	vobj->valid_cache = true;
+	build_modelview(vobj->prop_matr, vobj->owner->base, &dprop, vobj);
+}
+
+struct draw_list;
+static void defer_commit(struct draw_list* dl,
+	arcan_vobject* vobj, surface_properties* props);
+
+/*
+ * With [defer] set, objects (the parents included) that should have their
+ * properties cached are added to that list rather than modified, which makes
+ * this safe to call from several threads at once. The list is committed from
+ * the main thread when it is submitted.
+ */
+static void resolve_vidprop(arcan_vobject* vobj, float lerp,
+	surface_properties* props, struct draw_list* defer)
 {
 	if (vobj->valid_cache)
 		*props = vobj->prop_cache;
@@ -4370,7 +5119,7 @@ void arcan_resolve_vidprop(arcan_vobject* vobj, float lerp,
 /* first recurse to parents */
 	else if (vobj->parent && vobj->parent != &current_context->world){
 		surface_properties dprop = empty_surface();
-		arcan_resolve_vidprop(vobj->parent, lerp, &dprop);
+		resolve_vidprop(vobj->parent, lerp, &dprop, defer);
 		apply(vobj, props, &dprop, lerp, false);
 		switch(vobj->p_anchor){
 		case ANCHORP_UR:
@@ -4422,13 +5171,17 @@ void arcan_resolve_vidprop(arcan_vobject* vobj, float lerp,
 	}
 
 	if (can_cache && vobj->owner && vobj->valid_cache == false){
-		surface_properties dprop = *props;
-		vobj->prop_cache  = *props;
-		vobj->valid_cache = true;
-		build_modelview(vobj->prop_matr, vobj->owner->base, &dprop, vobj);
+		if (defer)
+			defer_commit(defer, vobj, props);
+		else
+			commit_vidprop_cache(vobj, props);
 	}
-	else
-		;
+}
+
+void arcan_resolve_vidprop(arcan_vobject* vobj, float lerp,
+	surface_properties* props)
+{
+	resolve_vidprop(vobj, lerp, props, NULL);
 }
 
 static void calc_cp_area(arcan_vobject* vobj, point* ul, point* lr)
@@ -4870,104 +5623,1127 @@ static inline bool setup_shallow_texclip(arcan_vobject* elem,
 	return true;
 }
 
-_Thread_local static struct rendertarget* current_rendertarget;
-struct rendertarget* arcan_vint_current_rt()
+/*
+ * Consecutive objects that share vstore, blend state and opacity and use the
+ * default shader are gathered here and transformed on the CPU side, so that
+ * they can be submitted as one draw call rather than one per object. Shapes,
+ * framesets, stencil clipping and custom shaders always take the normal path
+ * as they need per-object uniforms or state.
+ */
+#define BATCH_QUADS 256
+static struct {
+	float _Alignas(16) vtx[BATCH_QUADS * 6 * 4];
+	size_t count;
+	struct agp_vstore* vstore;
+	enum arcan_blendfunc blend;
+	float opa;
+} draw_batch;
+
+static bool batch_candidate(arcan_vobject* elem)
 {
-	return current_rendertarget;
+	return elem->program == 0 && !elem->frameset && !elem->shape &&
+		elem->vstore->txmapped == TXSTATE_TEX2D &&
+		elem->feed.state.tag != ARCAN_TAG_ASYNCIMGLD &&
+		!FL_TEST(elem, FL_FULL3D) &&
+		(elem->clip == ARCAN_CLIP_OFF ||
+		 elem->parent == &current_context->world ||
+		 (elem->clip == ARCAN_CLIP_SHALLOW && !elem->rotate_state));
 }
 
-static size_t process_rendertarget(struct rendertarget* tgt, float fract)
+static void batch_flush(arcan_benchdata* stats)
 {
-	arcan_vobject_litem* current;
-	if (tgt->link){
-		current = tgt->link->first;
-		tgt->dirtyc += tgt->link->dirtyc;
-		tgt->transfc += tgt->link->transfc;
-	}
-	else
-		current = tgt->first;
+	if (!draw_batch.count)
+		return;
 
-	if (arcan_video_display.ignore_dirty == false &&
-		(!tgt->link && tgt->dirtyc == 0 && tgt->transfc == 0))
-		return 0;
+	agp_shader_activate(agp_default_shader(BASIC_2D));
+	agp_activate_vstore(draw_batch.vstore);
+	agp_blendstate(draw_batch.blend);
+	agp_shader_envv(OBJ_OPACITY, &draw_batch.opa, sizeof(float));
+	agp_draw_vobj_batch(draw_batch.vtx, draw_batch.count);
 
-	current_rendertarget = tgt;
-	agp_activate_rendertarget(tgt->art);
-	agp_shader_envv(RTGT_ID, &tgt->id, sizeof(int));
+	stats->acc.draw_calls++;
+	draw_batch.count = 0;
+}
 
-	if (!FL_TEST(tgt, TGTFL_NOCLEAR))
-		agp_rendertarget_clear();
+static void batch_begin(struct agp_vstore* vstore,
+	enum arcan_blendfunc blend, float opa, arcan_benchdata* stats)
+{
+	if (draw_batch.count && (draw_batch.count == BATCH_QUADS ||
+		draw_batch.vstore != vstore || draw_batch.blend != blend ||
+		draw_batch.opa != opa))
+		batch_flush(stats);
 
-	size_t pc = 0;
+	draw_batch.vstore = vstore;
+	draw_batch.blend = blend;
+	draw_batch.opa = opa;
+}
 
-/* first, handle all 3d work (which may require multiple passes etc.) */
-	if (tgt->order3d == ORDER3D_FIRST && current && current->elem->order < 0){
-		current = arcan_3d_refresh(tgt->camtag, current, fract);
-		pc++;
+/* same modelview resolution as setup_surf, minus the shader environment */
+static float* batch_matrix(struct rendertarget* tgt,
+	arcan_vobject* elem, surface_properties* prop)
+{
+	static float _Alignas(16) dmatr[16];
+
+	if (elem->valid_cache && tgt == elem->owner){
+		prop->scale.x *= elem->origw * 0.5f;
+		prop->scale.y *= elem->origh * 0.5f;
+		return elem->prop_matr;
 	}
 
-/* skip a possible 3d pipeline */
-	while (current && current->elem->order < 0)
-		current = current->next;
+	build_modelview(dmatr, tgt->base, prop, elem);
+	return dmatr;
+}
 
-	if (!current)
-		goto end3d;
+/* same corner order as agp_draw_vobj, fan split into two triangles */
+static void batch_quad(const float* m,
+	const float* x, const float* y, const float* txcos)
+{
+	static const int order[6] = {0, 1, 2, 0, 2, 3};
 
-/* make sure we're in a decent state for 2D */
-	agp_pipeline_hint(PIPELINE_2D);
+	float* out = &draw_batch.vtx[draw_batch.count * 6 * 4];
+	for (size_t i = 0; i < 6; i++){
+		int c = order[i];
+		*out++ = m[0] * x[c] + m[4] * y[c] + m[12];
+		*out++ = m[1] * x[c] + m[5] * y[c] + m[13];
+		*out++ = txcos[c * 2 + 0];
+		*out++ = txcos[c * 2 + 1];
+	}
 
-	agp_shader_activate(agp_default_shader(BASIC_2D));
-	agp_shader_envv(PROJECTION_MATR, tgt->projection, sizeof(float)*16);
+	draw_batch.count++;
+}
 
-	while (current && current->elem->order >= 0){
-		arcan_vobject* elem = current->elem;
+static void batch_append(struct rendertarget* tgt, arcan_vobject* elem,
+	surface_properties prop, const float* txcos,
+	enum arcan_blendfunc blend, arcan_benchdata* stats)
+{
+	batch_begin(elem->vstore, blend, prop.opa, stats);
+	float* m = batch_matrix(tgt, elem, &prop);
 
-		if (current->elem->order < tgt->min_order){
-			current = current->next;
-			continue;
-		}
+	float x[4] = {-prop.scale.x, prop.scale.x, prop.scale.x, -prop.scale.x};
+	float y[4] = {-prop.scale.y, -prop.scale.y, prop.scale.y, prop.scale.y};
+	batch_quad(m, x, y, txcos);
+}
 
-		if (current->elem->order > tgt->max_order)
-			break;
+/*
+ * Glyph text is one quad per glyph in object-local pixels, these map onto
+ * the [-scale, scale] range the modelview expects. As every such object
+ * shares the atlas store, consecutive text objects end up in the same batch.
+ */
+static void glyph_quads(const float* m, surface_properties* prop,
+	arcan_vobject* elem, size_t ofs, size_t n)
+{
+	struct text_glyphs* glyphs = elem->glyphs;
+	float sx = elem->origw ? 2.0f * prop->scale.x / (float)elem->origw : 0;
+	float sy = elem->origh ? 2.0f * prop->scale.y / (float)elem->origh : 0;
 
-/* calculate coordinate system translations, world cannot be masked */
-		surface_properties dprops = empty_surface();
-		arcan_resolve_vidprop(elem, fract, &dprops);
+	for (size_t i = ofs; i < ofs + n; i++){
+		const float* q = &glyphs->vtx[i * 8];
+		float x1 = -prop->scale.x + q[0] * sx;
+		float y1 = -prop->scale.y + q[1] * sy;
+		float x2 = -prop->scale.x + q[2] * sx;
+		float y2 = -prop->scale.y + q[3] * sy;
 
-/* don't waste time on objects that aren't supposed to be visible */
-		if ( dprops.opa <= EPSILON || elem == tgt->color){
-			current = current->next;
-			continue;
-		}
+		float x[4] = {x1, x2, x2, x1};
+		float y[4] = {y1, y1, y2, y2};
+		float txcos[8] = {q[4], q[5], q[6], q[5], q[6], q[7], q[4], q[7]};
+		batch_quad(m, x, y, txcos);
+	}
+}
 
-/* enable clipping using stencil buffer, we need to reset the state of the
- * stencil buffer between draw calls so track if it's enabled or not */
-		bool clipped = false;
+static void batch_glyphs(struct rendertarget* tgt, arcan_vobject* elem,
+	surface_properties prop, struct agp_vstore* atlas,
+	enum arcan_blendfunc blend, arcan_benchdata* stats)
+{
+	float* m = batch_matrix(tgt, elem, &prop);
+
+	for (size_t i = 0; i < elem->glyphs->n_quads; i++){
+		batch_begin(atlas, blend, prop.opa, stats);
+		glyph_quads(m, &prop, elem, i, 1);
+	}
+}
 
 /*
- * texture coordinates that will be passed to the draw call, clipping and other
- * effects may maintain a local copy and manipulate these
+ * Refresh the glyphs against the atlas, returns the store to draw from or
+ * NULL if the glyphs couldn't be resolved and the text has been rasterized
+ * into its own store instead.
  */
-		float* txcos = elem->txcos;
-		float** dstcos = &txcos;
+static struct agp_vstore* glyph_prepare(
+	arcan_vobject* elem, arcan_benchdata* stats)
+{
+	uint64_t gen;
+	struct agp_vstore* atlas = arcan_renderfun_glyphatlas(&gen);
+	if (atlas && elem->glyphs->generation == gen)
+		return atlas;
 
-		if ( (elem->mask & MASK_MAPPING) > 0)
-			txcos = elem->parent != &current_context->world ?
-				elem->parent->txcos : elem->txcos;
+/* pending quads would sample from whatever the atlas turns into */
+	batch_flush(stats);
 
-		if (!txcos)
-			txcos = arcan_video_display.default_txcos;
+	if (!arcan_renderfun_glyphrefresh(elem->glyphs)){
+		text_materialize(elem);
+		return NULL;
+	}
 
-/* depending on frameset- mode, we may need to split the frameset up into
- * multitexturing, or switch the txcos with the ones that may be used for
- * clipping, but mapping TU indices to current shader must be done before.
- * To not skip on the early-out-on-clipping and not incur additional state
- * change costs, only do it in this edge case. */
-		bool shader_sw = false;
-		agp_shader_id shid = elem->program > 0 ?
-			elem->program : agp_default_shader(BASIC_2D);
+	return arcan_renderfun_glyphatlas(NULL);
+}
+
+/*
+ * Glyph text that can't be batched (custom shader, stencil clipping) still
+ * goes out as one draw call per BATCH_QUADS glyphs, with the shader, store
+ * and blend state already set up by the caller.
+ */
+static void draw_glyphsurf(struct rendertarget* dst,
+	surface_properties prop, arcan_vobject* src, arcan_benchdata* stats)
+{
+	float* mvm = NULL;
+	setup_surf(dst, &prop, src, &mvm);
+
+	size_t n_quads = src->glyphs->n_quads;
+	for (size_t i = 0; i < n_quads; i += BATCH_QUADS){
+		size_t n = n_quads - i > BATCH_QUADS ? BATCH_QUADS : n_quads - i;
+		glyph_quads(mvm, &prop, src, i, n);
+		agp_draw_vobj_batch(draw_batch.vtx, draw_batch.count);
+		draw_batch.count = 0;
+		stats->acc.draw_calls++;
+	}
+}
+
+_Thread_local static struct rendertarget* current_rendertarget;
+struct rendertarget* arcan_vint_current_rt()
+{
+	return current_rendertarget;
+}
+
+/*
+ * Draw lists are the resolved and culled set of 2D objects for one
+ * rendertarget and frame. Recording them is pure CPU work that does not
+ * modify any vobject, so several rendertargets can be recorded at once on
+ * the conductor workers while submission stays on the thread with the GL
+ * context.
+ */
+struct draw_item {
+	arcan_vobject* elem;
+	surface_properties dprops;
+
+/* what the item covers (rendertarget pixels) and what it looks like */
+	struct arcan_damage_rect box;
+	uint32_t state;
+
+/* what it is certain to cover without anything showing through, or empty */
+	struct arcan_damage_rect inner;
+};
+
+struct draw_commit {
+	arcan_vobject* elem;
+	surface_properties props;
+};
+
+struct draw_list {
+	struct rendertarget* tgt;
+	float fract;
+
+/* the target has a 3d pipeline, or something else that needs a full redraw */
+	bool full;
+	uint32_t view;
+
+	struct draw_item* items;
+	size_t count;
+	size_t limit;
+
+/* objects resolved while recording that can have their properties cached */
+	struct draw_commit* commits;
+	size_t n_commits;
+	size_t commit_limit;
+
+/* other rendertargets (by index, stdout last) sampled by this one */
+	bool deps[RENDERTARGET_LIMIT + 1];
+};
+
+static struct draw_list draw_lists[RENDERTARGET_LIMIT + 1];
+
+static void defer_commit(struct draw_list* dl,
+	arcan_vobject* vobj, surface_properties* props)
+{
+	if (dl->n_commits == dl->commit_limit){
+		size_t nlim = dl->commit_limit ? dl->commit_limit * 2 : 64;
+		struct draw_commit* ncommits = arcan_alloc_mem(
+			sizeof(struct draw_commit) * nlim, ARCAN_MEM_VSTRUCT,
+			ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL
+		);
+
+/* the object just gets resolved again next frame */
+		if (!ncommits)
+			return;
+
+		if (dl->commits){
+			memcpy(ncommits, dl->commits,
+				sizeof(struct draw_commit) * dl->n_commits);
+			arcan_mem_free(dl->commits);
+		}
+		dl->commits = ncommits;
+		dl->commit_limit = nlim;
+	}
+
+	dl->commits[dl->n_commits++] = (struct draw_commit){
+		.elem = vobj,
+		.props = *props
+	};
+}
+
+static size_t rtgt_index(struct rendertarget* tgt)
+{
+	if (tgt == &current_context->stdoutp)
+		return RENDERTARGET_LIMIT;
+	return tgt - current_context->rtargets;
+}
+
+/*
+ * Rendertarget [ind] is being removed and the ones after it moved down a
+ * slot, do the same for the draw lists and the dependency bits so that a list
+ * that isn't recorded again this frame doesn't refer to the wrong target.
+ */
+static void drop_draw_list(size_t ind)
+{
+	struct draw_list dead = draw_lists[ind];
+
+	memmove(&draw_lists[ind], &draw_lists[ind+1],
+		sizeof(struct draw_list) * (RENDERTARGET_LIMIT - 1 - ind));
+
+/* keep the buffers around for reuse */
+	draw_lists[RENDERTARGET_LIMIT - 1] = (struct draw_list){
+		.items = dead.items,
+		.limit = dead.limit,
+		.commits = dead.commits,
+		.commit_limit = dead.commit_limit
+	};
+
+	for (size_t i = 0; i < RENDERTARGET_LIMIT + 1; i++){
+		struct draw_list* dl = &draw_lists[i];
+		if (i >= ind && i < RENDERTARGET_LIMIT - 1 && dl->tgt)
+			dl->tgt = &current_context->rtargets[i];
+
+		memmove(&dl->deps[ind], &dl->deps[ind+1],
+			sizeof(bool) * (RENDERTARGET_LIMIT - 1 - ind));
+		dl->deps[RENDERTARGET_LIMIT - 1] = false;
+	}
+}
+
+/*
+ * Damage tracking works by giving each recorded item a box in rendertarget
+ * pixels and a hash of everything that decides how it looks. Comparing that
+ * against what was drawn the last time gives the regions that need to be
+ * redrawn, with new/changed/moved items adding their boxes and items that
+ * went away adding the box they used to cover.
+ */
+struct damage_item {
+	arcan_vobject* elem;
+	arcan_vobj_id cellid;
+	uint32_t state;
+	struct arcan_damage_rect box;
+};
+
+/* rects this close to each other are merged, saves on scissored passes */
+#define DAMAGE_SLACK 8
+
+static uint32_t damage_hash(uint32_t h, const void* buf, size_t n)
+{
+	const uint8_t* data = buf;
+	for (size_t i = 0; i < n; i++){
+		h ^= data[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static uint32_t damage_hashprops(uint32_t h, const surface_properties* p)
+{
+	float v[10] = {
+		p->position.x, p->position.y, p->position.z,
+		p->scale.x, p->scale.y, p->scale.z, p->opa,
+		p->rotation.roll, p->rotation.pitch, p->rotation.yaw
+	};
+	return damage_hash(h, v, sizeof(v));
+}
+
+static size_t damage_area(const struct arcan_damage_rect* r)
+{
+	return (size_t)(r->x2 - r->x1) * (size_t)(r->y2 - r->y1);
+}
+
+static bool damage_overlap(
+	const struct arcan_damage_rect* a, const struct arcan_damage_rect* b)
+{
+	return a->x1 < b->x2 && b->x1 < a->x2 && a->y1 < b->y2 && b->y1 < a->y2;
+}
+
+static struct arcan_damage_rect damage_union(
+	struct arcan_damage_rect a, struct arcan_damage_rect b)
+{
+	return (struct arcan_damage_rect){
+		.x1 = a.x1 < b.x1 ? a.x1 : b.x1,
+		.y1 = a.y1 < b.y1 ? a.y1 : b.y1,
+		.x2 = a.x2 > b.x2 ? a.x2 : b.x2,
+		.y2 = a.y2 > b.y2 ? a.y2 : b.y2
+	};
+}
+
+static void damage_add(struct arcan_damage* d,
+	struct arcan_damage_rect r, int w, int h)
+{
+	if (d->full)
+		return;
+
+	r.x1 = r.x1 < 0 ? 0 : r.x1;
+	r.y1 = r.y1 < 0 ? 0 : r.y1;
+	r.x2 = r.x2 > w ? w : r.x2;
+	r.y2 = r.y2 > h ? h : r.y2;
+	if (r.x1 >= r.x2 || r.y1 >= r.y2)
+		return;
+
+/* absorb everything the new rect touches, and start over as it grows */
+	for (size_t i = 0; i < d->count;){
+		struct arcan_damage_rect* c = &d->rects[i];
+		if (r.x1 <= c->x2 + DAMAGE_SLACK && c->x1 <= r.x2 + DAMAGE_SLACK &&
+			r.y1 <= c->y2 + DAMAGE_SLACK && c->y1 <= r.y2 + DAMAGE_SLACK){
+			r = damage_union(r, *c);
+			*c = d->rects[--d->count];
+			i = 0;
+		}
+		else
+			i++;
+	}
+
+/* out of slots, fold it into the rect where that grows the area the least,
+ * the result may touch others so it goes through the merge again */
+	if (d->count == DAMAGE_RECTS){
+		size_t best = 0, cost = SIZE_MAX;
+		for (size_t i = 0; i < d->count; i++){
+			struct arcan_damage_rect u = damage_union(r, d->rects[i]);
+			size_t c = damage_area(&u) - damage_area(&d->rects[i]);
+			if (c < cost){
+				cost = c;
+				best = i;
+			}
+		}
+		r = damage_union(r, d->rects[best]);
+		d->rects[best] = d->rects[--d->count];
+		damage_add(d, r, w, h);
+		return;
+	}
+
+	d->rects[d->count++] = r;
+
+/* past half the target, one pass without scissoring is cheaper */
+	size_t sum = 0;
+	for (size_t i = 0; i < d->count; i++)
+		sum += damage_area(&d->rects[i]);
+
+	if (sum * 2 > (size_t)w * (size_t)h){
+		d->full = true;
+		d->count = 0;
+	}
+}
+
+static void damage_merge(struct arcan_damage* dst,
+	const struct arcan_damage* src, int w, int h)
+{
+	if (src->full){
+		dst->full = true;
+		dst->count = 0;
+		return;
+	}
+
+	for (size_t i = 0; i < src->count; i++)
+		damage_add(dst, src->rects[i], w, h);
+}
+
+/*
+ * Project the canvas-space rectangle (x1, y1) - (x2, y2) through [mvp] (the
+ * projection and base of the target) into rendertarget pixels, [ext] gets
+ * min-x, min-y, max-x, max-y.
+ */
+static bool project_extents(const float* mvp,
+	float x1, float y1, float x2, float y2, int w, int h, float ext[4])
+{
+	ext[0] = ext[1] = INFINITY;
+	ext[2] = ext[3] = -INFINITY;
+
+	for (size_t i = 0; i < 4; i++){
+		float vx = i & 1 ? x2 : x1;
+		float vy = i & 2 ? y2 : y1;
+		float cw = mvp[3] * vx + mvp[7] * vy + mvp[15];
+		if (cw <= EPSILON)
+			return false;
+
+		float px = ((mvp[0] * vx + mvp[4] * vy + mvp[12]) / cw * 0.5f + 0.5f) * w;
+		float py = ((mvp[1] * vx + mvp[5] * vy + mvp[13]) / cw * 0.5f + 0.5f) * h;
+		ext[0] = fminf(ext[0], px);
+		ext[1] = fminf(ext[1], py);
+		ext[2] = fmaxf(ext[2], px);
+		ext[3] = fmaxf(ext[3], py);
+	}
+
+	return isfinite(ext[0]) && isfinite(ext[1]) &&
+		isfinite(ext[2]) && isfinite(ext[3]);
+}
+
+static bool rotated(const surface_properties* p)
+{
+	return fabsf(p->rotation.roll) > EPSILON ||
+		fabsf(p->rotation.pitch) > EPSILON || fabsf(p->rotation.yaw) > EPSILON;
+}
+
+/*
+ * The area an object can cover in rendertarget pixels. Rotated objects stay
+ * within the circle around their center, the origo offset is added on top
+ * of that as build_modelview translates by it. Returns false if no sensible
+ * bound can be found (shapes, 3d), then the entire target should be used.
+ */
+static bool damage_box(const float* mvp, arcan_vobject* elem,
+	const surface_properties* p, int w, int h, struct arcan_damage_rect* out)
+{
+	if (elem->shape || FL_TEST(elem, FL_FULL3D))
+		return false;
+
+	float ex = fabsf(p->scale.x * elem->origw * 0.5f);
+	float ey = fabsf(p->scale.y * elem->origh * 0.5f);
+	float cx = p->position.x + p->scale.x * elem->origw * 0.5f;
+	float cy = p->position.y + p->scale.y * elem->origh * 0.5f;
+	float ox = 0, oy = 0;
+
+	if (elem->origo_ofs.x > EPSILON || elem->origo_ofs.y > EPSILON){
+		ox = elem->origo_ofs.x;
+		oy = elem->origo_ofs.y;
+	}
+
+	if (rotated(p))
+		ex = ey = sqrtf(ex * ex + ey * ey) + 2.0f * sqrtf(ox * ox + oy * oy);
+
+	float ext[4];
+	if (!project_extents(mvp, cx - ex + fminf(ox, 0), cy - ey + fminf(oy, 0),
+		cx + ex + fmaxf(ox, 0), cy + ey + fmaxf(oy, 0), w, h, ext))
+		return false;
+
+/* a pixel of slack for filtering and rounding, clamped before converting */
+	out->x1 = floorf(fmaxf(ext[0], -1.0f)) - 1;
+	out->y1 = floorf(fmaxf(ext[1], -1.0f)) - 1;
+	out->x2 = ceilf(fminf(ext[2], w + 1.0f)) + 1;
+	out->y2 = ceilf(fminf(ext[3], h + 1.0f)) + 1;
+	return true;
+}
+
+/*
+ * The pixels an object is certain to overwrite completely: plain unrotated
+ * and unclipped quads that are drawn without blending, or with blending but
+ * at full opacity from a store without alpha. Returns false (and an empty
+ * rect) for anything else. Whether the shader is a default one is left to
+ * the caller as that can't be resolved from the recording threads.
+ */
+static bool occluder_box(const float* mvp, arcan_vobject* elem,
+	const surface_properties* p, int w, int h, struct arcan_damage_rect* out)
+{
+	struct agp_vstore* vs = elem->vstore;
+	*out = (struct arcan_damage_rect){0};
+
+	if (!vs || elem->shape || elem->glyphs || elem->frameset ||
+		FL_TEST(elem, FL_FULL3D) || rotated(p) ||
+		elem->feed.state.tag == ARCAN_TAG_ASYNCIMGLD ||
+		elem->origo_ofs.x > EPSILON || elem->origo_ofs.y > EPSILON ||
+		(elem->clip != ARCAN_CLIP_OFF && elem->parent != &current_context->world))
+		return false;
+
+/* color surfaces without a shader aren't drawn at all */
+	if (!(vs->txmapped == TXSTATE_TEX2D ||
+		(vs->txmapped == TXSTATE_OFF && elem->program != 0)))
+		return false;
+
+/* mirrors the blend state selection when drawing */
+	bool opaque = elem->blendmode == BLEND_NONE ||
+		(p->opa >= 1.0 - EPSILON && elem->blendmode != BLEND_FORCE &&
+		(vs->txmapped == TXSTATE_OFF ||
+		 vs->vinf.text.d_fmt == GL_NOALPHA_PIXEL_FORMAT));
+
+	if (!opaque)
+		return false;
+
+	float ext[4];
+	if (!project_extents(mvp, p->position.x, p->position.y,
+		p->position.x + p->scale.x * elem->origw,
+		p->position.y + p->scale.y * elem->origh, w, h, ext))
+		return false;
+
+/* only pixels that are entirely inside */
+	out->x1 = ceilf(fmaxf(ext[0], 0));
+	out->y1 = ceilf(fmaxf(ext[1], 0));
+	out->x2 = floorf(fminf(ext[2], w));
+	out->y2 = floorf(fminf(ext[3], h));
+
+	if (out->x1 >= out->x2 || out->y1 >= out->y2){
+		*out = (struct arcan_damage_rect){0};
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Everything that affects how an object looks, apart from position and the
+ * shader uniforms. The vstore sequence number covers texture updates, the
+ * object sequence number covers anything else that went through FLAG_DIRTY.
+ */
+static uint32_t damage_state(arcan_vobject* elem,
+	const surface_properties* p, float fract, struct draw_list* defer)
+{
+	uint32_t h = damage_hash(2166136261u, &elem->cellid, sizeof(elem->cellid));
+	h = damage_hash(h, &elem->update_seq, sizeof(elem->update_seq));
+	h = damage_hashprops(h, p);
+
+	uint16_t dim[2] = {elem->origw, elem->origh};
+	h = damage_hash(h, dim, sizeof(dim));
+	h = damage_hash(h, &elem->blendmode, sizeof(elem->blendmode));
+	h = damage_hash(h, &elem->program, sizeof(elem->program));
+	h = damage_hash(h, &elem->clip, sizeof(elem->clip));
+	int tag = elem->feed.state.tag;
+	h = damage_hash(h, &tag, sizeof(tag));
+
+	if (elem->glyphs){
+		h = damage_hash(h, &elem->glyphs, sizeof(elem->glyphs));
+		h = damage_hash(h, &elem->glyphs->n_quads, sizeof(size_t));
+	}
+
+	struct agp_vstore* vs = elem->vstore;
+	if (vs){
+		h = damage_hash(h, &vs, sizeof(vs));
+		h = damage_hash(h, &vs->update_seq, sizeof(vs->update_seq));
+		if (vs->txmapped == TXSTATE_OFF)
+			h = damage_hash(h, &vs->vinf.col, sizeof(vs->vinf.col));
+	}
+
+	if (elem->frameset){
+		struct vobject_frameset* fs = elem->frameset;
+		h = damage_hash(h, &fs->index, sizeof(fs->index));
+
+		for (size_t i = 0; i < fs->n_frames; i++){
+			if (fs->mode != ARCAN_FRAMESET_MULTITEXTURE && i != fs->index)
+				continue;
+
+			struct agp_vstore* fv = fs->frames[i].frame;
+			h = damage_hash(h, &fv, sizeof(fv));
+			h = damage_hash(h, fs->frames[i].txcos, sizeof(float) * 8);
+			if (fv)
+				h = damage_hash(h, &fv->update_seq, sizeof(fv->update_seq));
+		}
+	}
+
+/* same txcos resolution as when drawing */
+	float* txcos = elem->txcos;
+	if ( (elem->mask & MASK_MAPPING) > 0)
+		txcos = elem->parent != &current_context->world ?
+			elem->parent->txcos : elem->txcos;
+	if (txcos)
+		h = damage_hash(h, txcos, sizeof(float) * 8);
+
+/* clipping depends on where the parents are */
+	if (elem->clip != ARCAN_CLIP_OFF)
+		for (arcan_vobject* cur = elem->parent;
+			cur && cur != &current_context->world; cur = cur->parent){
+			surface_properties pp = empty_surface();
+			resolve_vidprop(cur, fract, &pp, defer);
+			h = damage_hashprops(h, &pp);
+			h = damage_hash(h, &cur->update_seq, sizeof(cur->update_seq));
+		}
+
+	return h;
+}
+
+static void* damage_scratch(size_t sz)
+{
+	static void* buf;
+	static size_t buf_sz;
+
+	if (sz > buf_sz){
+		size_t nsz = buf_sz ? buf_sz : 4096;
+		while (nsz < sz)
+			nsz *= 2;
+
+		void* nbuf = arcan_alloc_mem(nsz,
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL);
+		if (!nbuf)
+			return NULL;
+
+		arcan_mem_free(buf);
+		buf = nbuf;
+		buf_sz = nsz;
+	}
+
+	return buf;
+}
+
+/*
+ * Compare the recorded list against the snapshot from the last submission.
+ * Items are matched on object (and cellid, as slots get reused), and the
+ * matched ones that are not part of the longest run that kept its relative
+ * order count as having changed z-order. Returns false if scratch space is
+ * missing, the caller should then treat everything as damaged.
+ */
+static bool damage_diff(struct draw_list* dl, struct arcan_damage* frame,
+	int w, int h, agp_shader_id basic, agp_shader_id color)
+{
+	struct rendertarget* tgt = dl->tgt;
+	struct damage_item* prev = tgt->damage.items;
+	size_t np = tgt->damage.count;
+	size_t nc = dl->count;
+
+	size_t tsz = 16;
+	while (tsz < np * 2)
+		tsz *= 2;
+
+	int* table = damage_scratch(sizeof(int) * (tsz + nc * 3 + np));
+	if (!table)
+		return false;
+
+	int* seq = &table[tsz];
+	int* tails = &seq[nc];
+	int* link = &tails[nc];
+	int* seen = &link[nc];
+
+	memset(table, 0xff, sizeof(int) * tsz);
+	memset(seen, '\0', sizeof(int) * np);
+
+#define DAMAGE_SLOT(X) ((((uintptr_t)(X)) >> 4) * 2654435761u)
+	for (size_t j = 0; j < np; j++){
+		size_t ind = DAMAGE_SLOT(prev[j].elem) & (tsz - 1);
+		while (table[ind] != -1)
+			ind = (ind + 1) & (tsz - 1);
+		table[ind] = j;
+	}
+
+	for (size_t i = 0; i < nc; i++){
+		arcan_vobject* elem = dl->items[i].elem;
+		size_t ind = DAMAGE_SLOT(elem) & (tsz - 1);
+		seq[i] = -1;
+
+		for (; table[ind] != -1; ind = (ind + 1) & (tsz - 1)){
+			struct damage_item* pi = &prev[table[ind]];
+			if (pi->elem == elem && pi->cellid == elem->cellid){
+				seq[i] = table[ind];
+				seen[seq[i]] = 1;
+				break;
+			}
+		}
+	}
+#undef DAMAGE_SLOT
+
+/* longest increasing run of previous indices, patience style */
+	size_t len = 0;
+	for (size_t i = 0; i < nc; i++){
+		if (seq[i] < 0)
+			continue;
+
+		size_t lo = 0, hi = len;
+		while (lo < hi){
+			size_t mid = (lo + hi) / 2;
+			if (seq[tails[mid]] < seq[i])
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		link[i] = lo > 0 ? tails[lo - 1] : -1;
+		tails[lo] = i;
+		if (lo == len)
+			len++;
+	}
+
+/* tails is repurposed to mark the members of that run */
+	int last = len ? tails[len - 1] : -1;
+	memset(tails, '\0', sizeof(int) * nc);
+	for (; last != -1; last = link[last])
+		tails[last] = 1;
+
+	for (size_t i = 0; i < nc && !frame->full; i++){
+		struct draw_item* item = &dl->items[i];
+		agp_shader_id prg = item->elem->program;
+
+		if (seq[i] == -1){
+			damage_add(frame, item->box, w, h);
+			continue;
+		}
+
+/* custom shaders can animate on their own, assume they always do */
+		struct damage_item* pi = &prev[seq[i]];
+		if (!tails[i] || pi->state != item->state ||
+			memcmp(&pi->box, &item->box, sizeof(item->box)) != 0 ||
+			(prg != 0 && prg != basic && prg != color)){
+			damage_add(frame, pi->box, w, h);
+			damage_add(frame, item->box, w, h);
+		}
+	}
+
+	for (size_t j = 0; j < np && !frame->full; j++)
+		if (!seen[j])
+			damage_add(frame, prev[j].box, w, h);
+
+	return true;
+}
+
+/*
+ * Work out what needs to be drawn for the buffer the target is about to
+ * draw into, and snapshot the list for the next round. With multi-buffered
+ * targets each buffer has missed everything since it was last drawn into,
+ * that is what [pending] accumulates.
+ */
+static struct arcan_damage damage_update(struct draw_list* dl)
+{
+	struct rendertarget* tgt = dl->tgt;
+	struct arcan_damage frame = {0};
+	int w = 0, h = 0;
+
+	if (tgt->color && tgt->color->vstore){
+		w = tgt->color->vstore->w;
+		h = tgt->color->vstore->h;
+	}
+
+	size_t nslots;
+	size_t slot = agp_rendertarget_bufferslot(tgt->art, &nslots);
+
+	frame.full = !tgt->art || dl->full ||
+		arcan_video_display.no_damage || arcan_video_display.ignore_dirty ||
+		FL_TEST(tgt, TGTFL_NOCLEAR) ||
+		w != tgt->damage.w || h != tgt->damage.h || dl->view != tgt->damage.view ||
+		nslots != tgt->damage.nslots || nslots > DAMAGE_SLOTS;
+
+	if (!frame.full && !damage_diff(dl, &frame, w, h,
+		agp_default_shader(BASIC_2D), agp_default_shader(COLOR_2D)))
+		frame.full = true;
+
+/* snapshot, if that fails the next round will have to be a full one */
+	if (dl->count > tgt->damage.limit){
+		size_t nlim = tgt->damage.limit ? tgt->damage.limit : 64;
+		while (nlim < dl->count)
+			nlim *= 2;
+
+		struct damage_item* nitems = arcan_alloc_mem(
+			sizeof(struct damage_item) * nlim, ARCAN_MEM_VSTRUCT,
+			ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL
+		);
+
+		arcan_mem_free(tgt->damage.items);
+		tgt->damage.items = nitems;
+		tgt->damage.limit = nitems ? nlim : 0;
+	}
+
+	if (dl->count <= tgt->damage.limit){
+		for (size_t i = 0; i < dl->count; i++)
+			tgt->damage.items[i] = (struct damage_item){
+				.elem = dl->items[i].elem,
+				.cellid = dl->items[i].elem->cellid,
+				.state = dl->items[i].state,
+				.box = dl->items[i].box
+			};
+		tgt->damage.count = dl->count;
+		tgt->damage.w = w;
+		tgt->damage.h = h;
+	}
+	else {
+		tgt->damage.count = 0;
+		tgt->damage.w = tgt->damage.h = 0;
+	}
+
+	tgt->damage.view = dl->view;
+	tgt->damage.nslots = nslots;
+
+	if (frame.full || slot >= DAMAGE_SLOTS){
+		for (size_t i = 0; i < DAMAGE_SLOTS; i++)
+			tgt->damage.pending[i] = (struct arcan_damage){.full = true};
+		tgt->damage.pending[slot % DAMAGE_SLOTS] = (struct arcan_damage){0};
+		return (struct arcan_damage){.full = true};
+	}
+
+	for (size_t i = 0; i < nslots; i++)
+		damage_merge(&tgt->damage.pending[i], &frame, w, h);
+
+	struct arcan_damage res = tgt->damage.pending[slot];
+	tgt->damage.pending[slot] = (struct arcan_damage){0};
+	return res;
+}
+
+void arcan_vint_damageall(struct rendertarget* tgt)
+{
+	if (tgt)
+		tgt->damage.w = tgt->damage.h = 0;
+}
+
+static void damage_drop(struct rendertarget* tgt)
+{
+	arcan_mem_free(tgt->damage.items);
+	memset(&tgt->damage, '\0', sizeof(tgt->damage));
+}
 
-		if (elem->frameset){
+const struct arcan_damage* arcan_vint_worlddamage()
+{
+	struct arcan_damage* res = &current_context->stdoutp.damage.last;
+	return res->full || res->count ? res : NULL;
+}
+
+/*
+ * Linked targets also get to sum the dirty state of their source, this is
+ * the only side effect and it happens before any recording.
+ */
+static bool rendertarget_dirty(struct rendertarget* tgt)
+{
+	if (tgt->link){
+		tgt->dirtyc += tgt->link->dirtyc;
+		tgt->transfc += tgt->link->transfc;
+		return true;
+	}
+
+	return arcan_video_display.ignore_dirty ||
+		tgt->dirtyc != 0 || tgt->transfc != 0;
+}
+
+static void record_rendertarget(struct draw_list* dl, bool commit)
+{
+	struct rendertarget* tgt = dl->tgt;
+	arcan_vobject_litem* current = tgt->link ? tgt->link->first : tgt->first;
+	struct draw_list* defer = commit ? NULL : dl;
+
+	dl->count = 0;
+	dl->n_commits = 0;
+	memset(dl->deps, '\0', sizeof(dl->deps));
+
+/* a change to the view moves everything */
+	float _Alignas(16) mvp[16];
+	multiply_matrix(mvp, tgt->projection, tgt->base);
+	dl->view = damage_hash(2166136261u, mvp, sizeof(mvp));
+
+	int w = 0, h = 0;
+	if (tgt->color && tgt->color->vstore){
+		w = tgt->color->vstore->w;
+		h = tgt->color->vstore->h;
+	}
+
+/* skip a possible 3d pipeline, it isn't covered by damage tracking */
+	dl->full = current && current->elem->order < 0;
+	while (current && current->elem->order < 0)
+		current = current->next;
+
+	for (; current && current->elem->order >= 0; current = current->next){
+		arcan_vobject* elem = current->elem;
+
+		if (elem->order < tgt->min_order)
+			continue;
+
+		if (elem->order > tgt->max_order)
+			break;
+
+/* calculate coordinate system translations, world cannot be masked */
+		surface_properties dprops = empty_surface();
+		resolve_vidprop(elem, dl->fract, &dprops, defer);
+
+/* don't waste time on objects that aren't supposed to be visible */
+		if (dprops.opa <= EPSILON || elem == tgt->color)
+			continue;
+
+		if (dl->count == dl->limit){
+			size_t nlim = dl->limit ? dl->limit * 2 : 64;
+			struct draw_item* nitems = arcan_alloc_mem(
+				sizeof(struct draw_item) * nlim, ARCAN_MEM_VSTRUCT,
+				ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL
+			);
+			if (!nitems)
+				break;
+
+			if (dl->items){
+				memcpy(nitems, dl->items, sizeof(struct draw_item) * dl->count);
+				arcan_mem_free(dl->items);
+			}
+			dl->items = nitems;
+			dl->limit = nlim;
+		}
+
+		struct arcan_damage_rect box = {.x2 = w, .y2 = h}, inner;
+		damage_box(mvp, elem, &dprops, w, h, &box);
+		occluder_box(mvp, elem, &dprops, w, h, &inner);
+
+		dl->items[dl->count++] = (struct draw_item){
+			.elem = elem,
+			.dprops = dprops,
+			.box = box,
+			.inner = inner,
+			.state = damage_state(elem, &dprops, dl->fract, defer)
+		};
+
+/* sampling the output of another rendertarget means it should be drawn first */
+		if (FL_TEST(elem, FL_RTGT)){
+			struct rendertarget* dep = arcan_vint_findrt(elem);
+			if (dep && dep != tgt)
+				dl->deps[rtgt_index(dep)] = true;
+		}
+	}
+}
+
+/*
+ * Walk the list front to back, keeping the largest opaque regions seen so
+ * far, and drop the items that are entirely behind one of them. They have
+ * already been resolved (and their feeds processed), they just don't get
+ * drawn, and as they leave the list they come back as damage when uncovered.
+ */
+#define OCCLUDER_LIMIT 8
+static size_t occlusion_pass(struct draw_list* dl)
+{
+	struct arcan_damage_rect occ[OCCLUDER_LIMIT];
+	size_t n_occ = 0, culled = 0;
+	int w = 0, h = 0;
+
+	if (dl->tgt->color && dl->tgt->color->vstore){
+		w = dl->tgt->color->vstore->w;
+		h = dl->tgt->color->vstore->h;
+	}
+
+	agp_shader_id basic = agp_default_shader(BASIC_2D);
+	agp_shader_id color = agp_default_shader(COLOR_2D);
+
+	for (size_t i = dl->count; i > 0; i--){
+		struct draw_item* item = &dl->items[i-1];
+		struct arcan_damage_rect r = item->box;
+		r.x1 = r.x1 < 0 ? 0 : r.x1;
+		r.y1 = r.y1 < 0 ? 0 : r.y1;
+		r.x2 = r.x2 > w ? w : r.x2;
+		r.y2 = r.y2 > h ? h : r.y2;
+
+		bool hidden = false;
+		for (size_t j = 0; j < n_occ && !hidden; j++)
+			hidden = r.x1 >= occ[j].x1 && r.y1 >= occ[j].y1 &&
+				r.x2 <= occ[j].x2 && r.y2 <= occ[j].y2;
+
+		if (hidden){
+			item->elem = NULL;
+			culled++;
+			continue;
+		}
+
+/* custom shaders might discard or output alpha */
+		agp_shader_id prg = item->elem->program;
+		if (item->inner.x1 >= item->inner.x2 ||
+			(prg != 0 && prg != basic && prg != color))
+			continue;
+
+		if (n_occ < OCCLUDER_LIMIT){
+			occ[n_occ++] = item->inner;
+			continue;
+		}
+
+		size_t min = 0;
+		for (size_t j = 1; j < n_occ; j++)
+			if (damage_area(&occ[j]) < damage_area(&occ[min]))
+				min = j;
+
+		if (damage_area(&item->inner) > damage_area(&occ[min]))
+			occ[min] = item->inner;
+	}
+
+	if (!culled)
+		return 0;
+
+	size_t count = 0;
+	for (size_t i = 0; i < dl->count; i++)
+		if (dl->items[i].elem)
+			dl->items[count++] = dl->items[i];
+	dl->count = count;
+
+	return culled;
+}
+
+static void record_job(void* tag, size_t ind)
+{
+	struct draw_list** jobs = tag;
+	record_rendertarget(jobs[ind], false);
+}
+
+/*
+ * Draw the 2D part of a list, limited to the items that intersect [region]
+ * (if provided) as the caller has scissored to it.
+ */
+static size_t draw_pass(struct draw_list* dl,
+	const struct arcan_damage_rect* region, arcan_benchdata* stats)
+{
+	struct rendertarget* tgt = dl->tgt;
+	float fract = dl->fract;
+	size_t pc = 0;
+
+	for (size_t i = 0; i < dl->count; i++){
+		if (region && !damage_overlap(&dl->items[i].box, region))
+			continue;
+
+		arcan_vobject* elem = dl->items[i].elem;
+		surface_properties dprops = dl->items[i].dprops;
+		stats->acc.objects++;
+
+/* enable clipping using stencil buffer, we need to reset the state of the
+ * stencil buffer between draw calls so track if it's enabled or not */
+		bool clipped = false;
+
+/*
+ * texture coordinates that will be passed to the draw call, clipping and other
+ * effects may maintain a local copy and manipulate these
+ */
+		float* txcos = elem->txcos;
+		float** dstcos = &txcos;
+
+		if ( (elem->mask & MASK_MAPPING) > 0)
+			txcos = elem->parent != &current_context->world ?
+				elem->parent->txcos : elem->txcos;
+
+		if (!txcos)
+			txcos = arcan_video_display.default_txcos;
+
+		struct agp_vstore* atlas = NULL;
+		if (elem->glyphs)
+			atlas = glyph_prepare(elem, stats);
+
+		if (atlas && batch_candidate(elem) && (elem->clip == ARCAN_CLIP_OFF ||
+			elem->parent == &current_context->world)){
+			enum arcan_blendfunc blend = BLEND_NORMAL;
+			if (dprops.opa < 1.0 - EPSILON || elem->blendmode == BLEND_NONE ||
+				elem->blendmode == BLEND_FORCE)
+				blend = elem->blendmode;
+
+			batch_glyphs(tgt, elem, dprops, atlas, blend, stats);
+			pc++;
+			continue;
+		}
+
+		if (!atlas && batch_candidate(elem)){
+			if (elem->clip == ARCAN_CLIP_SHALLOW &&
+				elem->parent != &current_context->world &&
+				!setup_shallow_texclip(elem, dstcos, &dprops, fract))
+				continue;
+
+			enum arcan_blendfunc blend = BLEND_NORMAL;
+			if (dprops.opa < 1.0 - EPSILON || elem->blendmode == BLEND_NONE ||
+				elem->blendmode == BLEND_FORCE)
+				blend = elem->blendmode;
+
+			batch_append(tgt, elem, dprops, txcos, blend, stats);
+			pc++;
+			continue;
+		}
+
+/* anything else changes state that the batch depends on */
+		batch_flush(stats);
+
+/* depending on frameset- mode, we may need to split the frameset up into
+ * multitexturing, or switch the txcos with the ones that may be used for
+ * clipping, but mapping TU indices to current shader must be done before.
+ * To not skip on the early-out-on-clipping and not incur additional state
+ * change costs, only do it in this edge case. */
+		bool shader_sw = false;
+		agp_shader_id shid = elem->program > 0 ?
+			elem->program : agp_default_shader(BASIC_2D);
+
+		if (atlas)
+			agp_activate_vstore(atlas);
+		else if (elem->frameset){
 			if (elem->frameset->mode == ARCAN_FRAMESET_MULTITEXTURE){
 				agp_shader_activate(shid);
 				shader_sw = true;
@@ -4986,12 +6762,10 @@ static size_t process_rendertarget(struct rendertarget* tgt, float fract)
 /* a common clipping situation is that we have an invisible clipping parent
  * where neither objects is in a rotated state, which gives an easy way
  * out through the drawing region */
-		if (elem->clip == ARCAN_CLIP_SHALLOW &&
+		if (elem->clip == ARCAN_CLIP_SHALLOW && !atlas &&
 			elem->parent != &current_context->world && !elem->rotate_state){
-			if (!setup_shallow_texclip(elem, dstcos, &dprops, fract)){
-				current = current->next;
+			if (!setup_shallow_texclip(elem, dstcos, &dprops, fract))
 				continue;
-			}
 		}
 		else if (elem->clip != ARCAN_CLIP_OFF &&
 			elem->parent != &current_context->world){
@@ -5010,21 +6784,104 @@ static size_t process_rendertarget(struct rendertarget* tgt, float fract)
 			else
 				agp_blendstate(BLEND_NORMAL);
 
-		if (elem->vstore->txmapped == TXSTATE_OFF && elem->program != 0)
+		if (atlas)
+			draw_glyphsurf(tgt, dprops, elem, stats);
+		else if (elem->vstore->txmapped == TXSTATE_OFF && elem->program != 0){
 			draw_colorsurf(tgt, dprops, elem, elem->vstore->vinf.col.r,
 				elem->vstore->vinf.col.g, elem->vstore->vinf.col.b, *dstcos);
-		else if (elem->vstore->txmapped == TXSTATE_TEX2D)
+			stats->acc.draw_calls++;
+		}
+		else if (elem->vstore->txmapped == TXSTATE_TEX2D){
 			draw_texsurf(tgt, dprops, elem, *dstcos);
+			stats->acc.draw_calls++;
+		}
 		else
 			;
 		pc++;
 
 		if (clipped)
 			agp_disable_stencil();
+	}
+	batch_flush(stats);
 
-		current = current->next;
+	return pc;
+}
+
+static size_t submit_rendertarget(struct draw_list* dl)
+{
+	struct rendertarget* tgt = dl->tgt;
+	float fract = dl->fract;
+	arcan_vobject_litem* current = tgt->link ? tgt->link->first : tgt->first;
+
+	current_rendertarget = tgt;
+	arcan_benchdata* stats = arcan_bench_data();
+	agp_activate_rendertarget(tgt->art);
+	agp_shader_envv(RTGT_ID, &tgt->id, sizeof(int));
+
+/* caches found while recording on a worker, whether the objects get drawn,
+ * culled or not even are in the list (invisible parents) - the same object
+ * can be there more than once if several children share it */
+	for (size_t i = 0; i < dl->n_commits; i++){
+		struct draw_commit* dc = &dl->commits[i];
+		if (!dc->elem->valid_cache)
+			commit_vidprop_cache(dc->elem, &dc->props);
+	}
+	dl->n_commits = 0;
+
+/* anything that is about to be shown should be decoded first */
+	for (size_t i = 0; i < dl->count; i++)
+		if (dl->items[i].elem->feed.state.tag == ARCAN_TAG_ASYNCIMGLD)
+			loader_promote(dl->items[i].elem);
+
+	stats->acc.culled += occlusion_pass(dl);
+	struct arcan_damage damage = damage_update(dl);
+	tgt->damage.last = damage;
+	if (!damage.full && !damage.count)
+		return 0;
+
+	size_t pc = 0;
+
+	if (!damage.full){
+		agp_pipeline_hint(PIPELINE_2D);
+		agp_shader_activate(agp_default_shader(BASIC_2D));
+		agp_shader_envv(PROJECTION_MATR, tgt->projection, sizeof(float)*16);
+
+		for (size_t i = 0; i < damage.count; i++){
+			struct arcan_damage_rect* r = &damage.rects[i];
+			agp_rendertarget_scissor(tgt->art,
+				r->x1, r->y1, r->x2 - r->x1, r->y2 - r->y1);
+			agp_rendertarget_clear();
+			pc += draw_pass(dl, r, stats);
+			stats->acc.redraw_px += damage_area(r);
+		}
+
+		agp_rendertarget_scissor(tgt->art, 0, 0, 0, 0);
+		goto out;
 	}
 
+	if (!FL_TEST(tgt, TGTFL_NOCLEAR))
+		agp_rendertarget_clear();
+
+	if (tgt->color && tgt->color->vstore)
+		stats->acc.redraw_px += tgt->color->vstore->w * tgt->color->vstore->h;
+
+/* first, handle all 3d work (which may require multiple passes etc.) */
+	if (tgt->order3d == ORDER3D_FIRST && current && current->elem->order < 0){
+		arcan_3d_refresh(tgt->camtag, current, fract);
+		pc++;
+	}
+
+	if (!dl->count)
+		goto end3d;
+
+/* make sure we're in a decent state for 2D */
+	agp_pipeline_hint(PIPELINE_2D);
+
+	agp_shader_activate(agp_default_shader(BASIC_2D));
+	agp_shader_envv(PROJECTION_MATR, tgt->projection, sizeof(float)*16);
+
+	pc += draw_pass(dl, NULL, stats);
+
 /* reset and try the 3d part again if requested */
 end3d:
 	current = tgt->first;
@@ -5035,9 +6892,27 @@ end3d:
 			pc++;
 	}
 
+out:
+/* anything sampling the target should consider itself changed */
+	if (tgt->color && tgt->color->vstore)
+		tgt->color->vstore->update_seq++;
+
 	return pc;
 }
 
+static size_t process_rendertarget(struct rendertarget* tgt, float fract)
+{
+	if (!rendertarget_dirty(tgt))
+		return 0;
+
+	struct draw_list* dl = &draw_lists[rtgt_index(tgt)];
+	dl->tgt = tgt;
+	dl->fract = fract;
+	record_rendertarget(dl, true);
+
+	return submit_rendertarget(dl);
+}
+
 arcan_errc arcan_video_forceread(arcan_vobj_id sid, bool local,
 	av_pixel** dptr, size_t* dsize)
 {
@@ -5050,11 +6925,12 @@ arcan_errc arcan_video_forceread(arcan_vobj_id sid, bool local,
  */
 
 	arcan_vobject* vobj = arcan_video_getobject(sid);
-	struct agp_vstore* dstore = vobj->vstore;
-
-	if (!vobj || !dstore)
+	if (!vobj || !vobj->vstore)
 		return ARCAN_ERRC_NO_SUCH_OBJECT;
 
+	text_materialize(vobj);
+	struct agp_vstore* dstore = vobj->vstore;
+
 	if (dstore->txmapped != TXSTATE_TEX2D)
 		return ARCAN_ERRC_UNACCEPTED_STATE;
 
@@ -5164,26 +7040,108 @@ void arcan_vint_pollreadback(struct rendertarget* tgt)
 	FL_CLEAR(tgt, TGTFL_READING);
 }
 
-static size_t steptgt(float fract, struct rendertarget* tgt)
+/*
+ * Order the scheduled draw lists so that a rendertarget is submitted after
+ * the ones it samples from. This is stable (ties keep the rendertarget order
+ * with world last) and cycles (feedback setups) are broken by picking the
+ * first remaining target, which gives the old one-frame-behind behavior.
+ */
+static void sort_drawlists(struct draw_list** jobs, size_t n)
 {
-	size_t transfc = 0;
-	if (tgt->refresh < 0 && process_counter(tgt,
-		&tgt->refreshcnt, tgt->refresh, fract)){
-		process_rendertarget(tgt, fract);
-		transfc = tgt->transfc;
-		tgt->dirtyc = 0;
-/* may need to readback even if we havn't updated as it may
- * be used as clock (though optimization possibility of using buffer) */
-		process_readback(tgt, fract);
+	struct draw_list* out[n];
+	bool done[n];
+	memset(done, '\0', sizeof(done));
+
+	for (size_t step = 0; step < n; step++){
+		ssize_t pick = -1;
+
+		for (size_t i = 0; i < n && pick == -1; i++){
+			if (done[i])
+				continue;
+
+			bool ready = true;
+			for (size_t j = 0; j < n && ready; j++)
+				if (!done[j] && j != i && jobs[i]->deps[rtgt_index(jobs[j]->tgt)])
+					ready = false;
+
+			if (ready)
+				pick = i;
+		}
+
+		if (-1 == pick)
+			for (pick = 0; done[pick]; pick++){}
+
+		done[pick] = true;
+		out[step] = jobs[pick];
+	}
+
+	memcpy(jobs, out, sizeof(struct draw_list*) * n);
+}
+
+static bool schedule_tgt(float fract,
+	struct rendertarget* tgt, struct draw_list** jobs, size_t* njobs)
+{
+	if (!(tgt->refresh < 0 && process_counter(tgt,
+		&tgt->refreshcnt, tgt->refresh, fract)))
+		return false;
+
+	struct draw_list* dl = &draw_lists[rtgt_index(tgt)];
+	dl->tgt = tgt;
+	dl->fract = fract;
+	jobs[(*njobs)++] = dl;
+	return true;
+}
+
+/*
+ * mark the rendertargets that [vid] needs to be up to date, the target itself
+ * and the ones it samples (by the dependencies from the last recording)
+ */
+static void mark_feeding(arcan_vobj_id vid, bool* mark)
+{
+	struct rendertarget* tgt = arcan_vint_findrt(arcan_video_getobject(vid));
+	if (!tgt)
+		return;
+
+	size_t stack[RENDERTARGET_LIMIT + 1];
+	size_t sp = 0;
+	size_t root = rtgt_index(tgt);
+	if (mark[root])
+		return;
+
+	mark[root] = true;
+	stack[sp++] = root;
+
+	while (sp){
+		struct draw_list* dl = &draw_lists[stack[--sp]];
+		for (size_t i = 0; i < RENDERTARGET_LIMIT + 1; i++)
+			if (dl->deps[i] && !mark[i]){
+				mark[i] = true;
+				stack[sp++] = i;
+			}
 	}
-	return transfc;
 }
 
 unsigned arcan_vint_refresh(float fract, size_t* ndirty)
+{
+	return arcan_vint_refresh_displays(fract, NULL, 0, NULL, 0, ndirty);
+}
+
+unsigned arcan_vint_refresh_displays(float fract,
+	const arcan_vobj_id* due, size_t n_due,
+	const arcan_vobj_id* idle, size_t n_idle, size_t* ndirty)
 {
 	long long int pre = arcan_timemillis();
 	size_t transfc = 0;
 
+/* targets that only feed displays that aren't due are deferred, anything
+ * else (offscreen, readbacks, ...) is processed as before */
+	bool need[RENDERTARGET_LIMIT + 1] = {false};
+	bool hold[RENDERTARGET_LIMIT + 1] = {false};
+	for (size_t i = 0; i < n_due; i++)
+		mark_feeding(due[i], need);
+	for (size_t i = 0; i < n_idle; i++)
+		mark_feeding(idle[i], hold);
+
 /* we track last interp. state in order to handle forcerefresh */
 	arcan_video_display.c_lerp = fract;
 
@@ -5191,20 +7149,57 @@ unsigned arcan_vint_refresh(float fract, size_t* ndirty)
 	arcan_video_display.dirty +=
 		agp_shader_envv(FRACT_TIMESTAMP_F, &fract, sizeof(float));
 
-/* rendertargets may be composed on world- output, begin there */
+/* figure out which targets should be updated this pass, the dirty ones
+ * will have their draw lists recorded (possibly in parallel) */
+	struct draw_list* jobs[RENDERTARGET_LIMIT + 1];
+	struct draw_list* dirty[RENDERTARGET_LIMIT + 1];
+	size_t njobs = 0, ndl = 0;
+
 	for (size_t ind = 0; ind < current_context->n_rtargets; ind++){
 		struct rendertarget* tgt = &current_context->rtargets[ind];
 		tgt->dirtyc += arcan_video_display.dirty;
-		transfc += steptgt(fract, tgt);
+		if (hold[ind] && !need[ind])
+			continue;
+		if (schedule_tgt(fract, tgt, jobs, &njobs) && rendertarget_dirty(tgt))
+			dirty[ndl++] = jobs[njobs-1];
+	}
+
+	struct rendertarget* outtgt = &current_context->stdoutp;
+	outtgt->dirtyc += arcan_video_display.dirty;
+	if (!(hold[RENDERTARGET_LIMIT] && !need[RENDERTARGET_LIMIT]) &&
+		schedule_tgt(fract, outtgt, jobs, &njobs) && rendertarget_dirty(outtgt))
+		dirty[ndl++] = jobs[njobs-1];
+
+	arcan_conductor_parallel(record_job, dirty, ndl);
+	sort_drawlists(jobs, njobs);
+
+	for (size_t i = 0, j = 0; i < njobs; i++){
+		struct rendertarget* tgt = jobs[i]->tgt;
+
+/* reset the bound rendertarget before world, otherwise we may be in an
+ * undefined state if world isn't dirty or with pending transfers */
+		if (tgt == outtgt){
+			current_rendertarget = NULL;
+			agp_activate_rendertarget(NULL);
+		}
+
+		for (j = 0; j < ndl && dirty[j] != jobs[i]; j++){}
+		if (j < ndl)
+			submit_rendertarget(jobs[i]);
+		else
+			tgt->damage.last = (struct arcan_damage){0};
+
+		transfc += tgt->transfc;
+		tgt->dirtyc = 0;
+
+/* may need to readback even if we havn't updated as it may
+ * be used as clock (though optimization possibility of using buffer) */
+		process_readback(tgt, fract);
 	}
 
-/* reset the bound rendertarget, otherwise we may be in an undefined
- * state if world isn't dirty or with pending transfers */
 	current_rendertarget = NULL;
 	agp_activate_rendertarget(NULL);
 
-	current_context->stdoutp.dirtyc += arcan_video_display.dirty;
-	transfc += steptgt(fract, &current_context->stdoutp);
 	*ndirty = arcan_video_display.dirty;
 	arcan_video_display.dirty = transfc;
 
@@ -5595,6 +7590,7 @@ bool arcan_video_prepare_external()
 		return false;
 
 	arcan_event_deinit(arcan_event_defaultctx());
+	arcan_renderfun_glyphreset();
 	platform_video_prepare_external();
 
 	arcan_event ev = {
@@ -5717,8 +7713,11 @@ void arcan_video_shutdown(bool release_fsrv)
 			flag_ctxfsrv_dms(current_context);
 	}
 
+	arcan_conductor_stop_workers();
 	agp_shader_flush();
 	deallocate_gl_context(current_context, true, NULL);
+	loader_stop();
+	imgcache_flush();
 	arcan_video_reset_fontcache();
 	agp_rendertarget_clear();
 	TTF_Quit();
@@ -5795,6 +7794,8 @@ arcan_vobj_id arcan_video_renderstring(arcan_vobj_id src,
 
 #define ARGLST src, false, n_lines, \
 lineheights, &w, &h, &dsz, &maxw, &maxh, false
+#define GLYPHARG data.multiple ? NULL : data.message, \
+(const char**)(data.multiple ? data.array : NULL)
 
 		ds = vobj->vstore;
 		av_pixel* rawdst = ds->vinf.text.raw;
@@ -5802,6 +7803,18 @@ lineheights, &w, &h, &dsz, &maxw, &maxh, false
 		vobj->feed.state.tag = ARCAN_TAG_TEXT;
 		vobj->blendmode = BLEND_FORCE;
 
+/* as glyphs, the store is just a placeholder until something needs the
+ * rasterized version (text_materialize) */
+		if (arcan_renderfun_glyphfmtstr(GLYPHARG, &vobj->glyphs,
+			n_lines, lineheights, &maxw, &maxh)){
+			ds->vinf.text.vppcm = dst->vppcm;
+			ds->vinf.text.hppcm = dst->hppcm;
+			ds->vinf.text.kind = STORAGE_TEXT;
+			agp_empty_vstore(ds, 1, 1);
+			arcan_vint_attachobject(rv);
+			goto done;
+		}
+
 		ds->vinf.text.raw = data.multiple ?
 			arcan_renderfun_renderfmtstr_extended((const char**)data.array, ARGLST) :
 			arcan_renderfun_renderfmtstr(data.message, ARGLST);
@@ -5832,15 +7845,29 @@ lineheights, &w, &h, &dsz, &maxw, &maxh, false
 
 		ds = vobj->vstore;
 
-		if (data.multiple)
-			arcan_renderfun_renderfmtstr_extended((const char**)data.array, ARGLST);
-		else
-			arcan_renderfun_renderfmtstr(data.message, ARGLST);
+/* changing the string of glyph text only rewrites the quads, if it can't
+ * be represented as glyphs (anymore) or something else uses the store it
+ * falls back to rasterizing */
+		if (text_glyph_eligible(vobj) &&
+			arcan_renderfun_glyphfmtstr(GLYPHARG, &vobj->glyphs,
+			n_lines, lineheights, &maxw, &maxh)){
+			FLAG_DIRTY(vobj);
+		}
+		else {
+			if (vobj->glyphs)
+				arcan_renderfun_glyphfree(&vobj->glyphs);
+
+			if (data.multiple)
+				arcan_renderfun_renderfmtstr_extended((const char**)data.array, ARGLST);
+			else
+				arcan_renderfun_renderfmtstr(data.message, ARGLST);
+		}
 
 		invalidate_cache(vobj);
 		arcan_video_objectscale(vobj->cellid, 1.0, 1.0, 1.0, 0);
 	}
 
+done:
 	vobj->origw = maxw;
 	vobj->origh = maxh;
 
@@ -5855,6 +7882,7 @@ lineheights, &w, &h, &dsz, &maxw, &maxh, false
 	arcan_vint_defaultmapping(vobj->txcos, wv, hv);
  */
 #undef ARGLST
+#undef GLYPHARG
 #undef FAIL
 	return rv;
 }
@@ -517,10 +517,16 @@ arcan_errc arcan_video_resizefeed(arcan_vobj_id id, size_t w, size_t h);
  * defined in the resource will be retained, otherwise the image will be
  * rescaled upon loading (unfiltered and rather slow).
  *
- * The asynchronous version will spawn a worker thread (up to a certain
- * number, compile-time limited with ASYNCH_CONCURRENT_THREADS).
- * Context operations will force a join on any outstanding asynchronous
- * loading jobs.
+ * The asynchronous version queues the job for a fixed pool of decode
+ * workers (ASYNCH_WORKERS, overridden with ARCAN_IMAGE_WORKERS up to
+ * ASYNCH_CONCURRENT_THREADS). Jobs for objects that are visible are moved
+ * ahead in the queue, and jobs for objects deleted before decoding started
+ * are dropped. Context operations will force a join on any outstanding
+ * asynchronous loading jobs.
+ *
+ * Both versions first check the decoded image cache, and a resource that
+ * has already been loaded with the same constraints and store defaults
+ * shares the existing store rather than being decoded and uploaded again.
  *
  * Loadimage returns ARCAN_EID on failure, asynch will always succeed but
  * may later enqueue EVENT_ASYNCHIMAGE_FAILED or EVENT_VIDEO_ASYNCHIMAGE_LOADED
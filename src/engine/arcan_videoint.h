@@ -18,11 +18,11 @@
 
 /*
  *  Indicate that the video pipeline is in such a state that
- *  it should be redrawn. X should be NULL or a vobj reference
- *  (to permit partial redraws in the future if we need to save
- *  bandwidth).
+ *  it should be redrawn. X should be NULL or a vobj reference,
+ *  the reference marks the object as changed for damage tracking
+ *  so only the parts of rendertargets it covers get redrawn.
  */
-#define FLAG_DIRTY(X) (arcan_video_display.dirty++);
+#define FLAG_DIRTY(X) (arcan_video_display.dirty++, arcan_vint_touch(X));
 
 #define FL_SET(obj_ptr, fl) ((obj_ptr)->flags |= fl)
 #define FL_CLEAR(obj_ptr, fl) ((obj_ptr)->flags &= ~fl)
@@ -30,6 +30,28 @@
 
 struct arcan_vobject_litem;
 struct arcan_vobject;
+struct text_glyphs;
+struct damage_item;
+
+/*
+ * Damage is tracked as a short list of rectangles in rendertarget pixels
+ * (lower-left origo, x2/y2 exclusive), overlapping ones are merged and when
+ * the list is full, new ones are merged into the one that grows the least.
+ */
+#define DAMAGE_RECTS 8
+
+/* the number of rotating output buffers that damage can be tracked for */
+#define DAMAGE_SLOTS 4
+
+struct arcan_damage_rect {
+	int x1, y1, x2, y2;
+};
+
+struct arcan_damage {
+	bool full;
+	size_t count;
+	struct arcan_damage_rect rects[DAMAGE_RECTS];
+};
 
 enum rtgt_flags {
 	TGTFL_READING = 1,
@@ -78,16 +100,31 @@ struct rendertarget {
 	size_t transfc;
 
 /*
- * dirty- management is still incomplete in two ways, one is that dirty-
- * flagging is a global video state and not bound to rendertarget which is in
- * conflict with rendertargets being updated at different clocks.
- * second is that we do not consider the dirty- area, and just go for a full
- * redraw when it is time. Important optimizations but still low on the list.
- * When it is to be implemented, use this variable, an list of invalidation
- * rects and sweep the codebase for FLAG_DIRTY
+ * dirty- management is still incomplete in that dirty- flagging is a global
+ * video state and not bound to rendertarget which is in conflict with
+ * rendertargets being updated at different clocks. This only determines if
+ * the rendertarget should be considered, the damage below determines what
+ * actually gets redrawn.
  */
 	size_t dirtyc;
 
+/*
+ * The objects drawn the last time along with their screen-space boxes and
+ * a hash of the state that affects their appearance. This is compared
+ * against the next frame to find what changed. [pending] is what each
+ * output buffer has missed since it was last drawn to, and [last] is what
+ * the last submission actually redrew (empty if nothing).
+ */
+	struct {
+		struct damage_item* items;
+		size_t count, limit;
+		size_t nslots;
+		int w, h;
+		uint32_t view;
+		struct arcan_damage pending[DAMAGE_SLOTS];
+		struct arcan_damage last;
+	} damage;
+
 /*
  * track density per rendertarget, this affects some video objects that gets
  * attached in that they are rerasterized to match the properties of the new
@@ -220,10 +257,17 @@ typedef struct arcan_vobject {
 		int pcookie;
 	} feed;
 
+/* incremented by FLAG_DIRTY(obj), part of what damage tracking compares */
+	uint32_t update_seq;
+
 /* if NULL, a default mapping will be used */
 	float* txcos;
 	enum arcan_blendfunc blendmode;
 
+/* text that is drawn as quads from the shared glyph atlas, vstore then only
+ * gets the rasterized text if something asks for it */
+	struct text_glyphs* glyphs;
+
 /* position */
 	signed int order;
 	surface_properties current;
@@ -279,7 +323,7 @@ struct arcan_video_display {
 	bool suspended, fullscreen, conservative, in_video, no_stdout;
 
 	int dirty;
-	bool ignore_dirty;
+	bool ignore_dirty, no_damage;
 	enum arcan_order3d order3d;
 
 /*
@@ -359,6 +403,36 @@ extern struct arcan_video_display arcan_video_display;
  */
 unsigned arcan_vint_refresh(float fragment, size_t* ndirty);
 
+/*
+ * Same as arcan_vint_refresh, but for platforms that schedule displays on
+ * their own deadlines: the rendertargets that feed (directly or by sampling
+ * other rendertargets) only the objects mapped to [idle] displays are left
+ * for a later pass, while those feeding [due] displays and those not mapped
+ * anywhere are processed. Deferred targets keep their dirty state.
+ */
+unsigned arcan_vint_refresh_displays(float fragment,
+	const arcan_vobj_id* due, size_t n_due,
+	const arcan_vobj_id* idle, size_t n_idle, size_t* ndirty);
+
+/*
+ * Note that the contents of [obj] changed (through FLAG_DIRTY), a NULL
+ * object is accepted and ignored.
+ */
+void arcan_vint_touch(arcan_vobject* obj);
+
+/*
+ * Retrieve the regions of the world rendertarget that were redrawn by the
+ * last arcan_vint_refresh (pixels, lower-left origo, same as readbacks of
+ * the world store). Returns NULL if nothing was drawn.
+ */
+const struct arcan_damage* arcan_vint_worlddamage();
+
+/*
+ * Force the next update of [tgt] to redraw everything, for changes that
+ * damage tracking can't see (e.g. the clear color).
+ */
+void arcan_vint_damageall(struct rendertarget* tgt);
+
 /*
  * populate props with the (possibly cached) transformation state
  * of existing video object (vobj) at interpolation stage (0..1)
@@ -420,6 +494,32 @@ void arcan_vint_mirrormapping(float* dst, float st, float tt);
  */
 void arcan_vint_joinasynch(arcan_vobject* img, bool emit, bool force);
 
+/*
+ * Counters for the asynchronous image loader pool, queued is the current
+ * queue depth and peak the deepest it has been, the rest are running totals
+ * (decode times in milliseconds, completed includes loads that were forced
+ * to finish on the calling thread).
+ */
+struct arcan_asynch_stats {
+	size_t queued, peak, running, workers;
+	size_t completed, cancelled;
+	unsigned long long decode_ms, decode_max_ms;
+};
+void arcan_vint_asynchstats(struct arcan_asynch_stats* out);
+
+/*
+ * Images loaded from the same resource are shared through a cache of
+ * decoded stores. Call this before modifying the store of [vobj] in place;
+ * if the store is shared that way, [vobj] gets a private copy.
+ */
+void arcan_vint_privatestore(arcan_vobject* vobj);
+
+struct arcan_imgcache_stats {
+	size_t hits, misses, evictions;
+	size_t entries, bytes, limit;
+};
+void arcan_vint_imgcachestats(struct arcan_imgcache_stats* out);
+
 void arcan_vint_reraster(arcan_vobject* img, struct rendertarget*);
 
 /*
@@ -20,6 +20,7 @@
 #include <dlfcn.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <limits.h>
 
 #ifdef FRAMESERVER_LIBRETRO_3D
 #ifdef ENABLE_RETEXTURE
@@ -40,6 +41,7 @@
 #include "ntsc/snes_ntsc.h"
 #include "ievsched.h"
 #include "stateman.h"
+#include "pixconv.h"
 #include "sync_plot.h"
 #include "libretro.h"
 
@@ -57,6 +59,16 @@
 #define MAX_BUTTONS 16
 #endif
 
+/* upper bound on TARGET_SKIP_ROLLBACK, each dirty input replays this many */
+#ifndef MAX_ROLLBACK
+#define MAX_ROLLBACK 10
+#endif
+
+/* upper bound on run-ahead, every presented frame costs this many extra */
+#ifndef MAX_RUNAHEAD
+#define MAX_RUNAHEAD 8
+#endif
+
 #undef BADID
 
 #define COUNT_OF(x) \
@@ -155,9 +167,24 @@ static struct {
  	bool dirty_input;
 	float aframesz;
 	int rollback_window;
-	unsigned rollback_front;
-	char* rollback_state;
+
+/* rewind store (stateman) that backs both rollback and SEEKTIME, state_pos
+ * is the number of emulated frames that the current state corresponds to */
+	struct stateman_ctx* rewind;
+	ssize_t rewind_limit;
+	int rewind_precision;
+	int state_pos;
+	char* state_buf;
 	size_t state_sz;
+
+/* run-ahead: each presented frame is 'runahead' frames ahead of the emulated
+ * state, either by save / run / restore on this instance or by a second
+ * instance of the core on another thread (runahead_second), see run_ahead() */
+	int runahead;
+	bool runahead_second;
+	char* runahead_buf;
+	struct runahead_inst* second;
+	int runahead_cost, runahead_second_cost;
 	char* syspath;
 	bool res_empty;
 
@@ -314,136 +341,108 @@ static void process_frames(int nframes, bool overrv, bool overra)
 	if (overra)
 		retro.skipframe_a = true;
 
-	while(nframes--)
+	while(nframes--){
 		retro.run();
+		retro.state_pos++;
 
-	if (retro.skipmode <= TARGET_SKIP_ROLLBACK){
-		retro.serialize(retro.rollback_state +
-			(retro.rollback_front * retro.state_sz), retro.state_sz);
-		retro.rollback_front = (retro.rollback_front + 1)
-			% retro.rollback_window;
+		if (retro.rewind && retro.serialize(retro.state_buf, retro.state_sz))
+			stateman_feed(retro.rewind, retro.state_pos, retro.state_buf);
 	}
 
 	retro.skipframe_v = cv;
 	retro.skipframe_a = ca;
 }
 
-#define RGB565(b, g, r) ((uint16_t)(((uint8_t)(r) >> 3) << 11) | \
-								(((uint8_t)(g) >> 2) << 5) | ((uint8_t)(b) >> 3))
+/* the channel order that SHMIF_RGBA packs into, the conversion kernels
+ * (and the intermediate for the NTSC filter) follow it */
+#define SHMIF_PIXORDER (SHMIF_RGBA(0xff, 0, 0, 0) == 0xff ?\
+	PIXCONV_ORDER_RGBA : PIXCONV_ORDER_BGRA)
 
 static void push_ntsc(unsigned width, unsigned height,
 	const uint16_t* ntsc_imb, shmif_pixel* outp)
 {
-	size_t linew = SNES_NTSC_OUT_WIDTH(width) * 4;
+	size_t linew = SNES_NTSC_OUT_WIDTH(width) * sizeof(shmif_pixel);
+	size_t stride = retro.shmcont.stride;
 
 /* only draw on every other line, so we can easily mix or
  * blend interleaved (or just duplicate) */
 	snes_ntsc_blit(retro.ntscctx, ntsc_imb, width, 0,
-		width, height, outp, linew * 2);
+		width, height, outp, stride * 2);
 
 /* this might be a possible test-case for running two shmif
  * connections and let the compositor do interlacing management */
 	assert(ARCAN_SHMPAGE_VCHANNELS == 4);
 	for (int row = 1; row < height * 2; row += 2)
-		memcpy(& ((char*) retro.shmcont.vidp)[row * linew],
-			&((char*) retro.shmcont.vidp)[(row-1) * linew], linew);
+		memcpy(&((char*) outp)[row * stride],
+			&((char*) outp)[(row-1) * stride], linew);
 }
 
-/* better distribution for conversion (white is white ..) */
-static const uint8_t rgb565_lut5[] = {
-  0,   8,  16,  25,  33,  41,  49,  58,  66,   74,  82,  90,  99, 107, 115,123,
-132, 140, 148, 156, 165, 173, 181, 189,  197, 206, 214, 222, 230, 239, 247,255
-};
+/*
+ * The conversions themselves are in util/pixconv (SIMD, picked at runtime),
+ * these just clip to the segment and route through the NTSC intermediate
+ * when the filter is active.
+ */
+static void clip_dims(unsigned* width, unsigned* height)
+{
+	if (*width > retro.shmcont.w)
+		*width = retro.shmcont.w;
 
-static const uint8_t rgb565_lut6[] = {
-  0,   4,   8,  12,  16,  20,  24,  28,  32,  36,  40,  45,  49,  53,  57, 61,
- 65,  69,  73,  77,  81,  85,  89,  93,  97, 101, 105, 109, 113, 117, 121, 125,
-130, 134, 138, 142, 146, 150, 154, 158, 162, 166, 170, 174, 178, 182, 186, 190,
-194, 198, 202, 206, 210, 215, 219, 223, 227, 231, 235, 239, 243, 247, 251, 255
-};
+	if (*height > retro.shmcont.h)
+		*height = retro.shmcont.h;
+}
 
 static void libretro_rgb565_rgba(const uint16_t* data, shmif_pixel* outp,
-	unsigned width, unsigned height, size_t pitch)
+	unsigned width, unsigned height, size_t pitch, bool postfilter)
 {
-	uint16_t* interm = retro.ntsc_imb;
 	retro.colorspace = "RGB565->RGBA";
 
-/* with NTSC on, the input format is already correct */
-	for (int y = 0; y < height; y++){
-		for (int x = 0; x < width; x++){
-			uint16_t val = data[x];
-			uint8_t r = rgb565_lut5[ (val & 0xf800) >> 11 ];
-			uint8_t g = rgb565_lut6[ (val & 0x07e0) >> 5  ];
-			uint8_t b = rgb565_lut5[ (val & 0x001f)       ];
-
-			if (retro.ntscconv)
-				*interm++ = RGB565(r, g, b);
-			else
-				*outp++ = RGBA(r, g, b, 0xff);
-		}
-		data += pitch >> 1;
-	}
-
-	if (retro.ntscconv)
+	if (postfilter){
+		pixconv_rgb565_565(data, pitch,
+			retro.ntsc_imb, width, width, height, SHMIF_PIXORDER);
 		push_ntsc(width, height, retro.ntsc_imb, outp);
+		return;
+	}
 
-	return;
+	clip_dims(&width, &height);
+	pixconv_rgb565(data, pitch,
+		outp, retro.shmcont.pitch, width, height, SHMIF_PIXORDER);
 }
 
-static void libretro_xrgb888_rgba(const uint32_t* data, uint32_t* outp,
-	unsigned width, unsigned height, size_t pitch)
+static void libretro_xrgb888_rgba(const uint32_t* data, shmif_pixel* outp,
+	unsigned width, unsigned height, size_t pitch, bool postfilter)
 {
 	assert( (uintptr_t)data % 4 == 0 );
 	retro.colorspace = "XRGB888->RGBA";
 
-	uint16_t* interm = retro.ntsc_imb;
-
-	for (int y = 0; y < height; y++){
-		for (int x = 0; x < width; x++){
-			uint8_t* quad = (uint8_t*) (data + x);
-			if (retro.ntscconv)
-				*interm++ = RGB565(quad[2], quad[1], quad[0]);
-			else
-				*outp++ = RGBA(quad[2], quad[1], quad[0], 0xff);
-		}
-
-		data += pitch >> 2;
+	if (postfilter){
+		pixconv_xrgb8888_565(data, pitch,
+			retro.ntsc_imb, width, width, height, SHMIF_PIXORDER);
+		push_ntsc(width, height, retro.ntsc_imb, outp);
+		return;
 	}
 
-	if (retro.ntscconv)
-		push_ntsc(width, height, retro.ntsc_imb, outp);
+	clip_dims(&width, &height);
+	pixconv_xrgb8888(data, pitch,
+		outp, retro.shmcont.pitch, width, height, SHMIF_PIXORDER);
 }
 
-static void libretro_rgb1555_rgba(const uint16_t* data, uint32_t* outp,
+static void libretro_rgb1555_rgba(const uint16_t* data, shmif_pixel* outp,
 	unsigned width, unsigned height, size_t pitch, bool postfilter)
 {
-	uint16_t* interm = retro.ntsc_imb;
 	retro.colorspace = "RGB1555->RGBA";
 
-	unsigned dh = height >= ARCAN_SHMPAGE_MAXH ? ARCAN_SHMPAGE_MAXH : height;
-	unsigned dw =  width >= ARCAN_SHMPAGE_MAXW ? ARCAN_SHMPAGE_MAXW : width;
-
-	for (int y = 0; y < dh; y++){
-		for (int x = 0; x < dw; x++){
-			uint16_t val = data[x];
-			uint8_t r = ((val & 0x7c00) >> 10) << 3;
-			uint8_t g = ((val & 0x03e0) >>  5) << 3;
-			uint8_t b = ( val & 0x001f) <<  3;
-
-			if (postfilter)
-				*interm++ = RGB565(r, g, b);
-			else
-				*outp++ = RGBA(r, g, b, 0xff);
-		}
-
-		data += pitch >> 1;
+	if (postfilter){
+		pixconv_rgb1555_565(data, pitch,
+			retro.ntsc_imb, width, width, height, SHMIF_PIXORDER);
+		push_ntsc(width, height, retro.ntsc_imb, outp);
+		return;
 	}
 
-	if (postfilter)
-		push_ntsc(width, height, retro.ntsc_imb, outp);
+	clip_dims(&width, &height);
+	pixconv_rgb1555(data, pitch,
+		outp, retro.shmcont.pitch, width, height, SHMIF_PIXORDER);
 }
 
-
 static int testcounter;
 static void libretro_vidcb(const void* data, unsigned width,
 	unsigned height, size_t pitch)
@@ -532,6 +531,7 @@ static void libretro_skipnframes(unsigned count, bool fastfwd)
 
 	for (int i = 0; i < count; i++)
 		retro.run();
+	retro.state_pos += count;
 
 	if (fastfwd){
 		retro.aframecount = afc;
@@ -544,6 +544,46 @@ static void libretro_skipnframes(unsigned count, bool fastfwd)
 	retro.skipframe_v = false;
 }
 
+/*
+ * (re-)build the rewind store, needed for rollback (sized to the window
+ * unless a limit has been set) or if a rewind memory limit was provided
+ */
+static void setup_rewind()
+{
+	stateman_drop(&retro.rewind);
+	retro.rollback_window = 0;
+
+	if (!retro.state_sz || !retro.state_buf)
+		return;
+
+	ssize_t limit = retro.rewind_limit;
+	if (retro.skipmode <= TARGET_SKIP_ROLLBACK){
+		retro.rollback_window = (TARGET_SKIP_ROLLBACK - retro.skipmode) + 1;
+		if (retro.rollback_window > MAX_ROLLBACK)
+			retro.rollback_window = MAX_ROLLBACK;
+
+/* keep one full keyframe group behind the window */
+		if (!limit)
+			limit = -(retro.rollback_window + (retro.rewind_precision > 0 ?
+				retro.rewind_precision : retro.rollback_window));
+
+		LOG("setting input rollback (%d)\n", retro.rollback_window);
+	}
+	else if (!limit)
+		return;
+
+	retro.rewind = stateman_setup(retro.state_sz, limit, retro.rewind_precision);
+	if (!retro.rewind){
+		LOG("couldn't setup rewind store for %zu b states\n", retro.state_sz);
+		retro.rollback_window = 0;
+		return;
+	}
+
+/* since we can't be certain about our current vantage point...*/
+	if (retro.serialize(retro.state_buf, retro.state_sz))
+		stateman_feed(retro.rewind, retro.state_pos, retro.state_buf);
+}
+
 static void reset_timing(bool newstate)
 {
 	arcan_shmif_enqueue(&retro.shmcont, &(arcan_event){
@@ -558,24 +598,8 @@ static void reset_timing(bool newstate)
 		retro.rebasecount++;
 	}
 
-/* since we can't be certain about our current vantage point...*/
-	if (newstate && retro.skipmode <= TARGET_SKIP_ROLLBACK &&
-		retro.state_sz > 0){
-		retro.rollback_window = (TARGET_SKIP_ROLLBACK - retro.skipmode) + 1;
-		if (retro.rollback_window > 10)
-			retro.rollback_window = 10;
-
-		free(retro.rollback_state);
-		retro.rollback_state = malloc(retro.state_sz * retro.rollback_window);
-		retro.rollback_front = 0;
-
-		retro.serialize(retro.rollback_state, retro.state_sz);
-		for (int i=1; i < retro.rollback_window - 1; i++)
-			memcpy(retro.rollback_state + (i*retro.state_sz),
-				retro.rollback_state, retro.state_sz);
-
-		LOG("setting input rollback (%d)\n", retro.rollback_window);
-	}
+	if (newstate)
+		setup_rewind();
 }
 
 static void libretro_audscb(int16_t left, int16_t right)
@@ -948,19 +972,21 @@ static bool libretro_setenv(unsigned cmd, void* data){
 /*
  * this is quite sensitive to changes in libretro.h
  */
-static inline int16_t map_analog_axis(unsigned port, unsigned ind, unsigned id)
+static inline int16_t map_analog_axis(struct input_port* ports,
+	unsigned port, unsigned ind, unsigned id)
 {
 	ind *= 2;
 	ind += id;
 	assert(ind < MAX_AXES);
 
-	return (int16_t) retro.input_ports[port].axes[ind];
+	return (int16_t) ports[port].axes[ind];
 }
 
 /* use the context-tables from retro in combination with dev / ind / ... to
- * figure out what to return, this table is populated in flush_eventq(). */
-static inline int16_t libretro_inputmain(unsigned port, unsigned dev,
-	unsigned ind, unsigned id){
+ * figure out what to return, this table is populated in flush_eventq(). The
+ * run-ahead instance polls a snapshot of it instead, see run_ahead_second() */
+static inline int16_t libretro_inputmain(struct input_port* ports,
+	const char* kbdtbl, unsigned port, unsigned dev, unsigned ind, unsigned id){
 	static bool butn_warning = false;
 	static bool port_warning = false;
 
@@ -986,17 +1012,17 @@ static inline int16_t libretro_inputmain(unsigned port, unsigned dev,
 
 	switch (dev){
 		case RETRO_DEVICE_JOYPAD:
-			return (int16_t) retro.input_ports[port].buttons[id];
+			return (int16_t) ports[port].buttons[id];
 		break;
 
 		case RETRO_DEVICE_KEYBOARD:
 			if (id < RETROK_LAST)
-				rv |= retro.kbdtbl[id];
+				rv |= kbdtbl[id];
 		break;
 
 		case RETRO_DEVICE_MOUSE:
 			if (port == 1) port = 0;
-			inp = &retro.input_ports[port];
+			inp = &ports[port];
 			switch (id){
 				case RETRO_DEVICE_ID_MOUSE_LEFT:
 					return inp->buttons[ inp->cursor_btns[0] ];
@@ -1019,44 +1045,44 @@ static inline int16_t libretro_inputmain(unsigned port, unsigned dev,
 		case RETRO_DEVICE_LIGHTGUN:
 			switch (id){
 				case RETRO_DEVICE_ID_LIGHTGUN_X:
-					return (int16_t) retro.input_ports[port].axes[
-						retro.input_ports[port].cursor_x
+					return (int16_t) ports[port].axes[
+						ports[port].cursor_x
 					];
 
 				case RETRO_DEVICE_ID_LIGHTGUN_Y:
-					return (int16_t) retro.input_ports[port].axes[
-						retro.input_ports[port].cursor_y
+					return (int16_t) ports[port].axes[
+						ports[port].cursor_y
 					];
 
 				case RETRO_DEVICE_ID_LIGHTGUN_TRIGGER:
-					return (int16_t) retro.input_ports[port].buttons[
-						retro.input_ports[port].cursor_btns[0]
+					return (int16_t) ports[port].buttons[
+						ports[port].cursor_btns[0]
 					];
 
 				case RETRO_DEVICE_ID_LIGHTGUN_CURSOR:
-					return (int16_t) retro.input_ports[port].buttons[
-						retro.input_ports[port].cursor_btns[1]
+					return (int16_t) ports[port].buttons[
+						ports[port].cursor_btns[1]
 					];
 
 				case RETRO_DEVICE_ID_LIGHTGUN_START:
-					return (int16_t) retro.input_ports[port].buttons[
-					retro.input_ports[port].cursor_btns[2]
+					return (int16_t) ports[port].buttons[
+					ports[port].cursor_btns[2]
 				];
 
 					case RETRO_DEVICE_ID_LIGHTGUN_TURBO:
-					return (int16_t) retro.input_ports[port].buttons[
-					retro.input_ports[port].cursor_btns[3]
+					return (int16_t) ports[port].buttons[
+					ports[port].cursor_btns[3]
 				];
 
 				case RETRO_DEVICE_ID_LIGHTGUN_PAUSE:
-					return (int16_t) retro.input_ports[port].buttons[
-					retro.input_ports[port].cursor_btns[4]
+					return (int16_t) ports[port].buttons[
+					ports[port].cursor_btns[4]
 				];
 		}
 		break;
 
 		case RETRO_DEVICE_ANALOG:
-			return map_analog_axis(port, ind, id);
+			return map_analog_axis(ports, port, ind, id);
 
 		break;
 
@@ -1095,12 +1121,371 @@ static void enable_graphseg()
 static int16_t libretro_inputstate(unsigned port, unsigned dev,
 	unsigned ind, unsigned id)
 {
-	int16_t rv = libretro_inputmain(port, dev, ind, id);
+	int16_t rv = libretro_inputmain(
+		retro.input_ports, retro.kbdtbl, port, dev, ind, id);
 /* indirection to be used for debug graphing what inputs
  * the core actually requested */
 	return rv;
 }
 
+/*
+ * Run-ahead, removes [runahead] frames of the input lag that is built into
+ * the game itself (games commonly react to input a frame or two late). The
+ * real frame is run with video disabled and audio kept, then the state is
+ * saved, [runahead] more frames are run with the same input and without
+ * audio, the last of these is presented and the state is restored.
+ *
+ * With runahead_second, the speculative frames are instead run on a second
+ * instance of the core, on a thread of its own: it gets the state from
+ * before the real frame and a snapshot of the input, and runs the real
+ * frame plus [runahead] frames while the primary runs the real one. This
+ * trades a core for the added frame time, and only the serialize remains
+ * on the primary.
+ */
+struct runahead_inst {
+	void* lib;
+
+	void (*run)();
+	bool (*deserialize)(const void*, size_t);
+	void (*set_ioport)(unsigned, unsigned);
+
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool pending;
+
+/* input that the speculative frames poll, copied before each job */
+	struct input_port input_ports[MAX_PORTS];
+	char kbdtbl[RETROK_LAST];
+	bool optdirty;
+
+/* the core frame data is only valid during the callback, so the presented
+ * frame is kept and converted by the primary thread */
+	bool present, got_frame;
+	char* frame;
+	size_t frame_sz;
+	unsigned width, height;
+	size_t pitch;
+	int cost;
+};
+
+static void runahead_vidcb(const void* data, unsigned width,
+	unsigned height, size_t pitch)
+{
+	struct runahead_inst* inst = retro.second;
+	if (!inst->present || !data)
+		return;
+
+	size_t sz = pitch * height;
+	if (sz > inst->frame_sz){
+		char* frame = realloc(inst->frame, sz);
+		if (!frame)
+			return;
+		inst->frame = frame;
+		inst->frame_sz = sz;
+	}
+
+	memcpy(inst->frame, data, sz);
+	inst->width = width;
+	inst->height = height;
+	inst->pitch = pitch;
+	inst->got_frame = true;
+}
+
+static void runahead_audscb(int16_t left, int16_t right)
+{
+}
+
+static size_t runahead_audcb(const int16_t* data, size_t nframes)
+{
+	return nframes;
+}
+
+static int16_t runahead_inputstate(unsigned port, unsigned dev,
+	unsigned ind, unsigned id)
+{
+	return libretro_inputmain(retro.second->input_ports,
+		retro.second->kbdtbl, port, dev, ind, id);
+}
+
+static bool runahead_setenv(unsigned cmd, void* data)
+{
+	bool rv = true;
+
+	switch (cmd){
+/* already negotiated and forwarded to the parent by the primary */
+	case RETRO_ENVIRONMENT_SET_PIXEL_FORMAT:
+	case RETRO_ENVIRONMENT_SET_VARIABLES:
+	case RETRO_ENVIRONMENT_SET_SUPPORT_NO_GAME:
+	break;
+
+	case RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE:
+		rv = retro.second->optdirty;
+		if (data)
+			*(bool*)data = rv;
+		retro.second->optdirty = false;
+	break;
+
+	case RETRO_ENVIRONMENT_SHUTDOWN:
+	case RETRO_ENVIRONMENT_SET_HW_RENDER | RETRO_ENVIRONMENT_EXPERIMENTAL:
+	case RETRO_ENVIRONMENT_SET_HW_RENDER:
+		rv = false;
+	break;
+
+	default:
+		rv = libretro_setenv(cmd, data);
+	}
+
+	return rv;
+}
+
+static void* runahead_thread(void* arg)
+{
+	struct runahead_inst* inst = arg;
+
+	pthread_mutex_lock(&inst->lock);
+	for(;;){
+		while (!inst->pending)
+			pthread_cond_wait(&inst->cond, &inst->lock);
+		pthread_mutex_unlock(&inst->lock);
+
+		long long start = arcan_timemillis();
+		inst->got_frame = false;
+
+/* the real frame, then the speculative ones, only the last is presented */
+		if (inst->deserialize(retro.runahead_buf, retro.state_sz))
+			for (int i = 0; i <= retro.runahead; i++){
+				inst->present = i == retro.runahead;
+				inst->run();
+			}
+
+		inst->cost = arcan_timemillis() - start;
+
+		pthread_mutex_lock(&inst->lock);
+		inst->pending = false;
+		pthread_cond_signal(&inst->cond);
+	}
+
+	return NULL;
+}
+
+/*
+ * dlopen on the same path just returns the already loaded core, and cores
+ * keep their state in globals, so the second instance is loaded from a
+ * private copy of the library
+ */
+static void* load_core_copy(const char* libname)
+{
+	const char* tmpdir = getenv("TMPDIR");
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/arcan_retro_XXXXXX", tmpdir ? tmpdir : "/tmp");
+
+	int sfd = open(libname, O_RDONLY | O_CLOEXEC);
+	if (-1 == sfd)
+		return NULL;
+
+	int dfd = mkstemp(path);
+	if (-1 == dfd){
+		close(sfd);
+		return NULL;
+	}
+
+	char buf[65536];
+	ssize_t nr;
+	bool ok = true;
+	while (ok && (nr = read(sfd, buf, sizeof(buf))) != 0){
+		if (-1 == nr){
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			ok = false;
+			break;
+		}
+		ok = write_handle(buf, nr, dfd, false);
+	}
+	close(sfd);
+	close(dfd);
+
+	void* lib = ok ? dlopen(path, RTLD_NOW | RTLD_LOCAL) : NULL;
+	unlink(path);
+	return lib;
+}
+
+static bool setup_runahead_second(const char* libname)
+{
+	struct runahead_inst* inst = malloc(sizeof(struct runahead_inst));
+	if (!inst)
+		return false;
+
+	*inst = (struct runahead_inst){
+		.lib = load_core_copy(libname)
+	};
+
+	if (!inst->lib){
+		LOG("run-ahead: couldn't load a second instance of (%s)\n", libname);
+		free(inst);
+		return false;
+	}
+
+	void (*initf)() = dlsym(inst->lib, "retro_init");
+	void (*setenvf)(retro_environment_t) = dlsym(inst->lib, "retro_set_environment");
+	bool (*loadf)(const struct retro_game_info*) = dlsym(inst->lib, "retro_load_game");
+	size_t (*sizef)() = dlsym(inst->lib, "retro_serialize_size");
+	void (*vidf)(retro_video_refresh_t) = dlsym(inst->lib, "retro_set_video_refresh");
+	void (*audf)(retro_audio_sample_batch_t) =
+		dlsym(inst->lib, "retro_set_audio_sample_batch");
+	void (*audsf)(retro_audio_sample_t) = dlsym(inst->lib, "retro_set_audio_sample");
+	void (*pollf)(retro_input_poll_t) = dlsym(inst->lib, "retro_set_input_poll");
+	void (*inpf)(retro_input_state_t) = dlsym(inst->lib, "retro_set_input_state");
+	inst->run = dlsym(inst->lib, "retro_run");
+	inst->deserialize = dlsym(inst->lib, "retro_unserialize");
+	inst->set_ioport = dlsym(inst->lib, "retro_set_controller_port_device");
+
+	if (!initf || !setenvf || !loadf || !sizef || !vidf || !audf || !audsf ||
+		!pollf || !inpf || !inst->run || !inst->deserialize || !inst->set_ioport){
+		LOG("run-ahead: second instance is missing symbols\n");
+		goto fail;
+	}
+
+/* the callbacks reach the instance through retro.second */
+	retro.second = inst;
+	setenvf(runahead_setenv);
+	initf();
+	vidf(runahead_vidcb);
+	audf(runahead_audcb);
+	audsf(runahead_audscb);
+	pollf(libretro_pollcb);
+	inpf(runahead_inputstate);
+
+	if (!loadf(&retro.gameinfo) || sizef() != retro.state_sz){
+		LOG("run-ahead: second instance rejected the resource\n");
+		goto fail;
+	}
+
+	pthread_mutex_init(&inst->lock, NULL);
+	pthread_cond_init(&inst->cond, NULL);
+	if (0 != pthread_create(&inst->thread, NULL, runahead_thread, inst)){
+		LOG("run-ahead: couldn't spawn worker thread\n");
+		goto fail;
+	}
+
+	return true;
+
+/* the library isn't closed, the core may have left threads or atexit
+ * handlers behind that still point into it */
+fail:
+	retro.second = NULL;
+	free(inst);
+	return false;
+}
+
+static void setup_runahead(const char* libname)
+{
+	if (retro.runahead <= 0)
+		return;
+
+	if (retro.runahead > MAX_RUNAHEAD)
+		retro.runahead = MAX_RUNAHEAD;
+
+	if (retro.in_3d || !retro.state_sz ||
+		!(retro.runahead_buf = malloc(retro.state_sz))){
+		LOG("run-ahead requires a core with savestates and without 3D\n");
+		retro.runahead = 0;
+		return;
+	}
+
+	if (retro.runahead_second && !setup_runahead_second(libname)){
+		LOG("run-ahead: falling back to a single instance\n");
+		retro.runahead_second = false;
+	}
+
+	LOG("run-ahead: %d frames (%s)\n", retro.runahead,
+		retro.runahead_second ? "second instance" : "single instance");
+}
+
+static void run_ahead_single()
+{
+	process_frames(1, true, false);
+
+	long long start = arcan_timemillis();
+	if (!retro.serialize(retro.runahead_buf, retro.state_sz)){
+		LOG("run-ahead: serialization failed, disabling\n");
+		retro.runahead = 0;
+		return;
+	}
+
+/* only the presented frame counts for the frames / run() check */
+	retro.skipframe_a = true;
+	for (int i = 0; i < retro.runahead; i++){
+		retro.skipframe_v = i < retro.runahead - 1;
+		if (!retro.skipframe_v)
+			testcounter = 0;
+		retro.run();
+	}
+	retro.skipframe_a = false;
+	retro.skipframe_v = false;
+
+	retro.deserialize(retro.runahead_buf, retro.state_sz);
+	retro.runahead_cost = arcan_timemillis() - start;
+}
+
+static void run_ahead_second()
+{
+	struct runahead_inst* inst = retro.second;
+
+	long long start = arcan_timemillis();
+	if (!retro.serialize(retro.runahead_buf, retro.state_sz)){
+		LOG("run-ahead: serialization failed, disabling\n");
+		retro.runahead = 0;
+		process_frames(1, false, false);
+		return;
+	}
+
+	memcpy(inst->input_ports, retro.input_ports, sizeof(retro.input_ports));
+	memcpy(inst->kbdtbl, retro.kbdtbl, sizeof(retro.kbdtbl));
+
+	pthread_mutex_lock(&inst->lock);
+	inst->pending = true;
+	pthread_cond_signal(&inst->cond);
+	pthread_mutex_unlock(&inst->lock);
+	long long mid = arcan_timemillis();
+
+	process_frames(1, true, false);
+
+	long long wait = arcan_timemillis();
+	pthread_mutex_lock(&inst->lock);
+	while (inst->pending)
+		pthread_cond_wait(&inst->cond, &inst->lock);
+	pthread_mutex_unlock(&inst->lock);
+	long long stop = arcan_timemillis();
+
+/* the local run doesn't present, so only count a frame from the instance */
+	testcounter = 0;
+	if (inst->got_frame)
+		libretro_vidcb(inst->frame, inst->width, inst->height, inst->pitch);
+
+	retro.runahead_cost = (mid - start) + (stop - wait) +
+		(arcan_timemillis() - stop);
+	retro.runahead_second_cost = inst->cost;
+}
+
+/*
+ * run one frame with the configured run-ahead, video is left at the
+ * run-ahead frame (or empty), audio and the rewind store at the real one
+ */
+static void run_ahead()
+{
+/* the frame will be skipped anyhow, no point in looking ahead */
+	if (retro.skipframe_v){
+		process_frames(1, false, false);
+		return;
+	}
+
+	if (retro.second)
+		run_ahead_second();
+	else
+		run_ahead_single();
+}
+
 static int remaptbl[] = {
 	RETRO_DEVICE_ID_JOYPAD_A,
 	RETRO_DEVICE_ID_JOYPAD_B,
@@ -1332,11 +1717,15 @@ static inline void targetev(arcan_event* ev)
 
 		case TARGET_COMMAND_COREOPT:
 			retro.optdirty = true;
+			if (retro.second)
+				retro.second->optdirty = true;
 			update_corearg(tgt->code, tgt->message);
 		break;
 
 		case TARGET_COMMAND_SETIODEV:
 			retro.set_ioport(tgt->ioevs[0].iv, tgt->ioevs[1].iv);
+			if (retro.second)
+				retro.second->set_ioport(tgt->ioevs[0].iv, tgt->ioevs[1].iv);
 		break;
 
 /* should also emit a corresponding event back with the current framenumber */
@@ -1347,6 +1736,32 @@ static inline void targetev(arcan_event* ev)
 						retro.run();
 		break;
 
+/* relative (ioevs[0].iv != 1): ioevs[1].fv seconds from the current state,
+ * absolute: ioevs[1].fv seconds from the start of the session, both limited
+ * to what the rewind store still covers */
+		case TARGET_COMMAND_SEEKTIME:
+		{
+			if (!retro.rewind){
+				LOG("seek requested without rewind (see rewind=MiB argument)\n");
+				break;
+			}
+
+			int ofs = tgt->ioevs[1].fv * retro.avinfo.timing.fps;
+			int dst = tgt->ioevs[0].iv != 1 ? retro.state_pos + ofs : ofs;
+
+			long long start = arcan_timemillis();
+			if (stateman_seek(retro.rewind, retro.state_buf, dst, false) &&
+				retro.deserialize(retro.state_buf, retro.state_sz)){
+				retro.state_pos = stateman_position(retro.rewind);
+				LOG("seek to frame %d (%d requested), %lld ms\n",
+					retro.state_pos, dst, arcan_timemillis() - start);
+				reset_timing(false);
+			}
+			else
+				LOG("seek to frame %d failed\n", dst);
+		}
+		break;
+
 /* store / rewind operate on the last FD set through FDtransfer */
 		case TARGET_COMMAND_STORE:
 		{
@@ -1649,6 +2064,7 @@ static void setup_av()
 	LOG("video timing: %f fps (%f ms), audio samplerate: %f Hz\n",
 		(float)retro.avinfo.timing.fps, (float)retro.mspf,
 		(float)retro.avinfo.timing.sample_rate);
+	LOG("pixel conversion: %s\n", pixconv_impl_name());
 }
 
 static void setup_input()
@@ -1686,6 +2102,10 @@ static void dump_help()
 		" vbufc   \t num       \t (1) 1..4 - number of video buffers\n"
 		" abufc   \t num       \t (8) 1..16 - number of audio buffers\n"
 		" abufsz  \t num       \t audio buffer size in bytes (default = probe)\n"
+		" rewind  \t num       \t rewind store memory limit in MiB (0 = off)\n"
+		" rewind_key\t num     \t (60) frames between rewind keyframes\n"
+		" runahead\t num       \t (0) 0..8 - frames to run ahead of the input\n"
+		" runahead_second\t   \t run ahead on a second core instance/thread\n"
     " noreset \t           \t (3D) disable context reset calls\n"
     "---------\t-----------\t-----------------\n"
 	);
@@ -1729,6 +2149,17 @@ int	afsrv_game(struct arcan_shmif_cont* cont, struct arg_arr* args)
 		retro.def_abuf_sz = strtoul(val, NULL, 10);
 	}
 
+	if (arg_lookup(args, "rewind", 0, &val))
+		retro.rewind_limit = strtoul(val, NULL, 10) * 1024 * 1024;
+
+	if (arg_lookup(args, "rewind_key", 0, &val))
+		retro.rewind_precision = strtoul(val, NULL, 10);
+
+	if (arg_lookup(args, "runahead", 0, &val))
+		retro.runahead = strtoul(val, NULL, 10);
+
+	retro.runahead_second = arg_lookup(args, "runahead_second", 0, NULL);
+
 /* system directory doesn't really match any of arcan namespaces,
  * provide some kind of global-  user overridable way */
 	const char* spath = getenv("ARCAN_LIBRETRO_SYSPATH");
@@ -1831,8 +2262,14 @@ int	afsrv_game(struct arcan_shmif_cont* cont, struct arg_arr* args)
 /* some cores die on this kind of reset, retro.reset() e.g. NXengine
  * retro_reset() */
 
-	if (retro.state_sz > 0)
-		retro.rollback_state = malloc(retro.state_sz);
+	if (retro.state_sz > 0){
+		retro.state_buf = malloc(retro.state_sz);
+		setup_rewind();
+	}
+
+/* needs the game loaded and the state size, the second instance (if any)
+ * is loaded with the same resource */
+	setup_runahead(libname);
 
 /* basetime is used as epoch for all other timing calculations, run
  * an initial frame because sometimes first run can introduce a large stall */
@@ -1864,14 +2301,19 @@ int	afsrv_game(struct arcan_shmif_cont* cont, struct arg_arr* args)
 				TARGET_SKIP_STEP + 1, false);
 
 		else if (retro.skipmode <= TARGET_SKIP_ROLLBACK &&
-			retro.dirty_input){
-/* last entry will always be the current front */
-			retro.deserialize(retro.rollback_state +
-				retro.state_sz * retro.rollback_front, retro.state_sz);
+			retro.dirty_input && retro.rewind){
+/* the store may not reach the full window yet, replay what we got */
+			if (stateman_seek(retro.rewind,
+				retro.state_buf, retro.rollback_window - 1, true) &&
+				retro.deserialize(retro.state_buf, retro.state_sz)){
+				int back = retro.state_pos - stateman_position(retro.rewind);
+				retro.state_pos -= back;
 
 /* rollback to desired "point", run frame (which will consume input)
- * then roll forward to next video frame */
-			process_frames(retro.rollback_window - 1, true, true);
+ * then roll forward to next video frame, the replayed states replace
+ * the ones recorded with the old input */
+				process_frames(back, true, true);
+			}
 			retro.dirty_input = false;
 		}
 
@@ -1881,7 +2323,11 @@ int	afsrv_game(struct arcan_shmif_cont* cont, struct arg_arr* args)
  * testing by adding delays at various key synchronization points */
 		start = arcan_timemillis();
 			add_jitter(retro.jitterstep);
-			process_frames(1, false, false);
+			if (retro.runahead > 0 && retro.skipmode > TARGET_SKIP_ROLLBACK &&
+				retro.skipmode < TARGET_SKIP_STEP)
+				run_ahead();
+			else
+				process_frames(1, false, false);
 		stop = arcan_timemillis();
 		retro.framecost = stop - start;
 		if (retro.sync_data){
@@ -1939,14 +2385,16 @@ static void push_stats()
 	long long int timestamp = arcan_timemillis();
 
 	snprintf(scratch, 512, "%s, %s\n"
-		"%s, %f fps, %f Hz\n"
+		"%s (%s), %f fps, %f Hz\n"
 		"Mode: %d, Preaudio: %d\n Jitter: %d/%d\n"
 		"(A,V - A/V) %lld, %lld - %lld\n"
 		"Real (Hz): %f\n"
-		"cost,wake,xfer: %d, %d, %d ms \n",
+		"cost,wake,xfer: %d, %d, %d ms \n"
+		"Run-ahead: %d, +%d ms (second: %d ms)\n",
 		(char*)retro.sysinfo.library_name,
 		(char*)retro.sysinfo.library_version,
 		(char*)retro.colorspace,
+		pixconv_impl_name(),
 		(float)retro.avinfo.timing.fps,
 		(float)retro.avinfo.timing.sample_rate,
 		retro.skipmode, retro.preaudiogen,
@@ -1955,7 +2403,8 @@ static void push_stats()
 		retro.aframecount / retro.vframecount,
 		1000.0f * (float)retro.aframecount /
 			(float)(timestamp - retro.basetime),
-		retro.framecost, retro.prewake, retro.transfercost
+		retro.framecost, retro.prewake, retro.transfercost,
+		retro.runahead, retro.runahead_cost, retro.runahead_second_cost
 	);
 
 	if (!retro.sync_data->update(
@@ -12,6 +12,16 @@
 #include "tsm/libtsm.h"
 #include "tsm/libtsm_int.h"
 #include "tsm/shl-pty.h"
+#include "tsm/shl-ring.h"
+
+/*
+ * upper bound for how much pty output we buffer ahead of the parser, when
+ * reached the client gets blocked on write until we've caught up
+ */
+#define PTY_RING_CAP (4 * 1024 * 1024)
+
+/* how much to feed the state machine between each deadline check */
+#define PTY_PARSE_STEP (64 * 1024)
 
 static struct {
 	struct tui_context* screen;
@@ -19,6 +29,16 @@ static struct {
 	struct shl_pty* pty;
 	pid_t child;
 
+/* pty output that has been read but not yet parsed */
+	struct shl_ring ring;
+
+/* time (ms) we may spend parsing before the screen gets refreshed */
+	unsigned long long budget;
+
+/* accumulated ingestion throughput, for tracing */
+	size_t parsed_bytes;
+	unsigned long long parsed_ms;
+
 	bool alive;
 	long last_input;
 } term;
@@ -35,26 +55,59 @@ static inline void trace(const char* msg, ...)
 }
 
 /*
- * process one round of PTY input, this is non-blocking
+ * process as much PTY input as we can get within the time budget, this is
+ * non-blocking. Returns true if there is output left in the ring, meaning
+ * that the budget ran out and the caller should refresh and come back
+ * without waiting for the pty.
  */
-void pump_pty()
+static bool pump_pty()
 {
-	int count = 10;
-	while (term.alive && count--){
-		int rv = shl_pty_dispatch(term.pty);
+	unsigned long long start = arcan_timemillis();
+	size_t total = 0;
+
+	while (term.alive){
+		int rv = shl_pty_drain(term.pty, &term.ring, PTY_RING_CAP);
 		if (rv == -ENODEV){
 			term.alive = false;
+			break;
 		}
-		else if (rv == -EAGAIN){
-			continue;
-		}
-		else if (rv > 0){
+		else if (rv > 0)
 			term.last_input = arcan_timemillis();
+
+		if (!shl_ring_get_size(&term.ring))
 			break;
+
+/* feed in steps so that a big backlog doesn't blow the deadline */
+		struct iovec vec[2];
+		size_t nvec = shl_ring_peek(&term.ring, vec);
+		size_t step = 0;
+
+		for (size_t i = 0; i < nvec && step < PTY_PARSE_STEP; i++){
+			size_t nb = vec[i].iov_len;
+			if (nb > PTY_PARSE_STEP - step)
+				nb = PTY_PARSE_STEP - step;
+
+			tsm_vte_input(term.vte, vec[i].iov_base, nb);
+			step += nb;
 		}
-		else
+
+		shl_ring_pull(&term.ring, step);
+		total += step;
+
+		if (arcan_timemillis() - start >= term.budget)
 			break;
 	}
+
+	if (total){
+		unsigned long long elapsed = arcan_timemillis() - start;
+		term.parsed_bytes += total;
+		term.parsed_ms += elapsed;
+		trace("pty: %zu bytes in %llu ms (%zu pending, %.2f MB/s overall)",
+			total, elapsed, shl_ring_get_size(&term.ring), term.parsed_ms ?
+			(double)term.parsed_bytes / 1048.576 / (double)term.parsed_ms : 0.0);
+	}
+
+	return shl_ring_get_size(&term.ring) > 0;
 }
 
 static void dump_help()
@@ -77,6 +130,7 @@ static void dump_help()
 		" blink       \t ticks     \t set blink period, 0 to disable (default: 12)\n"
 		" login       \t [user]    \t login (optional: user, only works for root)\n"
 		" min_upd     \t ms        \t wait at least [ms] between refreshes (default: 30)\n"
+		" pty_budget  \t ms        \t max time to parse output between refreshes (default: 16)\n"
 		" substitute  \t           \t (experimental) allow ligature substitution\n"
 		" shape       \t           \t (experimental) allow non-monospace font shaping\n"
 		" scroll      \t steps     \t (experimental) smooth scrolling, (default:0=off) steps px/upd\n"
@@ -340,6 +394,10 @@ int afsrv_terminal(struct arcan_shmif_cont* con, struct arg_arr* args)
 	if (arg_lookup(args, "min_wait", 0, &val))
 		cap_timeout = strtol(val, NULL, 10);
 
+	term.budget = 16;
+	if (arg_lookup(args, "pty_budget", 0, &val))
+		term.budget = strtoul(val, NULL, 10);
+
 	struct tui_cbcfg cbcfg = {
 		.input_mouse_motion = on_mouse_motion,
 		.input_mouse_button = on_mouse_button,
@@ -450,6 +508,7 @@ int afsrv_terminal(struct arcan_shmif_cont* con, struct arg_arr* args)
  * with a pending render refactor to move it upstream, any synch will be much
  * more deterministic so better to wait for that */
 	while (term.alive){
+		bool backlog;
 		do {
 			int delta = arcan_timemillis() - last_frame;
 			if (delta < cap_refresh)
@@ -457,20 +516,22 @@ int afsrv_terminal(struct arcan_shmif_cont* con, struct arg_arr* args)
 			else
 				delta = 0;
 
+/* with output still pending we only want to flush the event queue, then
+ * present what we have, the pty will be readable again anyhow */
 			int ptyfd = shl_pty_get_fd(term.pty);
-			pump_pty();
+			backlog = pump_pty();
 			struct tui_process_res res =
-				arcan_tui_process(&term.screen, 1, &ptyfd, 1, delta);
+				arcan_tui_process(&term.screen, 1, &ptyfd, 1, backlog ? 0 : delta);
 
 			if (res.errc < TUI_ERRC_OK || res.bad){
 				goto out;
 			}
 		}
 		while (
-			tsm_vte_inseq(term.vte) || (
+			!backlog && (tsm_vte_inseq(term.vte) || (
 				arcan_timemillis() - term.last_input < cap_refresh &&
 				arcan_timemillis() - last_frame < cap_timeout
-			)
+			))
 		);
 
 /* and on an actually successful update, reset the user-input flag and timing */
@@ -487,6 +548,7 @@ int afsrv_terminal(struct arcan_shmif_cont* con, struct arg_arr* args)
 	out:
 	if (term.pty)
 		term.pty = (shl_pty_close(term.pty), NULL);
+	shl_ring_clear(&term.ring);
 
 /* don't care about cleaning up vte really */
 	arcan_tui_destroy(term.screen, NULL);
@@ -440,6 +440,48 @@ int shl_pty_dispatch(struct shl_pty *pty)
 	return r;
 }
 
+int shl_pty_drain(struct shl_pty *pty, struct shl_ring *dst, size_t cap)
+{
+	ssize_t len;
+	size_t nr = 0, want;
+	int r = 0;
+
+	if (!shl_pty_is_open(pty))
+		return -ENODEV;
+
+	/*
+	 * Unlike pty_read() we keep on reading until the kernel side runs dry
+	 * (or @dst is full) and leave the parsing to the caller, that way it can
+	 * consume in large blocks and decide on its own when to stop.
+	 */
+
+	while (shl_ring_get_size(dst) < cap) {
+		want = cap - shl_ring_get_size(dst);
+		if (want > sizeof(pty->in_buf))
+			want = sizeof(pty->in_buf);
+
+		len = read(pty->fd, pty->in_buf, want);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN)
+				r = -errno;
+			break;
+		} else if (!len) {
+			r = -EPIPE;
+			break;
+		}
+
+		r = shl_ring_push(dst, pty->in_buf, (size_t)len);
+		if (r < 0)
+			break;
+		nr += len;
+	}
+
+	pty_write(pty);
+	return nr > 0 ? (int)nr : r;
+}
+
 int shl_pty_write(struct shl_pty *pty, const char *u8, size_t len)
 {
 	if (!shl_pty_is_open(pty))
@@ -23,6 +23,7 @@
 /* pty */
 
 struct shl_pty;
+struct shl_ring;
 
 typedef void (*shl_pty_input_fn) (struct shl_pty *pty,
 				  void *data,
@@ -50,6 +51,14 @@ int shl_pty_get_fd(struct shl_pty *pty);
 pid_t shl_pty_get_child(struct shl_pty *pty);
 
 int shl_pty_dispatch(struct shl_pty *pty);
+
+/*
+ * Read everything that is pending on the pty into @dst without invoking the
+ * input callback, stopping early if @dst would grow past @cap bytes. Pending
+ * output is flushed as with shl_pty_dispatch. Returns the number of bytes
+ * read, 0 if nothing was pending or a negative error code.
+ */
+int shl_pty_drain(struct shl_pty *pty, struct shl_ring *dst, size_t cap);
 int shl_pty_write(struct shl_pty *pty, const char *u8, size_t len);
 int shl_pty_signal(struct shl_pty *pty, int sig);
 int shl_pty_resize(struct shl_pty *pty,
@@ -49,6 +49,9 @@
 #include <errno.h>
 #include <stdarg.h>
 #include <inttypes.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "libtsm_int.h"
 
 /* Input parser states */
@@ -841,6 +844,7 @@ void tsm_vte_reset(struct tsm_vte *vte)
 	arcan_tui_set_flags(vte->con, TUI_AUTO_WRAP);
 
 	tsm_utf8_mach_reset(vte->mach);
+	vte->mach_state = TSM_UTF8_START;
 	vte->state = STATE_GROUND;
 	vte->gl = &vte->g0;
 	vte->gr = &vte->g1;
@@ -2638,18 +2642,140 @@ static void parse_data(struct tsm_vte *vte, uint32_t raw)
 	DEBUG_LOG(vte, "unhandled input %u in state %d", raw, vte->state);
 }
 
+/*
+ * Length of the prefix of [u8] that is plain printable ASCII (0x20 - 0x7e)
+ */
+static size_t printable_prefix(const uint8_t *u8, size_t len)
+{
+	size_t i = 0;
+
+#ifdef __SSE2__
+/* shift the printable range to the bottom of the signed range so that it
+ * takes a single compare: 0x20..0x7e + 0x60 = -128..-34 */
+	const __m128i bias = _mm_set1_epi8(0x60);
+	const __m128i lim = _mm_set1_epi8(-33);
+
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)&u8[i]);
+		v = _mm_add_epi8(v, bias);
+		unsigned mask = _mm_movemask_epi8(_mm_cmplt_epi8(v, lim));
+		if (mask != 0xffff)
+			return i + __builtin_ctz(~mask);
+	}
+#endif
+
+	for (; i < len; i++)
+		if (u8[i] < 0x20 || u8[i] > 0x7e)
+			break;
+
+	return i;
+}
+
+/*
+ * Decode one complete multibyte UTF-8 sequence from the start of [u8] if it
+ * encodes a printable codepoint outside of C1, returns the number of bytes
+ * consumed or 0 if it has to go through the parser.
+ */
+static size_t printable_utf8(const uint8_t *u8, size_t len, uint32_t *out)
+{
+	uint32_t cp;
+	size_t n, i;
+
+	if (u8[0] >= 0xc2 && u8[0] <= 0xdf) {
+		n = 2;
+		cp = u8[0] & 0x1f;
+	} else if (u8[0] >= 0xe0 && u8[0] <= 0xef) {
+		n = 3;
+		cp = u8[0] & 0x0f;
+	} else if (u8[0] >= 0xf0 && u8[0] <= 0xf4) {
+		n = 4;
+		cp = u8[0] & 0x07;
+	} else
+		return 0;
+
+	if (n > len)
+		return 0;
+
+	for (i = 1; i < n; i++) {
+		if ((u8[i] & 0xc0) != 0x80)
+			return 0;
+		cp = (cp << 6) | (u8[i] & 0x3f);
+	}
+
+/* overlong, surrogates, out of range and the C1 block */
+	if ((n == 3 && cp < 0x800) || (n == 4 && cp < 0x10000) ||
+		(cp >= 0xd800 && cp <= 0xdfff) || cp > 0x10ffff || cp < 0xa0)
+		return 0;
+
+	*out = cp;
+	return n;
+}
+
+/*
+ * Most output is runs of text in the ground state with the default charsets,
+ * that would go through the state machine and on to the screen one symbol at
+ * a time. Collect such runs here and write them with a single attribute
+ * conversion and screen call, returns the number of bytes consumed.
+ */
+#define PRINT_RUN_SZ 256
+static size_t print_run(struct tsm_vte *vte, const uint8_t *u8, size_t len)
+{
+	uint32_t run[PRINT_RUN_SZ];
+	size_t pos = 0, n = 0;
+	bool utf8 = !(vte->flags & (FLAG_7BIT_MODE | FLAG_8BIT_MODE));
+
+	if (vte->state != STATE_GROUND || vte->glt || vte->grt ||
+		*vte->gl != &tsm_vte_unicode_lower ||
+		*vte->gr != &tsm_vte_unicode_upper)
+		return 0;
+
+/* partial sequence from an earlier call */
+	if (utf8 && vte->mach_state >= TSM_UTF8_EXPECT1)
+		return 0;
+
+	while (pos < len && n < PRINT_RUN_SZ) {
+		size_t step = printable_prefix(&u8[pos], len - pos);
+		if (step > PRINT_RUN_SZ - n)
+			step = PRINT_RUN_SZ - n;
+
+		for (size_t i = 0; i < step; i++)
+			run[n++] = u8[pos + i];
+		pos += step;
+
+		if (n == PRINT_RUN_SZ || pos == len)
+			break;
+
+		if (!utf8 || !(step = printable_utf8(&u8[pos], len - pos, &run[n])))
+			break;
+
+		n++;
+		pos += step;
+	}
+
+	if (n) {
+		to_rgb(vte, false);
+		arcan_tui_writeucs4(vte->con, run, n, &vte->cattr);
+	}
+
+	return pos;
+}
+
 SHL_EXPORT
 void tsm_vte_input(struct tsm_vte *vte, const char *u8, size_t len)
 {
-	int state;
 	uint32_t ucs4;
-	size_t i;
+	size_t i, run;
 
 	if (!vte || !vte->con)
 		return;
 
 	++vte->parse_cnt;
 	for (i = 0; i < len; ++i) {
+		if ((run = print_run(vte, (const uint8_t*)&u8[i], len - i))) {
+			i += run - 1;
+			continue;
+		}
+
 		if (vte->flags & FLAG_7BIT_MODE) {
 			if (u8[i] & 0x80)
 				DEBUG_LOG(vte, "receiving 8bit character U+%d from pty while in 7bit mode",
@@ -2658,9 +2784,9 @@ void tsm_vte_input(struct tsm_vte *vte, const char *u8, size_t len)
 		} else if (vte->flags & FLAG_8BIT_MODE) {
 			parse_data(vte, u8[i]);
 		} else {
-			state = tsm_utf8_mach_feed(vte->mach, u8[i]);
-			if (state == TSM_UTF8_ACCEPT ||
-			    state == TSM_UTF8_REJECT) {
+			vte->mach_state = tsm_utf8_mach_feed(vte->mach, u8[i]);
+			if (vte->mach_state == TSM_UTF8_ACCEPT ||
+			    vte->mach_state == TSM_UTF8_REJECT) {
 				ucs4 = tsm_utf8_mach_get(vte->mach);
 				parse_data(vte, ucs4);
 			}
@@ -0,0 +1,773 @@
+/*
+ * Copyright 2019, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ * Description: Pixel format conversion kernels, see pixconv.h
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "pixconv.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define PIXCONV_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PIXCONV_ARM
+#include <arm_neon.h>
+#endif
+
+/*
+ * The kernels work on one row at a time, the SIMD versions handle whatever
+ * doesn't fill a vector at the end of the row with the scalar version.
+ *
+ * 5/6 bit expansion: (v * 527 + 23) >> 6 and (v * 259 + 33) >> 6 are exact
+ * for round(v * 255 / 31) and round(v * 255 / 63) and stay within 16 bits,
+ * so they map to 16-bit multiplies in all the vector versions.
+ */
+typedef void (*row32_fn)(const void* src, uint32_t* dst,
+	size_t n, enum pixconv_order order);
+
+typedef void (*row16_fn)(const void* src, uint16_t* dst,
+	size_t n, enum pixconv_order order);
+
+struct pixconv_ops {
+	enum pixconv_impl impl;
+	const char* name;
+	row32_fn rgb565, rgb1555, xrgb8888;
+	row16_fn rgb565_565, rgb1555_565, xrgb8888_565;
+};
+
+static inline uint32_t pack_px(uint32_t r,
+	uint32_t g, uint32_t b, enum pixconv_order order)
+{
+	if (order == PIXCONV_ORDER_RGBA)
+		return 0xff000000 | (b << 16) | (g << 8) | r;
+	else
+		return 0xff000000 | (r << 16) | (g << 8) | b;
+}
+
+static void rgb565_scalar(const void* src,
+	uint32_t* dst, size_t n, enum pixconv_order order)
+{
+	const uint16_t* s = src;
+	for (size_t i = 0; i < n; i++){
+		uint32_t r = s[i] >> 11;
+		uint32_t g = (s[i] >> 5) & 0x3f;
+		uint32_t b = s[i] & 0x1f;
+		dst[i] = pack_px(
+			(r * 527 + 23) >> 6, (g * 259 + 33) >> 6, (b * 527 + 23) >> 6, order);
+	}
+}
+
+static void rgb1555_scalar(const void* src,
+	uint32_t* dst, size_t n, enum pixconv_order order)
+{
+	const uint16_t* s = src;
+	for (size_t i = 0; i < n; i++)
+		dst[i] = pack_px(((s[i] >> 10) & 0x1f) << 3,
+			((s[i] >> 5) & 0x1f) << 3, (s[i] & 0x1f) << 3, order);
+}
+
+static void xrgb8888_scalar(const void* src,
+	uint32_t* dst, size_t n, enum pixconv_order order)
+{
+	const uint32_t* s = src;
+	if (order == PIXCONV_ORDER_BGRA){
+		for (size_t i = 0; i < n; i++)
+			dst[i] = s[i] | 0xff000000;
+		return;
+	}
+
+	for (size_t i = 0; i < n; i++){
+		uint32_t rb = s[i] & 0x00ff00ff;
+		dst[i] = 0xff000000 | (rb << 16) | (rb >> 16) | (s[i] & 0x0000ff00);
+	}
+}
+
+/*
+ * The 565 intermediate follows the output order, r in the low bits for RGBA,
+ * so that the 0x00RRGGBB that the NTSC filter produces lands in shmif order.
+ */
+static void rgb565_565_scalar(const void* src,
+	uint16_t* dst, size_t n, enum pixconv_order order)
+{
+	const uint16_t* s = src;
+	if (order == PIXCONV_ORDER_BGRA){
+		memcpy(dst, s, n * sizeof(uint16_t));
+		return;
+	}
+
+	for (size_t i = 0; i < n; i++)
+		dst[i] = (s[i] << 11) | (s[i] & 0x07e0) | (s[i] >> 11);
+}
+
+static void rgb1555_565_scalar(const void* src,
+	uint16_t* dst, size_t n, enum pixconv_order order)
+{
+	const uint16_t* s = src;
+	if (order == PIXCONV_ORDER_BGRA)
+		for (size_t i = 0; i < n; i++)
+			dst[i] = ((s[i] & 0x7fe0) << 1) | (s[i] & 0x1f);
+	else
+		for (size_t i = 0; i < n; i++)
+			dst[i] = (s[i] << 11) | ((s[i] & 0x03e0) << 1) | ((s[i] >> 10) & 0x1f);
+}
+
+static void xrgb8888_565_scalar(const void* src,
+	uint16_t* dst, size_t n, enum pixconv_order order)
+{
+	const uint32_t* s = src;
+	if (order == PIXCONV_ORDER_BGRA)
+		for (size_t i = 0; i < n; i++)
+			dst[i] = ((s[i] >> 8) & 0xf800) |
+				((s[i] >> 5) & 0x07e0) | ((s[i] >> 3) & 0x1f);
+	else
+		for (size_t i = 0; i < n; i++)
+			dst[i] = ((s[i] << 8) & 0xf800) |
+				((s[i] >> 5) & 0x07e0) | ((s[i] >> 19) & 0x1f);
+}
+
+#ifdef PIXCONV_X86
+/* 8 pixels as 16-bit r, g, b lanes into 2x4 32-bit pixels */
+static inline void store8_sse2(uint32_t* dst,
+	__m128i r, __m128i g, __m128i b, enum pixconv_order order)
+{
+	const __m128i alpha = _mm_set1_epi16(0xff00);
+	__m128i lo, hi;
+
+	if (order == PIXCONV_ORDER_RGBA){
+		lo = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+		hi = _mm_or_si128(b, alpha);
+	}
+	else {
+		lo = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+		hi = _mm_or_si128(r, alpha);
+	}
+
+	_mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi16(lo, hi));
+	_mm_storeu_si128((__m128i*)&dst[4], _mm_unpackhi_epi16(lo, hi));
+}
+
+static void rgb565_sse2(const void* src,
+	uint32_t* dst, size_t n, enum pixconv_order order)
+{
+	const uint16_t* s = src;
+	const __m128i m5 = _mm_set1_epi16(0x1f), m6 = _mm_set1_epi16(0x3f);
+	const __m128i k5 = _mm_set1_epi16(527), c5 = _mm_set1_epi16(23);
+	const __m128i k6 = _mm_set1_epi16(259), c6 = _mm_set1_epi16(33);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8){
+		__m128i v = _mm_loadu_si128((const __m128i*)&s[i]);
+		__m128i r = _mm_srli_epi16(v, 11);
+		__m128i g = _mm_and_si128(_mm_srli_epi16(v, 5), m6);
+		__m128i b = _mm_and_si128(v, m5);
+
+		r = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(r, k5), c5), 6);
+		g = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(g, k6), c6), 6);
+		b = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(b, k5), c5), 6);
+		store8_sse2(&dst[i], r, g, b, order);
+	}
+
+	rgb565_scalar(&s[i], &dst[i], n - i, order);
+}
+
+static void rgb1555_sse2(const void* src,
+	uint32_t* dst, size_t n, enum pixconv_order order)
+{
+	const uint16_t* s = src;
+	const __m128i m5 = _mm_set1_epi16(0x1f);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8){
+		__m128i v = _mm_loadu_si128((const __m128i*)&s[i]);
+		__m128i r = _mm_slli_epi16(_mm_and_si128(_mm_srli_epi16(v, 10), m5), 3);
+		__m128i g = _mm_slli_epi16(_mm_and_si128(_mm_srli_epi16(v, 5), m5), 3);
+		__m128i b = _mm_slli_epi16(_mm_and_si128(v, m5), 3);
+		store8_sse2(&dst[i], r, g, b, order);
+	}
+
+	rgb1555_scalar(&s[i], &dst[i], n - i, order);
+}
+
+static void xrgb8888_sse2(const void* src,
+	uint32_t* dst, size_t n, enum pixconv_order order)
+{
+	const uint32_t* s = src;
+	const __m128i alpha = _mm_set1_epi32(0xff000000);
+	const __m128i mrb = _mm_set1_epi32(0x00ff00ff);
+	const __m128i mg = _mm_set1_epi32(0x0000ff00);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4){
+		__m128i v = _mm_loadu_si128((const __m128i*)&s[i]);
+		if (order == PIXCONV_ORDER_RGBA){
+			__m128i rb = _mm_and_si128(v, mrb);
+			v = _mm_or_si128(_mm_and_si128(v, mg),
+				_mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16)));
+		}
+		_mm_storeu_si128((__m128i*)&dst[i], _mm_or_si128(v, alpha));
+	}
+
+	xrgb8888_scalar(&s[i], &dst[i], n - i, order);
+}
+
+static void rgb565_565_sse2(const void* src,
+	uint16_t* dst, size_t n, enum pixconv_order order)
+{
+	const uint16_t* s = src;
+	const __m128i mg = _mm_set1_epi16(0x07e0);
+	size_t i = 0;
+
+	if (order == PIXCONV_ORDER_RGBA)
+		for (; i + 8 <= n; i += 8){
+			__m128i v = _mm_loadu_si128((const __m128i*)&s[i]);
+			v = _mm_or_si128(_mm_and_si128(v, mg),
+				_mm_or_si128(_mm_slli_epi16(v, 11), _mm_srli_epi16(v, 11)));
+			_mm_storeu_si128((__m128i*)&dst[i], v);
+		}
+
+	rgb565_565_scalar(&s[i], &dst[i], n - i, order);
+}
+
+static void rgb1555_565_sse2(const void* src,
+	uint16_t* dst, size_t n, enum pixconv_order order)
+{
+	const uint16_t* s = src;
+	const __m128i mrg = _mm_set1_epi16(0x7fe0), mg = _mm_set1_epi16(0x03e0);
+	const __m128i m5 = _mm_set1_epi16(0x1f);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8){
+		__m128i v = _mm_loadu_si128((const __m128i*)&s[i]);
+		if (order == PIXCONV_ORDER_BGRA)
+			v = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(v, mrg), 1), _mm_and_si128(v, m5));
+		else
+			v = _mm_or_si128(
+				_mm_or_si128(_mm_slli_epi16(v, 11), _mm_slli_epi16(_mm_and_si128(v, mg), 1)),
+				_mm_and_si128(_mm_srli_epi16(v, 10), m5)
+			);
+		_mm_storeu_si128((__m128i*)&dst[i], v);
+	}
+
+	rgb1555_565_scalar(&s[i], &dst[i], n - i, order);
+}
+
+/* 4 xrgb pixels into 565 in the low half of each lane, sign- extended so
+ * that the signed saturating pack (SSE2 has no unsigned 32->16) is exact */
+static inline __m128i xrgb_565_sse2(__m128i v, enum pixconv_order order)
+{
+	__m128i hi = order == PIXCONV_ORDER_BGRA ?
+		_mm_srli_epi32(v, 8) : _mm_slli_epi32(v, 8);
+	__m128i lo = order == PIXCONV_ORDER_BGRA ?
+		_mm_srli_epi32(v, 3) : _mm_srli_epi32(v, 19);
+
+	__m128i p = _mm_or_si128(
+		_mm_and_si128(hi, _mm_set1_epi32(0xf800)),
+		_mm_or_si128(
+			_mm_and_si128(_mm_srli_epi32(v, 5), _mm_set1_epi32(0x07e0)),
+			_mm_and_si128(lo, _mm_set1_epi32(0x001f))
+		)
+	);
+	return _mm_srai_epi32(_mm_slli_epi32(p, 16), 16);
+}
+
+static void xrgb8888_565_sse2(const void* src,
+	uint16_t* dst, size_t n, enum pixconv_order order)
+{
+	const uint32_t* s = src;
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8){
+		__m128i a = xrgb_565_sse2(_mm_loadu_si128((const __m128i*)&s[i]), order);
+		__m128i b = xrgb_565_sse2(_mm_loadu_si128((const __m128i*)&s[i + 4]), order);
+		_mm_storeu_si128((__m128i*)&dst[i], _mm_packs_epi32(a, b));
+	}
+
+	xrgb8888_565_scalar(&s[i], &dst[i], n - i, order);
+}
+
+/*
+ * AVX2 versions, only called after __builtin_cpu_supports. Unpack and pack
+ * work within 128-bit lanes, so the results are permuted back into order.
+ */
+#define AVX2_FN __attribute__((target("avx2")))
+
+static inline AVX2_FN void store16_avx2(uint32_t* dst,
+	__m256i r, __m256i g, __m256i b, enum pixconv_order order)
+{
+	const __m256i alpha = _mm256_set1_epi16(0xff00);
+	__m256i lo, hi;
+
+	if (order == PIXCONV_ORDER_RGBA){
+		lo = _mm256_or_si256(r, _mm256_slli_epi16(g, 8));
+		hi = _mm256_or_si256(b, alpha);
+	}
+	else {
+		lo = _mm256_or_si256(b, _mm256_slli_epi16(g, 8));
+		hi = _mm256_or_si256(r, alpha);
+	}
+
+/* a: 0-3, 8-11, b: 4-7, 12-15 */
+	__m256i a = _mm256_unpacklo_epi16(lo, hi);
+	__m256i c = _mm256_unpackhi_epi16(lo, hi);
+	_mm256_storeu_si256((__m256i*)dst, _mm256_permute2x128_si256(a, c, 0x20));
+	_mm256_storeu_si256((__m256i*)&dst[8], _mm256_permute2x128_si256(a, c, 0x31));
+}
+
+static AVX2_FN void rgb565_avx2(const void* src,
+	uint32_t* dst, size_t n, enum pixconv_order order)
+{
+	const uint16_t* s = src;
+	const __m256i m5 = _mm256_set1_epi16(0x1f), m6 = _mm256_set1_epi16(0x3f);
+	const __m256i k5 = _mm256_set1_epi16(527), c5 = _mm256_set1_epi16(23);
+	const __m256i k6 = _mm256_set1_epi16(259), c6 = _mm256_set1_epi16(33);
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16){
+		__m256i v = _mm256_loadu_si256((const __m256i*)&s[i]);
+		__m256i r = _mm256_srli_epi16(v, 11);
+		__m256i g = _mm256_and_si256(_mm256_srli_epi16(v, 5), m6);
+		__m256i b = _mm256_and_si256(v, m5);
+
+		r = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(r, k5), c5), 6);
+		g = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(g, k6), c6), 6);
+		b = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(b, k5), c5), 6);
+		store16_avx2(&dst[i], r, g, b, order);
+	}
+
+	rgb565_sse2(&s[i], &dst[i], n - i, order);
+}
+
+static AVX2_FN void rgb1555_avx2(const void* src,
+	uint32_t* dst, size_t n, enum pixconv_order order)
+{
+	const uint16_t* s = src;
+	const __m256i m5 = _mm256_set1_epi16(0x1f);
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16){
+		__m256i v = _mm256_loadu_si256((const __m256i*)&s[i]);
+		__m256i r = _mm256_slli_epi16(_mm256_and_si256(_mm256_srli_epi16(v, 10), m5), 3);
+		__m256i g = _mm256_slli_epi16(_mm256_and_si256(_mm256_srli_epi16(v, 5), m5), 3);
+		__m256i b = _mm256_slli_epi16(_mm256_and_si256(v, m5), 3);
+		store16_avx2(&dst[i], r, g, b, order);
+	}
+
+	rgb1555_sse2(&s[i], &dst[i], n - i, order);
+}
+
+static AVX2_FN void xrgb8888_avx2(const void* src,
+	uint32_t* dst, size_t n, enum pixconv_order order)
+{
+	const uint32_t* s = src;
+	size_t i = 0;
+
+/* no lane crossing needed here, a byte shuffle covers the swap */
+	const __m256i alpha = _mm256_set1_epi32(0xff000000);
+	const __m256i swap = _mm256_setr_epi8(
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15
+	);
+
+	for (; i + 8 <= n; i += 8){
+		__m256i v = _mm256_loadu_si256((const __m256i*)&s[i]);
+		if (order == PIXCONV_ORDER_RGBA)
+			v = _mm256_shuffle_epi8(v, swap);
+		_mm256_storeu_si256((__m256i*)&dst[i], _mm256_or_si256(v, alpha));
+	}
+
+	xrgb8888_sse2(&s[i], &dst[i], n - i, order);
+}
+
+static AVX2_FN void rgb565_565_avx2(const void* src,
+	uint16_t* dst, size_t n, enum pixconv_order order)
+{
+	const uint16_t* s = src;
+	const __m256i mg = _mm256_set1_epi16(0x07e0);
+	size_t i = 0;
+
+	if (order == PIXCONV_ORDER_RGBA)
+		for (; i + 16 <= n; i += 16){
+			__m256i v = _mm256_loadu_si256((const __m256i*)&s[i]);
+			v = _mm256_or_si256(_mm256_and_si256(v, mg),
+				_mm256_or_si256(_mm256_slli_epi16(v, 11), _mm256_srli_epi16(v, 11)));
+			_mm256_storeu_si256((__m256i*)&dst[i], v);
+		}
+
+	rgb565_565_sse2(&s[i], &dst[i], n - i, order);
+}
+
+static AVX2_FN void rgb1555_565_avx2(const void* src,
+	uint16_t* dst, size_t n, enum pixconv_order order)
+{
+	const uint16_t* s = src;
+	const __m256i mrg = _mm256_set1_epi16(0x7fe0), mg = _mm256_set1_epi16(0x03e0);
+	const __m256i m5 = _mm256_set1_epi16(0x1f);
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16){
+		__m256i v = _mm256_loadu_si256((const __m256i*)&s[i]);
+		if (order == PIXCONV_ORDER_BGRA)
+			v = _mm256_or_si256(
+				_mm256_slli_epi16(_mm256_and_si256(v, mrg), 1), _mm256_and_si256(v, m5));
+		else
+			v = _mm256_or_si256(
+				_mm256_or_si256(_mm256_slli_epi16(v, 11),
+					_mm256_slli_epi16(_mm256_and_si256(v, mg), 1)),
+				_mm256_and_si256(_mm256_srli_epi16(v, 10), m5)
+			);
+		_mm256_storeu_si256((__m256i*)&dst[i], v);
+	}
+
+	rgb1555_565_sse2(&s[i], &dst[i], n - i, order);
+}
+
+static inline AVX2_FN __m256i xrgb_565_avx2(__m256i v, enum pixconv_order order)
+{
+	__m256i hi = order == PIXCONV_ORDER_BGRA ?
+		_mm256_srli_epi32(v, 8) : _mm256_slli_epi32(v, 8);
+	__m256i lo = order == PIXCONV_ORDER_BGRA ?
+		_mm256_srli_epi32(v, 3) : _mm256_srli_epi32(v, 19);
+
+	return _mm256_or_si256(
+		_mm256_and_si256(hi, _mm256_set1_epi32(0xf800)),
+		_mm256_or_si256(
+			_mm256_and_si256(_mm256_srli_epi32(v, 5), _mm256_set1_epi32(0x07e0)),
+			_mm256_and_si256(lo, _mm256_set1_epi32(0x001f))
+		)
+	);
+}
+
+static AVX2_FN void xrgb8888_565_avx2(const void* src,
+	uint16_t* dst, size_t n, enum pixconv_order order)
+{
+	const uint32_t* s = src;
+	size_t i = 0;
+
+/* AVX2 has the unsigned pack, result quads are 0-3, 8-11, 4-7, 12-15 */
+	for (; i + 16 <= n; i += 16){
+		__m256i a = xrgb_565_avx2(_mm256_loadu_si256((const __m256i*)&s[i]), order);
+		__m256i b = xrgb_565_avx2(_mm256_loadu_si256((const __m256i*)&s[i + 8]), order);
+		_mm256_storeu_si256((__m256i*)&dst[i],
+			_mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xd8));
+	}
+
+	xrgb8888_565_sse2(&s[i], &dst[i], n - i, order);
+}
+#endif
+
+#ifdef PIXCONV_ARM
+/* interleaving stores do the packing */
+static inline void store8_neon(uint32_t* dst,
+	uint16x8_t r, uint16x8_t g, uint16x8_t b, enum pixconv_order order)
+{
+	uint8x8x4_t px;
+	px.val[order == PIXCONV_ORDER_RGBA ? 0 : 2] = vmovn_u16(r);
+	px.val[1] = vmovn_u16(g);
+	px.val[order == PIXCONV_ORDER_RGBA ? 2 : 0] = vmovn_u16(b);
+	px.val[3] = vdup_n_u8(0xff);
+	vst4_u8((uint8_t*)dst, px);
+}
+
+static void rgb565_neon(const void* src,
+	uint32_t* dst, size_t n, enum pixconv_order order)
+{
+	const uint16_t* s = src;
+	const uint16x8_t m5 = vdupq_n_u16(0x1f), m6 = vdupq_n_u16(0x3f);
+	const uint16x8_t c5 = vdupq_n_u16(23), c6 = vdupq_n_u16(33);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8){
+		uint16x8_t v = vld1q_u16(&s[i]);
+		uint16x8_t r = vshrq_n_u16(v, 11);
+		uint16x8_t g = vandq_u16(vshrq_n_u16(v, 5), m6);
+		uint16x8_t b = vandq_u16(v, m5);
+
+		r = vshrq_n_u16(vmlaq_n_u16(c5, r, 527), 6);
+		g = vshrq_n_u16(vmlaq_n_u16(c6, g, 259), 6);
+		b = vshrq_n_u16(vmlaq_n_u16(c5, b, 527), 6);
+		store8_neon(&dst[i], r, g, b, order);
+	}
+
+	rgb565_scalar(&s[i], &dst[i], n - i, order);
+}
+
+static void rgb1555_neon(const void* src,
+	uint32_t* dst, size_t n, enum pixconv_order order)
+{
+	const uint16_t* s = src;
+	const uint16x8_t m5 = vdupq_n_u16(0x1f);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8){
+		uint16x8_t v = vld1q_u16(&s[i]);
+		uint16x8_t r = vshlq_n_u16(vandq_u16(vshrq_n_u16(v, 10), m5), 3);
+		uint16x8_t g = vshlq_n_u16(vandq_u16(vshrq_n_u16(v, 5), m5), 3);
+		uint16x8_t b = vshlq_n_u16(vandq_u16(v, m5), 3);
+		store8_neon(&dst[i], r, g, b, order);
+	}
+
+	rgb1555_scalar(&s[i], &dst[i], n - i, order);
+}
+
+static void xrgb8888_neon(const void* src,
+	uint32_t* dst, size_t n, enum pixconv_order order)
+{
+	const uint32_t* s = src;
+	size_t i = 0;
+
+/* deinterleaved as b, g, r, x */
+	for (; i + 8 <= n; i += 8){
+		uint8x8x4_t px = vld4_u8((const uint8_t*)&s[i]);
+		if (order == PIXCONV_ORDER_RGBA){
+			uint8x8_t tmp = px.val[0];
+			px.val[0] = px.val[2];
+			px.val[2] = tmp;
+		}
+		px.val[3] = vdup_n_u8(0xff);
+		vst4_u8((uint8_t*)&dst[i], px);
+	}
+
+	xrgb8888_scalar(&s[i], &dst[i], n - i, order);
+}
+
+static void rgb565_565_neon(const void* src,
+	uint16_t* dst, size_t n, enum pixconv_order order)
+{
+	const uint16_t* s = src;
+	const uint16x8_t mg = vdupq_n_u16(0x07e0);
+	size_t i = 0;
+
+	if (order == PIXCONV_ORDER_RGBA)
+		for (; i + 8 <= n; i += 8){
+			uint16x8_t v = vld1q_u16(&s[i]);
+			vst1q_u16(&dst[i], vorrq_u16(vandq_u16(v, mg),
+				vorrq_u16(vshlq_n_u16(v, 11), vshrq_n_u16(v, 11))));
+		}
+
+	rgb565_565_scalar(&s[i], &dst[i], n - i, order);
+}
+
+static void rgb1555_565_neon(const void* src,
+	uint16_t* dst, size_t n, enum pixconv_order order)
+{
+	const uint16_t* s = src;
+	const uint16x8_t mrg = vdupq_n_u16(0x7fe0), mg = vdupq_n_u16(0x03e0);
+	const uint16x8_t m5 = vdupq_n_u16(0x1f);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8){
+		uint16x8_t v = vld1q_u16(&s[i]);
+		if (order == PIXCONV_ORDER_BGRA)
+			v = vorrq_u16(vshlq_n_u16(vandq_u16(v, mrg), 1), vandq_u16(v, m5));
+		else
+			v = vorrq_u16(
+				vorrq_u16(vshlq_n_u16(v, 11), vshlq_n_u16(vandq_u16(v, mg), 1)),
+				vandq_u16(vshrq_n_u16(v, 10), m5)
+			);
+		vst1q_u16(&dst[i], v);
+	}
+
+	rgb1555_565_scalar(&s[i], &dst[i], n - i, order);
+}
+
+static void xrgb8888_565_neon(const void* src,
+	uint16_t* dst, size_t n, enum pixconv_order order)
+{
+	const uint32_t* s = src;
+	size_t hi = order == PIXCONV_ORDER_BGRA ? 2 : 0;
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8){
+		uint8x8x4_t px = vld4_u8((const uint8_t*)&s[i]);
+		uint16x8_t c0 = vshlq_n_u16(vmovl_u8(vshr_n_u8(px.val[hi], 3)), 11);
+		uint16x8_t c1 = vshlq_n_u16(vmovl_u8(vshr_n_u8(px.val[1], 2)), 5);
+		uint16x8_t c2 = vmovl_u8(vshr_n_u8(px.val[2 - hi], 3));
+		vst1q_u16(&dst[i], vorrq_u16(vorrq_u16(c0, c1), c2));
+	}
+
+	xrgb8888_565_scalar(&s[i], &dst[i], n - i, order);
+}
+#endif
+
+static const struct pixconv_ops impls[] = {
+	{
+		.impl = PIXCONV_SCALAR,
+		.name = "scalar",
+		.rgb565 = rgb565_scalar,
+		.rgb1555 = rgb1555_scalar,
+		.xrgb8888 = xrgb8888_scalar,
+		.rgb565_565 = rgb565_565_scalar,
+		.rgb1555_565 = rgb1555_565_scalar,
+		.xrgb8888_565 = xrgb8888_565_scalar
+	},
+#ifdef PIXCONV_X86
+	{
+		.impl = PIXCONV_SSE2,
+		.name = "sse2",
+		.rgb565 = rgb565_sse2,
+		.rgb1555 = rgb1555_sse2,
+		.xrgb8888 = xrgb8888_sse2,
+		.rgb565_565 = rgb565_565_sse2,
+		.rgb1555_565 = rgb1555_565_sse2,
+		.xrgb8888_565 = xrgb8888_565_sse2
+	},
+	{
+		.impl = PIXCONV_AVX2,
+		.name = "avx2",
+		.rgb565 = rgb565_avx2,
+		.rgb1555 = rgb1555_avx2,
+		.xrgb8888 = xrgb8888_avx2,
+		.rgb565_565 = rgb565_565_avx2,
+		.rgb1555_565 = rgb1555_565_avx2,
+		.xrgb8888_565 = xrgb8888_565_avx2
+	},
+#endif
+#ifdef PIXCONV_ARM
+	{
+		.impl = PIXCONV_NEON,
+		.name = "neon",
+		.rgb565 = rgb565_neon,
+		.rgb1555 = rgb1555_neon,
+		.xrgb8888 = xrgb8888_neon,
+		.rgb565_565 = rgb565_565_neon,
+		.rgb1555_565 = rgb1555_565_neon,
+		.xrgb8888_565 = xrgb8888_565_neon
+	},
+#endif
+};
+
+static const struct pixconv_ops* active;
+
+static bool impl_supported(enum pixconv_impl impl)
+{
+#ifdef PIXCONV_X86
+	if (impl == PIXCONV_AVX2){
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+	}
+#endif
+	return true;
+}
+
+static const struct pixconv_ops* find_impl(enum pixconv_impl impl)
+{
+	for (size_t i = 0; i < sizeof(impls) / sizeof(impls[0]); i++)
+		if (impls[i].impl == impl && impl_supported(impl))
+			return &impls[i];
+	return NULL;
+}
+
+bool pixconv_set_impl(enum pixconv_impl impl)
+{
+	if (impl != PIXCONV_AUTO){
+		const struct pixconv_ops* ops = find_impl(impl);
+		if (ops)
+			active = ops;
+		return ops != NULL;
+	}
+
+	const char* env = getenv("ARCAN_PIXCONV");
+	if (env){
+		for (size_t i = 0; i < sizeof(impls) / sizeof(impls[0]); i++)
+			if (strcasecmp(env, impls[i].name) == 0 && impl_supported(impls[i].impl)){
+				active = &impls[i];
+				return true;
+			}
+	}
+
+/* table is in order of preference */
+	for (size_t i = sizeof(impls) / sizeof(impls[0]); i > 0; i--)
+		if (impl_supported(impls[i - 1].impl)){
+			active = &impls[i - 1];
+			break;
+		}
+
+	return true;
+}
+
+const char* pixconv_impl_name()
+{
+	if (!active)
+		pixconv_set_impl(PIXCONV_AUTO);
+	return active->name;
+}
+
+static void conv32(row32_fn fn, const void* src, size_t src_pitch,
+	uint32_t* dst, size_t dst_pitch, size_t w, size_t h, enum pixconv_order order)
+{
+	const uint8_t* s = src;
+	for (size_t y = 0; y < h; y++, s += src_pitch, dst += dst_pitch)
+		fn(s, dst, w, order);
+}
+
+static void conv16(row16_fn fn, const void* src, size_t src_pitch,
+	uint16_t* dst, size_t dst_pitch, size_t w, size_t h, enum pixconv_order order)
+{
+	const uint8_t* s = src;
+	for (size_t y = 0; y < h; y++, s += src_pitch, dst += dst_pitch)
+		fn(s, dst, w, order);
+}
+
+void pixconv_rgb565(const void* src, size_t src_pitch,
+	uint32_t* dst, size_t dst_pitch, size_t w, size_t h,
+	enum pixconv_order order)
+{
+	if (!active)
+		pixconv_set_impl(PIXCONV_AUTO);
+	conv32(active->rgb565, src, src_pitch, dst, dst_pitch, w, h, order);
+}
+
+void pixconv_rgb1555(const void* src, size_t src_pitch,
+	uint32_t* dst, size_t dst_pitch, size_t w, size_t h,
+	enum pixconv_order order)
+{
+	if (!active)
+		pixconv_set_impl(PIXCONV_AUTO);
+	conv32(active->rgb1555, src, src_pitch, dst, dst_pitch, w, h, order);
+}
+
+void pixconv_xrgb8888(const void* src, size_t src_pitch,
+	uint32_t* dst, size_t dst_pitch, size_t w, size_t h,
+	enum pixconv_order order)
+{
+	if (!active)
+		pixconv_set_impl(PIXCONV_AUTO);
+	conv32(active->xrgb8888, src, src_pitch, dst, dst_pitch, w, h, order);
+}
+
+void pixconv_rgb565_565(const void* src, size_t src_pitch,
+	uint16_t* dst, size_t dst_pitch, size_t w, size_t h,
+	enum pixconv_order order)
+{
+	if (!active)
+		pixconv_set_impl(PIXCONV_AUTO);
+	conv16(active->rgb565_565, src, src_pitch, dst, dst_pitch, w, h, order);
+}
+
+void pixconv_rgb1555_565(const void* src, size_t src_pitch,
+	uint16_t* dst, size_t dst_pitch, size_t w, size_t h,
+	enum pixconv_order order)
+{
+	if (!active)
+		pixconv_set_impl(PIXCONV_AUTO);
+	conv16(active->rgb1555_565, src, src_pitch, dst, dst_pitch, w, h, order);
+}
+
+void pixconv_xrgb8888_565(const void* src, size_t src_pitch,
+	uint16_t* dst, size_t dst_pitch, size_t w, size_t h,
+	enum pixconv_order order)
+{
+	if (!active)
+		pixconv_set_impl(PIXCONV_AUTO);
+	conv16(active->xrgb8888_565, src, src_pitch, dst, dst_pitch, w, h, order);
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2019, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ * Description: Pixel format conversion from the packed formats that
+ * emulators and other legacy sources produce (RGB565, 0RGB1555, XRGB8888)
+ * into shmif_pixel, with SIMD kernels picked at runtime. Kept free from
+ * shmif dependencies so that it can be built into tests/core/pixconvbench.
+ */
+
+#ifndef HAVE_PIXCONV
+#define HAVE_PIXCONV
+
+/* byte order of the 32-bit output, RGBA means r in the low byte */
+enum pixconv_order {
+	PIXCONV_ORDER_RGBA = 0,
+	PIXCONV_ORDER_BGRA = 1
+};
+
+enum pixconv_impl {
+	PIXCONV_AUTO = 0,
+	PIXCONV_SCALAR,
+	PIXCONV_SSE2,
+	PIXCONV_AVX2,
+	PIXCONV_NEON
+};
+
+/*
+ * Pick the implementation used by the conversion functions. AUTO selects
+ * the best one the CPU supports (and is what is used if this is never
+ * called), the ARCAN_PIXCONV environment variable (scalar, sse2, avx2,
+ * neon) can be used to override that. Returns false if [impl] is not
+ * available in this build or on this CPU.
+ */
+bool pixconv_set_impl(enum pixconv_impl impl);
+const char* pixconv_impl_name();
+
+/*
+ * Convert [w*h] pixels from [src] into [dst], alpha is set to 0xff. Pitches
+ * are in bytes for the source (as the cores provide them) and in pixels for
+ * the destination (as shmif provides them). Channel expansion matches the
+ * lookup tables this replaced: 5 and 6 bit channels in RGB565 are rounded
+ * to the full range, 0RGB1555 channels are shifted.
+ */
+void pixconv_rgb565(const void* src, size_t src_pitch,
+	uint32_t* dst, size_t dst_pitch, size_t w, size_t h,
+	enum pixconv_order order);
+
+void pixconv_rgb1555(const void* src, size_t src_pitch,
+	uint32_t* dst, size_t dst_pitch, size_t w, size_t h,
+	enum pixconv_order order);
+
+void pixconv_xrgb8888(const void* src, size_t src_pitch,
+	uint32_t* dst, size_t dst_pitch, size_t w, size_t h,
+	enum pixconv_order order);
+
+/*
+ * Same sources, but into a packed 16-bit intermediate (e.g. for the NTSC
+ * filter), [dst_pitch] in pixels. [order] is that of the final output: for
+ * RGBA the intermediate is BGR565 (r in the low bits) so that a filter that
+ * produces 0x00RRGGBB from RGB565 ends up with the channels in shmif order.
+ */
+void pixconv_rgb565_565(const void* src, size_t src_pitch,
+	uint16_t* dst, size_t dst_pitch, size_t w, size_t h,
+	enum pixconv_order order);
+
+void pixconv_rgb1555_565(const void* src, size_t src_pitch,
+	uint16_t* dst, size_t dst_pitch, size_t w, size_t h,
+	enum pixconv_order order);
+
+void pixconv_xrgb8888_565(const void* src, size_t src_pitch,
+	uint16_t* dst, size_t dst_pitch, size_t w, size_t h,
+	enum pixconv_order order);
+
+#endif
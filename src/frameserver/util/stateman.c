@@ -1,13 +1,23 @@
 /*
- * Arcan Hijack/Frameserver State Manager (incomplete)
+ * Arcan Hijack/Frameserver State Manager
  * Copyright 2014-2016, Björn Ståhl
  * License: 3-Clause BSD, see COPYING file in arcan source repository.
  * Reference: http://arcan-fe.com
  */
 
 /*
- * Still just a stub, nothing to see here. The plan is to add
- * per-session state tracking and use that to enable rewinding.
+ * Rewind store for serialized states. Every state is XORed against the one
+ * before it, and the result is stored as runs of [skip, literal] where the
+ * literal is the nonzero part of the XOR. For emulator states, most of the
+ * block (ROM mirrors, VRAM that didn't change, ...) cancels out, so a delta
+ * is typically a few percent of the state size.
+ *
+ * Every 'precision' states, a keyframe is stored instead (the same encoding
+ * against an all- zero block) so that reconstruction has a bounded number of
+ * deltas to apply, and so that the oldest states can be dropped in groups
+ * (keyframe + its deltas) when the memory limit is reached.
+ *
+ * If the encoded form would be larger than the raw XOR, the raw XOR is kept.
  */
 
 #include <stdlib.h>
@@ -18,29 +28,368 @@
 
 #include "stateman.h"
 
+#define DEFAULT_PRECISION 60
+
+/* a zero run shorter than this is cheaper to keep in the literal than to
+ * start a new [skip, literal] group over */
+#define MIN_SKIP 8
+
+struct state_entry {
+	int tstamp;
+	bool key;
+	bool rle;
+	size_t len;
+	uint8_t* data;
+};
+
 struct stateman_ctx {
-	int range_start, range_end;
+	size_t state_sz;
+	ssize_t limit;
+	int precision;
+
+/* reconstructed state at cursor, deltas for new states are built against it */
+	uint8_t* last;
+	uint8_t* scratch;
+
+	struct state_entry* entries;
+	size_t n_entries, n_alloc;
+	size_t bytes;
+
+/* index into entries that [last] corresponds to */
+	ssize_t cursor;
 };
 
+static void put_u32(uint8_t* dst, uint32_t v)
+{
+	memcpy(dst, &v, 4);
+}
+
+static uint32_t get_u32(const uint8_t* src)
+{
+	uint32_t v;
+	memcpy(&v, src, 4);
+	return v;
+}
+
+static inline uint8_t xb(const uint8_t* cur, const uint8_t* ref, size_t i)
+{
+	return ref ? cur[i] ^ ref[i] : cur[i];
+}
+
+/*
+ * encode cur ^ ref (ref == NULL: cur) into out, fails if that would need
+ * cap bytes or more. An unchanged state encodes to 0 bytes.
+ */
+static bool delta_encode(const uint8_t* cur,
+	const uint8_t* ref, size_t n, uint8_t* out, size_t cap, size_t* len)
+{
+	size_t pos = 0, op = 0;
+
+	while (pos < n){
+		size_t skip_start = pos;
+
+/* word- wise for the common case of long unchanged spans */
+		while (pos + 8 <= n){
+			uint64_t a, b = 0;
+			memcpy(&a, &cur[pos], 8);
+			if (ref)
+				memcpy(&b, &ref[pos], 8);
+			if (a != b)
+				break;
+			pos += 8;
+		}
+		while (pos < n && xb(cur, ref, pos) == 0)
+			pos++;
+
+		if (pos == n)
+			break;
+
+		size_t lit_start = pos;
+		for(;;){
+			while (pos < n && xb(cur, ref, pos) != 0)
+				pos++;
+
+			size_t z = 0;
+			while (pos + z < n && z < MIN_SKIP && xb(cur, ref, pos + z) == 0)
+				z++;
+
+			if (z >= MIN_SKIP || pos + z == n)
+				break;
+			pos += z;
+		}
+
+		size_t lit = pos - lit_start;
+		if (op + 8 + lit >= cap)
+			return false;
+
+		put_u32(&out[op], skip_start == lit_start ? 0 : lit_start - skip_start);
+		put_u32(&out[op + 4], lit);
+		op += 8;
+
+		for (size_t i = 0; i < lit; i++)
+			out[op + i] = xb(cur, ref, lit_start + i);
+		op += lit;
+	}
+
+	*len = op;
+	return true;
+}
+
+static void delta_apply(uint8_t* dst, size_t n, struct state_entry* ent)
+{
+	if (!ent->rle){
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8){
+			uint64_t a, b;
+			memcpy(&a, &dst[i], 8);
+			memcpy(&b, &ent->data[i], 8);
+			a ^= b;
+			memcpy(&dst[i], &a, 8);
+		}
+		for (; i < n; i++)
+			dst[i] ^= ent->data[i];
+		return;
+	}
+
+	size_t pos = 0, ip = 0;
+	while (ip + 8 <= ent->len){
+		pos += get_u32(&ent->data[ip]);
+		size_t lit = get_u32(&ent->data[ip + 4]);
+		ip += 8;
+		if (pos + lit > n || ip + lit > ent->len)
+			return;
+
+		for (size_t i = 0; i < lit; i++)
+			dst[pos + i] ^= ent->data[ip + i];
+		pos += lit;
+		ip += lit;
+	}
+}
+
+static void drop_range(struct stateman_ctx* ctx, size_t start, size_t end)
+{
+	for (size_t i = start; i < end; i++){
+		ctx->bytes -= ctx->entries[i].len;
+		free(ctx->entries[i].data);
+	}
+
+	memmove(&ctx->entries[start], &ctx->entries[end],
+		sizeof(struct state_entry) * (ctx->n_entries - end));
+	ctx->n_entries -= end - start;
+}
+
+static bool over_limit(struct stateman_ctx* ctx)
+{
+	if (ctx->limit < 0)
+		return ctx->n_entries > (size_t)(-ctx->limit);
+	return ctx->limit > 0 && ctx->bytes > (size_t)ctx->limit;
+}
+
+/* drop the oldest keyframe group as long as there is a newer one to keep */
+static void enforce_limit(struct stateman_ctx* ctx)
+{
+	while (over_limit(ctx)){
+		size_t next = 1;
+		while (next < ctx->n_entries && !ctx->entries[next].key)
+			next++;
+
+		if (next >= ctx->n_entries)
+			return;
+
+		drop_range(ctx, 0, next);
+		ctx->cursor -= next;
+	}
+}
+
 struct stateman_ctx* stateman_setup(size_t state_sz,
-	ssize_t limit, int precision){
-	return NULL;
+	ssize_t limit, int precision)
+{
+	if (!state_sz)
+		return NULL;
+
+	struct stateman_ctx* res = malloc(sizeof(struct stateman_ctx));
+	if (!res)
+		return NULL;
+
+	*res = (struct stateman_ctx){
+		.state_sz = state_sz,
+		.limit = limit,
+		.precision = precision > 0 ? precision : DEFAULT_PRECISION,
+		.last = malloc(state_sz),
+		.scratch = malloc(state_sz),
+		.cursor = -1
+	};
+
+	if (!res->last || !res->scratch){
+		stateman_drop(&res);
+		return NULL;
+	}
+
+	return res;
 }
 
 void stateman_feed(struct stateman_ctx* ctx, int tstamp, void* inbuf)
 {
-	if (!ctx)
+	if (!ctx || !inbuf)
 		return;
+
+/* branch: anything after the cursor or not before tstamp is gone, and the
+ * cursor entry itself must be older or the delta base would be wrong */
+	if (ctx->cursor + 1 < (ssize_t) ctx->n_entries)
+		drop_range(ctx, ctx->cursor + 1, ctx->n_entries);
+
+	while (ctx->n_entries && ctx->entries[ctx->n_entries - 1].tstamp >= tstamp){
+		drop_range(ctx, ctx->n_entries - 1, ctx->n_entries);
+		ctx->cursor = -1;
+	}
+
+	if (ctx->n_entries == ctx->n_alloc){
+		size_t nc = ctx->n_alloc ? ctx->n_alloc * 2 : 64;
+		struct state_entry* ne = realloc(ctx->entries, nc * sizeof(struct state_entry));
+		if (!ne)
+			return;
+		ctx->entries = ne;
+		ctx->n_alloc = nc;
+	}
+
+/* a keyframe is needed when there is no valid delta base, or when the last
+ * keyframe is 'precision' states back */
+	bool key = ctx->cursor < 0 || ctx->n_entries == 0;
+	if (!key){
+		size_t back = 0;
+		ssize_t i = ctx->n_entries - 1;
+		while (i >= 0 && !ctx->entries[i].key){
+			i--;
+			back++;
+		}
+		key = back + 1 >= (size_t) ctx->precision;
+	}
+
+	uint8_t* cur = inbuf;
+	const uint8_t* ref = key ? NULL : ctx->last;
+	size_t len;
+	bool rle = delta_encode(cur, ref, ctx->state_sz, ctx->scratch, ctx->state_sz, &len);
+	if (!rle)
+		len = ctx->state_sz;
+
+	uint8_t* data = NULL;
+	if (len && !(data = malloc(len)))
+		return;
+
+	if (rle){
+		if (len)
+			memcpy(data, ctx->scratch, len);
+	}
+	else if (key)
+		memcpy(data, cur, len);
+	else
+		for (size_t i = 0; i < len; i++)
+			data[i] = cur[i] ^ ref[i];
+
+	ctx->entries[ctx->n_entries++] = (struct state_entry){
+		.tstamp = tstamp,
+		.key = key,
+		.rle = rle,
+		.len = len,
+		.data = data
+	};
+	ctx->bytes += len;
+	ctx->cursor = ctx->n_entries - 1;
+	memcpy(ctx->last, cur, ctx->state_sz);
+
+	enforce_limit(ctx);
 }
 
 bool stateman_seek(struct stateman_ctx* ctx, void* dstbuf, int tstamp, bool rel)
 {
-	return false;
+	if (!ctx || !ctx->n_entries)
+		return false;
+
+	if (rel)
+		tstamp = ctx->entries[ctx->n_entries - 1].tstamp - tstamp;
+
+/* newest state at or before tstamp, clamped to the oldest one we have */
+	size_t ind = ctx->n_entries - 1;
+	while (ind > 0 && ctx->entries[ind].tstamp > tstamp)
+		ind--;
+
+	if ((ssize_t) ind != ctx->cursor){
+		ssize_t key = ind, end = ind + 1;
+		while (key > 0 && !ctx->entries[key].key)
+			key--;
+		while (end < (ssize_t) ctx->n_entries && !ctx->entries[end].key)
+			end++;
+
+/* within the same group, walk from the cursor: forward applies the deltas
+ * after it, and as they are XORs, backward applies the ones down to ind */
+		if (ctx->cursor >= key && ctx->cursor < end){
+			if (ctx->cursor < (ssize_t) ind)
+				for (ssize_t i = ctx->cursor + 1; i <= (ssize_t) ind; i++)
+					delta_apply(ctx->last, ctx->state_sz, &ctx->entries[i]);
+			else
+				for (ssize_t i = ctx->cursor; i > (ssize_t) ind; i--)
+					delta_apply(ctx->last, ctx->state_sz, &ctx->entries[i]);
+		}
+		else {
+			struct state_entry* kf = &ctx->entries[key];
+			if (kf->rle){
+				memset(ctx->last, '\0', ctx->state_sz);
+				delta_apply(ctx->last, ctx->state_sz, kf);
+			}
+			else
+				memcpy(ctx->last, kf->data, ctx->state_sz);
+
+			for (ssize_t i = key + 1; i <= (ssize_t) ind; i++)
+				delta_apply(ctx->last, ctx->state_sz, &ctx->entries[i]);
+		}
+
+		ctx->cursor = ind;
+	}
+
+	if (dstbuf)
+		memcpy(dstbuf, ctx->last, ctx->state_sz);
+
+	return true;
+}
+
+int stateman_position(struct stateman_ctx* ctx)
+{
+	if (!ctx || ctx->cursor < 0)
+		return -1;
+
+	return ctx->entries[ctx->cursor].tstamp;
+}
+
+void stateman_stats(struct stateman_ctx* ctx, struct stateman_stats* out)
+{
+	if (!out)
+		return;
+
+	*out = (struct stateman_stats){.first = -1, .last = -1};
+	if (!ctx)
+		return;
+
+	out->n_states = ctx->n_entries;
+	out->bytes = ctx->bytes;
+	for (size_t i = 0; i < ctx->n_entries; i++)
+		out->n_keyframes += ctx->entries[i].key;
+
+	if (ctx->n_entries){
+		out->first = ctx->entries[0].tstamp;
+		out->last = ctx->entries[ctx->n_entries - 1].tstamp;
+	}
 }
 
 void stateman_drop(struct stateman_ctx** dst)
 {
 	if (!dst || *dst == NULL)
 		return;
-}
 
+	struct stateman_ctx* ctx = *dst;
+	drop_range(ctx, 0, ctx->n_entries);
+	free(ctx->entries);
+	free(ctx->last);
+	free(ctx->scratch);
+	free(ctx);
+	*dst = NULL;
+}
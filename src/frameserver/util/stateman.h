@@ -11,6 +11,8 @@
  * state_sz defines block size
  * limit sets upper memory bounds in frames (limit( < 0)) or bytes
  * when reached, new frames will be added at the cost of old ones.
+ * precision is the number of states between each keyframe (<= 0, default),
+ * lower values trade memory for shorter seeks.
  */
 struct stateman_ctx* stateman_setup(size_t state_sz,
 	ssize_t limit, int precision);
@@ -25,10 +27,25 @@ void stateman_feed(struct stateman_ctx*, int tstamp, void* inbuf);
 
 /*
  * Reconstruct the state closest to, timestamp. If Rel is set,
- * tstamp moves backward from the latest entry.
+ * tstamp moves backward from the latest entry. The next feed will
+ * prune states that come after the one that was reconstructed.
  */
 bool stateman_seek(struct stateman_ctx*, void* dstbuf, int tstamp, bool rel);
 
+/*
+ * Timestamp of the state that was last fed or seeked to, or -1 if
+ * there are no states in the store.
+ */
+int stateman_position(struct stateman_ctx*);
+
+struct stateman_stats {
+	size_t n_states, n_keyframes;
+	size_t bytes;
+	int first, last;
+};
+
+void stateman_stats(struct stateman_ctx*, struct stateman_stats* out);
+
 /*
  * Drop a previously allocated staterecord
  */
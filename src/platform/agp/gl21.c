@@ -321,6 +321,9 @@ struct stream_meta agp_stream_prepare(struct agp_vstore* s,
 	res.state = true;
 	res.type = type;
 
+/* every path here ends up with new contents, now or on release */
+	s->update_seq++;
+
 	switch (type){
 	case STREAM_RAW:
 		if (!s->vinf.text.wid)
@@ -288,6 +288,9 @@ struct stream_meta agp_stream_prepare(struct agp_vstore* s,
 	struct agp_fenv* env = agp_env();
 	mout.state = true;
 
+/* every path here ends up with new contents, now or on release */
+	s->update_seq++;
+
 	switch(type){
 	case STREAM_RAW:
 		alloc_buffer(s);
@@ -72,6 +72,7 @@ struct agp_fenv {
 	void (*enable_vertex_attrarray) (GLuint);
 	void (*vertex_attrpointer) (GLuint, GLint, GLenum, GLboolean, GLsizei, const GLvoid*);
 	void (*vertex_iattrpointer) (GLuint, GLint, GLenum, GLsizei, const GLvoid*);
+	void (*vertex_attrib_divisor) (GLuint, GLuint);
 
 	void (*disable_vertex_attrarray) (GLuint);
 
@@ -140,6 +141,8 @@ struct agp_fenv {
 	void (*stencil_op) (GLenum, GLenum, GLenum);
 	void (*draw_arrays) (GLenum, GLint, GLsizei);
 	void (*draw_elements) (GLenum, GLsizei, GLenum, const GLvoid*);
+	void (*draw_arrays_instanced) (GLenum, GLint, GLsizei, GLsizei);
+	void (*draw_elements_instanced) (GLenum, GLsizei, GLenum, const GLvoid*, GLsizei);
 	void (*depth_mask) (GLboolean);
 	void (*depth_func) (GLenum);
 	void (*polygon_mode) (GLenum, GLenum);
@@ -150,6 +153,9 @@ struct agp_fenv {
 	int model_flags;
 	GLenum blend_src_alpha, blend_dst_alpha;
 	GLint last_store_mode;
+
+/* streaming vertex buffer used for batched 2D submission */
+	GLuint batch_vbo;
 };
 
 void agp_glinit_fenv(struct agp_fenv* dst,
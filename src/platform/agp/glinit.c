@@ -109,6 +109,9 @@ void agp_glinit_fenv(struct agp_fenv* dst,
 	dst->vertex_iattrpointer =
 		(void (*)(GLuint, GLint, GLenum, GLsizei, const GLvoid*))
 			lookup_opt(tag, "glVertexAttribIPointer");
+	dst->vertex_attrib_divisor =
+		(void (*)(GLuint, GLuint))
+			lookup_opt(tag, "glVertexAttribDivisor");
 	dst->disable_vertex_attrarray =
 		(void (*)(GLuint))
 			lookup(tag, "glDisableVertexAttribArray");
@@ -285,6 +288,12 @@ void agp_glinit_fenv(struct agp_fenv* dst,
 	dst->draw_elements =
 		(void(*)(GLenum, GLsizei, GLenum, const GLvoid*))
 			lookup(tag, "glDrawElements");
+	dst->draw_arrays_instanced =
+		(void(*)(GLenum, GLint, GLsizei, GLsizei))
+			lookup_opt(tag, "glDrawArraysInstanced");
+	dst->draw_elements_instanced =
+		(void(*)(GLenum, GLsizei, GLenum, const GLvoid*, GLsizei))
+			lookup_opt(tag, "glDrawElementsInstanced");
 	dst->depth_mask =
 		(void(*)(GLboolean))
 			lookup(tag, "glDepthMask");
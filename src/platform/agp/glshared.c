@@ -27,7 +27,7 @@
 
 #ifdef HEADLESS_NOARCAN
 #undef FLAG_DIRTY
-#define FLAG_DIRTY()
+#define FLAG_DIRTY(X)
 #endif
 
 #ifndef GL_VERTEX_PROGRAM_POINT_SIZE
@@ -163,6 +163,7 @@ uint64_t agp_rendertarget_swap(struct agp_rendertarget* dst, bool* swap)
 	env->framebuffer_texture_2d(GL_FRAMEBUFFER,
 		GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, dst->stores[front]->vinf.text.glid, 0);
 	dst->store->vinf.text.glid_proxy = &dst->stores[front]->vinf.text.glid;
+	dst->store->update_seq++;
 
 /* and switch back to the old rendertarget */
 	if (dst->fbo != cfbo)
@@ -170,7 +171,7 @@ uint64_t agp_rendertarget_swap(struct agp_rendertarget* dst, bool* swap)
 
 	if (dst->dirtyc > 0){
 		dst->dirtyc--;
-		FLAG_DIRTY();
+		FLAG_DIRTY(NULL);
 		if (!dst->dirtyc){
 			for (size_t i = 0; i < MAX_BUFFERS; i++){
 				if (!dst->shadow[i])
@@ -488,6 +489,7 @@ static bool update_cube(
 	}
 
 	backing->update_ts = arcan_timemillis();
+	backing->update_seq++;
 	env->bind_texture(GL_TEXTURE_CUBE_MAP, 0);
 	return true;
 }
@@ -764,6 +766,38 @@ void agp_rendertarget_clear()
 	agp_env()->clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
+void agp_rendertarget_scissor(
+	struct agp_rendertarget* tgt, size_t x, size_t y, size_t w, size_t h)
+{
+	if (!w || !h){
+		x = y = 0;
+		if (tgt){
+			w = tgt->store->w;
+			h = tgt->store->h;
+		}
+#ifndef HEADLESS_NOARCAN
+		else {
+			struct monitor_mode mode = platform_video_dimensions();
+			w = mode.width;
+			h = mode.height;
+		}
+#endif
+	}
+
+	agp_env()->scissor(x, y, w, h);
+}
+
+size_t agp_rendertarget_bufferslot(struct agp_rendertarget* tgt, size_t* nslots)
+{
+	if (!tgt || !tgt->n_stores){
+		*nslots = 1;
+		return 0;
+	}
+
+	*nslots = tgt->n_stores;
+	return tgt->store_ind;
+}
+
 void agp_pipeline_hint(enum pipeline_mode mode)
 {
 	struct agp_fenv* env = agp_env();
@@ -878,7 +912,8 @@ void agp_update_vstore(struct agp_vstore* s, bool copy)
 	if (s->txmapped == TXSTATE_OFF)
 		return;
 
-	FLAG_DIRTY();
+	FLAG_DIRTY(NULL);
+	s->update_seq++;
 
 	if (!copy)
 		env->bind_texture(GL_TEXTURE_2D, s->vinf.text.glid);
@@ -1086,6 +1121,47 @@ void agp_draw_vobj(float x1, float y1, float x2, float y2,
 	}
 }
 
+void agp_draw_vobj_batch(const float* vtx, size_t n_quads)
+{
+	struct agp_fenv* env = agp_env();
+	if (!n_quads)
+		return;
+
+	GLint attrindv = agp_shader_vattribute_loc(ATTRIBUTE_VERTEX);
+	GLint attrindt = agp_shader_vattribute_loc(ATTRIBUTE_TEXCORD0);
+	if (attrindv == -1)
+		return;
+
+/* vertices are already in rendertarget space */
+	agp_shader_envv(MODELVIEW_MATR, ident, sizeof(float) * 16);
+
+	if (!env->batch_vbo)
+		env->gen_buffers(1, &env->batch_vbo);
+
+/* re-specifying the full store each batch lets the driver orphan the old
+ * one rather than synchronize against draws that are still in flight */
+	size_t stride = sizeof(float) * 4;
+	env->bind_buffer(GL_ARRAY_BUFFER, env->batch_vbo);
+	env->buffer_data(GL_ARRAY_BUFFER,
+		n_quads * 6 * stride, vtx, GL_STREAM_DRAW);
+
+	env->enable_vertex_attrarray(attrindv);
+	env->vertex_attrpointer(attrindv, 2, GL_FLOAT, GL_FALSE, stride, NULL);
+
+	if (attrindt != -1){
+		env->enable_vertex_attrarray(attrindt);
+		env->vertex_attrpointer(attrindt, 2, GL_FLOAT,
+			GL_FALSE, stride, (void*)(sizeof(float) * 2));
+	}
+
+	env->draw_arrays(GL_TRIANGLES, 0, n_quads * 6);
+
+	if (attrindt != -1)
+		env->disable_vertex_attrarray(attrindt);
+	env->disable_vertex_attrarray(attrindv);
+	env->bind_buffer(GL_ARRAY_BUFFER, 0);
+}
+
 static void toggle_debugstates(float* modelview)
 {
 	struct agp_fenv* env = agp_env();
@@ -1123,7 +1199,8 @@ void agp_render_options(struct agp_render_options opts)
 	env->line_width(opts.line_width);
 }
 
-static void setup_transfer(struct agp_mesh_store* base, enum agp_mesh_flags fl)
+static void setup_transfer(struct agp_mesh_store* base,
+	enum agp_mesh_flags fl, const float* inst, size_t n_inst)
 {
 	struct agp_fenv* env = agp_env();
 	int attribs[] = {
@@ -1201,6 +1278,18 @@ static void setup_transfer(struct agp_mesh_store* base, enum agp_mesh_flags fl)
 	else
 		attribs[8] = -1;
 
+/* one column-major mat4 per instance, spread over four consecutive slots */
+	int inst_loc = -1;
+	if (n_inst){
+		inst_loc = agp_shader_vattribute_loc(ATTRIBUTE_INSTANCE_MODELVIEW);
+		for (size_t i = 0; i < 4; i++){
+			env->enable_vertex_attrarray(inst_loc + i);
+			env->vertex_attrpointer(inst_loc + i, 4, GL_FLOAT,
+				GL_FALSE, sizeof(float) * 16, &inst[i * 4]);
+			env->vertex_attrib_divisor(inst_loc + i, 1);
+		}
+	}
+
 	if (base->type == AGP_MESH_TRISOUP){
 		if (base->indices){
 			if (!base->validated){
@@ -1212,23 +1301,39 @@ static void setup_transfer(struct agp_mesh_store* base, enum agp_mesh_flags fl)
 								"(%zu=>%zu/%zu\n", i, base->indices[i], base->n_vertices);
 							warned = true;
 						}
-						return;
+						goto out;
 					}
 				}
 				base->validated = true;
 			}
-			env->draw_elements(GL_TRIANGLES,
-				base->n_indices, GL_UNSIGNED_INT, base->indices);
+			if (n_inst)
+				env->draw_elements_instanced(GL_TRIANGLES,
+					base->n_indices, GL_UNSIGNED_INT, base->indices, n_inst);
+			else
+				env->draw_elements(GL_TRIANGLES,
+					base->n_indices, GL_UNSIGNED_INT, base->indices);
 		}
+		else if (n_inst)
+			env->draw_arrays_instanced(GL_TRIANGLES, 0, base->n_vertices, n_inst);
 		else
 			env->draw_arrays(GL_TRIANGLES, 0, base->n_vertices);
 	}
 	else if (base->type == AGP_MESH_POINTCLOUD){
 		env->enable(GL_VERTEX_PROGRAM_POINT_SIZE);
-		env->draw_arrays(GL_POINTS, 0, base->n_vertices);
+		if (n_inst)
+			env->draw_arrays_instanced(GL_POINTS, 0, base->n_vertices, n_inst);
+		else
+			env->draw_arrays(GL_POINTS, 0, base->n_vertices);
 		env->disable(GL_VERTEX_PROGRAM_POINT_SIZE);
 	}
 
+out:
+	if (inst_loc != -1)
+		for (size_t i = 0; i < 4; i++){
+			env->vertex_attrib_divisor(inst_loc + i, 0);
+			env->disable_vertex_attrarray(inst_loc + i);
+		}
+
 	for (size_t i = 0; i < sizeof(attribs) / sizeof(attribs[0]); i++)
 		if (attribs[i] != -1)
 			env->disable_vertex_attrarray(attribs[i]);
@@ -1313,7 +1418,8 @@ static void setup_culling(struct agp_mesh_store* base, enum agp_mesh_flags fl)
 	}
 }
 
-void agp_submit_mesh(struct agp_mesh_store* base, enum agp_mesh_flags fl)
+static void submit_mesh(struct agp_mesh_store* base,
+	enum agp_mesh_flags fl, const float* inst, size_t n_inst)
 {
 /* make sure the current program actually uses the attributes from the mesh */
 	struct agp_fenv* env = agp_env();
@@ -1336,11 +1442,11 @@ void agp_submit_mesh(struct agp_mesh_store* base, enum agp_mesh_flags fl)
 #if !defined(GLES2) && !defined(GLES3)
 				env->polygon_mode(GL_FRONT_AND_BACK, GL_FILL);
 				env->color_mask(false, false, false, false);
-				setup_transfer(base, fl);
+				setup_transfer(base, fl, inst, n_inst);
 
 				env->polygon_mode(GL_FRONT_AND_BACK, GL_LINE);
 				env->color_mask(true, true, true, true);
-				setup_transfer(base, fl);
+				setup_transfer(base, fl, inst, n_inst);
 				env->polygon_mode(GL_FRONT_AND_BACK, GL_FILL);
 #else
 /* no wireframe support for GLES */
@@ -1358,7 +1464,37 @@ void agp_submit_mesh(struct agp_mesh_store* base, enum agp_mesh_flags fl)
 		env->model_flags = fl;
 	}
 
-	setup_transfer(base, fl);
+	setup_transfer(base, fl, inst, n_inst);
+}
+
+void agp_submit_mesh(struct agp_mesh_store* base, enum agp_mesh_flags fl)
+{
+	submit_mesh(base, fl, NULL, 0);
+}
+
+size_t agp_submit_mesh_instanced(struct agp_mesh_store* base,
+	enum agp_mesh_flags fl, const float* modelview, size_t n)
+{
+	struct agp_fenv* env = agp_env();
+
+	if (!n)
+		return 0;
+
+/* the shader has to opt in by taking the matrix as an attribute, otherwise
+ * it is the uniform, one draw call per instance */
+	if (agp_shader_vattribute_loc(ATTRIBUTE_INSTANCE_MODELVIEW) == -1 ||
+		!env->vertex_attrib_divisor ||
+		!env->draw_arrays_instanced || !env->draw_elements_instanced){
+		for (size_t i = 0; i < n; i++){
+			agp_shader_envv(MODELVIEW_MATR,
+				(void*) &modelview[i * 16], sizeof(float) * 16);
+			submit_mesh(base, fl, NULL, 0);
+		}
+		return n;
+	}
+
+	submit_mesh(base, fl, modelview, n);
+	return 1;
 }
 
 /*
@@ -25,7 +25,7 @@
 
 #ifdef HEADLESS_NOARCAN
 #undef FLAG_DIRTY
-#define FLAG_DIRTY()
+#define FLAG_DIRTY(X)
 #endif
 
 #define TBLSIZE (1 + TIMESTAMP_D - MODELVIEW_MATR)
@@ -120,7 +120,7 @@ static char* symtbl[TBLSIZE] = {
 	"timestamp"
 };
 
-static char* attrsymtbl[9] = {
+static char* attrsymtbl[10] = {
 	"vertex",
 	"normal",
 	"color",
@@ -129,7 +129,8 @@ static char* attrsymtbl[9] = {
 	"tangent",
 	"bitangent",
 	"joints",
-	"weights"
+	"weights",
+	"instance_modelview"
 };
 
 /* REFACTOR:
@@ -156,7 +157,7 @@ struct shader_cont {
 	GLuint prg_container, obj_vertex, obj_fragment;
 	GLint locations[sizeof(ofstbl) / sizeof(ofstbl[0])];
 /* match attrsymtbl */
-	GLint attributes[9];
+	GLint attributes[10];
 
 	struct arcan_strarr ugroups;
 };
@@ -612,7 +613,7 @@ void agp_shader_forceunif(const char* label, enum shdrutype type, void* value)
 	assert(shdr_global.active_prg != BROKEN_SHADER);
 	struct shader_cont* slot = &shdr_global.slots[
 		SHADER_INDEX(shdr_global.active_prg)];
-	FLAG_DIRTY();
+	FLAG_DIRTY(NULL);
 
 /* linear search */
 	struct shaderv** current = (struct shaderv**) &(
@@ -120,6 +120,17 @@ void agp_rendertarget_clear()
 {
 }
 
+void agp_rendertarget_scissor(
+	struct agp_rendertarget* tgt, size_t x, size_t y, size_t w, size_t h)
+{
+}
+
+size_t agp_rendertarget_bufferslot(struct agp_rendertarget* tgt, size_t* nslots)
+{
+	*nslots = 1;
+	return 0;
+}
+
 void agp_pipeline_hint(enum pipeline_mode mode)
 {
 }
@@ -139,7 +150,7 @@ void agp_activate_vstore_multi(struct agp_vstore** backing, size_t n)
 
 void agp_update_vstore(struct agp_vstore* s, bool copy)
 {
-	FLAG_DIRTY();
+	FLAG_DIRTY(NULL);
 }
 
 void agp_prepare_stencil()
@@ -163,10 +174,20 @@ void agp_draw_vobj(float x1, float y1,
 {
 }
 
+void agp_draw_vobj_batch(const float* vtx, size_t n_quads)
+{
+}
+
 void agp_submit_mesh(struct agp_mesh_store* base, enum agp_mesh_flags fl)
 {
 }
 
+size_t agp_submit_mesh_instanced(struct agp_mesh_store* base,
+	enum agp_mesh_flags fl, const float* modelview, size_t n)
+{
+	return 0;
+}
+
 void agp_invalidate_mesh(struct agp_mesh_store* base)
 {
 }
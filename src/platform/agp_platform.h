@@ -305,6 +305,14 @@ void agp_blendstate(enum arcan_blendfunc);
 void agp_draw_vobj(float x1, float y1, float x2, float y2,
 	const float* txcos, const float* modelview);
 
+/*
+ * Draw [n_quads] pre-transformed quads with a single draw call using the
+ * currently active shader, vstore and blend state. [vtx] is interleaved as
+ * (x, y, s, t) with 6 vertices (two triangles) per quad, already transformed
+ * into rendertarget space (modelview will be set to identity).
+ */
+void agp_draw_vobj_batch(const float* vtx, size_t n_quads);
+
 /*
  * Destination format for rendertargets. Note that we do not currently suport
  * floating point targets and that for some platforms, COLOR_DEPTH will map to
@@ -376,6 +384,23 @@ void agp_drop_rendertarget(struct agp_rendertarget*);
  */
 void agp_rendertarget_clear();
 
+/*
+ * Limit drawing and clearing in the currently bound rendertarget to a region
+ * (pixels, lower-left origo). A region without width or height resets it to
+ * cover the entire target, as does activating a rendertarget.
+ */
+void agp_rendertarget_scissor(
+	struct agp_rendertarget*, size_t x, size_t y, size_t w, size_t h);
+
+/*
+ * Retrieve the index of the color buffer that the next draw to the
+ * rendertarget will land in, along with the number of buffers that it
+ * rotates between (1 until agp_rendertarget_swap has been used). Each buffer
+ * keeps what was last drawn into it, so the caller only needs to redraw what
+ * changed since then.
+ */
+size_t agp_rendertarget_bufferslot(struct agp_rendertarget*, size_t* nslots);
+
 /*
  * change the clear color of the rendertarget from the default RGBA(0,0,0,1)
  */
@@ -468,6 +493,17 @@ const char* agp_ident();
 
 void agp_submit_mesh(struct agp_mesh_store*, enum agp_mesh_flags);
 
+/*
+ * Submit [n] instances of the mesh, with [modelview] holding one column-major
+ * 4x4 matrix per instance. If the active shader has the 'instance_modelview'
+ * attribute and the platform supports instancing, this is a single draw call
+ * with the matrix fed per instance through that attribute. Otherwise the
+ * modelview uniform is set and the mesh submitted once per instance. Returns
+ * the number of draw calls issued.
+ */
+size_t agp_submit_mesh_instanced(struct agp_mesh_store*,
+	enum agp_mesh_flags, const float* modelview, size_t n);
+
 /*
  * Mark that the contents of the mesh has changed dynamically and that possible
  * GPU- side cache might need to be updated.
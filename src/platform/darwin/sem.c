@@ -70,3 +70,22 @@ int arcan_sem_destroy(sem_handle sem)
 	int rv = sem_close(sem);
 	return rv;
 }
+
+/* no exposed futex- like primitive, shmif stays on the semaphore path */
+bool arcan_futex_available()
+{
+	return false;
+}
+
+int arcan_futex_wait(
+	volatile _Atomic unsigned int* addr, unsigned int val, unsigned timeout)
+{
+	errno = ENOTSUP;
+	return -1;
+}
+
+int arcan_futex_wake(volatile _Atomic unsigned int* addr)
+{
+	errno = ENOTSUP;
+	return -1;
+}
@@ -208,6 +208,10 @@ struct dispout {
 	unsigned long long last_update;
 	int output_format;
 
+/* changes since the display was last composed, and at the composition before
+ * that (double buffered, both buffers need the new contents) */
+	size_t damage, last_damage;
+
 /* the output buffers, actual fields use will vary with underlying
  * method, i.e. different for normal gbm, headless gbm and eglstreams */
 	struct {
@@ -275,6 +279,12 @@ static struct {
 #define MAX_DISPLAYS 16
 #endif
 
+/* number of times to sleep on display events waiting for one to become due
+ * before returning to the engine, so one stuck display can't stall it */
+#ifndef DUE_WAIT_LIMIT
+#define DUE_WAIT_LIMIT 4
+#endif
+
 static struct dispout displays[MAX_DISPLAYS];
 
 static struct dispout* allocate_display(struct dev_node* node)
@@ -3172,8 +3182,14 @@ static void page_flip_handler(int fd, unsigned int frame,
 	break;
 	}
 
-	float deadline = 1000.0f / (float)(d->vrefresh ? d->vrefresh : 60.0);
-	arcan_conductor_deadline(deadline);
+/* the event is timestamped by the kernel (CLOCK_MONOTONIC), translate the
+ * age of it to our clock rather than when we got around to read it */
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	long long age = (long long)(now.tv_sec - sec) * 1000 +
+		((long long)now.tv_nsec / 1000 - (long long)usec) / 1000;
+	arcan_conductor_display_synch(d->device->card_id,
+		d->id, arcan_timemillis() - (age > 0 ? age : 0));
 }
 
 static bool get_pending(bool primary_only)
@@ -3362,14 +3378,75 @@ void platform_video_synch(uint64_t tick_count, float fract,
 	if (get_pending(false))
 		flush_display_events(-1, false);
 
+/*
+ * Each display has its own deadline (see arcan_conductor_displays_due), so a
+ * 144Hz and a 60Hz display are composed and flipped on their own cadence and
+ * not at the rate of whichever was synched last. Wait for at least one to be
+ * close enough to its vblank, flip events and the conductor yield are
+ * processed in the meanwhile.
+ */
+	struct conductor_display_ref due[MAX_DISPLAYS];
+	int wait;
+	size_t n_due;
+	size_t tries = 0;
+
+	while (!(n_due = arcan_conductor_displays_due(due, MAX_DISPLAYS, &wait))
+		&& wait > 0 && tries++ < DUE_WAIT_LIMIT){
+		flush_display_events(wait, true);
+	}
+
+/* still nothing due, come back on the next synch rather than holding up the
+ * rest of the engine on displays that don't become ready */
+	if (!n_due && wait > 0){
+		arcan_conductor_deadline(wait > 255 ? 255 : wait);
+		goto out;
+	}
+
+/*
+ * No displays registered, just 'fake' synch to 60Hz unless the yield
+ * function tells us to run in a processing- like state (useful for
+ * displayless like processing).
+ */
+	if (!n_due){
+		size_t nd;
+		arcan_bench_register_cost(arcan_vint_refresh(fract, &nd));
+		arcan_conductor_deadline(-1);
+		arcan_conductor_fakesynch(1000.0f / 60.0f);
+		goto out;
+	}
+
+/* split the mapped displays into the due ones and the ones that can wait,
+ * rendertargets only feeding the later are deferred to their own pass */
+	arcan_vobj_id due_vids[MAX_DISPLAYS], idle_vids[MAX_DISPLAYS];
+	struct dispout* due_disps[MAX_DISPLAYS];
+	size_t n_idle = 0, n_disps = 0;
+
+	while ((d = get_display(i++))){
+		if (d->state != DISP_MAPPED)
+			continue;
+
+		bool is_due = false;
+		for (size_t j = 0; j < n_due && !is_due; j++)
+			is_due = due[j].gpu_id == d->device->card_id && due[j].disp_id == d->id;
+
+		if (is_due){
+			due_vids[n_disps] = d->vid;
+			due_disps[n_disps++] = d;
+		}
+		else
+			idle_vids[n_idle++] = d->vid;
+	}
+
 	size_t nd;
-	uint32_t cost_ms = arcan_vint_refresh(fract, &nd);
+	uint32_t cost_ms = arcan_vint_refresh_displays(
+		fract, due_vids, n_disps, idle_vids, n_idle, &nd);
 
 /*
- * At this stage, the contents of all RTs have been synched, with nd == 0,
- * nothing has changed from what was draw last time - but since we normally run
- * double buffered it is easier to synch the same contents in both buffers, so
- * that when dirty updates are being tracked, we won't be corrupted.
+ * At this stage, the contents of all RTs feeding the due displays have been
+ * synched. With no damage since the last two compositions nothing has
+ * changed from what was drawn the last time - but since we normally run
+ * double buffered it is easier to synch the same contents in both buffers,
+ * so that when dirty updates are being tracked, we won't be corrupted.
  *
  * The damage tracking is currently binary, a dirty- region style flow should
  * be added to the _agp layer in order to not miss anything (shaders, source-
@@ -3377,57 +3454,48 @@ void platform_video_synch(uint64_t tick_count, float fract,
  */
 	arcan_bench_register_cost( cost_ms );
 
-	static int last_nd;
-	bool update = nd || last_nd;
-	bool clocked = false;
-	bool updated = false;
-	int method = 0;
-
-/*
- * If we have a real update, the display timing will request a deadline based
- * on whatever display that was updated so we can go with that
- */
-	if (update){
-		while ( (d = get_display(i++)) ){
-			if (d->state == DISP_MAPPED && d->buffer.in_flip == 0){
-				updated |= update_display(d);
-				clocked |= d->device->vsynch_method == VSYNCH_CLOCK;
-			}
+	i = 0;
+	while ((d = get_display(i++)))
+		if (d->state == DISP_MAPPED)
+			d->damage += nd;
+
+	for (size_t j = 0; j < n_disps; j++){
+		d = due_disps[j];
+		long long start = arcan_timemillis();
+		bool queued = false;
+
+		if (d->buffer.in_flip == 0 && (d->damage || d->last_damage)){
+			update_display(d);
+/* the failsafe for devices that don't support giving a vsynch signal is to
+ * consider the frame scanned out at the next vblank, same as with no damage */
+			queued = d->buffer.in_flip &&
+				d->device->vsynch_method != VSYNCH_CLOCK;
 		}
-/*
- * Finally check for the callbacks, synchronize with the conductor and so on
- * the clocked is a failsafe for devices that don't support giving a vsynch
- * signal.
- */
-		if (get_pending(false) || updated)
-			flush_display_events(clocked ? 16 : 0, true);
+
+		d->last_damage = d->damage;
+		d->damage = 0;
+
+		arcan_conductor_display_submit(d->device->card_id, d->id,
+			cost_ms + (arcan_timemillis() - start), queued);
 	}
-/*
- * If there are no updates, just 'fake' synch to the display with the lowest
- * refresh unless the yield function tells us to run in a processing- like
- * state (useful for displayless like processing).
- */
-	else {
-		float refresh = 60.0;
-		i = 0;
-		while ((d = get_display(i++))){
-			if (d->state == DISP_MAPPED){
-				if (d->vrefresh > 0 && d->vrefresh > refresh)
-					refresh = d->vrefresh;
-			}
-		}
 
-/*
- * The other option would be to to set left as the deadline here, but that
- * makes the platform even worse when it comes to testing strategies etc.
- */
-		int left = 1000.0f / refresh;
-		arcan_conductor_deadline(-1);
-		arcan_conductor_fakesynch(left);
+/* due but not mapped (or gone), consider them handled so they don't spin */
+	for (size_t j = 0; j < n_due; j++){
+		bool found = false;
+		for (size_t k = 0; k < n_disps && !found; k++)
+			found = due[j].gpu_id == due_disps[k]->device->card_id &&
+				due[j].disp_id == due_disps[k]->id;
+
+		if (!found)
+			arcan_conductor_display_submit(due[j].gpu_id, due[j].disp_id, 0, false);
 	}
 
-	last_nd = nd;
+/* let the conductor defer until the next display is due */
+	arcan_conductor_displays_due(NULL, 0, &wait);
+	if (wait > 0)
+		arcan_conductor_deadline(wait > 255 ? 255 : wait);
 
+out:
 /*
  * The LEDs that are mapped as backlights via the internal pipe-led protocol
  * needs to be flushed separately, here is a decent time to get that out of
@@ -26,7 +26,9 @@ enum devnode_type {
 	DEVNODE_MISSING
 };
 
-typedef void (*devnode_decode_cb)(struct arcan_evctx*, struct devnode*);
+/* [inev] is a batch of [n] events read from the node, in order */
+typedef void (*devnode_decode_cb)(struct arcan_evctx*,
+	struct devnode*, struct input_event* inev, size_t n);
 
 struct evhandler {
 	const char* name;
@@ -43,10 +45,14 @@ struct evhandler {
 	uint64_t button_mask;
 };
 
-static void defhandler_kbd(struct arcan_evctx*, struct devnode*);
-static void defhandler_mouse(struct arcan_evctx*, struct devnode*);
-static void defhandler_game(struct arcan_evctx*, struct devnode*);
-static void defhandler_null(struct arcan_evctx*, struct devnode*);
+static void defhandler_kbd(struct arcan_evctx*,
+	struct devnode*, struct input_event*, size_t);
+static void defhandler_mouse(struct arcan_evctx*,
+	struct devnode*, struct input_event*, size_t);
+static void defhandler_game(struct arcan_evctx*,
+	struct devnode*, struct input_event*, size_t);
+static void defhandler_null(struct arcan_evctx*,
+	struct devnode*, struct input_event*, size_t);
 
 /* as with the other input.c, we should probably just move this out into
  * the virtual filesystem and have the path indicate decoder type as this
@@ -16,6 +16,8 @@
 #include <errno.h>
 #include <poll.h>
 #include <glob.h>
+#include <time.h>
+#include <pthread.h>
 
 #include <sys/types.h>
 #include <sys/param.h>
@@ -32,6 +34,7 @@
 #include "arcan_video.h"
 #include "arcan_videoint.h"
 #include "keycode_xlate.h"
+#include "evring.h"
 
 #include <linux/kd.h>
 #include <sys/inotify.h>
@@ -97,6 +100,7 @@ static const char* envopts[] = {
 	"scandir=path/to/folder", "Directory to monitor for device node hotplug "
 		"(Default: "NOTIFY_SCAN_DIR")",
 	"disable_ttyswap", "Disable tty- swapping signal handler",
+	"coalesce", "Merge relative motion reported between two event passes",
 #ifdef HAVE_XKBCOMMON
 	"", "",
 	"[XKB-ARGUMENTS]", "[these are ENV- only (fwd to libxkbcommon)]",
@@ -145,6 +149,14 @@ static struct {
 	struct devnode* nodes;
 
 	struct pollfd* pollset;
+
+/* bumped whenever a device is added or removed, nodes keep the value they
+ * were added with so that queued events can be matched against them */
+	unsigned gen;
+
+/* ms to add to kernel timestamps (monotonic, realtime) for the clock that
+ * arcan_timemillis uses */
+	int64_t pts_ofs[2];
 } iodev = {0};
 
 struct devnode {
@@ -159,6 +171,10 @@ struct devnode {
 	char* path;
 	unsigned short devnum;
 	size_t button_count;
+	unsigned gen;
+
+/* the driver didn't accept a monotonic clock for event timestamps */
+	bool realtime;
 
 	enum devnode_type type;
 	union {
@@ -195,6 +211,7 @@ struct devnode {
 		int pressure;
 		int size;
 		int ind;
+		uint64_t pts;
 	} touch;
 
 /* and also possible act as a LED controller */
@@ -208,6 +225,252 @@ struct devnode {
 
 static void got_device(struct arcan_evctx* ctx, int fd, const char*);
 
+/*
+ * Devices are read on a thread of their own that hands the raw events over
+ * through an SPSC ring, which platform_event_process drains and translates.
+ * That keeps the kernel buffers from overflowing when a frame runs long, and
+ * high rate devices from being read in lockstep with the frame loop.
+ *
+ * The thread polls a copy of the device set that is rebuilt when iodev.gen
+ * changes. Any change to iodev.nodes or the pollset is done with [lock] held,
+ * and a write to [wake] gets the thread out of poll to notice. Should the
+ * thread not start, the same code runs from platform_event_process instead.
+ */
+static struct {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	bool alive;
+	atomic_bool shutdown;
+	int wake[2];
+
+/* fold relative motion between passes, see evring_coalesce */
+	bool coalesce;
+
+	struct evring ring;
+} reader = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.wake = {-1, -1}
+};
+
+struct reader_set {
+	unsigned gen;
+	size_t count, limit;
+
+/* [0] is the wakeup pipe, the rest the devices in [src] */
+	struct pollfd* fds;
+	struct {
+		uint16_t slot;
+		unsigned gen;
+	}* src;
+};
+
+static void reader_lock()
+{
+	if (reader.alive){
+		uint8_t ch = 0;
+		ssize_t nw __attribute__((unused));
+		nw = write(reader.wake[1], &ch, 1);
+	}
+
+	pthread_mutex_lock(&reader.lock);
+}
+
+static void reader_unlock()
+{
+	pthread_mutex_unlock(&reader.lock);
+}
+
+static void reader_rebuild(struct reader_set* set)
+{
+	if (set->limit < iodev.sz_nodes + 1){
+		size_t limit = iodev.sz_nodes + 1;
+		struct pollfd* fds = malloc(sizeof(struct pollfd) * limit);
+		void* src = malloc(sizeof(set->src[0]) * limit);
+		if (!fds || !src){
+			arcan_warning("evdev(), couldn't grow the input thread device set\n");
+			free(fds);
+			free(src);
+			return;
+		}
+
+		free(set->fds);
+		free(set->src);
+		set->fds = fds;
+		set->src = src;
+		set->limit = limit;
+	}
+
+	set->fds[0] = (struct pollfd){
+		.fd = reader.alive ? reader.wake[0] : -1,
+		.events = POLLIN
+	};
+	set->count = 1;
+
+	for (size_t i = 0; i < iodev.sz_nodes; i++){
+		if (iodev.pollset[i].fd < 0)
+			continue;
+
+		set->fds[set->count] = (struct pollfd){
+			.fd = iodev.pollset[i].fd,
+			.events = POLLIN
+		};
+		set->src[set->count].slot = i;
+		set->src[set->count].gen = iodev.nodes[i].gen;
+		set->count++;
+	}
+
+	set->gen = iodev.gen;
+}
+
+static void reader_gone(struct reader_set* set, size_t i)
+{
+/* if the ring is full, poll will tell again next round */
+	if (evring_mark(&reader.ring, set->src[i].slot, set->src[i].gen, EVRING_GONE))
+		set->fds[i].fd = -1;
+}
+
+static void reader_read(struct reader_set* set, size_t i)
+{
+	struct input_event inev[64];
+	size_t lim = evring_space(&reader.ring);
+	if (lim > COUNT_OF(inev))
+		lim = COUNT_OF(inev);
+
+	ssize_t nr = read(set->fds[i].fd, inev, lim * sizeof(struct input_event));
+	if (-1 == nr){
+		if (errno != EINTR && errno != EAGAIN)
+			reader_gone(set, i);
+		return;
+	}
+
+	evring_push(&reader.ring, set->src[i].slot,
+		set->src[i].gen, inev, nr / sizeof(struct input_event));
+}
+
+/* one round of waiting for and reading whatever devices have to offer */
+static void reader_step(struct reader_set* set, int timeout)
+{
+	pthread_mutex_lock(&reader.lock);
+	if (!set->fds || set->gen != iodev.gen)
+		reader_rebuild(set);
+	pthread_mutex_unlock(&reader.lock);
+
+	if (!set->fds)
+		return;
+
+/* with the ring full, leave the events with the kernel for a while */
+	bool full = evring_space(&reader.ring) == 0;
+	int nr = poll(set->fds, full ? 1 : set->count, full ? 4 : timeout);
+
+	if (set->fds[0].revents & POLLIN){
+		uint8_t buf[64];
+		while (read(set->fds[0].fd, buf, sizeof(buf)) > 0){}
+	}
+
+	if (nr <= 0 || full)
+		return;
+
+/* the set changed while we were waiting, the descriptors might be gone */
+	pthread_mutex_lock(&reader.lock);
+	if (set->gen == iodev.gen){
+		for (size_t i = 1; i < set->count; i++){
+			if (set->fds[i].fd == -1 || !set->fds[i].revents)
+				continue;
+
+			if (set->fds[i].revents & POLLIN)
+				reader_read(set, i);
+			else
+				reader_gone(set, i);
+		}
+	}
+	pthread_mutex_unlock(&reader.lock);
+}
+
+static void* reader_thread(void* arg)
+{
+	struct reader_set set = {0};
+
+	while (!atomic_load(&reader.shutdown))
+		reader_step(&set, -1);
+
+	free(set.fds);
+	free(set.src);
+	return NULL;
+}
+
+static void reader_start()
+{
+	if (reader.alive)
+		return;
+
+	evring_reset(&reader.ring);
+	atomic_store(&reader.shutdown, false);
+
+	if (-1 == pipe(reader.wake)){
+		arcan_warning("evdev(), no input thread, couldn't create wakeup pipe\n");
+		return;
+	}
+
+	for (size_t i = 0; i < 2; i++){
+		int flags = fcntl(reader.wake[i], F_GETFL);
+		if (-1 != flags)
+			fcntl(reader.wake[i], F_SETFL, flags | O_NONBLOCK);
+		flags = fcntl(reader.wake[i], F_GETFD);
+		if (-1 != flags)
+			fcntl(reader.wake[i], F_SETFD, flags | FD_CLOEXEC);
+	}
+
+	reader.alive = true;
+	if (0 != pthread_create(&reader.thread, NULL, reader_thread, NULL)){
+		arcan_warning("evdev(), no input thread, devices will be polled\n");
+		reader.alive = false;
+		close(reader.wake[0]);
+		close(reader.wake[1]);
+		reader.wake[0] = reader.wake[1] = -1;
+	}
+}
+
+static void reader_stop()
+{
+	if (!reader.alive)
+		return;
+
+	atomic_store(&reader.shutdown, true);
+	reader_lock();
+	reader_unlock();
+	pthread_join(reader.thread, NULL);
+
+	reader.alive = false;
+	close(reader.wake[0]);
+	close(reader.wake[1]);
+	reader.wake[0] = reader.wake[1] = -1;
+}
+
+/*
+ * Kernel timestamps are either CLOCK_MONOTONIC (see got_device) or realtime,
+ * arcan_timemillis uses CLOCK_MONOTONIC_RAW, so the offsets are refreshed
+ * for every pass over the ring.
+ */
+static void update_pts_ofs()
+{
+	struct timespec mono, real;
+	clock_gettime(CLOCK_MONOTONIC, &mono);
+	clock_gettime(CLOCK_REALTIME, &real);
+	int64_t now = arcan_timemillis();
+
+	iodev.pts_ofs[0] = now -
+		((int64_t)mono.tv_sec * 1000 + mono.tv_nsec / 1000000);
+	iodev.pts_ofs[1] = now -
+		((int64_t)real.tv_sec * 1000 + real.tv_nsec / 1000000);
+}
+
+static uint64_t ev_pts(struct devnode* node, const struct input_event* ev)
+{
+	int64_t ms = (int64_t)ev->input_event_sec * 1000 +
+		ev->input_event_usec / 1000 + iodev.pts_ofs[node->realtime];
+	return ms > 0 ? ms : 0;
+}
+
 /* for other platforms and legacy, devid used to be allocated sequentially
  * and swept linear, even though this platform do not work like that and we
  * have a dynamic set of devices. For this reason, we split the 16 bit space
@@ -602,6 +865,7 @@ static void disconnect(struct arcan_evctx* ctx, struct devnode* node)
 		sizeof(addev.io.label[0]), "%s", node->label);
 	arcan_event_enqueue(ctx, &addev);
 
+	reader_lock();
 	for (size_t i = 0; i < iodev.sz_nodes; i++)
 		if (node->devnum == iodev.nodes[i].devnum){
 			close(node->handle);
@@ -630,7 +894,9 @@ static void disconnect(struct arcan_evctx* ctx, struct devnode* node)
 			}
 #endif
 			iodev.n_devs--;
+			iodev.gen++;
 		}
+	reader_unlock();
 }
 
 static void do_led(struct devnode* node)
@@ -669,6 +935,62 @@ static void do_led(struct devnode* node)
 	}
 }
 
+static struct devnode* live_node(uint16_t slot, unsigned gen)
+{
+	if (slot >= iodev.sz_nodes)
+		return NULL;
+
+	struct devnode* node = &iodev.nodes[slot];
+	return node->handle >= 0 && node->gen == gen ? node : NULL;
+}
+
+/*
+ * Translate what the reader has queued, consecutive records from the same
+ * device go to its handler as one batch. Records from a device that has
+ * since been removed (or its slot reused) are dropped. Stops after one ring
+ * worth so that a device spamming events can't keep us here.
+ */
+static void drain_reader(struct arcan_evctx* ctx)
+{
+	struct evring_rec recs[256];
+	struct input_event batch[COUNT_OF(recs)];
+	size_t n, total = 0;
+
+	update_pts_ofs();
+
+	while (total < EVRING_SIZE &&
+		(n = evring_pop(&reader.ring, recs, COUNT_OF(recs)))){
+		total += n;
+
+		for (size_t i = 0; i < n;){
+			struct devnode* node = live_node(recs[i].slot, recs[i].gen);
+
+			if (recs[i].flags & EVRING_GONE){
+				if (node)
+					disconnect(ctx, node);
+				i++;
+				continue;
+			}
+
+			size_t count = 0;
+			uint16_t slot = recs[i].slot;
+			unsigned gen = recs[i].gen;
+
+			while (i < n && recs[i].slot == slot &&
+				recs[i].gen == gen && !(recs[i].flags & EVRING_GONE))
+				batch[count++] = recs[i++].ev;
+
+			if (!node || !node->hnd.handler)
+				continue;
+
+			if (reader.coalesce)
+				count = evring_coalesce(batch, count);
+
+			node->hnd.handler(ctx, node, batch, count);
+		}
+	}
+}
+
 void platform_event_process(struct arcan_evctx* ctx)
 {
 /* lovely little variable length field at end of struct here /sarcasm,
@@ -695,37 +1017,20 @@ void platform_event_process(struct arcan_evctx* ctx)
 	if (gstate.pending)
 		process_pending(ctx);
 
-	int nr = poll(iodev.pollset, iodev.sz_nodes * 2, 0);
-	if (nr <= 0)
-		return;
-
-	for (size_t i = 0; i < iodev.sz_nodes; i++){
-/* recall, sz_nodes is half the count, i + sz_nodes = alt-dev index */
-		if (iodev.pollset[i+iodev.sz_nodes].revents & POLLIN){
-			do_led(&iodev.nodes[i]);
-		}
-
-		if (iodev.pollset[i].fd == -1 || 0 == iodev.pollset[i].revents)
-			continue;
+/* led controllers are still serviced here, the devices by the reader */
+	if (iodev.sz_nodes &&
+		poll(&iodev.pollset[iodev.sz_nodes], iodev.sz_nodes, 0) > 0){
+		for (size_t i = 0; i < iodev.sz_nodes; i++)
+			if (iodev.pollset[i+iodev.sz_nodes].revents & POLLIN)
+				do_led(&iodev.nodes[i]);
+	}
 
-/* !POLLIN, then something is wrong, remove the node */
-		if (0 == (iodev.pollset[i].revents & POLLIN)){
-			disconnect(ctx, &iodev.nodes[i]);
-			continue;
-		}
-/* some nodes may get a null handler temporarily or permanently assiged,
- * drain those for evdev structures */
-		else {
-			if (iodev.nodes[i].hnd.handler)
-				iodev.nodes[i].hnd.handler(ctx, &iodev.nodes[i]);
-			else{
-				char dump[256];
-				size_t nr __attribute__((unused));
-				nr = read(iodev.nodes[i].handle, dump, 256);
-			}
-		}
+	if (!reader.alive){
+		static struct reader_set inline_set;
+		reader_step(&inline_set, 0);
 	}
 
+	drain_reader(ctx);
 }
 
 void platform_event_samplebase(int devid, float xyz[3])
@@ -1060,6 +1365,11 @@ static void got_device(struct arcan_evctx* ctx, int fd, const char* path)
 		return;
 	}
 
+/* timestamps are converted to the arcan_timemillis clock in ev_pts,
+ * monotonic keeps that conversion from jumping around */
+	int clk = CLOCK_MONOTONIC;
+	node.realtime = -1 == ioctl(fd, EVIOCSCLOCKID, &clk);
+
 	if (!identify(fd, path, node.label, sizeof(node.label), &node.devnum)){
 			verbose_print(
 				"input: identify failed on %s, ignoring unknown.", path);
@@ -1175,8 +1485,10 @@ static void got_device(struct arcan_evctx* ctx, int fd, const char* path)
 	}
 
 /* finally added */
+	reader_lock();
 	int hole = alloc_node_slot(path);
 	if (-1 == hole){
+		reader_unlock();
 		verbose_print(
 			"input: dropped %s due to errors during scan.", path);
 		close(fd);
@@ -1184,6 +1496,7 @@ static void got_device(struct arcan_evctx* ctx, int fd, const char* path)
 	}
 
 	iodev.n_devs++;
+	node.gen = ++iodev.gen;
 	node.path = strdup(path);
 	iodev.pollset[hole].fd = fd;
 	iodev.pollset[hole].events = POLLIN | POLLERR | POLLHUP;
@@ -1211,6 +1524,7 @@ static void got_device(struct arcan_evctx* ctx, int fd, const char* path)
 		}
 	}
 	iodev.nodes[hole] = node;
+	reader_unlock();
 
 	verbose_print("input: (%s:%s) added as type: %s",
 		path, node.label, lookup_type(node.type));
@@ -1291,19 +1605,8 @@ static void update_state(int code, bool state, unsigned* statev)
 }
 
 static void defhandler_kbd(struct arcan_evctx* out,
-	struct devnode* node)
+	struct devnode* node, struct input_event* inev, size_t evs)
 {
-	struct input_event inev[64];
-	ssize_t evs = read(node->handle, &inev, sizeof(inev));
-
-	if (-1 == evs){
-		if (errno != EINTR && errno != EAGAIN)
-			disconnect(out, node);
-	}
-
-	if (evs < 0 || evs < sizeof(struct input_event))
-		return;
-
 	arcan_event newev = {
 		.category = EVENT_IO,
 		.io = {
@@ -1314,9 +1617,10 @@ static void defhandler_kbd(struct arcan_evctx* out,
 		}
 	};
 
-	for (size_t i = 0; i < evs / sizeof(struct input_event); i++){
+	for (size_t i = 0; i < evs; i++){
 		switch(inev[i].type){
 		case EV_KEY:
+		newev.io.pts = ev_pts(node, &inev[i]);
 		newev.io.input.translated.scancode = inev[i].code;
 		newev.io.input.translated.keysym = lookup_keycode(inev[i].code);
 		newev.io.input.translated.modifiers = node->keyboard.state;
@@ -1395,7 +1699,8 @@ static void flush_pending(struct arcan_evctx* ctx,
 		.subid = node->touch.ind + 128,
 		.kind = EVENT_IO_TOUCH,
 		.devkind = EVENT_IDEVKIND_TOUCHDISP,
-		.datatype = EVENT_IDATATYPE_TOUCH
+		.datatype = EVENT_IDATATYPE_TOUCH,
+		.pts = node->touch.pts
 		}
 	};
 
@@ -1469,7 +1774,7 @@ static void decode_mt(struct arcan_evctx* ctx,
 }
 
 static void decode_hat(struct arcan_evctx* ctx,
-	struct devnode* node, int ind, int val)
+	struct devnode* node, int ind, int val, uint64_t pts)
 {
 	arcan_event newev = {
 		.category = EVENT_IO,
@@ -1477,7 +1782,8 @@ static void decode_hat(struct arcan_evctx* ctx,
 			.label = "gamepad",
 			.kind = EVENT_IO_BUTTON,
 			.devkind = EVENT_IDEVKIND_GAMEDEV,
-			.datatype = EVENT_IDATATYPE_DIGITAL
+			.datatype = EVENT_IDATATYPE_DIGITAL,
+			.pts = pts
 		}
 	};
 
@@ -1520,19 +1826,8 @@ static void decode_hat(struct arcan_evctx* ctx,
 }
 
 static void defhandler_game(struct arcan_evctx* ctx,
-	struct devnode* node)
+	struct devnode* node, struct input_event* inev, size_t evs)
 {
-	struct input_event inev[64];
-	ssize_t evs = read(node->handle, &inev, sizeof(inev));
-
-	if (-1 == evs){
-		if (errno != EINTR && errno != EAGAIN)
-			disconnect(ctx, node);
-	}
-
-	if (evs < 0 || evs < sizeof(struct input_event))
-		return;
-
 	arcan_event newev = {
 		.category = EVENT_IO,
 		.io = {
@@ -1543,7 +1838,10 @@ static void defhandler_game(struct arcan_evctx* ctx,
 
 	short samplev;
 
-	for (size_t i = 0; i < evs / sizeof(struct input_event); i++){
+	for (size_t i = 0; i < evs; i++){
+		newev.io.pts = ev_pts(node, &inev[i]);
+		node->touch.pts = newev.io.pts;
+
 		switch(inev[i].type){
 		case EV_KEY:
 			if (inev[i].code >= BTN_TOUCH)
@@ -1580,7 +1878,8 @@ static void defhandler_game(struct arcan_evctx* ctx,
 				continue;
 
 			if (inev[i].code >= ABS_HAT0X && inev[i].code <= ABS_HAT3Y){
-				decode_hat(ctx, node, inev[i].code - ABS_HAT0X, inev[i].value);
+				decode_hat(ctx, node,
+					inev[i].code - ABS_HAT0X, inev[i].value, newev.io.pts);
 			}
 			else if (inev[i].code < node->game.axes &&
 				process_axis(ctx,
@@ -1635,20 +1934,8 @@ static inline short code_to_mouse(int code)
 }
 
 static void defhandler_mouse(struct arcan_evctx* ctx,
-	struct devnode* node)
+	struct devnode* node, struct input_event* inev, size_t evs)
 {
-	struct input_event inev[64];
-
-	ssize_t evs = read(node->handle, &inev, sizeof(inev));
-
-	if (-1 == evs){
-		if (errno != EINTR && errno != EAGAIN)
-			disconnect(ctx, node);
-	}
-
-	if (evs < 0 || evs < sizeof(struct input_event))
-		return;
-
 	arcan_event newev = {
 		.category = EVENT_IO,
 		.io = {
@@ -1660,8 +1947,9 @@ static void defhandler_mouse(struct arcan_evctx* ctx,
 	short samplev;
 	newev.io.devid = node->devnum;
 
-	for (size_t i = 0; i < evs / sizeof(struct input_event); i++){
+	for (size_t i = 0; i < evs; i++){
 		int vofs = 0;
+		newev.io.pts = ev_pts(node, &inev[i]);
 
 		switch(inev[i].type){
 		case EV_KEY:
@@ -1735,14 +2023,8 @@ static void defhandler_mouse(struct arcan_evctx* ctx,
 }
 
 static void defhandler_null(struct arcan_evctx* out,
-	struct devnode* node)
+	struct devnode* node, struct input_event* inev, size_t evs)
 {
-	char nbuf[256];
-	ssize_t evs = read(node->handle, nbuf, sizeof(nbuf));
-	if (-1 == evs){
-		if (errno != EINTR && errno != EAGAIN)
-			disconnect(out, node);
-	}
 }
 
 const char* platform_event_devlabel(int devid)
@@ -1767,6 +2049,7 @@ void platform_event_reset(struct arcan_evctx* ctx)
 void platform_event_deinit(struct arcan_evctx* ctx)
 {
 	platform_device_release("TTY", -1);
+	reader_stop();
 
 /* note, we purposely leak (let it disappear on close) to avoid the races and
  * interactions that come from TTY switching -> deinit -> signal -> init */
@@ -1789,6 +2072,7 @@ void platform_event_deinit(struct arcan_evctx* ctx)
 	}
 
 	iodev.n_devs = 0;
+	iodev.gen++;
 	gstate.init = false;
 }
 
@@ -1930,5 +2214,8 @@ void platform_event_init(arcan_evctx* ctx)
 		}
 	}
 
+	reader.coalesce = get_config("event_coalesce", 0, NULL, tag);
+	reader_start();
+
 	platform_event_rescan_idev(ctx);
 }
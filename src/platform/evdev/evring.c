@@ -0,0 +1,169 @@
+/*
+ * Copyright 2019, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ * Description: evdev record ring and motion folding, see evring.h
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "evring.h"
+
+#define EVRING_MASK (EVRING_SIZE - 1)
+
+void evring_reset(struct evring* ring)
+{
+	atomic_store(&ring->head, 0);
+	atomic_store(&ring->tail, 0);
+}
+
+size_t evring_space(struct evring* ring)
+{
+	size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+	return EVRING_SIZE - (head - tail);
+}
+
+size_t evring_push(struct evring* ring, uint16_t slot,
+	unsigned gen, const struct input_event* ev, size_t n)
+{
+	size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+	size_t space = EVRING_SIZE - (head - tail);
+
+	if (n > space)
+		n = space;
+
+	for (size_t i = 0; i < n; i++){
+		struct evring_rec* rec = &ring->buf[(head + i) & EVRING_MASK];
+		rec->slot = slot;
+		rec->gen = gen;
+		rec->flags = 0;
+		rec->ev = ev[i];
+	}
+
+	atomic_store_explicit(&ring->head, head + n, memory_order_release);
+	return n;
+}
+
+bool evring_mark(struct evring* ring, uint16_t slot, unsigned gen, uint8_t flags)
+{
+	size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+	if (head - tail == EVRING_SIZE)
+		return false;
+
+	ring->buf[head & EVRING_MASK] = (struct evring_rec){
+		.slot = slot,
+		.gen = gen,
+		.flags = flags
+	};
+
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+	return true;
+}
+
+size_t evring_pop(struct evring* ring, struct evring_rec* out, size_t lim)
+{
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+	size_t n = head - tail;
+
+	if (n > lim)
+		n = lim;
+
+	for (size_t i = 0; i < n; i++)
+		out[i] = ring->buf[(tail + i) & EVRING_MASK];
+
+	atomic_store_explicit(&ring->tail, tail + n, memory_order_release);
+	return n;
+}
+
+static bool is_motion(const struct input_event* ev)
+{
+	return ev->type == EV_REL && (ev->code == REL_X || ev->code == REL_Y);
+}
+
+static bool is_report(const struct input_event* ev)
+{
+	return ev->type == EV_SYN && ev->code == SYN_REPORT;
+}
+
+static size_t emit_run(struct input_event* ev, size_t out,
+	const struct input_event* report, int dx, int dy)
+{
+	if (dx){
+		ev[out] = *report;
+		ev[out].type = EV_REL;
+		ev[out].code = REL_X;
+		ev[out++].value = dx;
+	}
+
+	if (dy){
+		ev[out] = *report;
+		ev[out].type = EV_REL;
+		ev[out].code = REL_Y;
+		ev[out++].value = dy;
+	}
+
+	ev[out++] = *report;
+	return out;
+}
+
+/*
+ * The output never gets ahead of the input: a folded run is emitted once the
+ * run has ended and is never longer than the frames it replaces (at most
+ * REL_X, REL_Y, SYN_REPORT), everything else is moved down as is.
+ */
+size_t evring_coalesce(struct input_event* ev, size_t n)
+{
+	size_t out = 0;
+	size_t i = 0;
+
+	bool run = false;
+	int dx = 0, dy = 0;
+	struct input_event last;
+
+	while (i < n){
+		size_t end = i;
+		bool motion = true;
+
+		for (; end < n && !is_report(&ev[end]); end++)
+			if (!is_motion(&ev[end]))
+				motion = false;
+
+/* a frame without any events at all is just a (repeated) report */
+		bool complete = end < n;
+		if (complete && motion && end > i){
+			for (size_t j = i; j < end; j++){
+				if (ev[j].code == REL_X)
+					dx += ev[j].value;
+				else
+					dy += ev[j].value;
+			}
+			last = ev[end];
+			run = true;
+			i = end + 1;
+			continue;
+		}
+
+		if (run){
+			out = emit_run(ev, out, &last, dx, dy);
+			run = false;
+			dx = dy = 0;
+		}
+
+		size_t len = (complete ? end + 1 : end) - i;
+		memmove(&ev[out], &ev[i], len * sizeof(struct input_event));
+		out += len;
+		i += len;
+	}
+
+	if (run)
+		out = emit_run(ev, out, &last, dx, dy);
+
+	return out;
+}
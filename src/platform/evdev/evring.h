@@ -0,0 +1,74 @@
+/*
+ * Copyright 2019, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ * Description: Hand-over of raw evdev input_event records from the input
+ * thread (single producer) to the event context (single consumer) through a
+ * lock-free ring, along with folding of relative motion. Kept free from
+ * engine dependencies so that recorded streams can be replayed through it,
+ * see tests/core/evreplay.
+ */
+
+#ifndef HAVE_EVRING
+#define HAVE_EVRING
+
+#include <stdatomic.h>
+#include <linux/input.h>
+
+/* older kernel headers only have the timeval */
+#ifndef input_event_sec
+#define input_event_sec time.tv_sec
+#define input_event_usec time.tv_usec
+#endif
+
+/* number of records, must be a power of two */
+#ifndef EVRING_SIZE
+#define EVRING_SIZE 4096
+#endif
+
+enum evring_flags {
+/* the device went away, [ev] carries no data */
+	EVRING_GONE = 1
+};
+
+struct evring_rec {
+	uint16_t slot;
+	uint8_t flags;
+	unsigned gen;
+	struct input_event ev;
+};
+
+struct evring {
+	_Alignas(64) atomic_size_t head;
+	_Alignas(64) atomic_size_t tail;
+	struct evring_rec buf[EVRING_SIZE];
+};
+
+/* drop everything queued, neither side may be active */
+void evring_reset(struct evring* ring);
+
+/* number of records that can be pushed without blocking, producer side */
+size_t evring_space(struct evring* ring);
+
+/*
+ * Queue [n] events read from device [slot] ([gen] identifies the device
+ * that had the slot at the time). Returns the number of events that fit.
+ */
+size_t evring_push(struct evring* ring, uint16_t slot,
+	unsigned gen, const struct input_event* ev, size_t n);
+
+/* queue a record without data, e.g. EVRING_GONE */
+bool evring_mark(struct evring* ring, uint16_t slot, unsigned gen, uint8_t flags);
+
+/* dequeue up to [lim] records into [out], consumer side */
+size_t evring_pop(struct evring* ring, struct evring_rec* out, size_t lim);
+
+/*
+ * Fold runs of SYN_REPORT frames in [ev] (events from one device) that only
+ * carry REL_X / REL_Y into a single frame with the summed motion and the
+ * timestamp of the last frame in the run. Other frames and a trailing
+ * incomplete frame are left as is. Works in place, returns the new count.
+ */
+size_t evring_coalesce(struct input_event* ev, size_t n);
+
+#endif
@@ -153,4 +153,20 @@ bool platform_fsrv_lastwords(struct arcan_frameserver*, char* dst, size_t n);
  * Release any shared memory resources associated with the frameserver
  */
 void platform_fsrv_dropshared(struct arcan_frameserver* ctx);
+
+/*
+ * Clear the vready/aready flag and wake the frameserver up using the method
+ * that was negotiated through the synch_flags field of the shmpage (futex
+ * directly on the flag, or the vsync/async semaphores). The caller is
+ * expected to be inside platform_fsrv_enter/leave or have the page otherwise
+ * guarded. Releasing video also marks the dirty_chain of the frame as used.
+ */
+void platform_fsrv_release_video(struct arcan_frameserver* ctx);
+void platform_fsrv_release_audio(struct arcan_frameserver* ctx);
+
+/*
+ * For output segments, a new frame has been written to the video buffer:
+ * set vready and wake the frameserver in the same way as the release above.
+ */
+void platform_fsrv_push_video(struct arcan_frameserver* ctx);
 #endif
@@ -0,0 +1,177 @@
+/*
+ * Copyright 2019, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ * Description: Tiled readback comparison, see tilediff.h
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "tilediff.h"
+
+/*
+ * Generic vectors rather than intrinsics so that this lowers to SSE2 / NEON
+ * or whatever else the target has, without any dispatch of our own. Loads go
+ * through memcpy as neither buffer is guaranteed to be 16b aligned at the
+ * tile offsets.
+ */
+typedef uint32_t tdvec __attribute__((vector_size(16)));
+#define TDVEC_PX (sizeof(tdvec) / sizeof(uint32_t))
+
+/* columns are processed in segments to keep the per-band tile state fixed */
+#define SEGMENT_PX (256 * TILEDIFF_SIZE)
+
+static inline bool row_differs(const uint32_t* a, const uint32_t* b, size_t n)
+{
+	tdvec acc = {0};
+	size_t i = 0;
+
+	for (; i + TDVEC_PX <= n; i += TDVEC_PX){
+		tdvec va, vb;
+		memcpy(&va, &a[i], sizeof(tdvec));
+		memcpy(&vb, &b[i], sizeof(tdvec));
+		acc |= va ^ vb;
+	}
+
+	uint32_t tail = 0;
+	for (; i < n; i++)
+		tail |= a[i] ^ b[i];
+
+	uint64_t lanes[2];
+	memcpy(lanes, &acc, sizeof(lanes));
+	return (lanes[0] | lanes[1] | tail) != 0;
+}
+
+static size_t add_run(struct tilediff_rect* out, size_t count,
+	size_t out_lim, struct tilediff_rect run, struct tilediff_rect* bbox)
+{
+	bbox->x2 = run.x2 > bbox->x2 ? run.x2 : bbox->x2;
+
+/* stack onto a run from the previous tile row if it has the same span */
+	for (size_t i = 0; i < count && i < out_lim; i++){
+		if (out[i].x1 != run.x1 || out[i].x2 != run.x2)
+			continue;
+
+		if (out[i].y2 == run.y1){
+			out[i].y2 = run.y2;
+			return count;
+		}
+		if (out[i].y1 == run.y2){
+			out[i].y1 = run.y1;
+			return count;
+		}
+	}
+
+	if (count < out_lim)
+		out[count] = run;
+
+	return count + 1;
+}
+
+size_t tilediff_update(
+	const uint32_t* src, size_t src_stride,
+	uint32_t* dst, size_t dst_stride,
+	size_t w, size_t h, bool flip_y, struct tilediff_rect scan,
+	struct tilediff_rect* out, size_t out_lim, struct tilediff_rect* bbox)
+{
+	*bbox = (struct tilediff_rect){.x1 = w, .y1 = h};
+
+	if (scan.x2 > w)
+		scan.x2 = w;
+	if (scan.y2 > h)
+		scan.y2 = h;
+	if (scan.x1 >= scan.x2 || scan.y1 >= scan.y2)
+		return 0;
+
+/* keep the tile grid fixed so the same content always lands in the same tile */
+	size_t tx1 = scan.x1 - scan.x1 % TILEDIFF_SIZE;
+	size_t ty1 = scan.y1 - scan.y1 % TILEDIFF_SIZE;
+	size_t tx2 = scan.x2 + (TILEDIFF_SIZE - 1) - (scan.x2 - 1) % TILEDIFF_SIZE;
+	if (tx2 > w)
+		tx2 = w;
+
+	size_t count = 0;
+
+/*
+ * Walk each band of tiles row by row rather than tile by tile, the compare is
+ * bound by memory bandwidth and this keeps the access pattern linear. A row
+ * is first compared as a whole and only split into tiles when it differs.
+ * Once a tile is known to differ the rest of its rows are just copied.
+ */
+	for (size_t ty = ty1; ty < scan.y2; ty += TILEDIFF_SIZE){
+		size_t th = h - ty < TILEDIFF_SIZE ? h - ty : TILEDIFF_SIZE;
+		size_t dy1 = flip_y ? h - (ty + th) : ty;
+		size_t dy2 = dy1 + th;
+
+		struct tilediff_rect run = {0};
+		bool in_run = false;
+
+		for (size_t sx = tx1; sx < tx2; sx += SEGMENT_PX){
+			size_t sw = tx2 - sx < SEGMENT_PX ? tx2 - sx : SEGMENT_PX;
+			size_t n_tiles = (sw + TILEDIFF_SIZE - 1) / TILEDIFF_SIZE;
+			uint8_t dirty[SEGMENT_PX / TILEDIFF_SIZE] = {0};
+			size_t n_dirty = 0;
+
+			for (size_t row = ty; row < ty + th; row++){
+				const uint32_t* sr = &src[row * src_stride + sx];
+				uint32_t* dr = &dst[(flip_y ? h - 1 - row : row) * dst_stride + sx];
+
+				if (n_dirty == n_tiles){
+					memcpy(dr, sr, sw * sizeof(uint32_t));
+					continue;
+				}
+
+				if (!n_dirty && !row_differs(sr, dr, sw))
+					continue;
+
+				for (size_t t = 0; t < n_tiles; t++){
+					size_t x = t * TILEDIFF_SIZE;
+					size_t tw = sw - x < TILEDIFF_SIZE ? sw - x : TILEDIFF_SIZE;
+
+					if (!dirty[t]){
+						if (!row_differs(&sr[x], &dr[x], tw))
+							continue;
+						dirty[t] = 1;
+						n_dirty++;
+					}
+
+					memcpy(&dr[x], &sr[x], tw * sizeof(uint32_t));
+				}
+			}
+
+/* runs carry over between segments, they are only split on clean tiles */
+			for (size_t t = 0; t < n_tiles; t++){
+				size_t x = sx + t * TILEDIFF_SIZE;
+				size_t tw = tx2 - x < TILEDIFF_SIZE ? tx2 - x : TILEDIFF_SIZE;
+
+				if (!dirty[t]){
+					if (in_run)
+						count = add_run(out, count, out_lim, run, bbox);
+					in_run = false;
+					continue;
+				}
+
+				if (in_run){
+					run.x2 = x + tw;
+					continue;
+				}
+
+				in_run = true;
+				run = (struct tilediff_rect){
+					.x1 = x, .y1 = dy1, .x2 = x + tw, .y2 = dy2
+				};
+				bbox->x1 = x < bbox->x1 ? x : bbox->x1;
+				bbox->y1 = dy1 < bbox->y1 ? dy1 : bbox->y1;
+				bbox->y2 = dy2 > bbox->y2 ? dy2 : bbox->y2;
+			}
+		}
+
+		if (in_run)
+			count = add_run(out, count, out_lim, run, bbox);
+	}
+
+	return count;
+}
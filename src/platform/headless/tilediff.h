@@ -0,0 +1,39 @@
+/*
+ * Copyright 2019, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ * Description: Tiled comparison between a readback and the buffer last sent
+ * to an encoder, used by the headless platform to find what actually changed
+ * in a frame. Kept free from engine dependencies so that it can be built
+ * into the benchmark in tests/core/tilediff.
+ */
+
+#ifndef HAVE_TILEDIFF
+#define HAVE_TILEDIFF
+
+#define TILEDIFF_SIZE 32
+
+/* x2/y2 are exclusive */
+struct tilediff_rect {
+	size_t x1, y1, x2, y2;
+};
+
+/*
+ * Compare the [w*h] pixels of [src] against [dst] within [scan] (src
+ * coordinates, clamped to w/h) in TILEDIFF_SIZE tiles and copy the tiles
+ * that differ into [dst]. With [flip_y] set, src row n maps to dst row
+ * h - 1 - n. Strides are in pixels.
+ *
+ * The dirty tiles are merged into horizontal runs (and runs stacked on top
+ * of each other with the same span) and written to [out] in dst coordinates
+ * up to [out_lim]. Returns the number of runs that were needed, if that is
+ * larger than [out_lim] only [bbox] covers everything. [bbox] is set to an
+ * empty (x1 >= x2) region if nothing changed.
+ */
+size_t tilediff_update(
+	const uint32_t* src, size_t src_stride,
+	uint32_t* dst, size_t dst_stride,
+	size_t w, size_t h, bool flip_y, struct tilediff_rect scan,
+	struct tilediff_rect* out, size_t out_lim, struct tilediff_rect* bbox);
+
+#endif
@@ -37,6 +37,7 @@
 #include "arcan_event.h"
 
 #include "../platform.h"
+#include "tilediff.h"
 
 #define EGL_EGLEXT_PROTOTYPES
 #define GL_GLEXT_PROTOTYPES
@@ -71,6 +72,22 @@ static struct {
 	} egl;
 
 	struct agp_vstore* vstore;
+
+/* world regions redrawn since the last readback was requested */
+	struct arcan_damage_rect damage;
+	bool damage_full;
+
+/* the readback in flight, it is collected and sent on the next synch */
+	struct {
+		bool pending;
+		struct agp_vstore* store;
+		size_t w, h;
+		struct arcan_damage_rect damage;
+		bool full;
+
+/* contents of the mapped store when the readback was requested */
+		uint32_t seq, ts;
+	} readback;
 } global = {
 	.deadline = 13,
 	.encode = {
@@ -121,6 +138,8 @@ static void spawn_encode_output()
 	}
 
 	global.encode.outctx = fsrv;
+	global.damage_full = true;
+	global.readback.full = true;
 }
 
 void platform_video_shutdown()
@@ -237,120 +256,198 @@ int headless_flush_encode_events()
 	return FRV_NOFRAME;
 }
 
-static int readback_encode()
+/*
+ * Tell the encoder which parts of [vbufs[0]] that changed. For output
+ * segments we are the producer, so the chain is set in full here and
+ * [head, mark) describes the frame that is about to be flagged as ready.
+ * Too many runs for the chain and only the bounding box is provided.
+ */
+static void publish_dirty(struct arcan_shmif_page* page,
+	struct tilediff_rect* runs, size_t n_runs, struct tilediff_rect bbox)
 {
-/* other side is still encoding / synching so don't overwrite the buffer */
-	struct arcan_frameserver* out = global.encode.outctx;
-	TRAMP_GUARD(0, out);
-
-/* not finished, fake it until we finish */
-	if (out->shm.ptr->vready || global.encode.block){
-		platform_fsrv_leave();
-		return 0;
-	}
+	atomic_store(&page->dirty, ((struct arcan_shmif_region){
+		.x1 = bbox.x1, .y1 = bbox.y1, .x2 = bbox.x2, .y2 = bbox.y2
+	}));
 
-/* even if the store sizes have changed for some reason, we crop to the smallest */
-	agp_activate_rendertarget(NULL);
+	uint8_t hints = atomic_load(&page->hints) &
+		~(SHMIF_RHINT_SUBREGION | SHMIF_RHINT_SUBREGION_CHAIN);
 
-	struct agp_vstore* vs = global.vstore ? global.vstore : arcan_vint_world();
-	size_t row_len = vs->w > out->desc.width ? out->desc.width : vs->w;
-	size_t row_sz = row_len * sizeof(av_pixel);
-	size_t n_rows = vs->h > out->desc.height ? out->desc.height : vs->h;
-	size_t buf_sz = vs->w * vs->h * sizeof(av_pixel);
-
-/* recall, alloc_mem is default FATAL unless flagged otherwise */
-	if (buf_sz != vs->vinf.text.s_raw){
-		arcan_mem_free(vs->vinf.text.raw);
-		vs->vinf.text.s_raw = buf_sz;
-		vs->vinf.text.raw = arcan_alloc_mem(vs->vinf.text.s_raw,
-			ARCAN_MEM_VBUFFER, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_PAGE
-		);
+	if (n_runs > ARCAN_SHMIF_DIRTY_CHAIN_LIM){
+		atomic_store(&page->hints, hints | SHMIF_RHINT_SUBREGION);
+		return;
 	}
 
-/* don't really guarantee color format and coding here when it is
- * non-normal texture2D surfaces (where we statically pick formats
- * to avoid repack). */
-	agp_readback_synchronous(vs);
+	unsigned head = atomic_load(&page->dirty_chain.mark);
+	for (size_t i = 0; i < n_runs; i++){
+		atomic_store(&page->dirty_chain.regions[
+			(head + i) % ARCAN_SHMIF_DIRTY_CHAIN_LIM], ((struct arcan_shmif_region){
+			.x1 = runs[i].x1, .y1 = runs[i].y1, .x2 = runs[i].x2, .y2 = runs[i].y2
+		}));
+	}
 
-	bool in_dirty = false;
-	size_t x1 = row_len - 1;
-	size_t x2 = 0, y1 = 0, y2 = 0;
+	atomic_store(&page->dirty_chain.head, head);
+	atomic_store(&page->dirty_chain.tail, head + n_runs);
+	atomic_store_explicit(&page->dirty_chain.mark,
+		head + n_runs, memory_order_release);
 
-	shmif_pixel* dst = out->vbufs[0];
-	shmif_pixel* src = vs->vinf.text.raw;
+	atomic_store(&page->hints,
+		hints | SHMIF_RHINT_SUBREGION | SHMIF_RHINT_SUBREGION_CHAIN);
+}
 
-	size_t dst_row = n_rows - 1;
-	int dst_step = -1;
+/*
+ * Collect the readback requested on the previous synch, compare it to what
+ * the encoder already has and send the tiles that differ. Returns false if
+ * there was nothing to send.
+ */
+static bool send_readback(struct arcan_frameserver* out)
+{
+	struct agp_vstore* vs = global.readback.store;
+	global.readback.pending = false;
 
-	if (!global.encode.flip_y){
-		dst_row = 0;
-		dst_step = 1;
+/* resized since the request, the buffer contents can't be trusted */
+	if (vs->w != global.readback.w || vs->h != global.readback.h){
+		global.damage_full = true;
+		return false;
 	}
 
-	for (size_t row = 0; row < n_rows; row++, dst_row += dst_step){
-		av_pixel acc = 0;
-
-		for (size_t px = 0; px < row_len; px++){
-			av_pixel a = src[row     * vs->w           + px];
-			av_pixel b = dst[dst_row * out->desc.width + px];
-			acc = acc | (a ^ b);
-		}
+/* even if the store sizes have changed for some reason, we crop to the smallest */
+	size_t row_len = vs->w > out->desc.width ? out->desc.width : vs->w;
+	size_t n_rows = vs->h > out->desc.height ? out->desc.height : vs->h;
 
-		if (!acc)
-			continue;
+/* only the regions that were redrawn can differ from what the encoder has,
+ * (rows are in readback order, same as the damage) */
+	struct tilediff_rect scan = {.x2 = row_len, .y2 = n_rows};
+	if (!global.readback.full){
+		struct arcan_damage_rect* r = &global.readback.damage;
+		scan = (struct tilediff_rect){
+			.x1 = r->x1, .y1 = r->y1, .x2 = r->x2, .y2 = r->y2
+		};
+	}
 
-		if (!in_dirty){
-			in_dirty = true;
-			y1 = dst_row;
-			y2 = dst_row;
-		}
-		else
-			y1 = dst_row;
-
-/* grow / shrink the bounding volume */
-		for (size_t tx = 0; tx < x1; tx++){
-			if (
-					(dst[dst_row * out->desc.width + tx] ^
-					 src[row * out->desc.width + tx]) != 0){
-				x1 = tx;
-				break;
-			}
+/* by now the transfer should long since have finished so this won't stall */
+	struct asynch_readback_meta rb = agp_poll_readback(vs);
+	const av_pixel* src = rb.ptr;
+	if (!src){
+		if (rb.release)
+			rb.release(rb.tag);
+
+/* no PBO to map, take the slow path against the current contents instead,
+ * which may have changed outside the damage in the meanwhile */
+		size_t buf_sz = vs->w * vs->h * sizeof(av_pixel);
+		if (buf_sz != vs->vinf.text.s_raw){
+			arcan_mem_free(vs->vinf.text.raw);
+			vs->vinf.text.s_raw = buf_sz;
+			vs->vinf.text.raw = arcan_alloc_mem(vs->vinf.text.s_raw,
+				ARCAN_MEM_VBUFFER, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_PAGE
+			);
 		}
+		agp_activate_rendertarget(NULL);
+		agp_readback_synchronous(vs);
+		src = vs->vinf.text.raw;
+		scan = (struct tilediff_rect){.x2 = row_len, .y2 = n_rows};
+	}
 
-		for (size_t tx = row_len-1; tx > x2; tx--){
-			if (
-					(dst[dst_row * out->desc.width + tx] ^
-					 src[row * out->desc.width + tx]) != 0){
-				x2 = tx;
-				break;
-			}
-		}
+	struct tilediff_rect runs[ARCAN_SHMIF_DIRTY_CHAIN_LIM];
+	struct tilediff_rect bbox;
 
-		memcpy(&dst[dst_row * out->desc.width], &src[row * vs->w], row_sz);
-	}
+	size_t n_runs = tilediff_update(src, vs->w,
+		out->vbufs[0], out->desc.width, row_len, n_rows,
+		global.encode.flip_y, scan, runs, ARCAN_SHMIF_DIRTY_CHAIN_LIM, &bbox
+	);
 
-	if (!in_dirty){
-		platform_fsrv_leave();
-		return 1;
-	}
+	if (rb.ptr && rb.release)
+		rb.release(rb.tag);
 
-/* flag ok and commit dirty region */
-	global.encode.outctx->shm.ptr->hints |= SHMIF_RHINT_SUBREGION;
-	struct arcan_shmif_region dirty = {
-		.x1 = x1, .y1 = y1,
-		.x2 = x2, .y2 = y2
-	};
-	atomic_store(&global.encode.outctx->shm.ptr->dirty, dirty);
-	atomic_store_explicit(
-		&global.encode.outctx->shm.ptr->vready, true, memory_order_seq_cst);
+	if (!n_runs)
+		return false;
+
+	publish_dirty(out->shm.ptr, runs, n_runs, bbox);
+	atomic_store_explicit(&out->shm.ptr->vready, true, memory_order_seq_cst);
 
 /* encode has more explicit frame signalling until we have futexes */
-	platform_fsrv_pushevent(global.encode.outctx, &(struct arcan_event){
+	platform_fsrv_pushevent(out, &(struct arcan_event){
 		.tgt.kind = TARGET_COMMAND_STEPFRAME,
 		.category = EVENT_TARGET,
-		.tgt.ioevs[0] = global.encode.outctx->vfcount++
+		.tgt.ioevs[0] = out->vfcount++
 	});
 
+	return true;
+}
+
+static bool has_damage()
+{
+	struct arcan_damage_rect* d = &global.damage;
+	return global.damage_full || (d->x1 < d->x2 && d->y1 < d->y2);
+}
+
+/*
+ * A mapped store only has damage if it has been updated since the last
+ * readback. Rendertargets track what they redrew, anything else (e.g. a
+ * frameserver store) is taken in full.
+ */
+static const struct arcan_damage* mapped_damage()
+{
+	struct agp_vstore* vs = global.vstore;
+	if (vs->update_seq == global.readback.seq &&
+		vs->update_ts == global.readback.ts)
+		return NULL;
+
+	struct rendertarget* rt = arcan_vint_findrt_vstore(vs);
+	if (rt && (rt->damage.last.full || rt->damage.last.count))
+		return &rt->damage.last;
+
+	global.damage_full = true;
+	return NULL;
+}
+
+/*
+ * Start the transfer of what was just drawn, it is picked up by the next
+ * synch so that the GPU isn't stalled waiting for it (one frame of latency).
+ */
+static void request_readback()
+{
+	struct agp_vstore* vs = global.vstore ? global.vstore : arcan_vint_world();
+	struct arcan_damage_rect* d = &global.damage;
+
+	if (!has_damage())
+		return;
+
+	global.readback.pending = true;
+	global.readback.store = vs;
+	global.readback.w = vs->w;
+	global.readback.h = vs->h;
+	global.readback.damage = *d;
+	global.readback.full |= global.damage_full;
+	global.readback.seq = vs->update_seq;
+	global.readback.ts = vs->update_ts;
+
+	global.damage = (struct arcan_damage_rect){0};
+	global.damage_full = false;
+
+	agp_activate_rendertarget(NULL);
+	agp_request_readback(vs);
+}
+
+static int readback_encode()
+{
+/* other side is still encoding / synching so don't overwrite the buffer */
+	struct arcan_frameserver* out = global.encode.outctx;
+	TRAMP_GUARD(0, out);
+
+	if (global.readback.pending){
+/* not finished, fake it until we finish */
+		if (out->shm.ptr->vready || global.encode.block){
+			platform_fsrv_leave();
+			return 0;
+		}
+
+		send_readback(out);
+		global.readback.full = false;
+	}
+
+	if (!global.encode.block)
+		request_readback();
+
 	platform_fsrv_leave();
 	return 1;
 }
@@ -376,10 +473,29 @@ void platform_video_synch(uint64_t tick_count, float fract,
 	size_t nd;
 	arcan_bench_register_cost( arcan_vint_refresh(fract, &nd) );
 
+	const struct arcan_damage* damage =
+		global.vstore ? mapped_damage() : arcan_vint_worlddamage();
+	if (damage && damage->full)
+		global.damage_full = true;
+
+	for (size_t i = 0; damage && !global.damage_full && i < damage->count; i++){
+		struct arcan_damage_rect r = damage->rects[i];
+		struct arcan_damage_rect* d = &global.damage;
+		if (d->x1 >= d->x2 || d->y1 >= d->y2){
+			*d = r;
+			continue;
+		}
+		d->x1 = r.x1 < d->x1 ? r.x1 : d->x1;
+		d->y1 = r.y1 < d->y1 ? r.y1 : d->y1;
+		d->x2 = r.x2 > d->x2 ? r.x2 : d->x2;
+		d->y2 = r.y2 > d->y2 ? r.y2 : d->y2;
+	}
+
 /*
  * if there is no encoder listening run with the estimated fake synch
  */
-	if (!nd || !global.encode.outctx){
+	if ((!nd && !global.readback.pending && !has_damage()) ||
+		!global.encode.outctx){
 		arcan_conductor_fakesynch(global.deadline);
 	}
 /*
@@ -481,6 +597,11 @@ bool platform_video_map_display(
 		global.vstore = NULL;
 	}
 
+/* the encoder has been fed something else, so the next frame is a full one
+ * and whatever is in flight belongs to the old mapping */
+	global.damage_full = true;
+	global.readback.pending = false;
+
 /*
  * disable output temporarily if it's there
  */
@@ -30,6 +30,17 @@ int arcan_sem_trywait(sem_handle sem);
 int arcan_sem_init(sem_handle*, unsigned value);
 int arcan_sem_destroy(sem_handle);
 
+/*
+ * Optional wait/wake on a 32-bit word in shared memory. [timeout] is in
+ * milliseconds, 0 to wait until woken (or interrupted). Spurious wakeups are
+ * possible so the caller should re-check the value. Platforms without
+ * support return false from _available and -1/ENOTSUP from the others.
+ */
+bool arcan_futex_available();
+int arcan_futex_wait(
+	volatile _Atomic unsigned int* addr, unsigned int val, unsigned timeout);
+int arcan_futex_wake(volatile _Atomic unsigned int* addr);
+
 /*
  * Launch the specified program and bind its resources and control to the
  * returned frameserver instance (NULL if spawn was not possible for some
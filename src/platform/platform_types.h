@@ -182,6 +182,9 @@ struct agp_vstore {
 	size_t refcount;
 	uint32_t update_ts;
 
+/* incremented whenever the contents change, used for damage tracking */
+	uint32_t update_seq;
+
 	union {
 		struct {
 /* ID number connecting to AGP, this MAY be bound diretly to the glid
@@ -243,7 +246,8 @@ enum shader_vertex_attributes {
 	ATTRIBUTE_TANGENT,
 	ATTRIBUTE_BITANGENT,
 	ATTRIBUTE_JOINTS0,
-	ATTRIBUTE_WEIGHTS1
+	ATTRIBUTE_WEIGHTS1,
+	ATTRIBUTE_INSTANCE_MODELVIEW
 };
 
 /*
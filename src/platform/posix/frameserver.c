@@ -232,6 +232,13 @@ if (shmpage){
 		shmpage->aready = false;
 		arcan_sem_post( src->vsync );
 		arcan_sem_post( src->async );
+
+/* the client might be in either wait mode still if it hasn't seen the ack */
+		if (shmpage->synch_flags & SHMIF_SYNCH_FUTEX_CAP){
+			arcan_futex_wake(&shmpage->vready);
+			arcan_futex_wake(&shmpage->aready);
+			arcan_futex_wake(&shmpage->synch_flags);
+		}
 	}
 
 /* if BUS happens during _enter, the handler will take
@@ -690,12 +697,50 @@ fail:
 		shmpage->cookie = arcan_shmif_cookie();
 		shmpage->vpending = 1;
 		shmpage->apending = 1;
+		if (arcan_futex_available())
+			shmpage->synch_flags = SHMIF_SYNCH_FUTEX_CAP;
 		ctx->shm.ptr = shmpage;
 	platform_fsrv_leave(ctx);
 
 	return true;
 }
 
+static void wake_synch(struct arcan_frameserver* src,
+	volatile atomic_uint* flag, sem_handle sem)
+{
+	if (atomic_load(&src->shm.ptr->synch_flags) & SHMIF_SYNCH_FUTEX_ACK)
+		arcan_futex_wake(flag);
+	else
+		arcan_sem_post(sem);
+}
+
+static void release_synch(struct arcan_frameserver* src,
+	volatile atomic_uint* flag, sem_handle sem)
+{
+	atomic_store_explicit(flag, 0, memory_order_release);
+	wake_synch(src, flag, sem);
+}
+
+void platform_fsrv_release_video(struct arcan_frameserver* src)
+{
+/* the regions of the released frame are consumed along with the buffer */
+	atomic_store(&src->shm.ptr->dirty_chain.head,
+		atomic_load(&src->shm.ptr->dirty_chain.mark));
+
+	release_synch(src, &src->shm.ptr->vready, src->vsync);
+}
+
+void platform_fsrv_release_audio(struct arcan_frameserver* src)
+{
+	release_synch(src, &src->shm.ptr->aready, src->async);
+}
+
+void platform_fsrv_push_video(struct arcan_frameserver* src)
+{
+	atomic_store_explicit(&src->shm.ptr->vready, 1, memory_order_release);
+	wake_synch(src, &src->shm.ptr->vready, src->vsync);
+}
+
 struct arcan_frameserver* platform_fsrv_alloc()
 {
 	arcan_frameserver* res = arcan_alloc_mem(sizeof(arcan_frameserver),
@@ -1366,9 +1411,10 @@ fail:
 	state = -1;
 
 done:
-/* barrier + signal */
+/* barrier + signal, a futex- waiting client waits for the RESIZE bit */
 	FORCE_SYNCH();
-	arcan_sem_post(s->vsync);
+	atomic_fetch_and(&shmpage->synch_flags, ~SHMIF_SYNCH_RESIZE);
+	wake_synch(s, &shmpage->synch_flags, s->vsync);
 	return state;
 }
 
@@ -5,9 +5,21 @@
  */
 
 /*
- * This is mostly a stub implementation still, serious attempts
- * at getting a strong and efficient implementation is slated for
- * 0.8-0.9.
+ * Small VSTRUCT/STRINGBUF allocations are served from per-type size class
+ * freelists carved out of aligned chunks, and larger VBUFFER/ABUFFER ones
+ * from page-aligned slabs that are recycled on free rather than returned
+ * to the system right away. Everything else (and SENSITIVE, page-aligned
+ * small blocks etc.) still maps to malloc/posix_memalign.
+ *
+ * arcan_mem_free has to accept pointers that never came from here (strdup
+ * and friends are freed through it throughout), so ownership is determined
+ * by looking the address up in the chunk and slab maps.
+ *
+ * Several threads allocate (loader, recording and text workers), so each
+ * type has its own lock for its freelists and statistics. The maps only
+ * change when a chunk or slab is mapped or unmapped, so frees look them up
+ * under a shared read lock. The slab cache that arcan_mem_tick ages out has
+ * the one remaining global lock.
  */
 
 #include <stdlib.h>
@@ -17,6 +29,7 @@
 #include <stdbool.h>
 #include <signal.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #include <sys/mman.h>
 
@@ -38,6 +51,37 @@
 #define REALLOC_STEP 16
 #endif
 
+#ifndef POOL_CHUNK_SZ
+#define POOL_CHUNK_SZ (64 * 1024)
+#endif
+
+/* smallest VBUFFER/ABUFFER allocation that goes to a slab */
+#ifndef POOL_SLAB_MIN
+#define POOL_SLAB_MIN (64 * 1024)
+#endif
+
+/* upper bound on the size of freed slabs that are kept for reuse */
+#ifndef POOL_VBUFFER_CACHE
+#define POOL_VBUFFER_CACHE (64 * 1024 * 1024)
+#endif
+
+#ifndef POOL_ABUFFER_CACHE
+#define POOL_ABUFFER_CACHE (4 * 1024 * 1024)
+#endif
+
+/* number of arcan_mem_ticks a freed slab is kept around */
+#ifndef POOL_SLAB_TTL
+#define POOL_SLAB_TTL 80
+#endif
+
+#define POOL_CHUNK_HDR 64
+#define POOL_N_CLASSES 8
+#define POOL_N_SLABS 32
+
+static const size_t pool_classes[POOL_N_CLASSES] = {
+	16, 32, 64, 128, 256, 512, 1024, 2048
+};
+
 struct mempool_meta {
 /*	mempool_hook_t alloc;
 	  mempool_hook_t free; */
@@ -49,6 +93,75 @@ struct mempool_meta {
 	size_t n_pages;
 };
 
+/* placed at the beginning of each chunk */
+struct pool_chunk {
+	uint8_t type;
+	uint8_t cls;
+	size_t used;
+};
+
+struct pool_slab {
+	uint8_t* base;
+	size_t size;
+	size_t used;
+	uint8_t type;
+	bool free;
+	unsigned long long freed_at;
+};
+
+/* open addressing, address -> chunk or slab */
+struct pool_map {
+	uintptr_t* keys;
+	void** vals;
+	size_t count, limit;
+};
+
+struct pool_type {
+	pthread_mutex_t lock;
+	struct mempool_meta meta;
+	void* freelist[POOL_N_CLASSES];
+};
+
+static struct {
+	struct pool_type types[ARCAN_MEM_ENDMARKER];
+
+	pthread_rwlock_t map_lock;
+	struct pool_map chunks;
+	struct pool_map slabs;
+
+	pthread_mutex_t lock;
+
+/* freed slabs, reused for allocations that fit */
+	struct pool_slab* cache[POOL_N_SLABS];
+	size_t cache_bytes[ARCAN_MEM_ENDMARKER];
+	size_t n_cached;
+
+	unsigned long long tick;
+} pool = {
+	.map_lock = PTHREAD_RWLOCK_INITIALIZER,
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+static void pool_init()
+{
+	for (size_t i = 0; i < ARCAN_MEM_ENDMARKER; i++)
+		pthread_mutex_init(&pool.types[i].lock, NULL);
+}
+
+static struct pool_type* pool_lock(enum arcan_memtypes type)
+{
+	pthread_once(&pool_once, pool_init);
+	pthread_mutex_lock(&pool.types[type].lock);
+	return &pool.types[type];
+}
+
+static void pool_unlock(struct pool_type* pt)
+{
+	pthread_mutex_unlock(&pt->lock);
+}
+
 /* pool behaviors:
  * [ SENSITIVE is always a special case ]
  *   |-> pages will remain mapped in dumps, but data will be
@@ -107,6 +220,270 @@ struct mempool_meta {
 
 int system_page_size = 4096;
 
+static size_t map_slot(struct pool_map* map, uintptr_t key)
+{
+	size_t i = (key * 0x9E3779B97F4A7C15ull) & (map->limit - 1);
+	while (map->keys[i] && map->keys[i] != key)
+		i = (i + 1) & (map->limit - 1);
+	return i;
+}
+
+static void* map_get(struct pool_map* map, uintptr_t key)
+{
+	if (!map->count)
+		return NULL;
+
+	size_t i = map_slot(map, key);
+	return map->keys[i] ? map->vals[i] : NULL;
+}
+
+static bool map_set(struct pool_map* map, uintptr_t key, void* val)
+{
+	if ((map->count + 1) * 2 > map->limit){
+		struct pool_map nmap = {.limit = map->limit ? map->limit * 2 : 256};
+		nmap.keys = calloc(nmap.limit, sizeof(uintptr_t));
+		nmap.vals = calloc(nmap.limit, sizeof(void*));
+		if (!nmap.keys || !nmap.vals){
+			free(nmap.keys);
+			free(nmap.vals);
+			return false;
+		}
+
+		for (size_t i = 0; i < map->limit; i++)
+			if (map->keys[i]){
+				size_t j = map_slot(&nmap, map->keys[i]);
+				nmap.keys[j] = map->keys[i];
+				nmap.vals[j] = map->vals[i];
+			}
+
+		nmap.count = map->count;
+		free(map->keys);
+		free(map->vals);
+		*map = nmap;
+	}
+
+	size_t i = map_slot(map, key);
+	if (!map->keys[i])
+		map->count++;
+	map->keys[i] = key;
+	map->vals[i] = val;
+	return true;
+}
+
+static void map_del(struct pool_map* map, uintptr_t key)
+{
+	size_t i = map_slot(map, key);
+	if (!map->keys[i])
+		return;
+
+	map->keys[i] = 0;
+	map->count--;
+
+/* shift the rest of the cluster back so lookups don't stop early */
+	for (size_t j = (i + 1) & (map->limit - 1); map->keys[j];
+		j = (j + 1) & (map->limit - 1)){
+		uintptr_t k = map->keys[j];
+		void* v = map->vals[j];
+		map->keys[j] = 0;
+		map->keys[map_slot(map, k)] = k;
+		map->vals[map_slot(map, k)] = v;
+	}
+}
+
+static int pool_class(size_t nb)
+{
+	for (size_t i = 0; i < POOL_N_CLASSES; i++)
+		if (nb <= pool_classes[i])
+			return i;
+	return -1;
+}
+
+/* type lock held */
+static void* chunk_alloc(struct pool_type* pt, enum arcan_memtypes type, int cls)
+{
+	void** head = &pt->freelist[cls];
+
+	if (!*head){
+		void* base;
+		if (0 != posix_memalign(&base, POOL_CHUNK_SZ, POOL_CHUNK_SZ))
+			return NULL;
+
+/* set the header before the chunk can be found by a free on another thread */
+		struct pool_chunk* chunk = base;
+		*chunk = (struct pool_chunk){.type = type, .cls = cls};
+
+		pthread_rwlock_wrlock(&pool.map_lock);
+		bool ok = map_set(&pool.chunks, (uintptr_t) base, base);
+		pthread_rwlock_unlock(&pool.map_lock);
+
+		if (!ok){
+			free(base);
+			return NULL;
+		}
+
+		pt->meta.n_pages += POOL_CHUNK_SZ / system_page_size;
+
+/* thread the new objects so that they are handed out in address order */
+		size_t sz = pool_classes[cls];
+		size_t n = (POOL_CHUNK_SZ - POOL_CHUNK_HDR) / sz;
+		uint8_t* first = (uint8_t*) base + POOL_CHUNK_HDR;
+		for (size_t i = n; i > 0; i--){
+			*(void**) &first[(i - 1) * sz] = *head;
+			*head = &first[(i - 1) * sz];
+		}
+	}
+
+	void* rv = *head;
+	*head = *(void**) rv;
+
+	struct pool_chunk* chunk = (struct pool_chunk*)
+		((uintptr_t) rv & ~(uintptr_t)(POOL_CHUNK_SZ - 1));
+	chunk->used++;
+	pt->meta.in_use += pool_classes[cls];
+	pt->meta.alloc_cnt++;
+
+	return rv;
+}
+
+/* slab lock held */
+static void slab_unmap(struct pool_slab* slab)
+{
+	pthread_rwlock_wrlock(&pool.map_lock);
+	map_del(&pool.slabs, (uintptr_t) slab->base);
+	pthread_rwlock_unlock(&pool.map_lock);
+
+	struct pool_type* pt = pool_lock(slab->type);
+	pt->meta.n_pages -= slab->size / system_page_size;
+	pool_unlock(pt);
+
+	munmap(slab->base, slab->size);
+	free(slab);
+}
+
+static void cache_remove(size_t i)
+{
+	pool.cache_bytes[pool.cache[i]->type] -= pool.cache[i]->size;
+	pool.cache[i] = pool.cache[--pool.n_cached];
+}
+
+/* slab lock held */
+static void* slab_alloc(enum arcan_memtypes type, size_t nb, bool* fresh)
+{
+	size_t align = type == ARCAN_MEM_ABUFFER ? 64 * 1024 : system_page_size;
+	size_t size = (nb + align - 1) / align * align;
+
+/* the closest fit, but don't waste more than a quarter on reuse */
+	ssize_t best = -1;
+	for (size_t i = 0; i < pool.n_cached; i++){
+		struct pool_slab* slab = pool.cache[i];
+		if (slab->type != type || slab->size < size || slab->size > size + size / 4)
+			continue;
+		if (best == -1 || slab->size < pool.cache[best]->size)
+			best = i;
+	}
+
+	struct pool_slab* slab;
+	if (best != -1){
+		slab = pool.cache[best];
+		cache_remove(best);
+		*fresh = false;
+	}
+	else {
+		slab = malloc(sizeof(struct pool_slab));
+		if (!slab)
+			return NULL;
+
+		void* base = mmap(NULL, size,
+			PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (base == MAP_FAILED){
+			free(slab);
+			return NULL;
+		}
+
+		*slab = (struct pool_slab){
+			.base = base,
+			.size = size,
+			.type = type
+		};
+
+		pthread_rwlock_wrlock(&pool.map_lock);
+		bool ok = map_set(&pool.slabs, (uintptr_t) base, slab);
+		pthread_rwlock_unlock(&pool.map_lock);
+
+		if (!ok){
+			munmap(base, size);
+			free(slab);
+			return NULL;
+		}
+
+		if (NO_DUMPFLAG)
+			madvise(base, size, NO_DUMPFLAG);
+
+		*fresh = true;
+	}
+
+	slab->free = false;
+	slab->used = nb;
+
+	struct pool_type* pt = pool_lock(type);
+	if (*fresh)
+		pt->meta.n_pages += size / system_page_size;
+	pt->meta.in_use += nb;
+	pt->meta.alloc_cnt++;
+	pool_unlock(pt);
+
+	return slab->base;
+}
+
+static void chunk_release(struct pool_chunk* chunk, void* ptr)
+{
+	struct pool_type* pt = pool_lock(chunk->type);
+	*(void**) ptr = pt->freelist[chunk->cls];
+	pt->freelist[chunk->cls] = ptr;
+	chunk->used--;
+	pt->meta.in_use -= pool_classes[chunk->cls];
+	pt->meta.dealloc_cnt++;
+	pool_unlock(pt);
+}
+
+/* slab lock held */
+static void slab_release(struct pool_slab* slab)
+{
+	if (slab->free)
+		return;
+
+	struct pool_type* pt = pool_lock(slab->type);
+	pt->meta.in_use -= slab->used;
+	pt->meta.dealloc_cnt++;
+	pool_unlock(pt);
+
+	size_t limit = slab->type == ARCAN_MEM_VBUFFER ?
+		POOL_VBUFFER_CACHE : POOL_ABUFFER_CACHE;
+
+/* make room by dropping the oldest cached slab */
+	if (pool.n_cached == POOL_N_SLABS){
+		size_t oldest = 0;
+		for (size_t i = 1; i < pool.n_cached; i++)
+			if (pool.cache[i]->freed_at < pool.cache[oldest]->freed_at)
+				oldest = i;
+		struct pool_slab* old = pool.cache[oldest];
+		cache_remove(oldest);
+		slab_unmap(old);
+	}
+
+	if (pool.cache_bytes[slab->type] + slab->size > limit){
+		slab_unmap(slab);
+		return;
+	}
+
+/* keep the pages resident, the point is to not pay for faulting them in
+ * again when the same size comes back (feed resize, readback, ...) */
+	slab->free = true;
+	slab->freed_at = pool.tick;
+	pool.cache[pool.n_cached++] = slab;
+	pool.cache_bytes[slab->type] += slab->size;
+}
+
 /*
  * map initial pools, pre-fill some video buffers,
  * get limits and assert that our build-time minimal
@@ -114,16 +491,51 @@ int system_page_size = 4096;
  */
 void arcan_mem_init()
 {
-
+	long pagesz = sysconf(_SC_PAGE_SIZE);
+	if (pagesz > 0)
+		system_page_size = pagesz;
 }
 
 /*
  * there should essentially be NO memory blocks marked
  * TEMPORARY or SENSITIVE (NON VIDEO/AUDIO) alive at this
  * point, use the tick point to check and trap as leaks.
+ *
+ * slabs that have been sitting unused for a while are returned here.
  */
 void arcan_mem_tick()
 {
+	pthread_mutex_lock(&pool.lock);
+	pool.tick++;
+
+	for (size_t i = 0; i < pool.n_cached;){
+		struct pool_slab* slab = pool.cache[i];
+		if (pool.tick - slab->freed_at > POOL_SLAB_TTL){
+			cache_remove(i);
+			slab_unmap(slab);
+		}
+		else
+			i++;
+	}
+
+	pthread_mutex_unlock(&pool.lock);
+}
+
+bool arcan_mem_stats(enum arcan_memtypes type, struct arcan_mem_stats* out)
+{
+	if (type <= 0 || type >= ARCAN_MEM_ENDMARKER)
+		return false;
+
+	struct pool_type* pt = pool_lock(type);
+	*out = (struct arcan_mem_stats){
+		.alloc_cnt = pt->meta.alloc_cnt,
+		.dealloc_cnt = pt->meta.dealloc_cnt,
+		.in_use = pt->meta.in_use,
+		.n_pages = pt->meta.n_pages
+	};
+	pool_unlock(pt);
+
+	return true;
 }
 
 /*static void sigsegv_hand(int sig, siginfo_t* si, void* unused)
@@ -153,7 +565,39 @@ void* arcan_alloc_mem(size_t nb,
 	size_t header_sz = 0;
 	size_t footer_sz = 0;
 	size_t padding_sz = 0;
-	size_t total;
+	size_t total = nb;
+	bool fresh = false;
+
+/* sensitive blocks are never recycled */
+	if (nb && !(hint & ARCAN_MEM_SENSITIVE)){
+		int cls;
+
+		switch (type){
+		case ARCAN_MEM_VSTRUCT:
+		case ARCAN_MEM_STRINGBUF:
+			if (align != ARCAN_MEMALIGN_PAGE && -1 != (cls = pool_class(nb))){
+				struct pool_type* pt = pool_lock(type);
+				rptr = chunk_alloc(pt, type, cls);
+				pool_unlock(pt);
+			}
+		break;
+
+		case ARCAN_MEM_VBUFFER:
+		case ARCAN_MEM_ABUFFER:
+			if (nb >= POOL_SLAB_MIN){
+				pthread_mutex_lock(&pool.lock);
+				rptr = slab_alloc(type, nb, &fresh);
+				pthread_mutex_unlock(&pool.lock);
+			}
+		break;
+
+		default:
+		break;
+		}
+
+		if (rptr)
+			goto pooled;
+	}
 
 	switch (type){
 	case ARCAN_MEM_BINDING:
@@ -219,13 +663,14 @@ void* arcan_alloc_mem(size_t nb,
 	if (madvflag)
 		madvise(rptr, total, madvflag);
 
+pooled:
 	if (hint & ARCAN_MEM_BZERO){
 		if (type == ARCAN_MEM_VBUFFER){
 			av_pixel* buf = (av_pixel*) rptr;
 			for (size_t i = 0; i < nb; i += sizeof(av_pixel))
 				*buf++ = RGBA(0, 0, 0, 255);
 		}
-		else
+		else if (!fresh)
 			memset(rptr, '\0', total);
 	}
 
@@ -283,13 +728,28 @@ void* arcan_alloc_fillmem(const void* data,
 
 void arcan_mem_free(void* inptr)
 {
-/* lock then free */
+	if (!inptr)
+		return;
+
 /* depending on type and flag, verify integrity,
  * then cleanup. VBUFFER for instance doesn't
  * automatically shrink, but rather reset and flag
  * as unused */
-
-
-	free(inptr);
+	pthread_rwlock_rdlock(&pool.map_lock);
+	struct pool_chunk* chunk = map_get(&pool.chunks,
+		(uintptr_t) inptr & ~(uintptr_t)(POOL_CHUNK_SZ - 1));
+	struct pool_slab* slab =
+		chunk ? NULL : map_get(&pool.slabs, (uintptr_t) inptr);
+	pthread_rwlock_unlock(&pool.map_lock);
+
+	if (chunk)
+		chunk_release(chunk, inptr);
+	else if (slab){
+		pthread_mutex_lock(&pool.lock);
+		slab_release(slab);
+		pthread_mutex_unlock(&pool.lock);
+	}
+	else
+		free(inptr);
 }
 
@@ -9,6 +9,12 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#ifdef __linux
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
 #ifndef PLATFORM_HEADER
 #include "arcan_shmif.h"
 #else
@@ -47,3 +53,52 @@ int arcan_sem_destroy(sem_handle sem)
 {
 	return sem_destroy(sem);
 }
+
+/*
+ * The futex versions operate directly on a 32-bit word in the shared page,
+ * waking is tied to the actual state change rather than a separate counter
+ * that can drift from the atomic flag it is supposed to mirror.
+ */
+#ifdef __linux
+bool arcan_futex_available()
+{
+	return true;
+}
+
+int arcan_futex_wait(
+	volatile _Atomic unsigned int* addr, unsigned int val, unsigned timeout)
+{
+	struct timespec ts = {
+		.tv_sec = timeout / 1000,
+		.tv_nsec = (timeout % 1000) * 1000000
+	};
+
+/* shared-memory mapping between processes, can't use the _PRIVATE ops */
+	return syscall(SYS_futex, addr,
+		FUTEX_WAIT, val, timeout ? &ts : NULL, NULL, 0);
+}
+
+int arcan_futex_wake(volatile _Atomic unsigned int* addr)
+{
+	return syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+#else
+bool arcan_futex_available()
+{
+	return false;
+}
+
+int arcan_futex_wait(
+	volatile _Atomic unsigned int* addr, unsigned int val, unsigned timeout)
+{
+	errno = ENOTSUP;
+	return -1;
+}
+
+int arcan_futex_wake(volatile _Atomic unsigned int* addr)
+{
+	errno = ENOTSUP;
+	return -1;
+}
+#endif
@@ -34,6 +34,12 @@ void arcan_mem_tick()
 {
 }
 
+bool arcan_mem_stats(enum arcan_memtypes type, struct arcan_mem_stats* out)
+{
+	*out = (struct arcan_mem_stats){0};
+	return type > 0 && type < ARCAN_MEM_ENDMARKER;
+}
+
 void arcan_mem_growarr(struct arcan_strarr* res)
 {
 /* _alloc functions lacks a grow at the moment,
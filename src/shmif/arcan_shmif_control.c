@@ -127,6 +127,12 @@ struct shmif_hidden {
 	bool paused : 1;
 	bool log_event : 1;
 
+/* negotiated through synch_flags, wait on vready/aready directly */
+	bool futex : 1;
+
+/* more regions than the dirty_chain could fit, merge on signal */
+	bool chain_overflow : 1;
+
 	char* alt_conn;
 
 	enum ARCAN_FLAGS flags;
@@ -1231,6 +1237,14 @@ struct arcan_shmif_cont shmif_acquire_int(
 
 	setup_avbuf(&res);
 
+/* opt-in to waiting directly on the page if the parent can wake us there,
+ * this has to happen before the first transfer */
+	if ((atomic_load(&res.addr->synch_flags) & SHMIF_SYNCH_FUTEX_CAP) &&
+		arcan_futex_available() && !getenv("ARCAN_SHMIF_NOFUTEX")){
+		atomic_fetch_or(&res.addr->synch_flags, SHMIF_SYNCH_FUTEX_ACK);
+		res.priv->futex = true;
+	}
+
 	pthread_mutex_init(&res.priv->lock, NULL);
 
 /* local flag that hints at different synchronization work */
@@ -1254,6 +1268,25 @@ struct arcan_shmif_cont arcan_shmif_acquire(struct arcan_shmif_cont* parent,
 	return res;
 }
 
+/*
+ * Block until the parent has released [flag] (vready or aready) or the dms
+ * has been pulled, using the synchronization method picked in acquire.
+ */
+static void synch_wait(struct arcan_shmif_cont* ctx,
+	volatile atomic_uint* flag, sem_handle sem)
+{
+	if (!ctx->priv->futex){
+		while (atomic_load(flag) && ctx->addr->dms)
+			arcan_sem_wait(sem);
+		return;
+	}
+
+/* the timeout only matters if the parent dies without waking us */
+	unsigned val;
+	while ((val = atomic_load(flag)) && ctx->addr->dms)
+		arcan_futex_wait(flag, val, 1000);
+}
+
 /* this act as our safeword (or well safebyte), if either party
  * for _any_reason decides that it is not worth going - the dms
  * (dead man's switch) is pulled. */
@@ -1265,9 +1298,19 @@ static void* guard_thread(void* gs)
 		if (!parent_alive(gstr)){
 			volatile uint8_t* dms;
 			pthread_mutex_lock(&gstr->guard.synch);
-			if ((dms = atomic_load(&gstr->guard.dms)))
+			if ((dms = atomic_load(&gstr->guard.dms))){
 				*dms = false;
 
+/* futex- waiters re-check dms after a wakeup, the page is found via dms */
+				struct arcan_shmif_page* page = (struct arcan_shmif_page*)
+					((uintptr_t)dms - offsetof(struct arcan_shmif_page, dms));
+				if (page->synch_flags & SHMIF_SYNCH_FUTEX_ACK){
+					arcan_futex_wake(&page->vready);
+					arcan_futex_wake(&page->aready);
+					arcan_futex_wake(&page->synch_flags);
+				}
+			}
+
 			for (size_t i = 0; i < COUNT_OF(gstr->guard.semset); i++){
 				if (gstr->guard.semset[i])
 					arcan_sem_post(gstr->guard.semset[i]);
@@ -1388,6 +1431,30 @@ static bool step_v(struct arcan_shmif_cont* ctx)
 		atomic_store(&ctx->addr->dirty, ctx->dirty);
 	}
 
+/* the previous frame has been consumed at this stage (signal waits), so the
+ * slot after the last mark is free to hold the merged region on overflow */
+	if (ctx->hints & SHMIF_RHINT_SUBREGION_CHAIN){
+		unsigned tail = atomic_load(&ctx->addr->dirty_chain.tail);
+
+		if (priv->chain_overflow){
+			unsigned mark = atomic_load(&ctx->addr->dirty_chain.mark);
+			atomic_store(&ctx->addr->dirty_chain.regions[
+				mark % ARCAN_SHMIF_DIRTY_CHAIN_LIM], ctx->dirty);
+			tail = mark + 1;
+			atomic_store(&ctx->addr->dirty_chain.tail, tail);
+			priv->chain_overflow = false;
+		}
+
+		atomic_store(&ctx->addr->dirty, ctx->dirty);
+		atomic_store_explicit(&ctx->addr->dirty_chain.mark,
+			tail, memory_order_release);
+
+/* the bounding box is only kept for the overflow case, restart it */
+		ctx->dirty = (struct arcan_shmif_region){
+			.x1 = ctx->w, .y1 = ctx->h, .x2 = 0, .y2 = 0
+		};
+	}
+
 /* mark the current buffer as pending, this is used when we have
  * non-subregion + (double, triple, quadruple buffer) rendering */
 	int pending = atomic_fetch_or_explicit(
@@ -1471,9 +1538,13 @@ unsigned arcan_shmif_signal(struct arcan_shmif_cont* ctx,
 		bool lock = step_a(ctx);
 
 /* guard-thread will pull the sems for us on dms */
-		if (lock && !(mask & SHMIF_SIGBLK_NONE))
-			arcan_sem_wait(ctx->asem);
-		else
+		if (lock && !(mask & SHMIF_SIGBLK_NONE)){
+			if (priv->futex)
+				synch_wait(ctx, &ctx->addr->aready, ctx->asem);
+			else
+				arcan_sem_wait(ctx->asem);
+		}
+		else if (!priv->futex)
 			arcan_sem_trywait(ctx->asem);
 	}
 /* for sub-region multi-buffer synch, we currently need to
@@ -1488,16 +1559,14 @@ unsigned arcan_shmif_signal(struct arcan_shmif_cont* ctx,
 			);
 		}
 
-		while ((ctx->hints & SHMIF_RHINT_SUBREGION) && ctx->addr->vready)
-			arcan_sem_wait(ctx->vsem);
+		if (ctx->hints & (SHMIF_RHINT_SUBREGION | SHMIF_RHINT_SUBREGION_CHAIN))
+			synch_wait(ctx, &ctx->addr->vready, ctx->vsem);
 
 		bool lock = step_v(ctx);
 
-		if (lock && !(mask & SHMIF_SIGBLK_NONE)){
-			while (ctx->addr->vready)
-				arcan_sem_wait(ctx->vsem);
-		}
-		else
+		if (lock && !(mask & SHMIF_SIGBLK_NONE))
+			synch_wait(ctx, &ctx->addr->vready, ctx->vsem);
+		else if (!priv->futex)
 			arcan_sem_trywait(ctx->vsem);
 	}
 
@@ -1605,14 +1674,8 @@ static bool shmif_resize(struct arcan_shmif_cont* arg,
 	}
 
 /* wait for any outstanding v/asynch */
-	if (atomic_load(&arg->addr->vready)){
-		while (atomic_load(&arg->addr->vready) && arg->addr->dms)
-			arcan_sem_wait(arg->vsem);
-	}
-	if (atomic_load(&arg->addr->aready)){
-		while (atomic_load(&arg->addr->aready) && arg->addr->dms)
-			arcan_sem_wait(arg->asem);
-	}
+	synch_wait(arg, &arg->addr->vready, arg->vsem);
+	synch_wait(arg, &arg->addr->aready, arg->asem);
 
 	width = width < 1 ? 1 : width;
 	height = height < 1 ? 1 : height;
@@ -1657,11 +1720,22 @@ static bool shmif_resize(struct arcan_shmif_cont* arg,
 /* all force synch- calls should be removed when atomicity and reordering
  * behavior have been verified properly */
 	FORCE_SYNCH();
-	arg->addr->resized = 1;
-	do{
-		arcan_sem_wait(arg->vsem);
+	if (arg->priv->futex){
+		atomic_fetch_or(&arg->addr->synch_flags, SHMIF_SYNCH_RESIZE);
+		arg->addr->resized = 1;
+
+		unsigned val;
+		while (((val = atomic_load(&arg->addr->synch_flags)) &
+			SHMIF_SYNCH_RESIZE) && arg->addr->dms)
+			arcan_futex_wait(&arg->addr->synch_flags, val, 1000);
+	}
+	else {
+		arg->addr->resized = 1;
+		do{
+			arcan_sem_wait(arg->vsem);
+		}
+		while (arg->addr->resized);
 	}
-	while (arg->addr->resized);
 
 /*
  * spin until acknowledged, re-using the "wait on sync-fd" approach might be
@@ -2102,11 +2176,8 @@ enum shmif_migrate_status arcan_shmif_migrate(
 
 /* got a valid connection, first synch source segment so we don't have
  * anything pending */
-	while(atomic_load(&cont->addr->vready) && cont->addr->dms)
-		arcan_sem_wait(cont->vsem);
-
-	while(atomic_load(&cont->addr->aready) && cont->addr->dms)
-		arcan_sem_wait(cont->asem);
+	synch_wait(cont, &cont->addr->vready, cont->vsem);
+	synch_wait(cont, &cont->addr->aready, cont->asem);
 
 	size_t w = atomic_load(&cont->addr->w);
 	size_t h = atomic_load(&cont->addr->h);
@@ -2666,17 +2737,44 @@ pid_t arcan_shmif_handover_exec(
 int arcan_shmif_deadline(
 	struct arcan_shmif_cont* c, unsigned last_cost, int* jitter, int* errc)
 {
-	if (!c || !c->addr)
+	if (!c || !c->addr){
+		if (errc)
+			*errc = -1;
 		return -1;
+	}
 
-	if (c->addr->vready)
+	if (c->addr->vready){
+		if (errc)
+			*errc = -2;
 		return -2;
+	}
 
-/*
- * no actual deadline information yet, just first part in hooking it up
- * then modify shmif_signal / dirty to use the vpts field to retrieve
- */
-	return 0;
+	long long next = atomic_load(&c->addr->vsynch_next);
+	long long step = atomic_load(&c->addr->vsynch_step);
+	long long cost = atomic_load(&c->addr->vsynch_cost);
+	int jit = atomic_load(&c->addr->vsynch_jitter);
+
+/* parent doesn't provide feedback, assume ~60Hz with no composition cost,
+ * never negative as that would read as an error */
+	if (!next || !step){
+		if (errc)
+			*errc = -3;
+		if (jitter)
+			*jitter = 0;
+		return last_cost < 16666 ? 16666 - (int)last_cost : 0;
+	}
+
+	if (errc)
+		*errc = 0;
+	if (jitter)
+		*jitter = jit;
+
+/* the window might have closed already, then aim for the next one */
+	long long left = (next - arcan_timemillis()) * 1000 - cost - last_cost;
+	if (left < 0)
+		left = (step - (-left % step)) % step;
+
+	return left;
 }
 
 int arcan_shmif_dirty(struct arcan_shmif_cont* cont,
@@ -2685,7 +2783,9 @@ int arcan_shmif_dirty(struct arcan_shmif_cont* cont,
 	if (!cont || !cont->addr)
 		return -1;
 
-	cont->hints |= SHMIF_RHINT_SUBREGION;
+	bool chain = cont->hints & SHMIF_RHINT_SUBREGION_CHAIN;
+	if (!chain)
+		cont->hints |= SHMIF_RHINT_SUBREGION;
 
 	if (x1 >= x2)
 		x1 = 0;
@@ -2693,6 +2793,13 @@ int arcan_shmif_dirty(struct arcan_shmif_cont* cont,
 	if (y1 >= y2)
 		y1 = 0;
 
+	if (chain){
+		x2 = x2 > cont->w ? cont->w : x2;
+		y2 = y2 > cont->h ? cont->h : y2;
+		x1 = x1 >= x2 ? 0 : x1;
+		y1 = y1 >= y2 ? 0 : y1;
+	}
+
 	if (x1 < cont->dirty.x1)
 		cont->dirty.x1 = x1;
 
@@ -2705,15 +2812,24 @@ int arcan_shmif_dirty(struct arcan_shmif_cont* cont,
 	if (y2 > cont->dirty.y2)
 		cont->dirty.y2 = y2;
 
-	return 0;
+	if (!chain || cont->priv->chain_overflow)
+		return 0;
 
-/*
- * Missing: special behavior for SHMIF_RHINT_SUBREGION_CHAIN, setup chain of
- * atomic [uint32_t, bitfl] and walk from first position to last free. Bitfl
- * marks both the server side "I know this" and client side "synch this or
- * wait".
- *
- * If there's not enough store left to walk on, signal video and wait (unless
- * noblock flag is set)
- */
+/* [head] only moves forward as the parent consumes, so the distance to it is
+ * the number of slots in use, including those of an unconsumed frame */
+	unsigned tail = atomic_load(&cont->addr->dirty_chain.tail);
+	unsigned head = atomic_load(&cont->addr->dirty_chain.head);
+	if (tail - head >= ARCAN_SHMIF_DIRTY_CHAIN_LIM){
+		cont->priv->chain_overflow = true;
+		return 0;
+	}
+
+	atomic_store(&cont->addr->dirty_chain.regions[
+		tail % ARCAN_SHMIF_DIRTY_CHAIN_LIM], ((struct arcan_shmif_region){
+		.x1 = x1, .y1 = y1, .x2 = x2, .y2 = y2
+	}));
+	atomic_store_explicit(&cont->addr->dirty_chain.tail,
+		tail + 1, memory_order_release);
+
+	return 0;
 }
@@ -110,6 +110,13 @@ static const int ARCAN_SHMIF_ACHANNELS = 2;
  */
 #define ARCAN_SHMIF_ABUFC_LIM 12
 #define ARCAN_SHMIF_VBUFC_LIM 3
+
+/*
+ * Number of damaged regions that can be tracked with
+ * SHMIF_RHINT_SUBREGION_CHAIN before falling back to a merged one, affects
+ * ABI as the ring is part of the page.
+ */
+#define ARCAN_SHMIF_DIRTY_CHAIN_LIM 32
 /*
  * These are technically limited by the combination of graphics and video
  * platforms. Since the buffers are placed at the end of the struct, they
@@ -811,16 +818,24 @@ enum rhint_mask {
 	SHMIF_RHINT_VSIGNAL_EV = 32,
 
 /*
- * [Reserved, not yet used]
- * Change the buffer contents management method to be a chain of dirty
- * rectangles rather than one continous buffer. This means that the contents of
- * the normal vidp, stride and pitch members may mutate between calls to
- * arcan_shmif_dirty and that it is write only, you can't use it for reliable
- * blending etc. Setting this bit will invalidate SHMIF_RHINT_SUBREGION.
+ * Track damage as a chain of separate regions rather than one bounding box,
+ * each call to arcan_shmif_dirty adds one region to the chain of the next
+ * frame and the parent synchs each region individually. Useful when updates
+ * are small but spread out (cursor in one corner, status line in another).
+ * Implies SHMIF_RHINT_SUBREGION synchronization, see arcan_shmif_dirty.
  */
 	SHMIF_RHINT_SUBREGION_CHAIN = 64
 };
 
+/*
+ * Bits for the [synch_flags] member of the shmpage, see the comments there.
+ */
+enum shmif_synch_flags {
+	SHMIF_SYNCH_FUTEX_CAP = 1,
+	SHMIF_SYNCH_FUTEX_ACK = 2,
+	SHMIF_SYNCH_RESIZE = 4
+};
+
 struct arcan_shmif_page;
 
 #ifndef ARCAN_SHMIF_HIDEPAGE
@@ -881,6 +896,20 @@ struct arcan_shmif_page {
  */
 	uint32_t segment_token;
 
+/* [ARCAN-SET (cap), FSRV-SET (ack)]
+ * Negotiation of the synchronization method for [vready] and [aready]. If
+ * the parent can wake waiters directly on the page (futexes) it sets
+ * SHMIF_SYNCH_FUTEX_CAP during initialization, a child that can wait on the
+ * page sets SHMIF_SYNCH_FUTEX_ACK before its first transfer. Without the ACK
+ * both sides fall back to the vsem/asem semaphores. Occupies padding that was
+ * previously unused so the page layout does not change.
+ *
+ * With the ACK, a child waiting for [resized] to be acknowledged sets
+ * SHMIF_SYNCH_RESIZE and waits on this field, the parent clears it and wakes
+ * after it has updated [resized].
+ */
+	volatile atomic_uint synch_flags;
+
 /* [ARCAN-SET]
  * Calculated once when initializing segment, and verified periodically from
  * both [FSRV] and [ARCAN]. Any deviation MAY have the [dms] be pulled.
@@ -953,6 +982,23 @@ struct arcan_shmif_page {
  */
 	volatile _Atomic uint_least64_t vpts;
 
+/*
+ * [ARCAN-SET]
+ * Frame deadline feedback, refreshed every time the parent releases the video
+ * buffer. [vsynch_next] is the arcan_timemillis() timestamp of the next
+ * expected composition (0 if unknown), [vsynch_step] the estimated time
+ * between compositions, [vsynch_cost] how long before [vsynch_next] a frame
+ * has to be delivered to be part of it and [vsynch_jitter] how much the
+ * delivery of this segment has deviated from that point. All but
+ * [vsynch_next] are in MICROSECONDS. Use arcan_shmif_deadline rather than
+ * reading these directly. These are separate from [vpts] as that one is
+ * FSRV-SET with every frame.
+ */
+	volatile _Atomic uint_least64_t vsynch_next;
+	volatile _Atomic uint_least32_t vsynch_step;
+	volatile _Atomic uint_least32_t vsynch_cost;
+	volatile _Atomic uint_least32_t vsynch_jitter;
+
 /*
  * [ARCAN-SET]
  * Set during segment initalization, provides some identifier to determine
@@ -977,6 +1023,24 @@ struct arcan_shmif_page {
  */
 	volatile char last_words[32];
 
+/* [FSRV-SET (tail, mark, regions), ARCAN-SET (head)]
+ * Used with SHMIF_RHINT_SUBREGION_CHAIN. Ring of damaged regions where [mark]
+ * is set on signal to the end of the regions that belong to that frame, and
+ * [head] is moved up to [mark] by the parent when the frame is consumed. If
+ * there are more regions than slots, the frame is described by a single
+ * region set to the [dirty] bounding box.
+ *
+ * For output segments (e.g. the encode output of the headless platform) the
+ * parent is the producer and sets all of these along with vready, then
+ * [head, mark) are the regions of the frame. Kept last so that the fields
+ * before it stay where older versions of the page had them.
+ */
+	struct {
+		volatile atomic_uint head, tail, mark;
+		volatile _Atomic struct arcan_shmif_region
+			regions[ARCAN_SHMIF_DIRTY_CHAIN_LIM];
+	} dirty_chain;
+
 /*
  * Begin of apad/apad_type negotiated block. For the actual calculations here,
  * look inside engine/arcan_frameserver.c for setproto, and in platform for
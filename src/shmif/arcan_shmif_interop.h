@@ -41,7 +41,7 @@
  * during _integrity_check
  */
 #define ASHMIF_VERSION_MAJOR 0
-#define ASHMIF_VERSION_MINOR 11
+#define ASHMIF_VERSION_MINOR 13
 
 #ifndef LOG
 #define LOG(...) (fprintf(stderr, __VA_ARGS__))
@@ -81,6 +81,14 @@ file_handle arcan_fetchhandle(int insock, bool block);
 bool arcan_pushhandle(int fd, int channel);
 int arcan_sem_wait(sem_handle sem);
 int arcan_sem_trywait(sem_handle sem);
+
+/* C++ has no _Atomic qualifier, and the futexes live on the (hidden) page */
+#ifndef __cplusplus
+bool arcan_futex_available();
+int arcan_futex_wait(
+	volatile _Atomic unsigned int* addr, unsigned int val, unsigned timeout);
+int arcan_futex_wake(volatile _Atomic unsigned int* addr);
+#endif
 #endif
 
 struct arcan_shmif_cont;
@@ -333,12 +341,19 @@ pid_t arcan_shmif_handover_exec(
  * context is dead / broken. You are still required to use shmif_signal calls
  * to synchronize the contents. Only the set of damaged regions will grow.
  *
+ * For SHMIF_RHINT_SUBREGION_CHAIN, the region is added as a separate entry to
+ * the chain of the next frame (up to ARCAN_SHMIF_DIRTY_CHAIN_LIM entries)
+ * instead of growing a bounding box, and the parent synchs each of them
+ * individually. If the chain runs out of entries, the frame falls back to the
+ * merged bounding box of all the regions. The chain is reset on shmif_signal.
+ *
  * [ Not yet implemented ]
  * This interface combines a number of latency and performance sensitive
  * usecases, with the ideal should re-add the possibility of run-ahead or
  * a run-behind the beam on a single buffered output.
  *
- * For SHMIF_RHINT_SUBREGION_CHAIN, the options to the flags function are:
+ * For SHMIF_RHINT_SUBREGION_CHAIN, the additional options to the flags
+ * function are planned to be:
  * SHMIF_DIRTY_NONBLOCK, SHMIF_DIRTY_PARTIAL and SHMIF_DIRTY_SIGNAL.
  * Bitmask behavior is: NONBLOCK | (PARTIAL ^ SIGNAL).
  *
@@ -379,10 +394,16 @@ int arcan_shmif_dirty(struct arcan_shmif_cont*,
  *  -2, context in a blocked state
  *  -3, deadline information inaccurate, values returned are defaults.
  *
- * The optional [tolerance] argument provides an estimate as to how large
- * margin for error that is reasonable (in MICROSECONDS). This MAY be
- * derived from frame delivery timings or be adjusted by the consumer
- * to balance latency, precision and accuracy.
+ * For the first two cases the return value is the same as [errc].
+ *
+ * The optional [jitter] argument provides an estimate as to how large
+ * margin for error that is reasonable (in MICROSECONDS). This is derived
+ * from the delivery timings of previous frames from this segment, as seen by
+ * the parent.
+ *
+ * The values come from the parent (conductor) when it releases the previous
+ * frame. If the next composition has already passed by the time this is
+ * called, the estimate is rolled forward to the next one.
  *
  * Thus, deadline - jitter = time left until synch should be called for
  * a chance to have your contents be updated in time. This time can thus
@@ -285,7 +285,9 @@ int shmifsrv_poll(struct shmifsrv_client* cl)
 			int a = atomic_load(&cl->con->shm.ptr->aready);
 			int v = atomic_load(&cl->con->shm.ptr->vready);
 			shmifsrv_leave();
-			return (a * 1) | (v * 1);
+			if (v)
+				return CLIENT_VBUFFER_READY;
+			return a ? CLIENT_ABUFFER_READY : CLIENT_NOT_READY;
 		}
 		else
 			cl->status = BROKEN;
@@ -340,18 +342,30 @@ struct shmifsrv_vbuffer shmifsrv_video(struct shmifsrv_client* cl, bool step)
 
 	res.flags.origo_ll = cl->con->desc.hints & SHMIF_RHINT_ORIGO_LL;
 	res.flags.ignore_alpha = cl->con->desc.hints & SHMIF_RHINT_IGNORE_ALPHA;
-	res.flags.subregion = cl->con->desc.hints & SHMIF_RHINT_SUBREGION;
+	res.flags.subregion = cl->con->desc.hints &
+		(SHMIF_RHINT_SUBREGION | SHMIF_RHINT_SUBREGION_CHAIN);
 	res.flags.srgb = cl->con->desc.hints & SHMIF_RHINT_CSPACE_SRGB;
 	res.vpts = atomic_load(&cl->con->shm.ptr->vpts);
 	res.w = cl->con->desc.width;
 	res.h = cl->con->desc.height;
 
+/* chained regions are presented as the bounding box the client merges into */
+	if (res.flags.subregion)
+		res.region = atomic_load(&cl->con->shm.ptr->dirty);
+
+/* same slot selection as the engine side uses when it synchs the buffer */
+	int vready = atomic_load(&cl->con->shm.ptr->vready);
+	vready = (vready <= 0 || vready > cl->con->vbuf_cnt) ? 0 : vready - 1;
+	res.buffer = cl->con->vbufs[vready];
+	res.pitch = res.w;
+	res.stride = res.w * sizeof(shmif_pixel);
+	res.state = VBUFFER_OKDATA;
+
 /* samplerate, channels, vfthresh */
 
 	if (step){
 /* signal that we're done with the buffer */
-		atomic_store_explicit(&cl->con->shm.ptr->vready, 0, memory_order_release);
-		arcan_sem_post(cl->con->vsync);
+		platform_fsrv_release_video(cl->con);
 
 /* If the frameserver has indicated that it wants a frame callback every time
  * we consume. This is primarily for cases where a client needs to I/O mplex
@@ -366,11 +380,6 @@ struct shmifsrv_vbuffer shmifsrv_video(struct shmifsrv_client* cl, bool step)
 		return res;
 	}
 
-/*
- * copy the flags..
- * struct arcan_shmif_region dirty = atomic_load(&shmpage->dirty);
- *
- */
 	return res;
 }
 
@@ -408,8 +417,7 @@ struct shmifsrv_abuffer shmifsrv_audio(
 	volatile int amask = atomic_load(&cl->con->shm.ptr->apending);
 /* missing, copy buffer, re-use buf if possible, release if we're out
  * of buffers */
-	atomic_store_explicit(&cl->con->shm.ptr->aready, 0, memory_order_release);
-	arcan_sem_post(cl->con->async);
+	platform_fsrv_release_audio(cl->con);
 	return res;
 }
 
@@ -210,6 +210,11 @@ void tsm_screen_reset_all_tabstops(struct tsm_screen *con);
 
 int tsm_screen_write(struct tsm_screen *con, tsm_symbol_t ch,
 		const struct tui_screen_attr *attr);
+
+/* same as [n] calls to tsm_screen_write with the same attribute, but
+ * single-width symbols that fit on the current line are stored directly */
+int tsm_screen_write_run(struct tsm_screen *con, const tsm_symbol_t *ch,
+		size_t n, const struct tui_screen_attr *attr);
 int tsm_screen_newline(struct tsm_screen *con);
 int tsm_screen_scroll_up(struct tsm_screen *con, unsigned int num);
 int tsm_screen_scroll_down(struct tsm_screen *con, unsigned int num);
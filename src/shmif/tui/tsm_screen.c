@@ -1187,6 +1187,58 @@ int tsm_screen_write(struct tsm_screen *con, tsm_symbol_t ch,
 	return rv;
 }
 
+SHL_EXPORT
+int tsm_screen_write_run(struct tsm_screen *con, const tsm_symbol_t *ch,
+			  size_t n, const struct tui_screen_attr *attr)
+{
+	struct line *line;
+	unsigned int x, end;
+	size_t i = 0;
+	int rv = 0;
+
+	if (!con)
+		return 0;
+
+	if (!attr)
+		attr = &con->def_attr;
+
+	while (i < n) {
+		/* wrapping, scrolling and insert mode take the regular path */
+		if (con->cursor_x >= con->size_x ||
+		    con->cursor_y >= con->size_y ||
+		    (con->flags & TSM_SCREEN_INSERT_MODE)) {
+			rv += tsm_screen_write(con, ch[i++], attr);
+			continue;
+		}
+
+		inc_age(con);
+		line = con->lines[con->cursor_y];
+		x = con->cursor_x;
+		end = con->size_x;
+		if (n - i < end - x)
+			end = x + (n - i);
+
+		for (; x < end; ++x, ++i) {
+			if ((ch[i] < 0x20 || ch[i] > 0x7e) &&
+			    tsm_symbol_get_width(con->sym_table, ch[i]) != 1)
+				break;
+
+			line->cells[x].age = con->age_cnt;
+			line->cells[x].ch = ch[i];
+			line->cells[x].width = 1;
+			memcpy(&line->cells[x].attr, attr, sizeof(*attr));
+		}
+
+		/* wide, combined or zero-width symbol stopped us */
+		if (x == con->cursor_x)
+			rv += tsm_screen_write(con, ch[i++], attr);
+		else
+			move_cursor(con, x, con->cursor_y);
+	}
+
+	return rv;
+}
+
 struct export_metadata {
 	uint8_t magic[4];
 	uint32_t sb_count;
@@ -3255,6 +3255,20 @@ void arcan_tui_write(struct tui_context* c,
 	flag_cursor(c);
 }
 
+void arcan_tui_writeucs4(struct tui_context* c,
+	const uint32_t* ucs4, size_t n, struct tui_screen_attr* attr)
+{
+	if (!c || !ucs4 || !n)
+		return;
+
+	int ss = tsm_screen_write_run(c->screen, ucs4, n, attr);
+	if (c->smooth_scroll && ss){
+		c->scroll_backlog += ss;
+	}
+
+	flag_cursor(c);
+}
+
 void arcan_tui_ident(struct tui_context* c, const char* ident)
 {
 	arcan_event nev = {
@@ -13,6 +13,8 @@
 
 #include <string.h>
 #include <assert.h>
+#include <time.h>
+#include <sqlite3.h>
 
 #include "arcan_mem.h"
 #include "arcan_db.h"
@@ -45,6 +47,8 @@ static void usage()
 	"  show_config    \ttargetname configname\n"
 	"  show_appl      \tapplname\n"
 	"  show_exec      \ttargetname configname\n"
+	"\nDiagnostics: \n"
+	"  benchmark      \t(iterations)\n"
 	"Accepted keys are restricted to the set [a-Z0-9_+=/]\n\n"
 	"alternative (scripted) usage: arcan_db dbfile -\n"
  	"above commands are supplied using STDIN, tab as arg separator, linefeed \n"
@@ -554,6 +558,173 @@ static int show_appl(struct arcan_dbh* dst, int argc, char** argv)
 	return EXIT_SUCCESS;
 }
 
+static double bench_time()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec / 1000000000.0;
+}
+
+static void bench_report(const char* label, size_t n, double start)
+{
+	double elapsed = bench_time() - start;
+	printf("%-32s %12.0f/s\n", label, elapsed > 0.0 ? (double) n / elapsed : 0);
+}
+
+/*
+ * the way lookups were done before the statement cache, a prepare per query,
+ * used as the reference for the other numbers
+ */
+static void bench_raw(sqlite3* raw, const char* qry,
+	arcan_targetid tid, size_t n, size_t nkeys)
+{
+	char key[32];
+
+	for (size_t i = 0; i < n; i++){
+		sqlite3_stmt* stmt;
+		snprintf(key, sizeof(key), "key_%zu", i % nkeys);
+		sqlite3_prepare_v2(raw, qry, -1, &stmt, NULL);
+		sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
+		if (tid != BAD_TARGET)
+			sqlite3_bind_int(stmt, 2, tid);
+
+		if (SQLITE_ROW == sqlite3_step(stmt))
+			free(strdup((const char*) sqlite3_column_text(stmt, 0)));
+		sqlite3_finalize(stmt);
+	}
+}
+
+static void bench_lookup(struct arcan_dbh* dbh,
+	arcan_targetid tid, size_t n, size_t nkeys)
+{
+	char key[32];
+
+	for (size_t i = 0; i < n; i++){
+		snprintf(key, sizeof(key), "key_%zu", i % nkeys);
+		if (tid != BAD_TARGET)
+			free(arcan_db_getvalue(dbh, DVT_TARGET, tid, key));
+		else
+			free(arcan_db_appl_val(dbh, "bench", key));
+	}
+}
+
+/*
+ * the store_key pattern, one transaction per key, flushing the
+ * mirror at about the rate the engine would (once per tick)
+ */
+static void bench_store(struct arcan_dbh* dbh, size_t n, size_t nkeys)
+{
+	char key[32], val[32];
+	union arcan_dbtrans_id id = {.applname = "bench"};
+
+	for (size_t i = 0; i < n; i++){
+		snprintf(key, sizeof(key), "key_%zu", i % nkeys);
+		snprintf(val, sizeof(val), "%zu", i);
+		arcan_db_begin_transaction(dbh, DVT_APPL, id);
+		arcan_db_add_kvpair(dbh, key, val);
+		arcan_db_end_transaction(dbh);
+
+		if (i % 16 == 15)
+			arcan_db_flush(dbh);
+	}
+
+	arcan_db_flush(dbh);
+}
+
+static int benchmark(struct arcan_dbh* dst, int argc, char** argv)
+{
+	size_t n = argc > 0 ? strtoul(argv[0], NULL, 10) : 0;
+	const size_t nkeys = 256;
+	if (!n)
+		n = 100000;
+
+/* work on a scratch database rather than [dst] to not pollute it */
+	char path[] = "/tmp/arcan_db_bench_XXXXXX";
+	int fd = mkstemp(path);
+	if (-1 == fd){
+		printf("benchmark(), couldn't create scratch database\n");
+		return EXIT_FAILURE;
+	}
+	close(fd);
+
+	struct arcan_dbh* dbh = arcan_db_open(path, "bench");
+	if (!dbh){
+		printf("benchmark(), couldn't open scratch database (%s)\n", path);
+		unlink(path);
+		return EXIT_FAILURE;
+	}
+
+	char key[32];
+	union arcan_dbtrans_id id = {.applname = "bench"};
+	arcan_db_begin_transaction(dbh, DVT_APPL, id);
+	for (size_t i = 0; i < nkeys; i++){
+		snprintf(key, sizeof(key), "key_%zu", i);
+		arcan_db_add_kvpair(dbh, key, "value");
+	}
+	arcan_db_end_transaction(dbh);
+
+	arcan_targetid tid = arcan_db_addtarget(
+		dbh, "bench", "bench", "/bin/true", NULL, 0, BFRM_BIN);
+	id.tid = tid;
+	arcan_db_begin_transaction(dbh, DVT_TARGET, id);
+	for (size_t i = 0; i < nkeys; i++){
+		snprintf(key, sizeof(key), "key_%zu", i);
+		arcan_db_add_kvpair(dbh, key, "value");
+	}
+	arcan_db_end_transaction(dbh);
+
+	sqlite3* raw;
+	if (SQLITE_OK != sqlite3_open(path, &raw)){
+		printf("benchmark(), couldn't open reference connection\n");
+		arcan_db_close(&dbh);
+		unlink(path);
+		return EXIT_FAILURE;
+	}
+
+	printf("%zu lookups over %zu keys\n", n, nkeys);
+	double start = bench_time();
+	bench_raw(raw, "SELECT val FROM appl_bench WHERE key = ?;",
+		BAD_TARGET, n, nkeys);
+	bench_report("appl, prepare per lookup", n, start);
+
+	start = bench_time();
+	bench_lookup(dbh, BAD_TARGET, n, nkeys);
+	bench_report("appl, cached statement", n, start);
+
+	start = bench_time();
+	bench_raw(raw, "SELECT val FROM target_kv WHERE "
+		"key = ? AND target = ? LIMIT 1;", tid, n, nkeys);
+	bench_report("target, prepare per lookup", n, start);
+
+	start = bench_time();
+	bench_lookup(dbh, tid, n, nkeys);
+	bench_report("target, cached statement", n, start);
+
+	size_t nstore = n / 10 ? n / 10 : 1;
+	start = bench_time();
+	bench_store(dbh, nstore, nkeys);
+	bench_report("appl store, per transaction", nstore, start);
+
+	arcan_db_kvmirror(dbh, true);
+	start = bench_time();
+	bench_lookup(dbh, BAD_TARGET, n, nkeys);
+	bench_report("appl, mirror", n, start);
+
+	start = bench_time();
+	bench_lookup(dbh, tid, n, nkeys);
+	bench_report("target, mirror", n, start);
+
+	start = bench_time();
+	bench_store(dbh, nstore, nkeys);
+	bench_report("appl store, mirror", nstore, start);
+
+	sqlite3_close(raw);
+	arcan_db_close(&dbh);
+	unlink(path);
+
+	return EXIT_SUCCESS;
+}
+
 struct {
 	const char* key;
 	int (*fun)(struct arcan_dbh*, int, char**);
@@ -640,6 +811,10 @@ struct {
 	{
 		.key = "show_exec",
 		.fun = show_exec
+	},
+	{
+		.key = "benchmark",
+		.fun = benchmark
 	}
 };
 
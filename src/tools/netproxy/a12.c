@@ -1,4 +1,5 @@
 #include <arcan_shmif.h>
+#include <arcan_shmif_server.h>
 #include "a12.h"
 #include "blake2.h"
 #include <inttypes.h>
@@ -26,6 +27,21 @@
 
 #define DECODE_BUFFER_CAP 9000
 
+/* vstream-data: seqnr(8), channel-id(1), stream-id(4), length(2) */
+#define VIDEO_PACKET_HEADER 15
+#define VIDEO_PACKET_CHUNK 8192
+#define VIDEO_TILE_SZ 32
+#define VIDEO_FORMAT_XOR_RLE 0
+#define VIDEO_FLAG_KEYFRAME 1
+
+/* offsets into the control packet payload */
+#define CONTROL_SEQNR 0
+#define CONTROL_LASTSEEN 8
+#define CONTROL_ENTROPY 16
+#define CONTROL_CHID 24
+#define CONTROL_COMMAND 25
+#define CONTROL_ARGS 26
+
 #ifndef debug_print
 #define debug_print(fmt, ...) \
             do { if (DEBUG) fprintf(stderr, "%s:%d:%s(): " fmt "\n", \
@@ -43,6 +59,19 @@ enum {
 	STATE_BROKEN
 };
 
+enum control_commands {
+	COMMAND_HELLO = 0,
+	COMMAND_SHUTDOWN = 1,
+	COMMAND_ENCNEG = 2,
+	COMMAND_REKEY = 3,
+	COMMAND_CANCELSTREAM = 4,
+	COMMAND_NEWCH = 5,
+	COMMAND_FAILURE = 6,
+	COMMAND_VIDEOFRAME = 7,
+	COMMAND_AUDIOFRAME = 8,
+	COMMAND_BINARYSTREAM = 9
+};
+
 /*
  * Notes for dealing with A/W/B -
  *  need to add functions to set destination buffers for that
@@ -81,13 +110,83 @@ struct a12_state {
 
 /* when the channel has switched to a streamcipher, this is set to true */
 	bool in_encstate;
+
+/* shared counter for v/a/b stream identifiers */
+	uint32_t stream_id;
+
+/* outgoing video: the last frame as the other end should have it, and
+ * the scratch buffer the changed tiles gets encoded into */
+	struct {
+		shmif_pixel* prev;
+		size_t w, h;
+		uint8_t* buf;
+		size_t buf_sz;
+		bool force_key;
+	} venc;
+
+/* incoming video: the frame currently being assembled, the stream-data
+ * packet header is parsed first and then the payload is read in */
+	struct {
+		struct arcan_shmif_cont* dst;
+		uint32_t stream_id;
+		uint8_t format, flags;
+		size_t w, h, x, y, fw, fh;
+		uint8_t* buf;
+		size_t buf_sz, len, pos;
+		bool active, in_payload, need_key;
+	} vdec;
+
+	struct a12_stats stats;
 };
 
+static void pack_u16(uint16_t val, uint8_t* dst)
+{
+	dst[0] = val;
+	dst[1] = val >> 8;
+}
+
+static void pack_u32(uint32_t val, uint8_t* dst)
+{
+	for (size_t i = 0; i < 4; i++)
+		dst[i] = val >> (i * 8);
+}
+
+static void pack_u64(uint64_t val, uint8_t* dst)
+{
+	for (size_t i = 0; i < 8; i++)
+		dst[i] = val >> (i * 8);
+}
+
+static uint16_t unpack_u16(const uint8_t* src)
+{
+	return (uint16_t)src[0] | ((uint16_t)src[1] << 8);
+}
+
+static uint32_t unpack_u32(const uint8_t* src)
+{
+	uint32_t res = 0;
+	for (size_t i = 0; i < 4; i++)
+		res |= (uint32_t)src[i] << (i * 8);
+	return res;
+}
+
+static uint64_t unpack_u64(const uint8_t* src)
+{
+	uint64_t res = 0;
+	for (size_t i = 0; i < 8; i++)
+		res |= (uint64_t)src[i] << (i * 8);
+	return res;
+}
+
 static uint8_t* grow_array(uint8_t* dst, size_t* cur_sz, size_t new_sz)
 {
-	if (new_sz < *cur_sz)
+	if (new_sz <= *cur_sz)
 		return dst;
 
+/* video frames push quite a lot through here, avoid creeping realloc */
+	if (new_sz < *cur_sz * 2)
+		new_sz = *cur_sz * 2;
+
 	uint8_t* res = DYNAMIC_REALLOC(dst, new_sz);
 	if (!res){
 		return dst;
@@ -99,9 +198,12 @@ static uint8_t* grow_array(uint8_t* dst, size_t* cur_sz, size_t new_sz)
 
 /*
  * Used when a full byte buffer for a packet has been prepared, important
- * since it will also encrypt, generate MAC and add to buffer prestate
+ * since it will also encrypt, generate MAC and add to buffer prestate. The
+ * [data] block is optional and lets larger payloads be appended after a
+ * packet header without first being copied together with it.
  */
-static void append_outb(struct a12_state* S, uint8_t* out, size_t out_sz)
+static void append_outb_data(struct a12_state* S,
+	uint8_t* out, size_t out_sz, const uint8_t* data, size_t data_sz)
 {
 /* this means we can just continue our happy stream-cipher and apply to our
  * outgoing data */
@@ -113,10 +215,11 @@ static void append_outb(struct a12_state* S, uint8_t* out, size_t out_sz)
 	blake2bp_state mac_state = S->mac_init;
 	blake2bp_update(&mac_state, S->last_mac_out, MAC_BLOCK_SZ);
 	blake2bp_update(&mac_state, out, out_sz);
+	if (data_sz)
+		blake2bp_update(&mac_state, data, data_sz);
 
 /* grow buffer if its too small */
-	size_t required =
-		S->buf_sz[S->buf_ind] + MAC_BLOCK_SZ + out_sz + S->buf_ofs + 1;
+	size_t required = S->buf_ofs + MAC_BLOCK_SZ + out_sz + data_sz;
 	S->bufs[S->buf_ind] = grow_array(
 		S->bufs[S->buf_ind],
 		&S->buf_sz[S->buf_ind],
@@ -137,14 +240,40 @@ static void append_outb(struct a12_state* S, uint8_t* out, size_t out_sz)
 	memcpy(&(S->bufs[S->buf_ind][S->buf_ofs]), out, out_sz);
 	S->buf_ofs += out_sz;
 
-	debug_print("queued output package: %zu\n", out_sz);
+	if (data_sz){
+		memcpy(&(S->bufs[S->buf_ind][S->buf_ofs]), data, data_sz);
+		S->buf_ofs += data_sz;
+	}
+
+	debug_print("queued output package: %zu\n", out_sz + data_sz);
+}
+
+static void append_outb(struct a12_state* S, uint8_t* out, size_t out_sz)
+{
+	append_outb_data(S, out, out_sz, NULL, 0);
+}
+
+/*
+ * Fill out the type and the common control fields of [outb] (which is
+ * expected to be CONTROL_PACKET_SIZE + 1 with the command arguments
+ * already set) and queue it.
+ */
+static void send_control(struct a12_state* S, uint8_t cmd, uint8_t* outb)
+{
+	uint8_t* ctrl = &outb[1];
+	outb[0] = STATE_CONTROL_PACKET;
+	pack_u64(S->current_seqnr++, &ctrl[CONTROL_SEQNR]);
+	pack_u64(S->last_seen_seqnr, &ctrl[CONTROL_LASTSEEN]);
+	ctrl[CONTROL_CHID] = 0;
+	ctrl[CONTROL_COMMAND] = cmd;
+	append_outb(S, outb, CONTROL_PACKET_SIZE + 1);
 }
 
 static struct a12_state*
 a12_setup(uint8_t* authk, size_t authk_sz)
 {
 	struct a12_state* res = DYNAMIC_MALLOC(sizeof(struct a12_state));
-	if (res)
+	if (!res)
 		return NULL;
 
 	*res = (struct a12_state){};
@@ -180,10 +309,8 @@ struct a12_state* a12_channel_open(uint8_t* authk, size_t authk_sz)
 
 /* hello authentication packet, we add the seqnr here as there might
  * be encrypt-then-MAC going on in append_outb */
-	uint8_t outb[CONTROL_PACKET_SIZE] = {0};
-	memcpy(&outb[MAC_BLOCK_SZ], &res->current_seqnr, sizeof(uint64_t));
-	append_outb(res, outb, CONTROL_PACKET_SIZE);
-	res->current_seqnr++;
+	uint8_t outb[CONTROL_PACKET_SIZE + 1] = {0};
+	send_control(res, COMMAND_HELLO, outb);
 
 	return res;
 }
@@ -196,12 +323,230 @@ a12_channel_close(struct a12_state* S)
 
 	DYNAMIC_FREE(S->bufs[0]);
 	DYNAMIC_FREE(S->bufs[1]);
+	DYNAMIC_FREE(S->venc.prev);
+	DYNAMIC_FREE(S->venc.buf);
+	DYNAMIC_FREE(S->vdec.buf);
 	*S = (struct a12_state){};
 	S->cookie = 0xdeadbeef;
 
 	DYNAMIC_FREE(S);
 }
 
+/*
+ * Ask the other end to cancel the video stream it is sending, which also
+ * means that the next frame needs to be sent in full as we have lost the
+ * contents the deltas would have been applied against.
+ */
+static void request_keyframe(struct a12_state* S)
+{
+	if (S->vdec.need_key)
+		return;
+
+	S->vdec.need_key = true;
+	uint8_t outb[CONTROL_PACKET_SIZE + 1] = {0};
+	pack_u32(S->vdec.stream_id, &outb[1 + CONTROL_ARGS]);
+	send_control(S, COMMAND_CANCELSTREAM, outb);
+}
+
+static void video_drop(struct a12_state* S)
+{
+	debug_print("dropping video frame (%"PRIu32")", S->vdec.stream_id);
+	S->stats.vframes_drop++;
+	S->vdec.active = false;
+	request_keyframe(S);
+}
+
+/*
+ * command - 7, define vstream. Validate and set up the buffer the
+ * stream-data packets that follow will be collected into.
+ */
+static void video_define(struct a12_state* S, const uint8_t* args)
+{
+	if (S->vdec.active)
+		video_drop(S);
+
+	S->vdec.stream_id = unpack_u32(&args[0]);
+	S->vdec.format = args[4];
+	S->vdec.w = unpack_u16(&args[5]);
+	S->vdec.h = unpack_u16(&args[7]);
+	S->vdec.x = unpack_u16(&args[9]);
+	S->vdec.y = unpack_u16(&args[11]);
+	S->vdec.fw = unpack_u16(&args[13]);
+	S->vdec.fh = unpack_u16(&args[15]);
+	S->vdec.flags = args[17];
+	S->vdec.len = unpack_u32(&args[18]);
+	S->vdec.pos = 0;
+
+/* the peer decides the size, so stay within what a segment can be and what
+ * the encoder can produce for it: all pixels as literals along with the
+ * per-tile overhead (see encode_tile) */
+	size_t cap = 0;
+	if (S->vdec.w <= PP_SHMPAGE_MAXW && S->vdec.h <= PP_SHMPAGE_MAXH)
+		cap = (size_t) S->vdec.w * S->vdec.h * sizeof(shmif_pixel) +
+			((S->vdec.w + VIDEO_TILE_SZ - 1) / VIDEO_TILE_SZ) *
+			((S->vdec.h + VIDEO_TILE_SZ - 1) / VIDEO_TILE_SZ) * 8;
+
+	if (S->vdec.format != VIDEO_FORMAT_XOR_RLE || !cap ||
+		!S->vdec.w || !S->vdec.h || !S->vdec.fw || !S->vdec.fh ||
+		S->vdec.x + S->vdec.fw > S->vdec.w || S->vdec.y + S->vdec.fh > S->vdec.h ||
+		!S->vdec.len || S->vdec.len > cap){
+		debug_print("rejected malformed vstream definition");
+		video_drop(S);
+		return;
+	}
+
+	if (S->vdec.flags & VIDEO_FLAG_KEYFRAME)
+		S->vdec.need_key = false;
+
+/* a delta against something we don't have, keyframe is already requested */
+	else if (S->vdec.need_key){
+		S->stats.vframes_drop++;
+		return;
+	}
+
+	S->vdec.buf = grow_array(S->vdec.buf, &S->vdec.buf_sz, S->vdec.len);
+	if (S->vdec.buf_sz < S->vdec.len){
+		video_drop(S);
+		return;
+	}
+
+	S->vdec.active = true;
+}
+
+/*
+ * Apply the tiles in the assembled frame to [dst], each tile is:
+ * [tx : u16][ty : u16] followed by groups of [skip : u16][n : u16][n * u32]
+ * until all the pixels in the tile are covered, where the n values are XORed
+ * into the current contents after skipping [skip] unchanged pixels.
+ */
+static bool video_apply(struct a12_state* S, struct arcan_shmif_cont* dst)
+{
+	const uint8_t* buf = S->vdec.buf;
+	size_t len = S->vdec.len;
+	size_t pos = 0;
+	size_t tiles_x = (S->vdec.w + VIDEO_TILE_SZ - 1) / VIDEO_TILE_SZ;
+	size_t tiles_y = (S->vdec.h + VIDEO_TILE_SZ - 1) / VIDEO_TILE_SZ;
+
+	while (pos < len){
+		if (len - pos < 4)
+			return false;
+
+		size_t tx = unpack_u16(&buf[pos]);
+		size_t ty = unpack_u16(&buf[pos + 2]);
+		pos += 4;
+		if (tx >= tiles_x || ty >= tiles_y)
+			return false;
+
+		size_t x0 = tx * VIDEO_TILE_SZ;
+		size_t y0 = ty * VIDEO_TILE_SZ;
+		size_t tw = S->vdec.w - x0 > VIDEO_TILE_SZ ? VIDEO_TILE_SZ : S->vdec.w - x0;
+		size_t th = S->vdec.h - y0 > VIDEO_TILE_SZ ? VIDEO_TILE_SZ : S->vdec.h - y0;
+		size_t npx = tw * th;
+
+		for (size_t i = 0; i < npx;){
+			if (len - pos < 4)
+				return false;
+
+			size_t skip = unpack_u16(&buf[pos]);
+			size_t n = unpack_u16(&buf[pos + 2]);
+			pos += 4;
+			if (!(skip + n) || skip + n > npx - i || (len - pos) / 4 < n)
+				return false;
+
+			i += skip;
+			size_t row = i / tw;
+			size_t col = i % tw;
+			shmif_pixel* dp = &dst->vidp[(y0 + row) * dst->pitch + x0];
+
+			for (size_t j = 0; j < n; j++){
+				dp[col++] ^= unpack_u32(&buf[pos]);
+				pos += 4;
+				if (col == tw){
+					col = 0;
+					dp += dst->pitch;
+				}
+			}
+			i += n;
+		}
+	}
+
+	return true;
+}
+
+static void video_frame(struct a12_state* S)
+{
+	struct arcan_shmif_cont* dst = S->vdec.dst;
+	bool key = S->vdec.flags & VIDEO_FLAG_KEYFRAME;
+	S->vdec.active = false;
+
+	if (!dst){
+		video_drop(S);
+		return;
+	}
+
+/* only a keyframe can carry a new size as deltas need the old contents */
+	if (dst->w != S->vdec.w || dst->h != S->vdec.h){
+		if (!key || !arcan_shmif_resize(dst, S->vdec.w, S->vdec.h)){
+			video_drop(S);
+			return;
+		}
+	}
+
+/* keyframes are coded against an empty frame */
+	if (key){
+		for (size_t y = 0; y < dst->h; y++)
+			memset(&dst->vidp[y * dst->pitch], '\0', dst->w * sizeof(shmif_pixel));
+	}
+
+	if (!video_apply(S, dst)){
+		debug_print("malformed video frame data");
+		video_drop(S);
+		return;
+	}
+
+	dst->dirty = (struct arcan_shmif_region){
+		.x1 = S->vdec.x, .x2 = S->vdec.x + S->vdec.fw,
+		.y1 = S->vdec.y, .y2 = S->vdec.y + S->vdec.fh
+	};
+	arcan_shmif_signal(dst, SHMIF_SIGVID);
+	S->stats.vframes_in++;
+}
+
+static bool check_mac(struct a12_state* S)
+{
+	uint8_t final_mac[MAC_BLOCK_SZ];
+	blake2bp_final(&S->mac_dec, final_mac, MAC_BLOCK_SZ);
+
+/* Option to continue with broken authentication, ... */
+	if (memcmp(final_mac, S->last_mac_in, MAC_BLOCK_SZ) != 0){
+		debug_print("authentication mismatch on packet \n");
+		S->state = STATE_BROKEN;
+		return false;
+	}
+
+	return true;
+}
+
+static void process_control(struct a12_state* S, const uint8_t* ctrl)
+{
+	S->last_seen_seqnr = unpack_u64(&ctrl[CONTROL_SEQNR]);
+
+	switch (ctrl[CONTROL_COMMAND]){
+	case COMMAND_VIDEOFRAME:
+		video_define(S, &ctrl[CONTROL_ARGS]);
+	break;
+
+/* the only streams we send are video, so a cancel means that the other end
+ * couldn't use a frame and needs everything in the next one */
+	case COMMAND_CANCELSTREAM:
+		S->venc.force_key = true;
+	break;
+
+	default:
+	break;
+	}
+}
+
 /*
  * written as tail-recursive, one logical block (at most, or buffering) per call
  */
@@ -257,10 +602,13 @@ a12_channel_unpack(struct a12_state* S, const uint8_t* buf, size_t buf_sz)
 			S->left = sizeof(struct arcan_event) + 2 + 8 + 1;
 
 /* actual length comes in subheader so wait until then */
-		else if (
-			S->state == STATE_VIDEO_PACKET ||
-				S->state == STATE_AUDIO_PACKET || S->state == STATE_BLOB_PACKET){
-				S->left = 13;
+		else if (S->state == STATE_VIDEO_PACKET){
+			S->left = VIDEO_PACKET_HEADER;
+			S->vdec.in_payload = false;
+		}
+
+		else if (S->state == STATE_AUDIO_PACKET || S->state == STATE_BLOB_PACKET){
+			S->left = 13;
 		}
 
 		S->decode_pos = 0;
@@ -271,34 +619,23 @@ a12_channel_unpack(struct a12_state* S, const uint8_t* buf, size_t buf_sz)
 		switch (S->state){
 		case STATE_NOPACKET : break;
 		case STATE_CONTROL_PACKET : {
-			uint8_t final_mac[MAC_BLOCK_SZ];
 			blake2bp_update(&S->mac_dec, S->decode, S->decode_pos);
-			blake2bp_final(&S->mac_dec, final_mac, MAC_BLOCK_SZ);
-
-/* Option to continue with broken authentication, ... */
-			if (memcmp(final_mac, S->last_mac_in, MAC_BLOCK_SZ) != 0){
-				debug_print("authentication mismatch on packet \n");
-				S->state = STATE_BROKEN;
+			if (!check_mac(S))
 				return;
-			}
 
 /* crypto-fixme: place to decrypt stream */
+			process_control(S, S->decode);
 			S->state = STATE_NOPACKET;
 		}
 		break;
 		case STATE_EVENT_PACKET :{
-			uint8_t final_mac[MAC_BLOCK_SZ];
 			blake2bp_update(&S->mac_dec, S->decode, S->decode_pos);
-			blake2bp_final(&S->mac_dec, final_mac, MAC_BLOCK_SZ);
-			if (memcmp(final_mac, S->last_mac_in, MAC_BLOCK_SZ) != 0){
-				debug_print("authentication mismatch on packet\n");
-				S->state = STATE_BROKEN;
+			if (!check_mac(S))
 				return;
-			}
 
 			uint8_t chid;
 			struct arcan_event ev;
-			memcpy(&S->last_seen_seqnr, S->decode, sizeof(uint64_t));
+			S->last_seen_seqnr = unpack_u64(S->decode);
 			memcpy(&chid, &S->decode[8], 1);
 			arcan_shmif_eventunpack(&S->decode[9], sizeof(struct arcan_event)+2, &ev);
 /* if not descrevent, forward to parent- for interpretation */
@@ -306,7 +643,48 @@ a12_channel_unpack(struct a12_state* S, const uint8_t* buf, size_t buf_sz)
 			S->state = STATE_NOPACKET;
 		}
 		break;
-		case STATE_VIDEO_PACKET : break;
+
+/* two steps, first the fixed header that carries the payload length, then
+ * the payload itself - the MAC covers both */
+		case STATE_VIDEO_PACKET :
+			blake2bp_update(&S->mac_dec, S->decode, S->decode_pos);
+			if (!S->vdec.in_payload){
+				S->last_seen_seqnr = unpack_u64(S->decode);
+				uint32_t stream_id = unpack_u32(&S->decode[9]);
+				size_t len = unpack_u16(&S->decode[13]);
+				if (!len || len > VIDEO_PACKET_CHUNK){
+					debug_print("invalid vstream-data length: %zu", len);
+					S->state = STATE_BROKEN;
+					return;
+				}
+
+/* data for a frame that was rejected or cancelled is read but ignored */
+				if (S->vdec.active && stream_id != S->vdec.stream_id)
+					video_drop(S);
+
+				S->vdec.in_payload = true;
+				S->left = len;
+				S->decode_pos = 0;
+				break;
+			}
+
+			S->vdec.in_payload = false;
+			if (!check_mac(S))
+				return;
+
+			if (S->vdec.active){
+				if (S->decode_pos > S->vdec.len - S->vdec.pos){
+					video_drop(S);
+				}
+				else {
+					memcpy(&S->vdec.buf[S->vdec.pos], S->decode, S->decode_pos);
+					S->vdec.pos += S->decode_pos;
+					if (S->vdec.pos == S->vdec.len)
+						video_frame(S);
+				}
+			}
+			S->state = STATE_NOPACKET;
+		break;
 		case STATE_AUDIO_PACKET : break;
 		case STATE_BLOB_PACKET : break;
 		default:
@@ -361,8 +739,226 @@ a12_channel_enqueue(struct a12_state* S, struct arcan_event* ev)
 		return;
 	}
 
-	uint8_t outb[CONTROL_PACKET_SIZE] = {0};
-	memcpy(&outb[MAC_BLOCK_SZ], &S->current_seqnr, sizeof(uint64_t));
-	append_outb(S, outb, CONTROL_PACKET_SIZE);
+	uint8_t outb[1 + 8 + 1 + sizeof(struct arcan_event) + 2] = {0};
+	outb[0] = STATE_EVENT_PACKET;
+	pack_u64(S->current_seqnr, &outb[1]);
+	if (-1 == arcan_shmif_eventpack(ev, &outb[10], sizeof(outb) - 10))
+		return;
+
+	append_outb(S, outb, sizeof(outb));
 	S->current_seqnr++;
 }
+
+static bool tile_equal(const shmif_pixel* src, size_t pitch,
+	const shmif_pixel* prev, size_t w, size_t x, size_t y, size_t tw, size_t th)
+{
+	for (size_t row = 0; row < th; row++){
+		if (memcmp(&src[(y + row) * pitch + x],
+			&prev[(y + row) * w + x], tw * sizeof(shmif_pixel)) != 0)
+			return false;
+	}
+	return true;
+}
+
+/*
+ * XOR one tile against the previous contents, update those and write the
+ * run-length coded result to [out] (see video_apply for the format),
+ * returns the number of bytes written - at most 8 + 4 * tw * th as every
+ * group but the first skips and every group but the last has a literal.
+ */
+static size_t encode_tile(uint8_t* out, const shmif_pixel* src, size_t pitch,
+	shmif_pixel* prev, size_t w, size_t tx, size_t ty, size_t tw, size_t th)
+{
+	shmif_pixel delta[VIDEO_TILE_SZ * VIDEO_TILE_SZ];
+	size_t x = tx * VIDEO_TILE_SZ;
+	size_t y = ty * VIDEO_TILE_SZ;
+	size_t npx = 0;
+
+	for (size_t row = 0; row < th; row++){
+		const shmif_pixel* sp = &src[(y + row) * pitch + x];
+		shmif_pixel* pp = &prev[(y + row) * w + x];
+		for (size_t col = 0; col < tw; col++)
+			delta[npx++] = sp[col] ^ pp[col];
+		memcpy(pp, sp, tw * sizeof(shmif_pixel));
+	}
+
+	pack_u16(tx, out);
+	pack_u16(ty, &out[2]);
+	size_t pos = 4;
+
+	for (size_t i = 0; i < npx;){
+		size_t skip = i;
+		while (i < npx && !delta[i])
+			i++;
+		skip = i - skip;
+
+		size_t lit = i;
+		while (i < npx && delta[i])
+			i++;
+
+		pack_u16(skip, &out[pos]);
+		pack_u16(i - lit, &out[pos + 2]);
+		pos += 4;
+
+		for (; lit < i; lit++, pos += 4)
+			pack_u32(delta[lit], &out[pos]);
+	}
+
+	return pos;
+}
+
+void
+a12_channel_vframe(struct a12_state* S, struct shmifsrv_vbuffer* vb)
+{
+	if (!S || S->cookie != 0xfeedface || !vb || !vb->buffer)
+		return;
+
+	size_t w = vb->w, h = vb->h;
+	if (!w || !h || w > PP_SHMPAGE_MAXW || h > PP_SHMPAGE_MAXH || vb->pitch < w)
+		return;
+
+/* new or resized source, the reference frame needs to be rebuilt */
+	if (!S->venc.prev || S->venc.w != w || S->venc.h != h){
+		shmif_pixel* prev = DYNAMIC_REALLOC(S->venc.prev, w * h * sizeof(shmif_pixel));
+		if (!prev)
+			return;
+		S->venc.prev = prev;
+		S->venc.w = w;
+		S->venc.h = h;
+		S->venc.force_key = true;
+	}
+
+/* a keyframe is just a delta against an empty frame, receiver clears */
+	bool key = S->venc.force_key;
+	if (key)
+		memset(S->venc.prev, '\0', w * h * sizeof(shmif_pixel));
+	S->venc.force_key = false;
+
+	size_t tiles_x = (w + VIDEO_TILE_SZ - 1) / VIDEO_TILE_SZ;
+	size_t tiles_y = (h + VIDEO_TILE_SZ - 1) / VIDEO_TILE_SZ;
+	size_t tx1 = 0, ty1 = 0, tx2 = tiles_x, ty2 = tiles_y;
+
+/* the client tells us where it has drawn, no need to look elsewhere */
+	if (!key && vb->flags.subregion &&
+		vb->region.x2 >= vb->region.x1 && vb->region.y2 >= vb->region.y1 &&
+		vb->region.x1 < w && vb->region.y1 < h){
+		tx1 = vb->region.x1 / VIDEO_TILE_SZ;
+		ty1 = vb->region.y1 / VIDEO_TILE_SZ;
+		tx2 = vb->region.x2 / VIDEO_TILE_SZ + 1;
+		ty2 = vb->region.y2 / VIDEO_TILE_SZ + 1;
+		tx2 = tx2 > tiles_x ? tiles_x : tx2;
+		ty2 = ty2 > tiles_y ? tiles_y : ty2;
+	}
+
+	size_t pos = 0;
+	size_t bx1 = w, by1 = h, bx2 = 0, by2 = 0;
+
+	for (size_t ty = ty1; ty < ty2; ty++){
+		size_t y = ty * VIDEO_TILE_SZ;
+		size_t th = h - y > VIDEO_TILE_SZ ? VIDEO_TILE_SZ : h - y;
+
+		for (size_t tx = tx1; tx < tx2; tx++){
+			size_t x = tx * VIDEO_TILE_SZ;
+			size_t tw = w - x > VIDEO_TILE_SZ ? VIDEO_TILE_SZ : w - x;
+
+			if (tile_equal(vb->buffer, vb->pitch, S->venc.prev, w, x, y, tw, th))
+				continue;
+
+/* out of memory leaves the reference partially updated, start over */
+			size_t required = pos + 8 + 4 * tw * th;
+			S->venc.buf = grow_array(S->venc.buf, &S->venc.buf_sz, required);
+			if (S->venc.buf_sz < required){
+				S->venc.force_key = true;
+				return;
+			}
+
+			pos += encode_tile(&S->venc.buf[pos],
+				vb->buffer, vb->pitch, S->venc.prev, w, tx, ty, tw, th);
+
+			bx1 = x < bx1 ? x : bx1;
+			by1 = y < by1 ? y : by1;
+			bx2 = x + tw > bx2 ? x + tw : bx2;
+			by2 = y + th > by2 ? y + th : by2;
+		}
+	}
+
+/* the receiver clears the whole surface on a keyframe so that is all dirty,
+ * while a keyframe of an empty surface still needs to be sent */
+	if (key){
+		bx1 = by1 = 0;
+		bx2 = w;
+		by2 = h;
+		if (!pos){
+			S->venc.buf = grow_array(S->venc.buf, &S->venc.buf_sz, 8);
+			if (S->venc.buf_sz < 8){
+				S->venc.force_key = true;
+				return;
+			}
+			size_t tw = w > VIDEO_TILE_SZ ? VIDEO_TILE_SZ : w;
+			size_t th = h > VIDEO_TILE_SZ ? VIDEO_TILE_SZ : h;
+			pack_u16(0, S->venc.buf);
+			pack_u16(0, &S->venc.buf[2]);
+			pack_u16(tw * th, &S->venc.buf[4]);
+			pack_u16(0, &S->venc.buf[6]);
+			pos = 8;
+		}
+	}
+	else if (!pos){
+		S->stats.vframes_skip++;
+		return;
+	}
+
+	uint32_t stream_id = S->stream_id++;
+	uint8_t outb[CONTROL_PACKET_SIZE + 1] = {0};
+	uint8_t* args = &outb[1 + CONTROL_ARGS];
+	pack_u32(stream_id, &args[0]);
+	args[4] = VIDEO_FORMAT_XOR_RLE;
+	pack_u16(w, &args[5]);
+	pack_u16(h, &args[7]);
+	pack_u16(bx1, &args[9]);
+	pack_u16(by1, &args[11]);
+	pack_u16(bx2 - bx1, &args[13]);
+	pack_u16(by2 - by1, &args[15]);
+	args[17] = key ? VIDEO_FLAG_KEYFRAME : 0;
+	pack_u32(pos, &args[18]);
+	send_control(S, COMMAND_VIDEOFRAME, outb);
+
+	for (size_t ofs = 0; ofs < pos; ofs += VIDEO_PACKET_CHUNK){
+		size_t nb = pos - ofs > VIDEO_PACKET_CHUNK ? VIDEO_PACKET_CHUNK : pos - ofs;
+		uint8_t hdr[1 + VIDEO_PACKET_HEADER];
+		hdr[0] = STATE_VIDEO_PACKET;
+		pack_u64(S->current_seqnr++, &hdr[1]);
+		hdr[9] = 0;
+		pack_u32(stream_id, &hdr[10]);
+		pack_u16(nb, &hdr[14]);
+		append_outb_data(S, hdr, sizeof(hdr), &S->venc.buf[ofs], nb);
+	}
+
+	S->stats.vframes_out++;
+	S->stats.vbytes_out += pos;
+	S->stats.vbytes_raw += w * h * sizeof(shmif_pixel);
+}
+
+void
+a12_set_destination(struct a12_state* S, struct arcan_shmif_cont* wnd)
+{
+	if (!S || S->cookie != 0xfeedface)
+		return;
+
+/* whatever the sender thinks we have is not in the new destination */
+	if (S->vdec.dst != wnd){
+		S->vdec.dst = wnd;
+		S->vdec.active = false;
+		if (wnd && S->stats.vframes_in)
+			request_keyframe(S);
+	}
+}
+
+void
+a12_channel_stats(struct a12_state* S, struct a12_stats* out)
+{
+	if (!S || S->cookie != 0xfeedface || !out)
+		return;
+
+	*out = S->stats;
+}
@@ -99,4 +99,40 @@ a12_channel_poll(struct a12_state*);
 void
 a12_channel_enqueue(struct a12_state*, struct arcan_event*);
 
+/*
+ * Forward a video frame over the channel. The contents of [vb] are compared
+ * against the last frame that was sent, and only the 32x32 tiles that changed
+ * are encoded (XOR against the previous contents, then run-length coded) so
+ * the caller is free to step / release the buffer as soon as this returns.
+ * If [vb] has the subregion flag set, only tiles touching the region will be
+ * considered. The first frame and any frame after a resize is sent in full.
+ */
+struct shmifsrv_vbuffer;
+void
+a12_channel_vframe(struct a12_state*, struct shmifsrv_vbuffer* vb);
+
+/*
+ * Set the segment that incoming video frames should be reconstructed into,
+ * resizing it on the next complete frame if the dimensions differ. Frames
+ * that arrive while no destination is set are dropped, and updates that
+ * depend on a dropped frame are discarded until the next complete frame.
+ */
+void
+a12_set_destination(struct a12_state*, struct arcan_shmif_cont* wnd);
+
+struct a12_stats {
+	size_t vframes_out;  /* frames encoded and queued for output       */
+	size_t vframes_skip; /* frames that didn't change and were ignored */
+	size_t vbytes_out;   /* encoded video payload bytes queued         */
+	size_t vbytes_raw;   /* uncompressed size of the queued frames     */
+	size_t vframes_in;   /* frames reconstructed and signalled         */
+	size_t vframes_drop; /* frames that arrived but couldn't be used   */
+};
+
+/*
+ * Retrieve the accumulated channel statistics
+ */
+void
+a12_channel_stats(struct a12_state*, struct a12_stats* out);
+
 #endif
@@ -0,0 +1,169 @@
+/*
+ * Loopback benchmark for the a12 video path, synthetic frames are pushed
+ * through the encoder of one channel and unpacked into a local buffer by
+ * another, with the reconstructed frame compared against the source.
+ *
+ * Usage: arcan-netbench [scroll | rect | noise | static] [w] [h] [frames]
+ */
+#include <arcan_shmif.h>
+#include <arcan_shmif_server.h>
+#include <time.h>
+#include <inttypes.h>
+#include "a12.h"
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint32_t rng_state = 0x12345678;
+static uint32_t rnd()
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+/* text- like rows of noise on a flat background */
+static void fill_row(shmif_pixel* row, size_t w)
+{
+	for (size_t x = 0; x < w; x++)
+		row[x] = (rnd() % 7 == 0) ? SHMIF_RGBA(0xff, 0xff, 0xff, 0xff) :
+			SHMIF_RGBA(0x20, 0x20, 0x20, 0xff);
+}
+
+static void build_frame(const char* mode,
+	shmif_pixel* buf, size_t w, size_t h, size_t frame)
+{
+	if (strcmp(mode, "scroll") == 0){
+		size_t step = 16;
+		if (frame == 0){
+			for (size_t y = 0; y < h; y++)
+				fill_row(&buf[y * w], w);
+			return;
+		}
+		memmove(buf, &buf[step * w], (h - step) * w * sizeof(shmif_pixel));
+		for (size_t y = h - step; y < h; y++)
+			fill_row(&buf[y * w], w);
+	}
+	else if (strcmp(mode, "rect") == 0){
+		size_t rw = 64, rh = 64;
+		for (size_t y = 0; y < h; y++)
+			for (size_t x = 0; x < w; x++)
+				buf[y * w + x] = SHMIF_RGBA(x & 0xff, y & 0xff, 0x40, 0xff);
+
+		size_t rx = (frame * 7) % (w > rw ? w - rw : 1);
+		size_t ry = (frame * 3) % (h > rh ? h - rh : 1);
+		for (size_t y = ry; y < ry + rh && y < h; y++)
+			for (size_t x = rx; x < rx + rw && x < w; x++)
+				buf[y * w + x] = SHMIF_RGBA(0xff, 0x00, 0x00, 0xff);
+	}
+	else if (strcmp(mode, "noise") == 0){
+		for (size_t i = 0; i < w * h; i++)
+			buf[i] = rnd();
+	}
+	else if (frame == 0){
+		for (size_t y = 0; y < h; y++)
+			fill_row(&buf[y * w], w);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const char* mode = argc > 1 ? argv[1] : "scroll";
+	size_t w = argc > 2 ? strtoul(argv[2], NULL, 10) : 1280;
+	size_t h = argc > 3 ? strtoul(argv[3], NULL, 10) : 720;
+	size_t frames = argc > 4 ? strtoul(argv[4], NULL, 10) : 300;
+
+	if (!w || !h || w > UINT16_MAX || h > UINT16_MAX || !frames){
+		fprintf(stderr, "Usage: %s [scroll | rect | noise | static] "
+			"[w] [h] [frames]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	uint8_t authk[16] = {0};
+	struct a12_state* src = a12_channel_open(authk, sizeof(authk));
+	struct a12_state* dst = a12_channel_build(authk, sizeof(authk));
+	if (!src || !dst){
+		fprintf(stderr, "couldn't build channels\n");
+		return EXIT_FAILURE;
+	}
+
+/* the destination is never mapped, so signal turns into a no-op */
+	shmif_pixel* frame = calloc(w * h, sizeof(shmif_pixel));
+	struct arcan_shmif_cont wnd = {
+		.w = w, .h = h, .pitch = w, .stride = w * sizeof(shmif_pixel),
+		.vidp = calloc(w * h, sizeof(shmif_pixel))
+	};
+	if (!frame || !wnd.vidp){
+		fprintf(stderr, "couldn't allocate frame buffers\n");
+		return EXIT_FAILURE;
+	}
+	a12_set_destination(dst, &wnd);
+
+	size_t wire = 0, mismatch = 0;
+	uint64_t enc_ns = 0, dec_ns = 0;
+
+	for (size_t i = 0; i < frames; i++){
+		build_frame(mode, frame, w, h, i);
+
+		struct shmifsrv_vbuffer vb = {
+			.state = VBUFFER_OKDATA,
+			.buffer = frame,
+			.w = w, .h = h, .pitch = w, .stride = w * sizeof(shmif_pixel)
+		};
+
+		uint64_t t0 = now_ns();
+		a12_channel_vframe(src, &vb);
+		uint8_t* buf;
+		size_t nb = a12_channel_flush(src, &buf);
+		uint64_t t1 = now_ns();
+		wire += nb;
+		if (nb)
+			a12_channel_unpack(dst, buf, nb);
+		uint64_t t2 = now_ns();
+
+/* the back-channel carries keyframe requests */
+		if ((nb = a12_channel_flush(dst, &buf)))
+			a12_channel_unpack(src, buf, nb);
+
+		enc_ns += t1 - t0;
+		dec_ns += t2 - t1;
+
+		if (a12_channel_poll(src) < 0 || a12_channel_poll(dst) < 0){
+			fprintf(stderr, "channel broken at frame %zu\n", i);
+			return EXIT_FAILURE;
+		}
+
+		if (memcmp(frame, wnd.vidp, w * h * sizeof(shmif_pixel)) != 0)
+			mismatch++;
+	}
+
+	struct a12_stats out, in;
+	a12_channel_stats(src, &out);
+	a12_channel_stats(dst, &in);
+
+	double secs = (double)(enc_ns + dec_ns) / 1000000000.0;
+	printf("%s %zux%zu, %zu frames (%zu sent, %zu unchanged, %zu dropped)\n",
+		mode, w, h, frames, out.vframes_out, out.vframes_skip, in.vframes_drop);
+	printf("bytes/frame: %.1f payload, %.1f on the wire (raw %zu, ratio %.2f%%)\n",
+		(double)out.vbytes_out / frames, (double)wire / frames,
+		w * h * sizeof(shmif_pixel),
+		out.vbytes_raw ? 100.0 * out.vbytes_out / out.vbytes_raw : 0.0);
+	printf("encode: %.3f ms/frame, decode: %.3f ms/frame, %.1f frames/s\n",
+		(double)enc_ns / frames / 1000000.0,
+		(double)dec_ns / frames / 1000000.0, secs > 0 ? frames / secs : 0.0);
+
+	if (mismatch)
+		printf("%zu frames did not match the source\n", mismatch);
+
+	a12_channel_close(src);
+	a12_channel_close(dst);
+	free(frame);
+	free(wnd.vidp);
+
+	return mismatch ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -32,8 +32,10 @@ static void server_mode(struct shmifsrv_client* a, struct a12_state* ast)
 		int np = 2;
 		if (outbuf_sz || (outbuf_sz = a12_channel_flush(ast, &outbuf))){
 			ssize_t nw = write(STDOUT_FILENO, outbuf, outbuf_sz);
-			if (nw > 0)
+			if (nw > 0){
+				outbuf += nw;
 				outbuf_sz -= nw;
+			}
 			if (outbuf_sz)
 				np = 3;
 		}
@@ -75,9 +77,13 @@ static void server_mode(struct shmifsrv_client* a, struct a12_state* ast)
 /* do nothing */
 			break;
 			case CLIENT_VBUFFER_READY:
-				fprintf(stderr, "client got vbuffer, flush to state\n");
-/* copy + release if possible */
-				shmifsrv_video(a, true);
+/* the changes are encoded into the output buffer so release immediately */
+				if (shmifsrv_enter(a)){
+					struct shmifsrv_vbuffer vb = shmifsrv_video(a, false);
+					a12_channel_vframe(ast, &vb);
+					shmifsrv_video(a, true);
+					shmifsrv_leave();
+				}
 			break;
 			case CLIENT_ABUFFER_READY:
 				fprintf(stderr, "client got abuffer\n");
@@ -134,6 +140,7 @@ static int run_shmif_client(uint8_t* authk, size_t authk_sz)
 		arcan_shmif_open(SEGID_UNKNOWN, SHMIF_NOACTIVATE, NULL);
 
 	struct a12_state* ast = a12_channel_build(authk, authk_sz);
+	a12_set_destination(ast, &wnd);
 
 	struct pollfd fds[] = {
 		{ .fd = wnd.epipe, .events = c_pollev },
@@ -144,14 +151,16 @@ static int run_shmif_client(uint8_t* authk, size_t authk_sz)
 	uint8_t* outbuf;
 	size_t outbuf_sz = 0;
 
-	bool alive;
+	bool alive = true;
 	while (alive){
 /* first, flush current outgoing and/or swap buffers */
 		int np = 2;
 		if (outbuf_sz || (outbuf_sz = a12_channel_flush(ast, &outbuf))){
 			ssize_t nw = write(STDOUT_FILENO, outbuf, outbuf_sz);
-			if (nw > 0)
+			if (nw > 0){
+				outbuf += nw;
 				outbuf_sz -= nw;
+			}
 			if (outbuf_sz)
 				np = 3;
 		}
@@ -165,7 +174,16 @@ static int run_shmif_client(uint8_t* authk, size_t authk_sz)
 			continue;
 		}
 
+/* STDIN - update a12 state machine, video frames gets signalled from here */
 		if (sv && fds[1].revents){
+			uint8_t inbuf[9000];
+			ssize_t nr = 0;
+			while ((nr = read(fds[1].fd, inbuf, 9000)) > 0){
+				a12_channel_unpack(ast, inbuf, nr);
+			}
+		}
+
+		if (sv && fds[0].revents){
 			struct arcan_event newev;
 			int sc;
 			while (( sc = arcan_shmif_poll(&wnd, &newev)) > 0){
@@ -176,6 +194,8 @@ static int run_shmif_client(uint8_t* authk, size_t authk_sz)
 		}
 	}
 
+	a12_channel_close(ast);
+	arcan_shmif_drop(&wnd);
 	return EXIT_SUCCESS;
 }
 
@@ -19,19 +19,34 @@ extern "C" {
 #include "a12.h"
 };
 
-static void handle_outcon(
-	struct shmifsrv_client* cl, std::string host, uint16_t port)
+static void handle_outcon(struct shmifsrv_client* cl,
+	std::string authk, std::string host, uint16_t port)
 {
 /* CUDTUnited::newSocket */
 /* thread runner, add to job queue */
+	struct a12_state* ast = a12_channel_open(
+		reinterpret_cast<uint8_t*>(&authk[0]), authk.size());
+	if (!ast){
+		shmifsrv_free(cl);
+		return;
+	}
 
 	int sv;
 	while ((sv = shmifsrv_poll(cl)) != CLIENT_NOT_READY){
 		switch (sv){
 		case CLIENT_DEAD:
+			a12_channel_close(ast);
 			return;
 		break;
+/* same as netpipe, the changes are encoded into the channel output buffer
+ * so the client gets its buffer back immediately */
 		case CLIENT_VBUFFER_READY:
+			if (shmifsrv_enter(cl)){
+				struct shmifsrv_vbuffer vb = shmifsrv_video(cl, false);
+				a12_channel_vframe(ast, &vb);
+				shmifsrv_video(cl, true);
+				shmifsrv_leave();
+			}
 		break;
 		case CLIENT_ABUFFER_READY:
 		break;
@@ -51,6 +66,13 @@ static void handle_outcon(
 
 	}
 
+/* FIXME: the UDT carrier (above) isn't there yet, so the encoded output has
+ * nowhere to go - drop it rather than letting the channel buffers grow */
+	uint8_t* outbuf;
+	while (a12_channel_flush(ast, &outbuf)){}
+
+	a12_channel_close(ast);
+
 /* need shmifsrv_tick() */
 /* shmifsrv_free on ext() */
 }
@@ -74,7 +96,7 @@ static void handle_incon(UDTSOCKET connection)
  * Keep the same local connection point active, and each time a new connection
  * arrives, fire away a connection primitive upstream
  */
-static void spawn_conn(
+static void spawn_conn(const std::string& authk,
 	const std::string& listen, const std::string& host, uint_least16_t port)
 {
 	while (true){
@@ -84,7 +106,7 @@ static void spawn_conn(
 		if (!cl)
 			break;
 
-		std::thread th(&handle_outcon, cl, host, port);
+		std::thread th(&handle_outcon, cl, authk, host, port);
 		th.detach();
 	}
 }
@@ -114,6 +114,10 @@ static void dump_snapshot(struct arcan_shmif_page* page, int qlim)
 		(size_t) page->w, (size_t) page->h, (int) page->resized,
 		(int) page->vready, (int) page->vpending, (uint64_t) page->vpts
 	);
+	printf("deadline: %"PRIu64" (step: %zu us, cost: %zu us, jitter: %zu us)\n\t",
+		(uint64_t) page->vsynch_next, (size_t) page->vsynch_step,
+		(size_t) page->vsynch_cost, (size_t) page->vsynch_jitter
+	);
 	printf("dirty region: %zu,%zu - %zu,%zu\n\t",
 		(size_t) page->dirty.x1, (size_t) page->dirty.y1,
 		(size_t) page->dirty.x2, (size_t) page->dirty.y2
@@ -128,6 +132,11 @@ static void dump_snapshot(struct arcan_shmif_page* page, int qlim)
 	if (page->hints & SHMIF_RHINT_SUBREGION)
 		printf("subregion ");
 
+	if (page->hints & SHMIF_RHINT_SUBREGION_CHAIN)
+		printf("subregion-chain(%u:%u:%u) ",
+			(unsigned) page->dirty_chain.head, (unsigned) page->dirty_chain.mark,
+			(unsigned) page->dirty_chain.tail);
+
 	if (page->hints & SHMIF_RHINT_IGNORE_ALPHA)
 		printf("ignore-alpha ");
 
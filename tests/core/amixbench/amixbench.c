@@ -0,0 +1,320 @@
+/*
+ * Throughput benchmark for the audio monitor mixer in engine/arcan_amixer,
+ * used when a recording frameserver has several audio sources attached.
+ *
+ * A number of stereo int16 sources are fed in avfeedmon sized chunks and
+ * mixed into an output buffer, for every implementation that the CPU
+ * supports and for the per-sample float conversion and memmove based mixer
+ * that the frameserver used before ('ref'). The output of every
+ * implementation is checked against the reference. Sources at 44.1kHz and
+ * 32kHz are also fed through the resampler, and the length and pitch of the
+ * resampled output are checked.
+ *
+ * Usage: amixbench [seconds of audio per run]
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+
+#include "arcan_amixer.h"
+
+#define RATE 48000
+#define CHUNK 1024
+
+static uint64_t now_ns()
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return (uint64_t)tp.tv_sec * 1000000000ull + tp.tv_nsec;
+}
+
+/*
+ * the previous feed_amixer, though with the left gain applied to the first
+ * channel (it used to be swapped)
+ */
+struct ref_src {
+	float inbuf[4096];
+	size_t inofs;
+	int id;
+	float l_gain, r_gain;
+};
+
+static void ref_feed(struct ref_src* srcs, size_t n_srcs, int id,
+	const int16_t* buf, size_t nsamples, int16_t* out, size_t* ofs, size_t sz)
+{
+	size_t minv = INT_MAX;
+
+	for (size_t i = 0; i < n_srcs; i++){
+		struct ref_src* cur = &srcs[i];
+		if (cur->id == id){
+			size_t ulim = sizeof(cur->inbuf) / sizeof(float);
+			size_t count = 0;
+			size_t left = nsamples;
+			const int16_t* in = buf;
+
+			while (left-- && cur->inofs < ulim){
+				float val = *in++;
+				cur->inbuf[cur->inofs++] =
+					(count++ % 2 ? cur->r_gain : cur->l_gain) * (val / 32767.0f);
+			}
+		}
+		if (cur->inofs < minv)
+			minv = cur->inofs;
+	}
+
+	if (minv == INT_MAX || minv <= 512 || sz - *ofs == 0)
+		return;
+
+	if (*ofs + minv > sz)
+		minv = sz - *ofs;
+
+	for (size_t sc = 0; sc < minv; sc++){
+		float work = 0;
+		for (size_t i = 0; i < n_srcs; i++)
+			work += srcs[i].inbuf[sc] - (work * srcs[i].inbuf[sc]);
+		out[(*ofs)++] = work >= 1.0 ? 32767 :
+			(work < -1.0 ? -32768 : work * 32767);
+	}
+
+	for (size_t i = 0; i < n_srcs; i++){
+		struct ref_src* cur = &srcs[i];
+		if (cur->inofs > minv){
+			memmove(cur->inbuf, &cur->inbuf[minv], (cur->inofs - minv) * sizeof(float));
+			cur->inofs -= minv;
+		}
+		else
+			cur->inofs = 0;
+	}
+}
+
+/* noise, mostly at moderate levels with the occasional near full scale burst
+ * so that the mix hits the clipping paths */
+static int16_t* gen_sources(size_t n_srcs, size_t n)
+{
+	int16_t* buf = malloc(n_srcs * n * sizeof(int16_t));
+	if (!buf)
+		exit(EXIT_FAILURE);
+
+	uint32_t seed = 0x4321;
+	for (size_t i = 0; i < n_srcs * n; i++){
+		seed = seed * 1664525u + 1013904223u;
+		int16_t v = (int16_t)(seed >> 16);
+		buf[i] = (i / 4096) % 7 == 3 ? v : v / 4;
+	}
+
+	return buf;
+}
+
+static void gains(size_t i, float* l, float* r)
+{
+	*l = 1.0f - 0.1f * (i % 4);
+	*r = 0.5f + 0.15f * (i % 3);
+}
+
+static size_t run_ref(size_t n_srcs, const int16_t* in, size_t n, int16_t* out)
+{
+	struct ref_src* srcs = calloc(n_srcs, sizeof(struct ref_src));
+	if (!srcs)
+		exit(EXIT_FAILURE);
+
+	for (size_t i = 0; i < n_srcs; i++){
+		srcs[i].id = i + 1;
+		gains(i, &srcs[i].l_gain, &srcs[i].r_gain);
+	}
+
+	size_t ofs = 0;
+	for (size_t pos = 0; pos < n; pos += CHUNK)
+		for (size_t i = 0; i < n_srcs; i++)
+			ref_feed(srcs, n_srcs, i + 1, &in[i * n + pos], CHUNK, out, &ofs, n);
+
+	free(srcs);
+	return ofs;
+}
+
+static size_t run_amixer(size_t n_srcs, const int16_t* in, size_t n,
+	int16_t* out, unsigned rate)
+{
+	int ids[n_srcs];
+	for (size_t i = 0; i < n_srcs; i++)
+		ids[i] = i + 1;
+
+	struct amixer mix = {0};
+	if (!amixer_setup(&mix, RATE, n_srcs, ids))
+		exit(EXIT_FAILURE);
+
+	for (size_t i = 0; i < n_srcs; i++){
+		float l, r;
+		gains(i, &l, &r);
+		amixer_gain(&mix, i + 1, l, r);
+	}
+
+	size_t ofs = 0;
+	for (size_t pos = 0; pos < n; pos += CHUNK){
+		for (size_t i = 0; i < n_srcs; i++)
+			amixer_feed(&mix, i + 1, &in[i * n + pos], CHUNK, 2, rate);
+		ofs += amixer_mix(&mix, &out[ofs], n * 2 - ofs);
+	}
+
+	amixer_free(&mix);
+	return ofs;
+}
+
+static bool verify(size_t n_srcs)
+{
+	size_t n = 64 * CHUNK;
+	int16_t* in = gen_sources(n_srcs, n);
+	int16_t* ref = malloc(n * sizeof(int16_t));
+	int16_t* out = malloc(n * 2 * sizeof(int16_t));
+	if (!ref || !out)
+		exit(EXIT_FAILURE);
+
+	size_t n_ref = run_ref(n_srcs, in, n, ref);
+	size_t n_out = run_amixer(n_srcs, in, n, out, RATE);
+	bool ok = n_ref > n / 2 && n_out > n / 2;
+
+/* the mixer buffers differently, so compare the part both have produced,
+ * conversion is a multiply by gain / 32767 rather than a divide so allow
+ * for one step of difference */
+	size_t lim = n_ref < n_out ? n_ref : n_out;
+	for (size_t i = 0; i < lim && ok; i++)
+		if (abs(ref[i] - out[i]) > 1){
+			fprintf(stderr, "sample %zu: %d, expected %d\n", i, out[i], ref[i]);
+			ok = false;
+		}
+
+	free(in);
+	free(ref);
+	free(out);
+	return ok;
+}
+
+/* a 1kHz tone at [rate] should come out at 48kHz with the length scaled and
+ * still be a 1kHz tone */
+static bool verify_resample(unsigned rate)
+{
+	size_t frames = rate;
+	int16_t* in = malloc(frames * 2 * sizeof(int16_t));
+	int16_t* out = malloc(RATE * 4 * sizeof(int16_t));
+	if (!in || !out)
+		exit(EXIT_FAILURE);
+
+	for (size_t i = 0; i < frames; i++)
+		in[i*2+0] = in[i*2+1] = 16000.0 * sin(2.0 * M_PI * 1000.0 * i / rate);
+
+	int ids[] = {1, 2};
+	struct amixer mix = {0};
+	if (!amixer_setup(&mix, RATE, 2, ids))
+		exit(EXIT_FAILURE);
+
+/* second source is silence at the native rate, mixing with it is a no-op */
+	int16_t silence[CHUNK] = {0};
+	size_t ofs = 0;
+	size_t step = CHUNK * rate / RATE & ~(size_t)1;
+	for (size_t pos = 0; pos + step <= frames * 2; pos += step){
+		amixer_feed(&mix, 1, &in[pos], step, 2, rate);
+		amixer_feed(&mix, 2, silence, CHUNK, 2, RATE);
+		ofs += amixer_mix(&mix, &out[ofs], RATE * 4 - ofs);
+	}
+	amixer_free(&mix);
+
+/* measure between the first and last crossing after the resampler has
+ * settled, the filter rings a bit around 0 while its history fills up */
+	size_t crossings = 0, first = 0, last = 0;
+	for (size_t i = 256; i < ofs; i += 2)
+		if ((out[i-2] < 0) != (out[i] < 0)){
+			if (!first)
+				first = i;
+			last = i;
+			crossings++;
+		}
+
+	double seconds = (double) ofs / 2 / RATE;
+	double hz = crossings > 1 ?
+		(crossings - 1) / 2.0 / ((double)(last - first) / 2 / RATE) : 0;
+
+	free(in);
+	free(out);
+	return seconds > 0.9 && fabs(hz - 1000.0) < 1.0;
+}
+
+static double run(bool ref, size_t n_srcs, size_t n, unsigned rate)
+{
+	int16_t* in = gen_sources(n_srcs, n);
+	int16_t* out = malloc(n * 2 * sizeof(int16_t));
+	if (!out)
+		exit(EXIT_FAILURE);
+
+	uint64_t ts = now_ns();
+	if (ref)
+		run_ref(n_srcs, in, n, out);
+	else
+		run_amixer(n_srcs, in, n, out, rate);
+	uint64_t ns = now_ns() - ts;
+
+	free(in);
+	free(out);
+	return (double)ns / 1000000.0;
+}
+
+int main(int argc, char** argv)
+{
+	size_t seconds = 10;
+	if (argc > 1)
+		seconds = strtoul(argv[1], NULL, 10);
+	if (!seconds)
+		seconds = 1;
+
+/* samples per source per run, rounded to whole chunks */
+	size_t n = (seconds * RATE * 2 + CHUNK - 1) / CHUNK * CHUNK;
+	double audio_ms = seconds * 1000.0;
+
+	static const size_t sources[] = {2, 4, 8, 16};
+	static const enum amixer_impl impl[] = {
+		AMIXER_SCALAR, AMIXER_SSE2, AMIXER_NEON
+	};
+
+	for (size_t s = 0; s < sizeof(sources) / sizeof(sources[0]); s++){
+		double ms = run(true, sources[s], n, RATE);
+		printf("%-6s %2zu sources %8.2f ms (%7.1f Msamples/s, %6.0fx realtime)\n",
+			"ref", sources[s], ms, (double)(n * sources[s]) / ms / 1000.0,
+			audio_ms / ms);
+	}
+
+	for (size_t i = 0; i < sizeof(impl) / sizeof(impl[0]); i++){
+		if (!amixer_set_impl(impl[i]))
+			continue;
+
+		for (size_t s = 0; s < sizeof(sources) / sizeof(sources[0]); s++){
+			if (!verify(sources[s])){
+				fprintf(stderr, "%s %zu sources: mismatch against reference\n",
+					amixer_impl_name(), sources[s]);
+				return EXIT_FAILURE;
+			}
+
+			double ms = run(false, sources[s], n, RATE);
+			printf("%-6s %2zu sources %8.2f ms (%7.1f Msamples/s, %6.0fx realtime)\n",
+				amixer_impl_name(), sources[s], ms,
+				(double)(n * sources[s]) / ms / 1000.0, audio_ms / ms);
+		}
+
+		static const unsigned rates[] = {44100, 32000};
+		for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++){
+			if (!verify_resample(rates[r])){
+				fprintf(stderr, "%s %u Hz: resampled output is off\n",
+					amixer_impl_name(), rates[r]);
+				return EXIT_FAILURE;
+			}
+
+			double ms = run(false, 4, n, rates[r]);
+			printf("%-6s  4 sources %8.2f ms (%7.1f Msamples/s) at %u Hz\n",
+				amixer_impl_name(), ms, (double)(n * 4) / ms / 1000.0, rates[r]);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
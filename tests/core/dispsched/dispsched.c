@@ -0,0 +1,309 @@
+/*
+ * Simulated-vblank harness for the per-display scanout scheduling in
+ * engine/arcan_dispsched.c, as used by the conductor and the egl-dri
+ * platform.
+ *
+ * A set of displays with different refresh rates and vblank phases is
+ * simulated against a virtual clock. Composing a display costs a (jittered)
+ * amount of time, a queued frame is scanned out at the first vblank of that
+ * display after the composition finished and the flip event carries the
+ * time of that vblank. Content is assumed to change every frame.
+ *
+ * Two loops are compared: 'shared', the previous behavior where all displays
+ * that aren't in a flip are composed together and the loop then waits for
+ * the primary display, and 'split' where the scheduler decides which display
+ * to compose and when. Reported per display: flips and compositions per
+ * second, vblanks that went without a new frame, and the time from starting
+ * to compose until scanout.
+ *
+ * For 'split' every display is checked to get (nearly) every vblank, not be
+ * composed more often than it flips and have its frames composed within a
+ * period of scanout.
+ *
+ * 'lost' drops the flip events of one display for the first half of the run
+ * (as with DPMS off or a VT switch), which should then still be composed at
+ * some rate rather than wait forever, without holding up the other display.
+ *
+ * Usage: dispsched [seconds]
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "arcan_dispsched.h"
+
+/* same as the conductor timestep */
+#define MARGIN 2
+
+struct sim_display {
+	float rate;
+	double phase;
+	double cost;
+	bool primary;
+
+	double period;
+	bool pending;
+	double flip_at;
+	double compose_at;
+
+/* flips before this time happen, but the event never arrives */
+	double lost_until;
+
+	unsigned long long flips, composed, vblanks;
+	double latency, max_latency;
+};
+
+struct scenario {
+	const char* name;
+	size_t n;
+	struct sim_display disps[4];
+};
+
+static uint32_t seed = 0x5eed;
+static double jitter(double cost)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return cost * (0.8 + 0.4 * (double)(seed >> 8) / (double)(1 << 24));
+}
+
+static double next_vblank(struct sim_display* d, double t)
+{
+	double k = floor((t - d->phase) / d->period) + 1.0;
+	return d->phase + k * d->period;
+}
+
+static double compose(struct sim_display* d, double t)
+{
+	d->composed++;
+	d->compose_at = t;
+	t += jitter(d->cost);
+	d->pending = true;
+	d->flip_at = next_vblank(d, t);
+	return t;
+}
+
+static void flip(struct sim_display* d)
+{
+	double lat = d->flip_at - d->compose_at;
+	d->latency += lat;
+	if (lat > d->max_latency)
+		d->max_latency = lat;
+	d->flips++;
+	d->pending = false;
+}
+
+/* process the flips that have happened by [t], return the time of the first
+ * one that is still outstanding */
+static double flush(struct sim_display* disps, size_t n,
+	struct dispsched* ctx, double t)
+{
+	double next = INFINITY;
+	for (size_t i = 0; i < n; i++){
+		struct sim_display* d = &disps[i];
+		if (d->pending && d->flip_at <= t){
+			flip(d);
+			if (ctx && d->flip_at >= d->lost_until)
+				dispsched_vblank(ctx, 0, i, (long long) d->flip_at);
+		}
+		if (d->pending && d->flip_at < next)
+			next = d->flip_at;
+	}
+	return next;
+}
+
+static void run_shared(struct sim_display* disps, size_t n, double end)
+{
+	double t = 0;
+	while (t < end){
+		flush(disps, n, NULL, t);
+		for (size_t i = 0; i < n; i++)
+			if (!disps[i].pending)
+				t = compose(&disps[i], t);
+
+/* wait for the flip on the primary display(s) */
+		for (size_t i = 0; i < n; i++)
+			if (disps[i].primary && disps[i].pending && disps[i].flip_at > t)
+				t = disps[i].flip_at;
+		flush(disps, n, NULL, t);
+	}
+}
+
+static void run_split(struct sim_display* disps, size_t n, double end,
+	struct dispsched* out)
+{
+	struct dispsched ctx = {0};
+	for (size_t i = 0; i < n; i++)
+		dispsched_register(&ctx, 0, i, disps[i].rate, i);
+
+	double t = 0;
+	while (t < end){
+		double next_flip = flush(disps, n, &ctx, t);
+
+		struct dispsched_display* due[DISPSCHED_LIMIT];
+		int wait;
+		size_t nd = dispsched_due(&ctx, (long long) t, MARGIN,
+			false, due, DISPSCHED_LIMIT, &wait);
+
+/* like the platform, sleep until something is due or a flip comes in */
+		if (!nd){
+			double wake = t + (wait > 0 ? wait : 1);
+			t = wake < next_flip ? wake : next_flip;
+			continue;
+		}
+
+		for (size_t i = 0; i < nd; i++){
+			struct sim_display* d = &disps[due[i]->disp_id];
+			double start = t;
+			t = compose(d, t);
+			dispsched_submit(&ctx, 0, due[i]->disp_id,
+				(long long) t, (int) ceil(t - start), true);
+		}
+	}
+
+	if (out)
+		*out = ctx;
+}
+
+static bool report(const char* mode, struct scenario* sc, double secs, bool check)
+{
+	bool ok = true;
+
+	for (size_t i = 0; i < sc->n; i++){
+		struct sim_display* d = &sc->disps[i];
+		d->vblanks = floor((secs * 1000.0 - d->phase) / d->period);
+		double mean = d->flips ? d->latency / d->flips : 0;
+		unsigned long long missed = d->vblanks > d->flips ? d->vblanks - d->flips : 0;
+
+		printf("%-8s %-6s %5.1fHz%s flips: %6.1f/s composed: %6.1f/s "
+			"missed: %5.2f%% latency: %5.2f ms (max %5.2f)\n",
+			sc->name, mode, d->rate, d->primary ? "*" : " ",
+			d->flips / secs, d->composed / secs,
+			100.0 * (double) missed / d->vblanks, mean, d->max_latency);
+
+		if (!check)
+			continue;
+
+		if (missed > d->vblanks / 50 || d->composed > d->flips + 1 || mean > d->period){
+			fprintf(stderr, "%s: %.1fHz display out of bounds\n", sc->name, d->rate);
+			ok = false;
+		}
+	}
+
+	return ok;
+}
+
+static void reset(struct scenario* sc)
+{
+	for (size_t i = 0; i < sc->n; i++){
+		struct sim_display* d = &sc->disps[i];
+		*d = (struct sim_display){
+			.rate = d->rate,
+			.phase = d->phase,
+			.cost = d->cost,
+			.primary = d->primary,
+			.lost_until = d->lost_until,
+			.period = 1000.0 / d->rate
+		};
+	}
+}
+
+static bool check_lost(double secs)
+{
+	struct scenario sc = {
+		.name = "lost",
+		.n = 2,
+		.disps = {
+			{.rate = 144, .phase = 0.0, .cost = 2.0, .primary = true},
+			{.rate = 60, .phase = 3.3, .cost = 3.0, .lost_until = secs * 500.0}
+		}
+	};
+	struct dispsched ctx;
+	bool ok = true;
+
+	reset(&sc);
+	run_split(sc.disps, sc.n, secs * 1000.0, &ctx);
+	report("split", &sc, secs, false);
+
+/* the unaffected display should keep up as normal */
+	struct sim_display* d = &sc.disps[0];
+	if (d->vblanks - d->flips > d->vblanks / 50){
+		fprintf(stderr, "lost: %.1fHz display stalled\n", d->rate);
+		ok = false;
+	}
+
+/* with no events, every frame expires after a period past its target, so
+ * at least every third vblank should still be composed and counted missed */
+	d = &sc.disps[1];
+	unsigned long long lost = floor(d->lost_until / d->period);
+	struct dispsched_display* sd = dispsched_find(&ctx, 0, 1);
+	if (d->flips < lost / 3 + (d->vblanks - lost) * 49 / 50 ||
+		sd->misses < lost / 3 || d->composed > d->flips + 1){
+		fprintf(stderr, "lost: %.1fHz display didn't recover "
+			"(flips: %llu, misses: %llu)\n", d->rate, d->flips, sd->misses);
+		ok = false;
+	}
+
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	double secs = 10;
+	if (argc > 1)
+		secs = strtod(argv[1], NULL);
+	if (secs < 1)
+		secs = 1;
+
+	struct scenario scenarios[] = {
+		{
+			.name = "single",
+			.n = 1,
+			.disps = {{.rate = 60, .phase = 1.5, .cost = 3, .primary = true}}
+		},
+		{
+			.name = "144+60",
+			.n = 2,
+			.disps = {
+				{.rate = 144, .phase = 0.0, .cost = 2.0, .primary = true},
+				{.rate = 60, .phase = 3.3, .cost = 3.0}
+			}
+		},
+		{
+			.name = "60+144",
+			.n = 2,
+			.disps = {
+				{.rate = 60, .phase = 3.3, .cost = 3.0, .primary = true},
+				{.rate = 144, .phase = 0.0, .cost = 2.0}
+			}
+		},
+		{
+			.name = "3-head",
+			.n = 3,
+			.disps = {
+				{.rate = 144, .phase = 0.0, .cost = 1.5, .primary = true},
+				{.rate = 75, .phase = 5.0, .cost = 2.0},
+				{.rate = 59.94, .phase = 11.0, .cost = 2.5}
+			}
+		}
+	};
+
+	bool ok = true;
+	for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++){
+		struct scenario* sc = &scenarios[i];
+
+		reset(sc);
+		run_shared(sc->disps, sc->n, secs * 1000.0);
+		report("shared", sc, secs, false);
+
+		reset(sc);
+		run_split(sc->disps, sc->n, secs * 1000.0, NULL);
+		ok &= report("split", sc, secs, true);
+	}
+
+	ok &= check_lost(secs);
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
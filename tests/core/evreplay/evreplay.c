@@ -0,0 +1,431 @@
+/*
+ * Replays recorded evdev streams through the ring that the evdev input
+ * platform uses between its reader thread and the event context, so that
+ * the hand-over and the motion coalescing can be tested without devices.
+ *
+ * A recording is the raw stream of struct input_event as read from a device
+ * node, e.g. cat /dev/input/event3 > mouse.ev. Each file acts as a device,
+ * read by a producer thread in chunks of varying size while the main thread
+ * drains and groups the records the way platform_event_process does, once
+ * as is and once with coalescing. Without coalescing, every device has to
+ * get its events back unchanged. With coalescing, the total motion, all
+ * other events and the motion that preceded each of them have to match the
+ * recording, and timestamps must not go backwards.
+ *
+ * Without arguments, a 1kHz mouse and a keyboard are synthesized into
+ * temporary recordings first.
+ *
+ * Usage: evreplay [-r] [recording ...]
+ *  -r  feed at the recorded pace and drain every 16ms like the frame loop,
+ *      reports the time from each event to when it was drained
+ */
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "evring.h"
+
+#define PASS_MS 16
+
+struct device {
+	const char* path;
+	struct input_event* ev;
+	size_t n;
+
+/* drained, for the current mode */
+	struct input_event* out;
+	size_t n_out;
+	size_t fed;
+};
+
+static struct {
+	struct device* devs;
+	size_t n_devs;
+	bool paced;
+	uint64_t start;
+	atomic_bool done;
+	struct evring ring;
+} replay;
+
+static uint64_t now_us()
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return (uint64_t)tp.tv_sec * 1000000ull + tp.tv_nsec / 1000;
+}
+
+static uint64_t ev_us(const struct input_event* ev)
+{
+	return (uint64_t)ev->input_event_sec * 1000000ull + ev->input_event_usec;
+}
+
+static bool is_motion(const struct input_event* ev)
+{
+	return ev->type == EV_REL && (ev->code == REL_X || ev->code == REL_Y);
+}
+
+static void put(FILE* fout, uint64_t us, int type, int code, int value)
+{
+	struct input_event ev = {
+		.type = type,
+		.code = code,
+		.value = value
+	};
+	ev.input_event_sec = us / 1000000;
+	ev.input_event_usec = us % 1000000;
+	fwrite(&ev, sizeof(ev), 1, fout);
+}
+
+/* 10s of a 1kHz mouse with some clicks and wheel, and a keyboard typing */
+static char* synth(bool mouse)
+{
+	char* path = strdup("/tmp/evreplay_XXXXXX");
+	int fd = mkstemp(path);
+	FILE* fout = fd != -1 ? fdopen(fd, "w") : NULL;
+	if (!fout){
+		fprintf(stderr, "couldn't create a temporary recording\n");
+		exit(EXIT_FAILURE);
+	}
+
+	uint32_t seed = mouse ? 0x1234 : 0x4321;
+	uint64_t base = 1000ull * 1000000ull;
+
+	for (size_t ms = 0; ms < 10000; ms++){
+		uint64_t us = base + ms * 1000;
+		seed = seed * 1664525u + 1013904223u;
+
+		if (!mouse){
+			if (ms % 100 == 0 || ms % 100 == 40){
+				put(fout, us, EV_MSC, MSC_SCAN, 30 + ms / 100 % 20);
+				put(fout, us, EV_KEY, KEY_A + ms / 100 % 20, ms % 100 == 0);
+				put(fout, us, EV_SYN, SYN_REPORT, 0);
+			}
+			else if (ms % 1000 > 500 && ms % 1000 < 900 && ms % 33 == 0){
+				put(fout, us, EV_KEY, KEY_SPACE, 2);
+				put(fout, us, EV_SYN, SYN_REPORT, 0);
+			}
+			continue;
+		}
+
+		int dx = (int)(seed >> 28) - 8;
+		int dy = (int)((seed >> 24) & 0x0f) - 8;
+		if (dx)
+			put(fout, us, EV_REL, REL_X, dx);
+		if (dy)
+			put(fout, us, EV_REL, REL_Y, dy);
+		if (dx || dy)
+			put(fout, us, EV_SYN, SYN_REPORT, 0);
+
+		if (ms % 250 == 100 || ms % 250 == 150){
+			put(fout, us, EV_MSC, MSC_SCAN, 0x90001);
+			put(fout, us, EV_KEY, BTN_LEFT, ms % 250 == 100);
+			put(fout, us, EV_SYN, SYN_REPORT, 0);
+		}
+
+/* motion in the same frame as the wheel */
+		if (ms % 500 == 300){
+			put(fout, us, EV_REL, REL_X, 1);
+			put(fout, us, EV_REL, REL_WHEEL, -1);
+			put(fout, us, EV_SYN, SYN_REPORT, 0);
+		}
+	}
+
+	fclose(fout);
+	return path;
+}
+
+static bool load(struct device* dev, const char* path)
+{
+	FILE* fin = fopen(path, "r");
+	if (!fin)
+		return false;
+
+	fseek(fin, 0, SEEK_END);
+	long sz = ftell(fin);
+	fseek(fin, 0, SEEK_SET);
+
+	dev->path = path;
+	dev->n = sz > 0 ? sz / sizeof(struct input_event) : 0;
+	dev->ev = malloc(dev->n * sizeof(struct input_event) + 1);
+	dev->out = malloc(dev->n * sizeof(struct input_event) + 1);
+	if (!dev->ev || !dev->out ||
+		fread(dev->ev, sizeof(struct input_event), dev->n, fin) != dev->n){
+		fclose(fin);
+		return false;
+	}
+
+	fclose(fin);
+	return dev->n > 0;
+}
+
+/* the reader thread, minus the polling: each round takes a chunk of up to 64
+ * events from every device that has something to deliver */
+static void* producer(void* arg)
+{
+	uint32_t seed = 0xbeef;
+	bool left = true;
+
+	while (left){
+		left = false;
+		uint64_t elapsed = now_us() - replay.start;
+
+		for (size_t i = 0; i < replay.n_devs; i++){
+			struct device* dev = &replay.devs[i];
+			if (dev->fed == dev->n)
+				continue;
+			left = true;
+
+			seed = seed * 1664525u + 1013904223u;
+			size_t n = 1 + (seed >> 26);
+			if (n > dev->n - dev->fed)
+				n = dev->n - dev->fed;
+
+/* only what has 'happened' by now */
+			if (replay.paced){
+				uint64_t first = ev_us(&dev->ev[0]);
+				size_t lim = 0;
+				while (lim < n &&
+					ev_us(&dev->ev[dev->fed + lim]) - first <= elapsed)
+					lim++;
+				n = lim;
+			}
+
+			dev->fed += evring_push(&replay.ring, i, 1, &dev->ev[dev->fed], n);
+		}
+
+		if (replay.paced || evring_space(&replay.ring) == 0)
+			usleep(replay.paced ? 500 : 50);
+	}
+
+	atomic_store(&replay.done, true);
+	return NULL;
+}
+
+struct stats {
+	size_t in, out, motion, passes;
+	double ms;
+	uint64_t lat_sum, lat_max;
+};
+
+/* drain like platform_event_process: group consecutive records per device
+ * into a batch and coalesce it */
+static void drain(bool coalesce, struct stats* st)
+{
+	struct evring_rec recs[256];
+	struct input_event batch[256];
+	size_t n;
+
+	while ((n = evring_pop(&replay.ring, recs, 256))){
+		uint64_t now = now_us();
+		for (size_t i = 0; i < n;){
+			uint16_t slot = recs[i].slot;
+			size_t count = 0;
+
+			while (i < n && recs[i].slot == slot)
+				batch[count++] = recs[i++].ev;
+			st->in += count;
+
+			if (coalesce)
+				count = evring_coalesce(batch, count);
+
+			struct device* dev = &replay.devs[slot];
+			for (size_t j = 0; j < count; j++){
+				dev->out[dev->n_out++] = batch[j];
+				st->motion += is_motion(&batch[j]);
+
+				if (replay.paced){
+					uint64_t lat = now - replay.start -
+						(ev_us(&batch[j]) - ev_us(&dev->ev[0]));
+					st->lat_sum += lat;
+					if (lat > st->lat_max)
+						st->lat_max = lat;
+				}
+			}
+			st->out += count;
+		}
+	}
+}
+
+/* cumulative motion and event, for every event that isn't motion or a report */
+static size_t digest(const struct input_event* ev, size_t n, int64_t* out)
+{
+	int64_t dx = 0, dy = 0;
+	size_t count = 0;
+
+	for (size_t i = 0; i < n; i++){
+		if (is_motion(&ev[i])){
+			if (ev[i].code == REL_X)
+				dx += ev[i].value;
+			else
+				dy += ev[i].value;
+			continue;
+		}
+
+		if (ev[i].type == EV_SYN && ev[i].code == SYN_REPORT)
+			continue;
+
+		if (out){
+			out[count * 4 + 0] = dx;
+			out[count * 4 + 1] = dy;
+			out[count * 4 + 2] = ev[i].type << 16 | ev[i].code;
+			out[count * 4 + 3] = ev[i].value;
+		}
+		count++;
+	}
+
+	if (out){
+		out[count * 4 + 0] = dx;
+		out[count * 4 + 1] = dy;
+	}
+	return count;
+}
+
+static bool verify(struct device* dev, bool coalesce)
+{
+	if (!coalesce){
+		if (dev->n_out != dev->n ||
+			memcmp(dev->out, dev->ev, dev->n * sizeof(struct input_event)) != 0){
+			fprintf(stderr, "%s: %zu events in, %zu out or reordered\n",
+				dev->path, dev->n, dev->n_out);
+			return false;
+		}
+		return true;
+	}
+
+	for (size_t i = 1; i < dev->n_out; i++)
+		if (ev_us(&dev->out[i]) < ev_us(&dev->out[i-1])){
+			fprintf(stderr, "%s: timestamp went backwards at %zu\n", dev->path, i);
+			return false;
+		}
+
+	size_t na = digest(dev->ev, dev->n, NULL);
+	size_t nb = digest(dev->out, dev->n_out, NULL);
+	if (na != nb){
+		fprintf(stderr, "%s: %zu other events, expected %zu\n", dev->path, nb, na);
+		return false;
+	}
+
+	int64_t* a = malloc((na + 1) * 4 * sizeof(int64_t));
+	int64_t* b = malloc((nb + 1) * 4 * sizeof(int64_t));
+	if (!a || !b)
+		exit(EXIT_FAILURE);
+
+	digest(dev->ev, dev->n, a);
+	digest(dev->out, dev->n_out, b);
+
+	bool ok = true;
+	for (size_t i = 0; i <= na && ok; i++){
+		size_t lim = i == na ? 2 : 4;
+		if (memcmp(&a[i * 4], &b[i * 4], lim * sizeof(int64_t)) != 0){
+			fprintf(stderr, "%s: event %zu (motion %"PRId64",%"PRId64"), got "
+				"(motion %"PRId64",%"PRId64")\n", dev->path, i,
+				a[i * 4], a[i * 4 + 1], b[i * 4], b[i * 4 + 1]);
+			ok = false;
+		}
+	}
+
+	free(a);
+	free(b);
+	return ok;
+}
+
+static bool run(bool coalesce, struct stats* st)
+{
+	*st = (struct stats){0};
+	for (size_t i = 0; i < replay.n_devs; i++)
+		replay.devs[i].n_out = replay.devs[i].fed = 0;
+
+	evring_reset(&replay.ring);
+	atomic_store(&replay.done, false);
+	replay.start = now_us();
+
+	pthread_t pth;
+	if (0 != pthread_create(&pth, NULL, producer, NULL))
+		exit(EXIT_FAILURE);
+
+	for(;;){
+		bool last = atomic_load(&replay.done);
+		drain(coalesce, st);
+		st->passes++;
+		if (last)
+			break;
+
+		if (replay.paced)
+			usleep(PASS_MS * 1000);
+	}
+
+	pthread_join(pth, NULL);
+	st->ms = (double)(now_us() - replay.start) / 1000.0;
+
+	for (size_t i = 0; i < replay.n_devs; i++)
+		if (!verify(&replay.devs[i], coalesce))
+			return false;
+
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	int first = 1;
+	if (argc > 1 && strcmp(argv[1], "-r") == 0){
+		replay.paced = true;
+		first++;
+	}
+
+	char* tmp[2] = {NULL, NULL};
+	const char** paths = (const char**) &argv[first];
+	size_t n_paths = argc - first;
+
+	if (!n_paths){
+		tmp[0] = synth(true);
+		tmp[1] = synth(false);
+		paths = (const char**) tmp;
+		n_paths = 2;
+	}
+
+	replay.devs = calloc(n_paths, sizeof(struct device));
+	replay.n_devs = n_paths;
+	if (!replay.devs)
+		return EXIT_FAILURE;
+
+	for (size_t i = 0; i < n_paths; i++)
+		if (!load(&replay.devs[i], paths[i])){
+			fprintf(stderr, "couldn't load recording %s\n", paths[i]);
+			return EXIT_FAILURE;
+		}
+
+	int rv = EXIT_SUCCESS;
+	for (size_t i = 0; i < 2; i++){
+		struct stats st;
+		if (!run(i == 1, &st)){
+			fprintf(stderr, "%s: replay mismatch\n", i ? "coalesced" : "direct");
+			rv = EXIT_FAILURE;
+			break;
+		}
+
+		printf("%-9s %8zu events in, %8zu out (%7zu motion), %6zu passes, "
+			"%8.2f ms", i ? "coalesced" : "direct",
+			st.in, st.out, st.motion, st.passes, st.ms);
+		if (replay.paced)
+			printf(", latency avg %.2f ms max %.2f ms",
+				st.out ? (double)st.lat_sum / st.out / 1000.0 : 0,
+				(double)st.lat_max / 1000.0);
+		else
+			printf(" (%.1f Mevents/s)", (double)st.in / st.ms / 1000.0);
+		printf("\n");
+	}
+
+	for (size_t i = 0; i < 2; i++)
+		if (tmp[i]){
+			unlink(tmp[i]);
+			free(tmp[i]);
+		}
+
+	return rv;
+}
@@ -0,0 +1,43 @@
+# Shared setup for the standalone harnesses here that build a few engine or
+# platform sources directly rather than linking against the shmif libraries.
+# A harness directory has <name>.c and a CMakeLists.txt that includes this
+# and lists what it needs from the source tree:
+#
+# core_harness(<name>
+#	SOURCES <paths relative to src/>
+#	[INCLUDES <dirs relative to src/>]
+#	[LIBRARIES <libs>]
+# )
+
+if (NOT ARCAN_SOURCE_DIR)
+	set(ARCAN_SOURCE_DIR ${CMAKE_CURRENT_LIST_DIR}/../../src)
+endif()
+
+add_definitions(
+	-Wall
+	-std=gnu11
+)
+
+if (NOT CMAKE_BUILD_TYPE)
+	set(CMAKE_BUILD_TYPE Release)
+endif()
+
+include(CMakeParseArguments)
+
+function(core_harness name)
+	cmake_parse_arguments(HARNESS "" "" "SOURCES;INCLUDES;LIBRARIES" ${ARGN})
+
+	set(SOURCES ${name}.c)
+	foreach(src ${HARNESS_SOURCES})
+		list(APPEND SOURCES ${ARCAN_SOURCE_DIR}/${src})
+	endforeach()
+
+	foreach(dir ${HARNESS_INCLUDES})
+		include_directories(${ARCAN_SOURCE_DIR}/${dir})
+	endforeach()
+
+	add_executable(${name} ${SOURCES})
+	if (HARNESS_LIBRARIES)
+		target_link_libraries(${name} ${HARNESS_LIBRARIES})
+	endif()
+endfunction()
@@ -0,0 +1,260 @@
+/*
+ * Microbenchmark for the pixel format conversion in frameserver/util/pixconv,
+ * used by the game frameserver to get core output into shmif.
+ *
+ * Every implementation that the CPU supports is run for each of the source
+ * formats, straight to 32-bit and to the RGB565 NTSC intermediate, at a few
+ * resolutions from native 16-bit console output up to the internal
+ * resolutions that 3D cores get scaled to. The per- pixel lookup table
+ * conversion that the frameserver used before is timed as 'lut', and the
+ * output of every implementation is checked against it, with a padded source
+ * pitch and an odd destination pitch to cover row handling.
+ *
+ * Usage: pixconvbench [n_frames]
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "pixconv.h"
+
+static uint64_t now_ns()
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return (uint64_t)tp.tv_sec * 1000000000ull + tp.tv_nsec;
+}
+
+/* the tables from the previous libretro_rgb565_rgba */
+static const uint8_t rgb565_lut5[] = {
+  0,   8,  16,  25,  33,  41,  49,  58,  66,   74,  82,  90,  99, 107, 115,123,
+132, 140, 148, 156, 165, 173, 181, 189,  197, 206, 214, 222, 230, 239, 247,255
+};
+
+static const uint8_t rgb565_lut6[] = {
+  0,   4,   8,  12,  16,  20,  24,  28,  32,  36,  40,  45,  49,  53,  57, 61,
+ 65,  69,  73,  77,  81,  85,  89,  93,  97, 101, 105, 109, 113, 117, 121, 125,
+130, 134, 138, 142, 146, 150, 154, 158, 162, 166, 170, 174, 178, 182, 186, 190,
+194, 198, 202, 206, 210, 215, 219, 223, 227, 231, 235, 239, 243, 247, 251, 255
+};
+
+#define RGBA(r, g, b) (0xff000000 | ((uint32_t)(b) << 16) | \
+	((uint32_t)(g) << 8) | (uint32_t)(r))
+
+#define RGB565(b, g, r) ((uint16_t)(((uint8_t)(r) >> 3) << 11) | \
+	(((uint8_t)(g) >> 2) << 5) | ((uint8_t)(b) >> 3))
+
+enum format {
+	FMT_RGB565 = 0,
+	FMT_RGB1555,
+	FMT_XRGB8888
+};
+
+static const char* format_names[] = {"rgb565", "rgb1555", "xrgb8888"};
+
+/*
+ * per- pixel reference, the way the frameserver used to convert: lookup
+ * tables and a branch on the NTSC intermediate for every pixel
+ */
+static bool lut_ntsc;
+
+static void lut_convert(enum format fmt, const void* src, size_t pitch,
+	size_t w, size_t h, uint32_t* out, uint16_t* out565)
+{
+	for (size_t y = 0; y < h; y++){
+		const uint8_t* row = (const uint8_t*)src + y * pitch;
+		for (size_t x = 0; x < w; x++){
+			uint8_t r, g, b;
+			if (fmt == FMT_XRGB8888){
+				const uint8_t* quad = &row[x * 4];
+				r = quad[2]; g = quad[1]; b = quad[0];
+			}
+			else {
+				uint16_t val;
+				memcpy(&val, &row[x * 2], 2);
+				if (fmt == FMT_RGB565){
+					r = rgb565_lut5[(val & 0xf800) >> 11];
+					g = rgb565_lut6[(val & 0x07e0) >> 5];
+					b = rgb565_lut5[(val & 0x001f)];
+				}
+				else {
+					r = ((val & 0x7c00) >> 10) << 3;
+					g = ((val & 0x03e0) >> 5) << 3;
+					b = (val & 0x001f) << 3;
+				}
+			}
+			if (lut_ntsc)
+				*out565++ = RGB565(r, g, b);
+			else
+				*out++ = RGBA(r, g, b);
+		}
+	}
+}
+
+static void convert(enum format fmt, bool to565, const void* src, size_t pitch,
+	void* dst, size_t dst_pitch, size_t w, size_t h, enum pixconv_order order)
+{
+	switch (fmt){
+	case FMT_RGB565:
+		if (to565)
+			pixconv_rgb565_565(src, pitch, dst, dst_pitch, w, h, order);
+		else
+			pixconv_rgb565(src, pitch, dst, dst_pitch, w, h, order);
+	break;
+	case FMT_RGB1555:
+		if (to565)
+			pixconv_rgb1555_565(src, pitch, dst, dst_pitch, w, h, order);
+		else
+			pixconv_rgb1555(src, pitch, dst, dst_pitch, w, h, order);
+	break;
+	case FMT_XRGB8888:
+		if (to565)
+			pixconv_xrgb8888_565(src, pitch, dst, dst_pitch, w, h, order);
+		else
+			pixconv_xrgb8888(src, pitch, dst, dst_pitch, w, h, order);
+	break;
+	}
+}
+
+static uint32_t swap_rb(uint32_t px)
+{
+	uint32_t rb = px & 0x00ff00ff;
+	return (px & 0xff00ff00) | (rb << 16) | (rb >> 16);
+}
+
+static bool verify(enum format fmt, size_t w, size_t h)
+{
+	size_t bpp = fmt == FMT_XRGB8888 ? 4 : 2;
+	size_t pitch = w * bpp + 24;
+	size_t dst_pitch = w + 3;
+
+	uint8_t* src = malloc(pitch * h);
+	uint32_t* ref = malloc(w * h * 4);
+	uint16_t* ref565 = malloc(w * h * 2);
+	uint32_t* dst = malloc(dst_pitch * h * 4);
+	if (!src || !ref || !ref565 || !dst)
+		exit(EXIT_FAILURE);
+
+	uint32_t seed = 0x1234;
+	for (size_t i = 0; i < pitch * h; i++){
+		seed = seed * 1664525u + 1013904223u;
+		src[i] = seed >> 24;
+	}
+
+	lut_ntsc = false;
+	lut_convert(fmt, src, pitch, w, h, ref, NULL);
+	lut_ntsc = true;
+	lut_convert(fmt, src, pitch, w, h, NULL, ref565);
+	bool ok = true;
+
+	for (size_t o = 0; o < 2 && ok; o++){
+		memset(dst, '\0', dst_pitch * h * 4);
+		convert(fmt, false, src, pitch, dst, dst_pitch, w, h, o);
+		for (size_t y = 0; y < h && ok; y++)
+			for (size_t x = 0; x < w && ok; x++){
+				uint32_t exp = o == PIXCONV_ORDER_RGBA ?
+					ref[y * w + x] : swap_rb(ref[y * w + x]);
+				ok = dst[y * dst_pitch + x] == exp;
+			}
+	}
+
+/* the old conversion produced BGR565 for the NTSC filter, see pixconv.h */
+	uint16_t* dst565 = (uint16_t*) dst;
+	for (size_t o = 0; o < 2 && ok; o++){
+		convert(fmt, true, src, pitch, dst565, dst_pitch, w, h, o);
+		for (size_t y = 0; y < h && ok; y++)
+			for (size_t x = 0; x < w && ok; x++){
+				uint16_t exp = ref565[y * w + x];
+				if (o == PIXCONV_ORDER_BGRA)
+					exp = (exp << 11) | (exp & 0x07e0) | (exp >> 11);
+				ok = dst565[y * dst_pitch + x] == exp;
+			}
+	}
+
+	free(src);
+	free(ref);
+	free(ref565);
+	free(dst);
+	return ok;
+}
+
+static double run(enum format fmt,
+	bool lut, bool to565, size_t w, size_t h, size_t n)
+{
+	size_t bpp = fmt == FMT_XRGB8888 ? 4 : 2;
+	uint8_t* src = malloc(w * h * bpp);
+	uint32_t* dst = malloc(w * h * 4);
+	if (!src || !dst)
+		exit(EXIT_FAILURE);
+
+	for (size_t i = 0; i < w * h * bpp; i++)
+		src[i] = i * 2654435761u >> 24;
+	memset(dst, '\0', w * h * 4);
+
+	uint64_t ts = now_ns();
+	lut_ntsc = to565;
+	for (size_t i = 0; i < n; i++)
+		if (lut)
+			lut_convert(fmt, src, w * bpp, w, h, dst, (uint16_t*) dst);
+		else
+			convert(fmt, to565, src, w * bpp, dst, w, w, h, PIXCONV_ORDER_RGBA);
+	uint64_t ns = now_ns() - ts;
+
+	free(src);
+	free(dst);
+	return (double)ns / n / 1000000.0;
+}
+
+int main(int argc, char** argv)
+{
+	size_t n = 100;
+	if (argc > 1)
+		n = strtoul(argv[1], NULL, 10);
+	if (!n)
+		n = 1;
+
+	static const size_t res[][2] = {
+		{256, 224}, {640, 480}, {1920, 1080}, {3840, 2160}
+	};
+
+	static const enum pixconv_impl impl[] = {
+		PIXCONV_SCALAR, PIXCONV_SSE2, PIXCONV_AVX2, PIXCONV_NEON
+	};
+
+	for (size_t fmt = FMT_RGB565; fmt <= FMT_XRGB8888; fmt++)
+		for (size_t r = 0; r < sizeof(res) / sizeof(res[0]); r++){
+			size_t w = res[r][0], h = res[r][1];
+			double ms = run(fmt, true, false, w, h, n);
+			double ms565 = run(fmt, true, true, w, h, n);
+			printf("%-6s %-8s %4zux%-4zu %7.3f ms/frame (%7.1f Mpx/s), "
+				"ntsc565: %7.3f ms/frame\n", "lut", format_names[fmt],
+				w, h, ms, (double)(w * h) / ms / 1000.0, ms565);
+		}
+
+	for (size_t i = 0; i < sizeof(impl) / sizeof(impl[0]); i++){
+		if (!pixconv_set_impl(impl[i]))
+			continue;
+
+		for (size_t fmt = FMT_RGB565; fmt <= FMT_XRGB8888; fmt++){
+			if (!verify(fmt, 37, 5) || !verify(fmt, 1917, 31)){
+				fprintf(stderr, "%s %s: mismatch against reference\n",
+					pixconv_impl_name(), format_names[fmt]);
+				return EXIT_FAILURE;
+			}
+
+			for (size_t r = 0; r < sizeof(res) / sizeof(res[0]); r++){
+				size_t w = res[r][0], h = res[r][1];
+				double ms = run(fmt, false, false, w, h, n);
+				double ms565 = run(fmt, false, true, w, h, n);
+				printf("%-6s %-8s %4zux%-4zu %7.3f ms/frame (%7.1f Mpx/s), "
+					"ntsc565: %7.3f ms/frame\n", pixconv_impl_name(),
+					format_names[fmt], w, h, ms, (double)(w * h) / ms / 1000.0, ms565);
+			}
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,189 @@
+/*
+ * Microbenchmark for the rewind store in frameserver/util/stateman.c, as
+ * used by the game frameserver for rollback and seeking.
+ *
+ * A synthetic 'emulator state' is mutated every frame: a few spans of
+ * work RAM, a frame counter and (for the 'video' scenario) a larger VRAM
+ * region, with the rest of the block (ROM mirrors, unused banks) constant.
+ * The states are fed to the store, and a few seeks backwards are timed and
+ * checked against copies of the states that were taken while feeding.
+ *
+ * Reported: stored bytes per frame (against the state size a flat ring would
+ * need), feed cost and seek latency for 1, precision/2 and precision-1 frames
+ * back and for the oldest state still in the store.
+ *
+ * Usage: statebench [n_frames] [precision]
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "stateman.h"
+
+static uint64_t now_ns()
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return (uint64_t)tp.tv_sec * 1000000000ull + tp.tv_nsec;
+}
+
+static uint32_t rnd(uint32_t* seed)
+{
+	*seed = *seed * 1664525u + 1013904223u;
+	return *seed >> 8;
+}
+
+enum scenario {
+	SC_IDLE = 0,
+	SC_GAME,
+	SC_VIDEO
+};
+
+static const char* scenario_names[] = {"idle", "game", "video"};
+
+static void step(uint8_t* state, size_t sz, enum scenario sc, uint32_t* seed, int i)
+{
+/* frame counter at a fixed spot, even 'idle' has that */
+	memcpy(state, &i, sizeof(int));
+	if (sc == SC_IDLE)
+		return;
+
+/* wram: the first 1/16th of the block, a handful of short writes */
+	size_t wram = sz / 16;
+	for (size_t k = 0; k < 64; k++){
+		size_t ofs = 16 + rnd(seed) % (wram - 32);
+		size_t len = 1 + rnd(seed) % 16;
+		for (size_t j = 0; j < len; j++)
+			state[ofs + j] = rnd(seed);
+	}
+
+	if (sc != SC_VIDEO)
+		return;
+
+/* vram: the next 1/8th, a few tile- sized spans rewritten */
+	size_t vram = sz / 8;
+	for (size_t k = 0; k < 32; k++){
+		size_t ofs = wram + (rnd(seed) % (vram / 64)) * 64;
+		for (size_t j = 0; j < 64; j++)
+			state[ofs + j] = rnd(seed);
+	}
+}
+
+static double seek_ms(struct stateman_ctx* ctx, uint8_t* dst,
+	int back, const uint8_t* ref, size_t sz, bool* ok)
+{
+	uint64_t ts = now_ns();
+	bool rv = stateman_seek(ctx, dst, back, true);
+	double ms = (double)(now_ns() - ts) / 1000000.0;
+
+	if (!rv || (ref && memcmp(ref, dst, sz)))
+		*ok = false;
+
+/* jump back to the front so the next seek starts from the same place */
+	stateman_seek(ctx, NULL, 0, true);
+	return ms;
+}
+
+static void run(size_t sz, enum scenario sc, int n, int precision)
+{
+	uint8_t* state = malloc(sz);
+	uint8_t* dst = malloc(sz);
+	int back[3] = {1, precision / 2, precision - 1};
+	uint8_t* refs[3];
+
+	for (size_t i = 0; i < 3; i++)
+		refs[i] = malloc(sz);
+
+	if (!state || !dst || !refs[0] || !refs[1] || !refs[2])
+		exit(EXIT_FAILURE);
+
+/* fault in dst so the first timed seek doesn't pay for it */
+	memset(dst, '\0', sz);
+
+/* 'rom': incompressible but constant */
+	uint32_t seed = 0xdeadbeef;
+	for (size_t i = 0; i < sz; i++)
+		state[i] = rnd(&seed);
+
+	struct stateman_ctx* ctx = stateman_setup(sz, -(n + precision), precision);
+	if (!ctx)
+		exit(EXIT_FAILURE);
+
+	uint64_t feed_ns = 0;
+	for (int i = 1; i <= n; i++){
+		step(state, sz, sc, &seed, i);
+
+		for (size_t k = 0; k < 3; k++)
+			if (i == n - back[k])
+				memcpy(refs[k], state, sz);
+
+		uint64_t ts = now_ns();
+		stateman_feed(ctx, i, state);
+		feed_ns += now_ns() - ts;
+	}
+
+	bool ok = true;
+	double seek[4];
+/* untimed, the first pass over the store is dominated by cache misses */
+	seek_ms(ctx, dst, 1, NULL, sz, &ok);
+	for (size_t k = 0; k < 3; k++)
+		seek[k] = seek_ms(ctx, dst, back[k], refs[k], sz, &ok);
+
+/* clamped to the oldest */
+	seek[3] = seek_ms(ctx, dst, n, NULL, sz, &ok);
+
+	if (!stateman_seek(ctx, dst, 0, true) || memcmp(dst, state, sz))
+		ok = false;
+
+	if (!ok){
+		fprintf(stderr, "%zuk %s: reconstruction mismatch\n",
+			sz / 1024, scenario_names[sc]);
+		exit(EXIT_FAILURE);
+	}
+
+	struct stateman_stats stats;
+	stateman_stats(ctx, &stats);
+
+	printf("%5zuk %-5s %8.1f bytes/frame (%5.2f%%) feed: %6.3f ms "
+		"seek(1, %d, %d, oldest): %6.3f %6.3f %6.3f %6.3f ms\n",
+		sz / 1024, scenario_names[sc],
+		(double)stats.bytes / stats.n_states,
+		100.0 * (double)stats.bytes / ((double)stats.n_states * sz),
+		(double)feed_ns / n / 1000000.0, back[1], back[2],
+		seek[0], seek[1], seek[2], seek[3]
+	);
+
+	stateman_drop(&ctx);
+	for (size_t i = 0; i < 3; i++)
+		free(refs[i]);
+	free(state);
+	free(dst);
+}
+
+int main(int argc, char** argv)
+{
+	int n = 600;
+	int precision = 60;
+
+	if (argc > 1)
+		n = strtol(argv[1], NULL, 10);
+	if (argc > 2)
+		precision = strtol(argv[2], NULL, 10);
+	if (precision < 2)
+		precision = 2;
+	if (n < precision)
+		n = precision;
+
+/* roughly 8-bit/16-bit, 32-bit and 'modern' core state sizes */
+	static const size_t sizes[] = {256 * 1024, 2 * 1024 * 1024, 8 * 1024 * 1024};
+
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+		for (size_t sc = SC_IDLE; sc <= SC_VIDEO; sc++)
+			run(sizes[i], sc, n, precision);
+
+	return EXIT_SUCCESS;
+}
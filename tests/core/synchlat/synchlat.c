@@ -0,0 +1,216 @@
+/*
+ * Microbenchmark for the shmif video synchronization round-trip, i.e. the
+ * time a client spends in arcan_shmif_signal(SIGVID) until the server has
+ * consumed the buffer and woken it up again.
+ *
+ * The same server loop is run against two forked clients, the first one with
+ * ARCAN_SHMIF_NOFUTEX set (semaphores) and the second one allowed to
+ * negotiate the futex synchronization mode (where the platform supports it).
+ *
+ * The resize round-trip is measured the same way, alternating between two
+ * sizes so that every resize is negotiated. A resize that takes longer than
+ * the wait timeout of the futex mode means the client missed its wakeup and
+ * fails the run.
+ *
+ * Usage: synchlat [n_frames]
+ */
+#include <arcan_shmif.h>
+#include <arcan_shmif_server.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+static uint64_t now_ns()
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return (uint64_t)tp.tv_sec * 1000000000ull + tp.tv_nsec;
+}
+
+static int cmp_u64(const void* a, const void* b)
+{
+	uint64_t va = *(const uint64_t*)a;
+	uint64_t vb = *(const uint64_t*)b;
+	return va < vb ? -1 : va > vb;
+}
+
+/* the timeout for a futex- waiting client, see arcan_shmif_control.c */
+#define WAKEUP_TIMEOUT_NS 1000000000ull
+
+static void report(const char* mode, const char* what,
+	uint64_t* samples, size_t n, uint64_t sum)
+{
+	qsort(samples, n, sizeof(uint64_t), cmp_u64);
+	printf("%-6s %-7s %6zu avg: %8.2f us p50: %8.2f us "
+		"p99: %8.2f us max: %8.2f us\n", mode, what, n,
+		(double)sum / n / 1000.0,
+		(double)samples[n / 2] / 1000.0,
+		(double)samples[(n * 99) / 100] / 1000.0,
+		(double)samples[n - 1] / 1000.0
+	);
+}
+
+static void run_client(const char* mode, size_t n)
+{
+	struct arcan_shmif_cont cont = arcan_shmif_open(
+		SEGID_APPLICATION, SHMIF_ACQUIRE_FATALFAIL, NULL);
+
+	uint64_t* samples = malloc(sizeof(uint64_t) * n);
+	if (!samples)
+		exit(EXIT_FAILURE);
+
+/* warm up both sides before sampling */
+	for (size_t i = 0; i < 100; i++)
+		arcan_shmif_signal(&cont, SHMIF_SIGVID);
+
+	uint64_t sum = 0;
+	for (size_t i = 0; i < n; i++){
+		cont.vidp[0] = SHMIF_RGBA(i & 0xff, 0x00, 0x00, 0xff);
+		uint64_t ts = now_ns();
+		arcan_shmif_signal(&cont, SHMIF_SIGVID);
+		samples[i] = now_ns() - ts;
+		sum += samples[i];
+	}
+
+	report(mode, "frames", samples, n, sum);
+
+	size_t nr = n / 50 ? n / 50 : 1;
+	sum = 0;
+	for (size_t i = 0; i < nr; i++){
+		size_t sz = i % 2 ? 64 : 32;
+		uint64_t ts = now_ns();
+		if (!arcan_shmif_resize(&cont, sz, sz)){
+			fprintf(stderr, "%s: resize to %zu*%zu failed\n", mode, sz, sz);
+			exit(EXIT_FAILURE);
+		}
+		samples[i] = now_ns() - ts;
+		sum += samples[i];
+	}
+
+	report(mode, "resize", samples, nr, sum);
+	bool stalled = samples[nr - 1] >= WAKEUP_TIMEOUT_NS;
+
+	free(samples);
+	arcan_shmif_drop(&cont);
+
+	if (stalled){
+		fprintf(stderr, "%s: resize waited for the timeout\n", mode);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/*
+ * Busy-polls the client so the measured latency is dominated by the wakeup
+ * path and not by the server sleeping.
+ */
+static void run_server(struct shmifsrv_client* cl)
+{
+	bool alive = true;
+	shmifsrv_monotonic_rebase();
+
+	while (alive){
+		int sv;
+		while ((sv = shmifsrv_poll(cl)) != CLIENT_NOT_READY){
+			if (sv == CLIENT_DEAD){
+				alive = false;
+				break;
+			}
+			else if (sv == CLIENT_VBUFFER_READY)
+				shmifsrv_video(cl, true);
+			else if (sv == CLIENT_ABUFFER_READY)
+				shmifsrv_audio(cl, NULL, 0);
+		}
+
+		struct arcan_event ev;
+		while (1 == shmifsrv_dequeue_events(cl, &ev, 1)){
+			if (ev.category == EVENT_EXTERNAL &&
+				ev.ext.kind == EVENT_EXTERNAL_REGISTER){
+				shmifsrv_enqueue_event(cl, &(struct arcan_event){
+					.category = EVENT_TARGET,
+					.tgt.kind = TARGET_COMMAND_ACTIVATE
+				}, -1);
+			}
+			else
+				shmifsrv_process_event(cl, &ev);
+		}
+
+/* the connection socket is the only reliable hangup indicator here, but
+ * there is no need to pay for that syscall on every iteration */
+		int ticks = shmifsrv_monotonic_tick(NULL);
+		if (!ticks)
+			continue;
+
+		while(ticks--)
+			shmifsrv_tick(cl);
+
+		struct pollfd pfd = {
+			.fd = shmifsrv_client_handle(cl),
+			.events = POLLIN | POLLERR | POLLHUP
+		};
+		if (poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLERR | POLLHUP)))
+			alive = false;
+	}
+}
+
+static bool run_mode(const char* mode, bool futex, size_t n)
+{
+	int fd = -1;
+	int sc = 0;
+	char cpoint[32];
+	snprintf(cpoint, sizeof(cpoint), "synchlat_%d", (int) getpid());
+
+	struct shmifsrv_client* cl =
+		shmifsrv_allocate_connpoint(cpoint, NULL, S_IRWXU, &fd, &sc, 0);
+
+	if (!cl){
+		fprintf(stderr, "couldn't allocate connection point (%d)\n", sc);
+		return false;
+	}
+
+	pid_t pid = fork();
+	if (pid == -1){
+		shmifsrv_free(cl);
+		return false;
+	}
+
+	if (pid == 0){
+		setenv("ARCAN_CONNPATH", cpoint, 1);
+		if (futex)
+			unsetenv("ARCAN_SHMIF_NOFUTEX");
+		else
+			setenv("ARCAN_SHMIF_NOFUTEX", "1", 1);
+
+		run_client(mode, n);
+		exit(EXIT_SUCCESS);
+	}
+
+	run_server(cl);
+	shmifsrv_free(cl);
+	if (-1 != fd)
+		close(fd);
+
+	int status;
+	while (-1 == waitpid(pid, &status, 0) && errno == EINTR){}
+	return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+	size_t n = 10000;
+	if (argc > 1){
+		n = strtoul(argv[1], NULL, 10);
+		if (!n){
+			fprintf(stderr, "usage: synchlat [n_frames > 0]\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	bool ok = run_mode("sem", false, n);
+	ok = run_mode("futex", true, n) && ok;
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
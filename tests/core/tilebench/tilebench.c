@@ -0,0 +1,189 @@
+/*
+ * Microbenchmark for the comparison step in the headless platform encode
+ * output, i.e. finding what changed between a readback of the world and the
+ * buffer the encoder has, and updating the encoder buffer to match.
+ *
+ * The tiled comparison in platform/headless/tilediff.c is run against the
+ * per-row scalar XOR bounding box scan that it replaced, for a few output
+ * resolutions and three kinds of frames: nothing changed, a small region
+ * (cursor- sized) moved, everything changed. The readback itself is not
+ * measured as that needs a GL context.
+ *
+ * Usage: tilebench [n_frames]
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "tilediff.h"
+
+static uint64_t now_ns()
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return (uint64_t)tp.tv_sec * 1000000000ull + tp.tv_nsec;
+}
+
+/* the previous readback_encode loop, kept here as the reference */
+static size_t scalar_update(const uint32_t* src,
+	uint32_t* dst, size_t w, size_t h, struct tilediff_rect* bbox)
+{
+	bool in_dirty = false;
+	size_t x1 = w - 1, x2 = 0, y1 = 0, y2 = 0;
+	size_t dst_row = h - 1;
+
+	for (size_t row = 0; row < h; row++, dst_row--){
+		uint32_t acc = 0;
+		for (size_t px = 0; px < w; px++)
+			acc |= src[row * w + px] ^ dst[dst_row * w + px];
+
+		if (!acc)
+			continue;
+
+		if (!in_dirty){
+			in_dirty = true;
+			y2 = dst_row;
+		}
+		y1 = dst_row;
+
+		for (size_t tx = 0; tx < x1; tx++)
+			if (dst[dst_row * w + tx] != src[row * w + tx]){
+				x1 = tx;
+				break;
+			}
+
+		for (size_t tx = w - 1; tx > x2; tx--)
+			if (dst[dst_row * w + tx] != src[row * w + tx]){
+				x2 = tx;
+				break;
+			}
+
+		memcpy(&dst[dst_row * w], &src[row * w], w * sizeof(uint32_t));
+	}
+
+	*bbox = (struct tilediff_rect){x1, y1, x2 + 1, y2 + 1};
+	return in_dirty;
+}
+
+enum scenario {
+	SC_STATIC = 0,
+	SC_CURSOR,
+	SC_FULL
+};
+
+static const char* scenario_names[] = {"static", "cursor", "full"};
+
+/* returns the damaged region, like the engine would report it */
+static struct tilediff_rect step(
+	uint32_t* src, size_t w, size_t h, enum scenario sc, size_t i)
+{
+	if (sc == SC_STATIC)
+		return (struct tilediff_rect){0};
+
+	if (sc == SC_FULL){
+		for (size_t j = 0; j < w * h; j++)
+			src[j] = 0xff000000 | (uint32_t)(i * 2654435761u + j);
+		return (struct tilediff_rect){0, 0, w, h};
+	}
+
+/* erase the old box and draw it one step further along */
+	size_t bw = 32, bh = 32;
+	struct tilediff_rect dmg = {w, h, 0, 0};
+
+	for (size_t k = 0; k < 2; k++){
+		size_t ofs = (i - k) * 7;
+		size_t x = ofs % (w - bw), y = (ofs * 3) % (h - bh);
+		uint32_t col = k ? 0xff202020 : 0xffffffff;
+		for (size_t row = y; row < y + bh; row++)
+			for (size_t px = x; px < x + bw; px++)
+				src[row * w + px] = col;
+
+		dmg.x1 = x < dmg.x1 ? x : dmg.x1;
+		dmg.y1 = y < dmg.y1 ? y : dmg.y1;
+		dmg.x2 = x + bw > dmg.x2 ? x + bw : dmg.x2;
+		dmg.y2 = y + bh > dmg.y2 ? y + bh : dmg.y2;
+	}
+
+	return dmg;
+}
+
+static bool verify(const uint32_t* src, const uint32_t* dst, size_t w, size_t h)
+{
+	for (size_t row = 0; row < h; row++)
+		if (memcmp(&src[row * w], &dst[(h - 1 - row) * w], w * sizeof(uint32_t)))
+			return false;
+	return true;
+}
+
+static void run(size_t w, size_t h, enum scenario sc, size_t n)
+{
+	size_t sz = w * h * sizeof(uint32_t);
+	uint32_t* src = malloc(sz);
+	uint32_t* dst = malloc(sz);
+	if (!src || !dst)
+		exit(EXIT_FAILURE);
+
+	struct tilediff_rect runs[32];
+	struct tilediff_rect bbox;
+	uint64_t ns[3] = {0};
+	size_t n_runs = 0;
+
+/* mode 0: scalar, 1: tiled over everything, 2: tiled over the damage */
+	for (size_t m = 0; m < 3; m++){
+		for (size_t j = 0; j < w * h; j++)
+			src[j] = dst[j] = 0xff202020;
+
+		for (size_t i = 1; i <= n; i++){
+			struct tilediff_rect dmg = step(src, w, h, sc, i);
+			uint64_t ts = now_ns();
+
+			if (m == 0)
+				scalar_update(src, dst, w, h, &bbox);
+			else{
+				size_t nr = tilediff_update(src, w, dst, w, w, h, true,
+					m == 1 ? (struct tilediff_rect){0, 0, w, h} : dmg, runs, 32, &bbox);
+				if (m == 1)
+					n_runs += nr;
+			}
+
+			ns[m] += now_ns() - ts;
+		}
+
+		if (!verify(src, dst, w, h)){
+			fprintf(stderr, "%zux%zu %s: mismatch in mode %zu\n",
+				w, h, scenario_names[sc], m);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	printf("%4zux%-4zu %-6s scalar: %7.3f tiled: %7.3f damaged: %7.3f ms/frame"
+		" (runs: %.1f)\n", w, h, scenario_names[sc],
+		(double)ns[0] / n / 1000000.0, (double)ns[1] / n / 1000000.0,
+		(double)ns[2] / n / 1000000.0, (double)n_runs / n
+	);
+
+	free(src);
+	free(dst);
+}
+
+int main(int argc, char** argv)
+{
+	size_t n = 100;
+	if (argc > 1)
+		n = strtoul(argv[1], NULL, 10);
+	if (!n)
+		n = 1;
+
+	static const size_t res[][2] = {
+		{1280, 720}, {1920, 1080}, {2560, 1440}, {3840, 2160}
+	};
+
+	for (size_t i = 0; i < sizeof(res) / sizeof(res[0]); i++)
+		for (size_t sc = SC_STATIC; sc <= SC_FULL; sc++)
+			run(res[i][0], res[i][1], sc, n);
+
+	return EXIT_SUCCESS;
+}
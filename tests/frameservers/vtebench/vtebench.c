@@ -0,0 +1,122 @@
+/*
+ * Parser throughput benchmark for the terminal emulator state machine
+ * (frameserver/terminal/default/tsm), connects as a TUI client and feeds
+ * the contents of one or more recorded terminal captures (e.g. from
+ * script(1) or plain program output with the escape codes intact)
+ * through tsm_vte_input, reporting MB/s per capture.
+ *
+ * usage: vtebench [-c chunk_sz] [-n passes] capture1 [capture2 ...]
+ */
+#include <arcan_shmif.h>
+#include <arcan_tui.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <getopt.h>
+#include "tsm/libtsm.h"
+#include "tsm/libtsm_int.h"
+
+static void write_callback(struct tsm_vte* vte,
+	const char* u8, size_t len, void* data)
+{
+/* replies (DSR, DA, ...) have nowhere to go */
+}
+
+static void str_callback(struct tsm_vte* vte, enum tsm_vte_group group,
+	const char* msg, size_t len, bool crop, void* tag)
+{
+}
+
+static bool load_capture(const char* path, char** out, size_t* out_sz)
+{
+	FILE* fpek = fopen(path, "r");
+	if (!fpek)
+		return false;
+
+	fseek(fpek, 0, SEEK_END);
+	long sz = ftell(fpek);
+	fseek(fpek, 0, SEEK_SET);
+	if (sz <= 0){
+		fclose(fpek);
+		return false;
+	}
+
+	*out = malloc(sz);
+	*out_sz = fread(*out, 1, sz, fpek);
+	fclose(fpek);
+
+	return *out_sz > 0;
+}
+
+int main(int argc, char** argv)
+{
+	size_t chunk = 4096;
+	size_t passes = 4;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "c:n:")) != -1){
+		switch (ch){
+		case 'c':
+			chunk = strtoul(optarg, NULL, 10);
+		break;
+		case 'n':
+			passes = strtoul(optarg, NULL, 10);
+		break;
+		default:
+			fprintf(stderr, "usage: vtebench [-c chunk_sz] [-n passes] capture1 ...\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (optind >= argc || !chunk || !passes){
+		fprintf(stderr, "usage: vtebench [-c chunk_sz] [-n passes] capture1 ...\n");
+		return EXIT_FAILURE;
+	}
+
+	arcan_tui_conn* conn = arcan_tui_open_display("vtebench", "");
+	struct tui_cbcfg cbcfg = {};
+	struct tui_settings cfg = arcan_tui_defaults(conn, NULL);
+	struct tui_context* tui = arcan_tui_setup(conn, &cfg, &cbcfg, sizeof(cbcfg));
+
+	if (!tui){
+		fprintf(stderr, "failed to setup TUI connection\n");
+		return EXIT_FAILURE;
+	}
+
+	struct tsm_vte* vte;
+	if (tsm_vte_new(&vte, tui, write_callback, NULL) < 0){
+		arcan_tui_destroy(tui, "couldn't setup terminal emulator");
+		return EXIT_FAILURE;
+	}
+	tsm_set_strhandler(vte, str_callback, 256, NULL);
+
+	printf("capture:bytes:passes:ms:MB/s\n");
+
+	for (int i = optind; i < argc; i++){
+		char* buf;
+		size_t buf_sz;
+		if (!load_capture(argv[i], &buf, &buf_sz)){
+			fprintf(stderr, "couldn't load capture: %s\n", argv[i]);
+			continue;
+		}
+
+/* the refresh per pass is not part of the measurement, but keeps the
+ * screen state from building up damage that would skew the next pass */
+		unsigned long long total = 0;
+		for (size_t pass = 0; pass < passes; pass++){
+			unsigned long long start = arcan_timemillis();
+			for (size_t ofs = 0; ofs < buf_sz; ofs += chunk)
+				tsm_vte_input(vte, &buf[ofs], ofs + chunk > buf_sz ? buf_sz - ofs : chunk);
+			total += arcan_timemillis() - start;
+			arcan_tui_refresh(tui);
+		}
+
+		double mbs = total ?
+			(double)(buf_sz * passes) / 1048.576 / (double) total : 0.0;
+		printf("%s:%zu:%zu:%llu:%.2f\n", argv[i], buf_sz, passes, total, mbs);
+		free(buf);
+	}
+
+	arcan_tui_destroy(tui, NULL);
+	return EXIT_SUCCESS;
+}